@@ -93,6 +93,7 @@ static const pa_daemon_conf default_conf = {
     .no_cpu_limit = true,
     .disable_shm = false,
     .disable_memfd = true,
+    .hugepages = false,
     .lock_memory = false,
     .deferred_volume = true,
     .default_n_fragments = 4,
@@ -169,6 +170,7 @@ void pa_daemon_conf_free(pa_daemon_conf *c) {
     pa_xfree(c->script_commands);
     pa_xfree(c->dl_search_path);
     pa_xfree(c->default_script_file);
+    pa_xfree(c->io_thread_cpus);
 
     if (c->log_target)
         pa_log_target_free(c->log_target);
@@ -294,6 +296,24 @@ static int parse_resample_method(pa_config_parser_state *state) {
     return 0;
 }
 
+static int parse_cpu_list(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if (*state->rvalue && pa_parse_cpu_list(state->rvalue, NULL, 0) < 0) {
+        pa_log(_("[%s:%u] Invalid CPU list '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    pa_xfree(c->io_thread_cpus);
+    c->io_thread_cpus = *state->rvalue ? pa_xstrdup(state->rvalue) : NULL;
+
+    return 0;
+}
+
 #ifdef HAVE_SYS_RESOURCE_H
 static int parse_rlimit(pa_config_parser_state *state) {
     struct pa_rlimit *r;
@@ -528,12 +548,15 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "disable-shm",                pa_config_parse_bool,     &c->disable_shm, NULL },
         { "enable-shm",                 pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "enable-memfd",               pa_config_parse_not_bool, &c->disable_memfd, NULL },
+        { "enable-hugepages",           pa_config_parse_bool,     &c->hugepages, NULL },
         { "flat-volumes",               pa_config_parse_bool,     &c->flat_volumes, NULL },
         { "lock-memory",                pa_config_parse_bool,     &c->lock_memory, NULL },
         { "enable-deferred-volume",     pa_config_parse_bool,     &c->deferred_volume, NULL },
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
         { "scache-idle-time",           pa_config_parse_int,      &c->scache_idle_time, NULL },
         { "realtime-priority",          parse_rtprio,             c, NULL },
+        { "io-thread-cpus",             parse_cpu_list,           c, NULL },
+        { "spread-io-threads",          pa_config_parse_bool,     &c->io_thread_spread, NULL },
         { "dl-search-path",             pa_config_parse_string,   &c->dl_search_path, NULL },
         { "default-script-file",        pa_config_parse_string,   &c->default_script_file, NULL },
         { "log-target",                 parse_log_target,         c, NULL },
@@ -728,6 +751,8 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "nice-level = %i\n", c->nice_level);
     pa_strbuf_printf(s, "realtime-scheduling = %s\n", pa_yes_no(c->realtime_scheduling));
     pa_strbuf_printf(s, "realtime-priority = %i\n", c->realtime_priority);
+    pa_strbuf_printf(s, "io-thread-cpus = %s\n", pa_strempty(c->io_thread_cpus));
+    pa_strbuf_printf(s, "spread-io-threads = %s\n", pa_yes_no(c->io_thread_spread));
     pa_strbuf_printf(s, "allow-module-loading = %s\n", pa_yes_no(!c->disallow_module_loading));
     pa_strbuf_printf(s, "allow-exit = %s\n", pa_yes_no(!c->disallow_exit));
     pa_strbuf_printf(s, "use-pid-file = %s\n", pa_yes_no(c->use_pid_file));
@@ -761,6 +786,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "deferred-volume-safety-margin-usec = %u\n", c->deferred_volume_safety_margin_usec);
     pa_strbuf_printf(s, "deferred-volume-extra-delay-usec = %d\n", c->deferred_volume_extra_delay_usec);
     pa_strbuf_printf(s, "shm-size-bytes = %lu\n", (unsigned long) c->shm_size);
+    pa_strbuf_printf(s, "enable-hugepages = %s\n", pa_yes_no(c->hugepages));
     pa_strbuf_printf(s, "log-meta = %s\n", pa_yes_no(c->log_meta));
     pa_strbuf_printf(s, "log-time = %s\n", pa_yes_no(c->log_time));
     pa_strbuf_printf(s, "log-backtrace = %u\n", c->log_backtrace);
@@ -67,6 +67,7 @@ typedef struct pa_daemon_conf {
         no_cpu_limit,
         disable_shm,
         disable_memfd,
+        hugepages,
         disable_remixing,
         disable_lfe_remixing,
         load_default_script_file,
@@ -75,7 +76,8 @@ typedef struct pa_daemon_conf {
         log_time,
         flat_volumes,
         lock_memory,
-        deferred_volume;
+        deferred_volume,
+        io_thread_spread;
     pa_server_type_t local_server_type;
     int exit_idle_time,
         scache_idle_time,
@@ -83,6 +85,7 @@ typedef struct pa_daemon_conf {
         nice_level,
         resample_method;
     char *script_commands, *dl_search_path, *default_script_file;
+    char *io_thread_cpus;
     pa_log_target *log_target;
     pa_log_level_t log_level;
     unsigned log_backtrace;
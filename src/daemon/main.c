@@ -1019,7 +1019,7 @@ int main(int argc, char *argv[]) {
 
     if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm,
                           !conf->disable_shm && !conf->disable_memfd && pa_memfd_is_locally_supported(),
-                          conf->shm_size))) {
+                          conf->shm_size, conf->hugepages))) {
         pa_log(_("pa_core_new() failed."));
         goto finish;
     }
@@ -1037,6 +1037,8 @@ int main(int argc, char *argv[]) {
     c->resample_method = conf->resample_method;
     c->realtime_priority = conf->realtime_priority;
     c->realtime_scheduling = conf->realtime_scheduling;
+    c->io_thread_cpus = pa_xstrdup(conf->io_thread_cpus);
+    c->io_thread_spread = conf->io_thread_spread;
     c->disable_remixing = conf->disable_remixing;
     c->disable_lfe_remixing = conf->disable_lfe_remixing;
     c->deferred_volume = conf->deferred_volume;
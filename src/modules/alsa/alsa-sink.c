@@ -2002,7 +2002,7 @@ static int setup_mixer(struct userdata *u, bool ignore_dB) {
 pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_card *card, pa_alsa_mapping *mapping) {
 
     struct userdata *u = NULL;
-    const char *dev_id = NULL, *key, *mod_name;
+    const char *dev_id = NULL, *key, *mod_name, *cpus;
     pa_sample_spec ss;
     char *thread_name = NULL;
     uint32_t alternate_sample_rate;
@@ -2294,6 +2294,16 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
         goto fail;
     }
 
+    if ((cpus = pa_modargs_get_value(ma, "cpu_affinity", NULL))) {
+        if (pa_parse_cpu_list(cpus, NULL, 0) < 0) {
+            pa_log("Invalid CPU list '%s'.", cpus);
+            pa_sink_new_data_done(&data);
+            goto fail;
+        }
+
+        pa_sink_new_data_set_cpu_affinity(&data, cpus);
+    }
+
     if (u->ucm_context)
         pa_alsa_ucm_add_ports(&data.ports, data.proplist, u->ucm_context, true, card);
     else if (u->mixer_path_set)
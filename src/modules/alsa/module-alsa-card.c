@@ -69,6 +69,7 @@ PA_MODULE_USAGE(
         "profile_set=<profile set configuration file> "
         "paths_dir=<directory containing the path configuration files> "
         "use_ucm=<load use case manager> "
+        "cpu_affinity=<CPUs to run the IO threads on> "
 );
 
 static const char* const valid_modargs[] = {
@@ -96,6 +97,7 @@ static const char* const valid_modargs[] = {
     "profile_set",
     "paths_dir",
     "use_ucm",
+    "cpu_affinity",
     NULL
 };
 
@@ -0,0 +1,245 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/once.h>
+
+#include "rtp.h"
+#include "a2dp-sbc.h"
+
+ssize_t pa_a2dp_sbc_encode_packet(sbc_t *sbc, uint16_t seq_num, uint32_t timestamp,
+                                  const void *pcm, size_t pcm_size, void *packet, size_t packet_size) {
+    struct rtp_header *header;
+    struct rtp_payload *payload;
+    size_t to_write;
+    unsigned frame_count = 0;
+    uint8_t *d;
+
+    pa_assert(sbc);
+    pa_assert(pcm);
+    pa_assert(packet);
+
+    if (packet_size < sizeof(*header) + sizeof(*payload))
+        return -1;
+
+    header = packet;
+    payload = (struct rtp_payload*) ((uint8_t*) packet + sizeof(*header));
+
+    d = (uint8_t*) packet + sizeof(*header) + sizeof(*payload);
+    to_write = packet_size - sizeof(*header) - sizeof(*payload);
+
+    while (PA_LIKELY(pcm_size > 0 && to_write > 0)) {
+        ssize_t written;
+        ssize_t encoded;
+
+        encoded = sbc_encode(sbc, pcm, pcm_size, d, to_write, &written);
+
+        if (PA_UNLIKELY(encoded <= 0)) {
+            pa_log_error("SBC encoding error (%li)", (long) encoded);
+            return -1;
+        }
+
+        pa_assert_fp((size_t) encoded <= pcm_size);
+        pa_assert_fp((size_t) written <= to_write);
+
+        pcm = (const uint8_t*) pcm + encoded;
+        pcm_size -= encoded;
+
+        d += written;
+        to_write -= written;
+
+        frame_count++;
+    }
+
+    if (pcm_size > 0)
+        return -1;
+
+    memset(packet, 0, sizeof(*header) + sizeof(*payload));
+    header->v = 2;
+    header->pt = 1;
+    header->sequence_number = htons(seq_num);
+    header->timestamp = htonl(timestamp);
+    header->ssrc = htonl(1);
+    payload->frame_count = frame_count;
+
+    return d - (uint8_t*) packet;
+}
+
+size_t pa_a2dp_sbc_block_size(sbc_t *sbc, size_t mtu) {
+    pa_assert(sbc);
+    pa_assert(mtu > sizeof(struct rtp_header) + sizeof(struct rtp_payload));
+
+    return (mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
+        / sbc_get_frame_length(sbc) * sbc_get_codesize(sbc);
+}
+
+void pa_a2dp_sbc_writer_init(pa_a2dp_sbc_writer *w, sbc_t *sbc, const pa_sample_spec *ss, bool encode_ahead,
+                             pa_a2dp_render_cb_t render, void *userdata) {
+    pa_assert(w);
+    pa_assert(sbc);
+    pa_assert(ss);
+    pa_assert(render);
+
+    pa_zero(*w);
+    w->sbc = sbc;
+    w->sample_spec = ss;
+    w->encode_ahead = encode_ahead;
+    w->render = render;
+    w->userdata = userdata;
+}
+
+void pa_a2dp_sbc_writer_done(pa_a2dp_sbc_writer *w) {
+    pa_assert(w);
+
+    pa_xfree(w->packet);
+    w->packet = NULL;
+    w->packet_max = w->packet_size = w->packet_pcm_size = 0;
+}
+
+void pa_a2dp_sbc_writer_reset(pa_a2dp_sbc_writer *w) {
+    pa_assert(w);
+
+    w->packet_size = w->packet_pcm_size = 0;
+}
+
+int pa_a2dp_sbc_writer_encode(pa_a2dp_sbc_writer *w, uint64_t write_index, size_t block_size, size_t mtu) {
+    pa_memchunk memchunk;
+    ssize_t nbytes;
+
+    pa_assert(w);
+    pa_assert(w->packet_size == 0);
+    pa_assert(block_size > 0);
+
+    if (w->packet_max < mtu) {
+        pa_xfree(w->packet);
+        w->packet_max = 2 * mtu;
+        w->packet = pa_xmalloc(w->packet_max);
+    }
+
+    w->render(block_size, &memchunk, w->userdata);
+
+    /* Try to create a packet of the full MTU */
+    nbytes = pa_a2dp_sbc_encode_packet(w->sbc, w->seq_num, write_index / pa_frame_size(w->sample_spec),
+                                       pa_memblock_acquire_chunk(&memchunk), memchunk.length,
+                                       w->packet, mtu);
+
+    pa_memblock_release(memchunk.memblock);
+    pa_memblock_unref(memchunk.memblock);
+
+    if (nbytes < 0)
+        return -1;
+
+    /* Only packets that were actually created take a sequence number */
+    w->seq_num++;
+
+    PA_ONCE_BEGIN {
+        pa_log_debug("Using SBC encoder implementation: %s", pa_strnull(sbc_get_implementation_info(w->sbc)));
+    } PA_ONCE_END;
+
+    w->packet_size = (size_t) nbytes;
+    w->packet_pcm_size = memchunk.length;
+
+    return 0;
+}
+
+int pa_a2dp_sbc_writer_write(pa_a2dp_sbc_writer *w, int fd, int *write_type, uint64_t *write_index,
+                             size_t block_size, size_t mtu) {
+    ssize_t l;
+
+    pa_assert(w);
+    pa_assert(fd >= 0);
+    pa_assert(write_index);
+
+    /* First, render and encode some data, unless that has been done ahead */
+    if (w->packet_size == 0 && pa_a2dp_sbc_writer_encode(w, *write_index, block_size, mtu) < 0)
+        return -1;
+
+    for (;;) {
+        l = pa_write(fd, w->packet, w->packet_size, write_type);
+
+        pa_assert(l != 0);
+
+        if (l >= 0)
+            break;
+
+        if (errno == EINTR)
+            /* Retry right away if we got interrupted */
+            continue;
+
+        if (errno == EAGAIN)
+            /* Hmm, apparently the socket was not writable, give up for now */
+            return 0;
+
+        pa_log_error("Failed to write data to socket: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    pa_assert((size_t) l <= w->packet_size);
+
+    if ((size_t) l != w->packet_size) {
+        pa_log_warn("Wrote memory block to socket only partially! %llu written, wanted to write %llu.",
+                    (unsigned long long) l,
+                    (unsigned long long) w->packet_size);
+        return -1;
+    }
+
+    *write_index += (uint64_t) w->packet_pcm_size;
+    w->packet_size = w->packet_pcm_size = 0;
+
+    /* Now that the packet is out, encode the next one while we are
+     * waiting for the socket, so that encoding doesn't eat into the
+     * time between POLLOUT and the write. */
+    if (w->encode_ahead && pa_a2dp_sbc_writer_encode(w, *write_index, block_size, mtu) < 0)
+        return -1;
+
+    return 1;
+}
+
+void pa_a2dp_sbc_writer_skip(pa_a2dp_sbc_writer *w, uint64_t *write_index, uint64_t skip_bytes) {
+    pa_memchunk tmp;
+
+    pa_assert(w);
+    pa_assert(write_index);
+
+    if (skip_bytes <= 0)
+        return;
+
+    w->render((size_t) skip_bytes, &tmp, w->userdata);
+    pa_memblock_unref(tmp.memblock);
+    *write_index += skip_bytes;
+
+    /* A packet that was encoded ahead now starts after the gap */
+    if (w->packet_size > 0) {
+        struct rtp_header *header = (struct rtp_header *) w->packet;
+
+        header->timestamp = htonl(*write_index / pa_frame_size(w->sample_spec));
+    }
+}
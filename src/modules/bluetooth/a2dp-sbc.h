@@ -0,0 +1,85 @@
+#ifndef fooa2dpsbchfoo
+#define fooa2dpsbchfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include <sbc/sbc.h>
+
+#include <pulse/sample.h>
+#include <pulsecore/memchunk.h>
+
+/* Encodes pcm_size bytes of PCM, a multiple of the SBC codesize, into an
+ * RTP packet for an A2DP sink, header included. timestamp is in frames.
+ * Returns the size of the packet, or -1 if encoding failed or the packet
+ * doesn't fit into packet_size bytes. */
+ssize_t pa_a2dp_sbc_encode_packet(sbc_t *sbc, uint16_t seq_num, uint32_t timestamp,
+                                  const void *pcm, size_t pcm_size, void *packet, size_t packet_size);
+
+/* Returns the number of PCM bytes that fit into one packet of mtu bytes */
+size_t pa_a2dp_sbc_block_size(sbc_t *sbc, size_t mtu);
+
+/* Renders length bytes of audio into chunk, like pa_sink_render_full() */
+typedef void (*pa_a2dp_render_cb_t)(size_t length, pa_memchunk *chunk, void *userdata);
+
+/* The write path of an A2DP sink. A packet is rendered and encoded when it
+ * is written, or right after the previous one was written if encode_ahead
+ * is set. Indexes are in bytes of audio, like the write_index of the sink. */
+typedef struct pa_a2dp_sbc_writer {
+    sbc_t *sbc;
+    const pa_sample_spec *sample_spec;
+    bool encode_ahead;
+
+    pa_a2dp_render_cb_t render;
+    void *userdata;
+
+    uint16_t seq_num;                    /* Cumulative packet sequence */
+
+    uint8_t *packet;                     /* Buffer for the encoded packet */
+    size_t packet_max;                   /* Size of the buffer */
+    size_t packet_size;                  /* Size of the packet in the buffer, 0 if there is none */
+    size_t packet_pcm_size;              /* Bytes of audio in that packet */
+} pa_a2dp_sbc_writer;
+
+void pa_a2dp_sbc_writer_init(pa_a2dp_sbc_writer *w, sbc_t *sbc, const pa_sample_spec *ss, bool encode_ahead,
+                             pa_a2dp_render_cb_t render, void *userdata);
+void pa_a2dp_sbc_writer_done(pa_a2dp_sbc_writer *w);
+
+/* Drops the packet that was encoded ahead, if any */
+void pa_a2dp_sbc_writer_reset(pa_a2dp_sbc_writer *w);
+
+/* Renders block_size bytes of audio starting at write_index and encodes
+ * them into a packet of at most mtu bytes. There must be no packet
+ * pending. Returns 0 on success, -1 on error. */
+int pa_a2dp_sbc_writer_encode(pa_a2dp_sbc_writer *w, uint64_t write_index, size_t block_size, size_t mtu);
+
+/* Writes the pending packet to fd, encoding one first if there is none.
+ * On success *write_index is advanced by the audio in the packet, and the
+ * next packet is encoded if encode_ahead is set. Returns 1 if a packet
+ * was written, 0 if the socket was not writable and -1 on error. */
+int pa_a2dp_sbc_writer_write(pa_a2dp_sbc_writer *w, int fd, int *write_type, uint64_t *write_index,
+                             size_t block_size, size_t mtu);
+
+/* Renders and throws away skip_bytes of audio at *write_index and
+ * advances it past them. A packet that was encoded ahead is moved behind
+ * the gap, so that the receiver sees the skip in the RTP timestamps. */
+void pa_a2dp_sbc_writer_skip(pa_a2dp_sbc_writer *w, uint64_t *write_index, uint64_t skip_bytes);
+
+#endif
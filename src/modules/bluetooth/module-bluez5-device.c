@@ -45,6 +45,7 @@
 #include <pulsecore/time-smoother.h>
 
 #include "a2dp-codecs.h"
+#include "a2dp-sbc.h"
 #include "bluez5-util.h"
 #include "rtp.h"
 
@@ -54,7 +55,8 @@ PA_MODULE_AUTHOR("João Paulo Rechi Vita");
 PA_MODULE_DESCRIPTION("BlueZ 5 Bluetooth audio sink and source");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(false);
-PA_MODULE_USAGE("path=<device object path>");
+PA_MODULE_USAGE("path=<device object path> "
+                "a2dp_encode_ahead=<encode the next A2DP packet right after writing one?>");
 
 #define MAX_PLAYBACK_CATCH_UP_USEC (100 * PA_USEC_PER_MSEC)
 #define FIXED_LATENCY_PLAYBACK_A2DP (25 * PA_USEC_PER_MSEC)
@@ -65,9 +67,11 @@ PA_MODULE_USAGE("path=<device object path>");
 #define BITPOOL_DEC_LIMIT 32
 #define BITPOOL_DEC_STEP 5
 #define HSP_MAX_GAIN 15
+#define DEFAULT_A2DP_ENCODE_AHEAD true
 
 static const char* const valid_modargs[] = {
     "path",
+    "a2dp_encode_ahead",
     NULL
 };
 
@@ -88,12 +92,13 @@ typedef struct sbc_info {
     sbc_t sbc;                           /* Codec data */
     bool sbc_initialized;                /* Keep track if the encoder is initialized */
     size_t codesize, frame_length;       /* SBC Codesize, frame_length. We simply cache those values here */
-    uint16_t seq_num;                    /* Cumulative packet sequence */
     uint8_t min_bitpool;
     uint8_t max_bitpool;
 
     void* buffer;                        /* Codec transfer buffer */
     size_t buffer_size;                  /* Size of the buffer */
+
+    pa_a2dp_sbc_writer writer;           /* Encodes and writes packets for A2DP sink */
 } sbc_info_t;
 
 struct userdata {
@@ -133,9 +138,9 @@ struct userdata {
     uint64_t write_index;
     pa_usec_t started_at;
     pa_smoother *read_smoother;
-    pa_memchunk write_memchunk;
     pa_sample_spec sample_spec;
     struct sbc_info sbc_info;
+    bool a2dp_encode_ahead;
 };
 
 typedef enum pa_bluetooth_form_factor {
@@ -405,134 +410,20 @@ static void a2dp_prepare_buffer(struct userdata *u) {
 }
 
 /* Run from IO thread */
-static int a2dp_process_render(struct userdata *u) {
-    struct sbc_info *sbc_info;
-    struct rtp_header *header;
-    struct rtp_payload *payload;
-    size_t nbytes;
-    void *d;
-    const void *p;
-    size_t to_write, to_encode;
-    unsigned frame_count;
-    int ret = 0;
+static void a2dp_render(size_t length, pa_memchunk *chunk, void *userdata) {
+    struct userdata *u = userdata;
 
+    pa_sink_render_full(u->sink, length, chunk);
+}
+
+/* Run from IO thread */
+static int a2dp_process_render(struct userdata *u) {
     pa_assert(u);
     pa_assert(u->profile == PA_BLUETOOTH_PROFILE_A2DP_SINK);
     pa_assert(u->sink);
 
-    /* First, render some data */
-    if (!u->write_memchunk.memblock)
-        pa_sink_render_full(u->sink, u->write_block_size, &u->write_memchunk);
-
-    pa_assert(u->write_memchunk.length == u->write_block_size);
-
-    a2dp_prepare_buffer(u);
-
-    sbc_info = &u->sbc_info;
-    header = sbc_info->buffer;
-    payload = (struct rtp_payload*) ((uint8_t*) sbc_info->buffer + sizeof(*header));
-
-    frame_count = 0;
-
-    /* Try to create a packet of the full MTU */
-
-    p = (const uint8_t *) pa_memblock_acquire_chunk(&u->write_memchunk);
-    to_encode = u->write_memchunk.length;
-
-    d = (uint8_t*) sbc_info->buffer + sizeof(*header) + sizeof(*payload);
-    to_write = sbc_info->buffer_size - sizeof(*header) - sizeof(*payload);
-
-    while (PA_LIKELY(to_encode > 0 && to_write > 0)) {
-        ssize_t written;
-        ssize_t encoded;
-
-        encoded = sbc_encode(&sbc_info->sbc,
-                             p, to_encode,
-                             d, to_write,
-                             &written);
-
-        if (PA_UNLIKELY(encoded <= 0)) {
-            pa_log_error("SBC encoding error (%li)", (long) encoded);
-            pa_memblock_release(u->write_memchunk.memblock);
-            return -1;
-        }
-
-        pa_assert_fp((size_t) encoded <= to_encode);
-        pa_assert_fp((size_t) encoded == sbc_info->codesize);
-
-        pa_assert_fp((size_t) written <= to_write);
-        pa_assert_fp((size_t) written == sbc_info->frame_length);
-
-        p = (const uint8_t*) p + encoded;
-        to_encode -= encoded;
-
-        d = (uint8_t*) d + written;
-        to_write -= written;
-
-        frame_count++;
-    }
-
-    pa_memblock_release(u->write_memchunk.memblock);
-
-    pa_assert(to_encode == 0);
-
-    PA_ONCE_BEGIN {
-        pa_log_debug("Using SBC encoder implementation: %s", pa_strnull(sbc_get_implementation_info(&sbc_info->sbc)));
-    } PA_ONCE_END;
-
-    /* write it to the fifo */
-    memset(sbc_info->buffer, 0, sizeof(*header) + sizeof(*payload));
-    header->v = 2;
-    header->pt = 1;
-    header->sequence_number = htons(sbc_info->seq_num++);
-    header->timestamp = htonl(u->write_index / pa_frame_size(&u->sample_spec));
-    header->ssrc = htonl(1);
-    payload->frame_count = frame_count;
-
-    nbytes = (uint8_t*) d - (uint8_t*) sbc_info->buffer;
-
-    for (;;) {
-        ssize_t l;
-
-        l = pa_write(u->stream_fd, sbc_info->buffer, nbytes, &u->stream_write_type);
-
-        pa_assert(l != 0);
-
-        if (l < 0) {
-
-            if (errno == EINTR)
-                /* Retry right away if we got interrupted */
-                continue;
-
-            else if (errno == EAGAIN)
-                /* Hmm, apparently the socket was not writable, give up for now */
-                break;
-
-            pa_log_error("Failed to write data to socket: %s", pa_cstrerror(errno));
-            ret = -1;
-            break;
-        }
-
-        pa_assert((size_t) l <= nbytes);
-
-        if ((size_t) l != nbytes) {
-            pa_log_warn("Wrote memory block to socket only partially! %llu written, wanted to write %llu.",
-                        (unsigned long long) l,
-                        (unsigned long long) nbytes);
-            ret = -1;
-            break;
-        }
-
-        u->write_index += (uint64_t) u->write_memchunk.length;
-        pa_memblock_unref(u->write_memchunk.memblock);
-        pa_memchunk_reset(&u->write_memchunk);
-
-        ret = 1;
-
-        break;
-    }
-
-    return ret;
+    return pa_a2dp_sbc_writer_write(&u->sbc_info.writer, u->stream_fd, &u->stream_write_type, &u->write_index,
+                                    u->write_block_size, u->write_link_mtu);
 }
 
 /* Run from IO thread */
@@ -672,17 +563,12 @@ static void a2dp_set_bitpool(struct userdata *u, uint8_t bitpool) {
 
     pa_log_debug("Bitpool has changed to %u", sbc_info->sbc.bitpool);
 
-    u->read_block_size =
-        (u->read_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
-        / sbc_info->frame_length * sbc_info->codesize;
-
-    u->write_block_size =
-        (u->write_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
-        / sbc_info->frame_length * sbc_info->codesize;
+    u->read_block_size = pa_a2dp_sbc_block_size(&sbc_info->sbc, u->read_link_mtu);
+    u->write_block_size = pa_a2dp_sbc_block_size(&sbc_info->sbc, u->write_link_mtu);
 
     pa_sink_set_max_request_within_thread(u->sink, u->write_block_size);
     pa_sink_set_fixed_latency_within_thread(u->sink,
-            FIXED_LATENCY_PLAYBACK_A2DP + pa_bytes_to_usec(u->write_block_size, &u->sample_spec));
+            FIXED_LATENCY_PLAYBACK_A2DP + pa_bytes_to_usec((u->a2dp_encode_ahead ? 2 : 1) * u->write_block_size, &u->sample_spec));
 }
 
 /* Run from I/O thread */
@@ -722,10 +608,7 @@ static void teardown_stream(struct userdata *u) {
         u->read_smoother = NULL;
     }
 
-    if (u->write_memchunk.memblock) {
-        pa_memblock_unref(u->write_memchunk.memblock);
-        pa_memchunk_reset(&u->write_memchunk);
-    }
+    pa_a2dp_sbc_writer_reset(&u->sbc_info.writer);
 
     pa_log_debug("Audio stream torn down");
 }
@@ -770,21 +653,21 @@ static void transport_config_mtu(struct userdata *u) {
         u->read_block_size = u->read_link_mtu;
         u->write_block_size = u->write_link_mtu;
     } else {
-        u->read_block_size =
-            (u->read_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
-            / u->sbc_info.frame_length * u->sbc_info.codesize;
-
-        u->write_block_size =
-            (u->write_link_mtu - sizeof(struct rtp_header) - sizeof(struct rtp_payload))
-            / u->sbc_info.frame_length * u->sbc_info.codesize;
+        u->read_block_size = pa_a2dp_sbc_block_size(&u->sbc_info.sbc, u->read_link_mtu);
+        u->write_block_size = pa_a2dp_sbc_block_size(&u->sbc_info.sbc, u->write_link_mtu);
     }
 
     if (u->sink) {
         pa_sink_set_max_request_within_thread(u->sink, u->write_block_size);
-        pa_sink_set_fixed_latency_within_thread(u->sink,
-                                                (u->profile == PA_BLUETOOTH_PROFILE_A2DP_SINK ?
-                                                 FIXED_LATENCY_PLAYBACK_A2DP : FIXED_LATENCY_PLAYBACK_SCO) +
-                                                pa_bytes_to_usec(u->write_block_size, &u->sample_spec));
+
+        if (u->profile == PA_BLUETOOTH_PROFILE_A2DP_SINK)
+            pa_sink_set_fixed_latency_within_thread(u->sink,
+                                                    FIXED_LATENCY_PLAYBACK_A2DP +
+                                                    pa_bytes_to_usec((u->a2dp_encode_ahead ? 2 : 1) * u->write_block_size, &u->sample_spec));
+        else
+            pa_sink_set_fixed_latency_within_thread(u->sink,
+                                                    FIXED_LATENCY_PLAYBACK_SCO +
+                                                    pa_bytes_to_usec(u->write_block_size, &u->sample_spec));
     }
 
     if (u->source)
@@ -1049,6 +932,9 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
                 wi = pa_bytes_to_usec(u->write_index, &u->sample_spec);
             }
 
+            /* The packet that was encoded ahead has been rendered already */
+            wi += pa_bytes_to_usec(u->sbc_info.writer.packet_pcm_size, &u->sample_spec);
+
             *((pa_usec_t*) data) = FIXED_LATENCY_PLAYBACK_A2DP + wi > ri ? FIXED_LATENCY_PLAYBACK_A2DP + wi - ri : 0;
 
             return 0;
@@ -1426,18 +1312,20 @@ static void thread_func(void *userdata) {
                             skip_bytes = pa_usec_to_bytes(skip_usec, &u->sample_spec);
 
                             if (skip_bytes > 0) {
-                                pa_memchunk tmp;
-
                                 pa_log_warn("Skipping %llu us (= %llu bytes) in audio stream",
                                             (unsigned long long) skip_usec,
                                             (unsigned long long) skip_bytes);
 
-                                pa_sink_render_full(u->sink, skip_bytes, &tmp);
-                                pa_memblock_unref(tmp.memblock);
-                                u->write_index += skip_bytes;
-
-                                if (u->profile == PA_BLUETOOTH_PROFILE_A2DP_SINK)
+                                if (u->profile == PA_BLUETOOTH_PROFILE_A2DP_SINK) {
+                                    pa_a2dp_sbc_writer_skip(&u->sbc_info.writer, &u->write_index, skip_bytes);
                                     a2dp_reduce_bitpool(u);
+                                } else {
+                                    pa_memchunk tmp;
+
+                                    pa_sink_render_full(u->sink, skip_bytes, &tmp);
+                                    pa_memblock_unref(tmp.memblock);
+                                    u->write_index += skip_bytes;
+                                }
                             }
                         }
 
@@ -2144,6 +2032,14 @@ int pa__init(pa_module* m) {
         goto fail;
     }
 
+    u->a2dp_encode_ahead = DEFAULT_A2DP_ENCODE_AHEAD;
+    if (pa_modargs_get_value_boolean(ma, "a2dp_encode_ahead", &u->a2dp_encode_ahead) < 0) {
+        pa_log_error("Failed to parse a2dp_encode_ahead argument");
+        goto fail;
+    }
+
+    pa_a2dp_sbc_writer_init(&u->sbc_info.writer, &u->sbc_info.sbc, &u->sample_spec, u->a2dp_encode_ahead, a2dp_render, u);
+
     if ((u->discovery = pa_shared_get(u->core, "bluetooth-discovery")))
         pa_bluetooth_discovery_ref(u->discovery);
     else {
@@ -2234,6 +2130,8 @@ void pa__done(pa_module *m) {
     if (u->sbc_info.buffer)
         pa_xfree(u->sbc_info.buffer);
 
+    pa_a2dp_sbc_writer_done(&u->sbc_info.writer);
+
     if (u->sbc_info.sbc_initialized)
         sbc_finish(&u->sbc_info.sbc);
 
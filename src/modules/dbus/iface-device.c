@@ -65,6 +65,7 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
 
 static void handle_suspend(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_get_port_by_name(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_timing_statistics(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
 static void handle_sink_get_monitor_source(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
@@ -181,11 +182,13 @@ static pa_dbus_property_handler source_property_handlers[SOURCE_PROPERTY_HANDLER
 enum method_handler_index {
     METHOD_HANDLER_SUSPEND,
     METHOD_HANDLER_GET_PORT_BY_NAME,
+    METHOD_HANDLER_GET_TIMING_STATISTICS,
     METHOD_HANDLER_MAX
 };
 
 static pa_dbus_arg_info suspend_args[] = { { "suspend", "b", "in" } };
 static pa_dbus_arg_info get_port_by_name_args[] = { { "name", "s", "in" }, { "port", "o", "out" } };
+static pa_dbus_arg_info get_timing_statistics_args[] = { { "statistics", "a{s(tttta(tt))}", "out" } };
 
 static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
     [METHOD_HANDLER_SUSPEND] = {
@@ -197,7 +200,12 @@ static pa_dbus_method_handler method_handlers[METHOD_HANDLER_MAX] = {
         .method_name = "GetPortByName",
         .arguments = get_port_by_name_args,
         .n_arguments = sizeof(get_port_by_name_args) / sizeof(pa_dbus_arg_info),
-        .receive_cb = handle_get_port_by_name }
+        .receive_cb = handle_get_port_by_name },
+    [METHOD_HANDLER_GET_TIMING_STATISTICS] = {
+        .method_name = "GetTimingStatistics",
+        .arguments = get_timing_statistics_args,
+        .n_arguments = sizeof(get_timing_statistics_args) / sizeof(pa_dbus_arg_info),
+        .receive_cb = handle_get_timing_statistics }
 };
 
 enum signal_index {
@@ -991,6 +999,88 @@ static void handle_get_port_by_name(DBusConnection *conn, DBusMessage *msg, void
     pa_dbus_send_basic_value_reply(conn, msg, DBUS_TYPE_OBJECT_PATH, &port_path);
 }
 
+/* Appends a histogram as (count, min, max, sum, [(upper bound, count)]),
+ * with only the non-empty buckets */
+static void append_histogram_dict_entry(DBusMessageIter *dict_iter, const char *key, const pa_histogram *h) {
+    DBusMessageIter dict_entry_iter;
+    DBusMessageIter struct_iter;
+    DBusMessageIter array_iter;
+    DBusMessageIter bucket_iter;
+    unsigned i;
+
+    pa_assert_se(dbus_message_iter_open_container(dict_iter, DBUS_TYPE_DICT_ENTRY, NULL, &dict_entry_iter));
+    pa_assert_se(dbus_message_iter_append_basic(&dict_entry_iter, DBUS_TYPE_STRING, &key));
+
+    pa_assert_se(dbus_message_iter_open_container(&dict_entry_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &h->count));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &h->min));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &h->max));
+    pa_assert_se(dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &h->sum));
+
+    pa_assert_se(dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "(tt)", &array_iter));
+
+    for (i = 0; i < PA_HISTOGRAM_N_BUCKETS; i++) {
+        uint64_t upper_bound;
+
+        if (h->buckets[i] == 0)
+            continue;
+
+        upper_bound = pa_histogram_bucket_upper_bound(i);
+
+        pa_assert_se(dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &bucket_iter));
+        pa_assert_se(dbus_message_iter_append_basic(&bucket_iter, DBUS_TYPE_UINT64, &upper_bound));
+        pa_assert_se(dbus_message_iter_append_basic(&bucket_iter, DBUS_TYPE_UINT64, &h->buckets[i]));
+        pa_assert_se(dbus_message_iter_close_container(&array_iter, &bucket_iter));
+    }
+
+    pa_assert_se(dbus_message_iter_close_container(&struct_iter, &array_iter));
+    pa_assert_se(dbus_message_iter_close_container(&dict_entry_iter, &struct_iter));
+    pa_assert_se(dbus_message_iter_close_container(dict_iter, &dict_entry_iter));
+}
+
+static void handle_get_timing_statistics(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_device *d = userdata;
+    DBusMessage *reply = NULL;
+    DBusMessageIter msg_iter;
+    DBusMessageIter dict_iter;
+    pa_io_timing *timing;
+    int r;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(d);
+
+    timing = pa_xnew(pa_io_timing, 1);
+
+    if (d->type == PA_DEVICE_TYPE_SINK)
+        r = pa_sink_get_timing(d->sink, timing);
+    else
+        r = pa_source_get_timing(d->source, timing);
+
+    if (r < 0) {
+        pa_dbus_send_error(conn, msg, DBUS_ERROR_FAILED, "Failed to get the timing statistics.");
+        pa_xfree(timing);
+        return;
+    }
+
+    pa_assert_se((reply = dbus_message_new_method_return(msg)));
+
+    dbus_message_iter_init_append(reply, &msg_iter);
+    pa_assert_se(dbus_message_iter_open_container(&msg_iter, DBUS_TYPE_ARRAY, "{s(tttta(tt))}", &dict_iter));
+
+    append_histogram_dict_entry(&dict_iter, "Process", &timing->process_usec);
+    append_histogram_dict_entry(&dict_iter, "Resample", &timing->resample_usec);
+    append_histogram_dict_entry(&dict_iter, "WakeupLateness", &timing->wakeup_lateness_usec);
+    append_histogram_dict_entry(&dict_iter, "Rewind", &timing->rewind_bytes);
+
+    pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
+
+    pa_assert_se(dbus_connection_send(conn, reply, NULL));
+
+    dbus_message_unref(reply);
+    pa_xfree(timing);
+}
+
 static void handle_sink_get_monitor_source(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_device *d = userdata;
     const char *monitor_source = NULL;
@@ -39,6 +39,8 @@
 
 #include <pulsecore/i18n.h>
 #include <pulsecore/atomic.h>
+#include <pulsecore/asyncq.h>
+#include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sink.h>
@@ -50,6 +52,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/thread.h>
 
 #include "module-echo-cancel-symdef.h"
 
@@ -76,6 +79,7 @@ PA_MODULE_USAGE(
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
           "use_master_format=<yes or no> "
+          "use_worker_thread=<run the canceller in its own thread, yes or no> "
         ));
 
 /* NOTE: Make sure the enum and ec_table are maintained in the correct order */
@@ -142,6 +146,11 @@ static const pa_echo_canceller ec_table[] = {
 #define DEFAULT_SAVE_AEC false
 #define DEFAULT_AUTOLOADED false
 #define DEFAULT_USE_MASTER_FORMAT false
+#define DEFAULT_USE_WORKER_THREAD false
+#define STATS_INTERVAL_USEC (5*PA_USEC_PER_SEC)
+
+/* Maximum number of jobs on their way to or back from the worker thread */
+#define DSP_QUEUE_SIZE 64
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
@@ -176,6 +185,14 @@ static const pa_echo_canceller ec_table[] = {
  *    be before capture and the difference should not be bigger than one frame
  *    size. We would ideally like to resample the sink_input but most driver
  *    don't give enough accuracy to be able to do that right now.
+ *
+ * The actual cancelling is done on blocks of the canceller's size, which the
+ * source IO thread wraps into jobs. Normally it processes them itself, right
+ * away. With use_worker_thread they are passed on to a DSP thread of their own
+ * through a pair of lock-free queues instead, so that the other outputs of the
+ * master source don't have to wait for the canceller. The output of a block
+ * is posted when the next block has been captured, which adds a fixed latency
+ * of one block.
  */
 
 struct userdata;
@@ -188,6 +205,29 @@ struct pa_echo_canceller_msg {
 PA_DEFINE_PRIVATE_CLASS(pa_echo_canceller_msg, pa_msgobject);
 #define PA_ECHO_CANCELLER_MSG(o) (pa_echo_canceller_msg_cast(o))
 
+typedef enum dsp_job_type {
+    DSP_JOB_RUN,         /* cancel rchunk against pchunk into cchunk */
+    DSP_JOB_PLAY,        /* feed pchunk to the canceller */
+    DSP_JOB_RECORD,      /* cancel rchunk into cchunk */
+    DSP_JOB_SET_DRIFT,   /* update the drift estimate */
+    DSP_JOB_SKIP,        /* post cchunk unprocessed */
+    DSP_JOB_QUIT         /* stop the worker thread */
+} dsp_job_type_t;
+
+struct dsp_job {
+    dsp_job_type_t type;
+
+    pa_memchunk rchunk, pchunk, cchunk;
+    float drift;
+
+    /* Capture volume when the job was created, and the one the canceller
+     * asked for while processing it, or PA_VOLUME_INVALID */
+    pa_volume_t capture_volume;
+    pa_volume_t new_capture_volume;
+};
+
+PA_STATIC_FLIST_DECLARE(dsp_jobs, 0, pa_xfree);
+
 struct snapshot {
     pa_usec_t sink_now;
     pa_usec_t sink_latency;
@@ -251,6 +291,21 @@ struct userdata {
 
     bool use_volume_sharing;
 
+    /* The job the canceller is working on */
+    struct dsp_job *current_job;
+
+    bool use_worker_thread;
+    pa_thread *dsp_thread;
+    pa_asyncq *dsp_in, *dsp_out;
+    unsigned dsp_pending, dsp_pending_outputs; /* only accessed by the source IO thread */
+
+    /* Processing time statistics since the last update of the source
+     * properties */
+    pa_atomic_t stat_blocks;
+    pa_atomic_t stat_usec;
+    pa_atomic_t stat_max_usec;
+    pa_time_event *stats_event;
+
     struct {
         pa_cvolume current_volume;
     } thread_info;
@@ -277,6 +332,7 @@ static const char* const valid_modargs[] = {
     "autoloaded",
     "use_volume_sharing",
     "use_master_format",
+    "use_worker_thread",
     NULL
 };
 
@@ -395,6 +451,35 @@ static void time_callback(pa_mainloop_api *a, pa_time_event *e, const struct tim
     pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + u->adjust_time);
 }
 
+/* Called from main context */
+static void stats_callback(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct userdata *u = userdata;
+    int blocks, usec, max;
+
+    pa_assert(u);
+    pa_assert(u->stats_event == e);
+    pa_assert_ctl_context();
+
+    blocks = pa_atomic_load(&u->stat_blocks);
+    usec = pa_atomic_load(&u->stat_usec);
+    max = pa_atomic_load(&u->stat_max_usec);
+
+    pa_atomic_sub(&u->stat_blocks, blocks);
+    pa_atomic_sub(&u->stat_usec, usec);
+    pa_atomic_cmpxchg(&u->stat_max_usec, max, 0);
+
+    if (blocks > 0 && u->source) {
+        pa_proplist *pl = pa_proplist_new();
+
+        pa_proplist_setf(pl, "echo_cancel.process_usec.avg", "%i", usec / blocks);
+        pa_proplist_setf(pl, "echo_cancel.process_usec.max", "%i", max);
+        pa_source_update_proplist(u->source, PA_UPDATE_REPLACE, pl);
+        pa_proplist_free(pl);
+    }
+
+    pa_core_rttime_restart(u->core, u->stats_event, pa_rtclock_now() + STATS_INTERVAL_USEC);
+}
+
 /* Called from source I/O thread context */
 static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SOURCE(o)->userdata;
@@ -418,8 +503,9 @@ static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t
                 pa_source_get_latency_within_thread(u->source_output->source) +
                 /* Add the latency internal to our source output on top */
                 pa_bytes_to_usec(pa_memblockq_get_length(u->source_output->thread_info.delay_memblockq), &u->source_output->source->sample_spec) +
-                /* and the buffering we do on the source */
-                pa_bytes_to_usec(u->source_output_blocksize, &u->source_output->source->sample_spec);
+                /* and the buffering we do on the source, plus the block
+                 * in the DSP thread */
+                pa_bytes_to_usec((u->use_worker_thread ? 2 : 1) * u->source_output_blocksize, &u->source_output->source->sample_spec);
 
             return 0;
 
@@ -693,6 +779,197 @@ static void do_resync(struct userdata *u) {
     apply_diff_time(u, diff_time);
 }
 
+static void update_stats(struct userdata *u, pa_usec_t t) {
+    int max;
+
+    pa_atomic_inc(&u->stat_blocks);
+    pa_atomic_add(&u->stat_usec, (int) t);
+
+    do {
+        max = pa_atomic_load(&u->stat_max_usec);
+    } while ((int) t > max && !pa_atomic_cmpxchg(&u->stat_max_usec, max, (int) t));
+}
+
+/* Runs the canceller on a job.
+ *
+ * Called from source I/O thread context, or from the DSP thread. */
+static void process_job(struct userdata *u, struct dsp_job *job) {
+    uint8_t *rdata = NULL, *pdata = NULL, *cdata = NULL;
+    pa_usec_t start;
+    int unused PA_GCC_UNUSED;
+
+    if (job->type == DSP_JOB_SKIP)
+        return;
+
+    if (job->type == DSP_JOB_SET_DRIFT) {
+        u->ec->set_drift(u->ec, job->drift);
+
+        if (u->save_aec && u->drift_file)
+            fprintf(u->drift_file, "d %a\n", job->drift);
+
+        return;
+    }
+
+    if (job->rchunk.memblock)
+        rdata = (uint8_t *) pa_memblock_acquire(job->rchunk.memblock) + job->rchunk.index;
+    if (job->pchunk.memblock)
+        pdata = (uint8_t *) pa_memblock_acquire(job->pchunk.memblock) + job->pchunk.index;
+    if (job->cchunk.memblock)
+        cdata = pa_memblock_acquire(job->cchunk.memblock);
+
+    if (u->save_aec) {
+        if (u->drift_file && job->type == DSP_JOB_PLAY)
+            fprintf(u->drift_file, "p %d\n", u->sink_blocksize);
+        if (u->drift_file && job->type == DSP_JOB_RECORD)
+            fprintf(u->drift_file, "c %d\n", u->source_output_blocksize);
+        if (u->captured_file && rdata)
+            unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
+        if (u->played_file && pdata)
+            unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
+    }
+
+    u->current_job = job;
+    start = pa_rtclock_now();
+
+    switch (job->type) {
+        case DSP_JOB_RUN:
+            u->ec->run(u->ec, rdata, pdata, cdata);
+            break;
+        case DSP_JOB_PLAY:
+            u->ec->play(u->ec, pdata);
+            break;
+        case DSP_JOB_RECORD:
+            u->ec->record(u->ec, rdata, cdata);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+
+    update_stats(u, pa_rtclock_now() - start);
+    u->current_job = NULL;
+
+    if (u->save_aec && u->canceled_file && cdata)
+        unused = fwrite(cdata, 1, job->cchunk.length, u->canceled_file);
+
+    if (cdata)
+        pa_memblock_release(job->cchunk.memblock);
+    if (pdata)
+        pa_memblock_release(job->pchunk.memblock);
+    if (rdata)
+        pa_memblock_release(job->rchunk.memblock);
+}
+
+/* Forwards the output of a processed job to the virtual source, if post is
+ * set, and drops its memory blocks.
+ *
+ * Called from source I/O thread context, or from main context once the DSP
+ * thread is gone. */
+static void finish_job(struct userdata *u, struct dsp_job *job, bool post) {
+    if (post && job->cchunk.memblock)
+        pa_source_post(u->source, &job->cchunk);
+
+#ifndef ECHO_CANCEL_TEST
+    if (post && job->new_capture_volume != PA_VOLUME_INVALID)
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(u->ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME,
+                PA_UINT_TO_PTR(job->new_capture_volume), 0, NULL, NULL);
+#endif
+
+    if (job->rchunk.memblock)
+        pa_memblock_unref(job->rchunk.memblock);
+    if (job->pchunk.memblock)
+        pa_memblock_unref(job->pchunk.memblock);
+    if (job->cchunk.memblock)
+        pa_memblock_unref(job->cchunk.memblock);
+}
+
+/* Waits for the oldest job the DSP thread was given and finishes it.
+ *
+ * Called from source I/O thread context, or from main context once the
+ * source output is unlinked. */
+static void collect_job(struct userdata *u, bool post) {
+    struct dsp_job *job;
+
+    pa_assert(u->dsp_pending > 0);
+    pa_assert_se(job = pa_asyncq_pop(u->dsp_out, true));
+
+    u->dsp_pending--;
+    if (job->cchunk.memblock)
+        u->dsp_pending_outputs--;
+
+    finish_job(u, job, post);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(dsp_jobs), job) < 0)
+        pa_xfree(job);
+}
+
+/* Drops whatever the DSP thread is still working on. */
+static void drain_jobs(struct userdata *u) {
+    while (u->dsp_pending > 0)
+        collect_job(u, false);
+}
+
+/* Called from source I/O thread context. */
+static void init_job(struct userdata *u, struct dsp_job *job, dsp_job_type_t type) {
+    pa_zero(*job);
+    job->type = type;
+    job->capture_volume = pa_cvolume_avg(&u->thread_info.current_volume);
+    job->new_capture_volume = PA_VOLUME_INVALID;
+}
+
+/* Processes the job right away, or hands it to the DSP thread. In the latter
+ * case the output of the previous block is posted once the DSP thread is done
+ * with it, so that exactly one block of output is in the pipeline.
+ *
+ * Called from source I/O thread context. */
+static void submit_job(struct userdata *u, const struct dsp_job *job) {
+    struct dsp_job *j;
+
+    if (!u->dsp_thread) {
+        struct dsp_job copy = *job;
+
+        process_job(u, &copy);
+        finish_job(u, &copy, true);
+        return;
+    }
+
+    /* Make sure neither the worker nor we can block on a full queue */
+    while (u->dsp_pending >= DSP_QUEUE_SIZE)
+        collect_job(u, true);
+
+    if (!(j = pa_flist_pop(PA_STATIC_FLIST_GET(dsp_jobs))))
+        j = pa_xnew(struct dsp_job, 1);
+
+    *j = *job;
+
+    pa_assert_se(pa_asyncq_push(u->dsp_in, j, false) == 0);
+
+    u->dsp_pending++;
+    if (j->cchunk.memblock)
+        u->dsp_pending_outputs++;
+
+    while (u->dsp_pending_outputs > 1)
+        collect_job(u, true);
+}
+
+static void dsp_thread_func(void *userdata) {
+    struct userdata *u = userdata;
+    struct dsp_job *job;
+
+    pa_assert(u);
+
+    pa_log_debug("DSP thread starting up");
+
+    if (u->core->realtime_scheduling)
+        pa_make_realtime(u->core->realtime_priority);
+
+    while ((job = pa_asyncq_pop(u->dsp_in, true))->type != DSP_JOB_QUIT) {
+        process_job(u, job);
+        pa_assert_se(pa_asyncq_push(u->dsp_out, job, true) == 0);
+    }
+
+    pa_log_debug("DSP thread shutting down");
+}
+
 /* 1. Calculate drift at this point, pass to canceller
  * 2. Push out playback samples in blocksize chunks
  * 3. Push out capture samples in blocksize chunks
@@ -703,10 +980,8 @@ static void do_resync(struct userdata *u) {
  */
 static void do_push_drift_comp(struct userdata *u) {
     size_t rlen, plen;
-    pa_memchunk rchunk, pchunk, cchunk;
-    uint8_t *rdata, *pdata, *cdata;
+    struct dsp_job job;
     float drift;
-    int unused PA_GCC_UNUSED;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
     plen = pa_memblockq_get_length(u->sink_memblockq);
@@ -726,67 +1001,33 @@ static void do_push_drift_comp(struct userdata *u) {
     u->source_rem = rlen % u->source_output_blocksize;
 
     /* Now let the canceller work its drift compensation magic */
-    u->ec->set_drift(u->ec, drift);
-
-    if (u->save_aec) {
-        if (u->drift_file)
-            fprintf(u->drift_file, "d %a\n", drift);
-    }
+    init_job(u, &job, DSP_JOB_SET_DRIFT);
+    job.drift = drift;
+    submit_job(u, &job);
 
     /* Send in the playback samples first */
     while (plen >= u->sink_blocksize) {
-        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &pchunk);
-        pdata = pa_memblock_acquire(pchunk.memblock);
-        pdata += pchunk.index;
-
-        u->ec->play(u->ec, pdata);
-
-        if (u->save_aec) {
-            if (u->drift_file)
-                fprintf(u->drift_file, "p %d\n", u->sink_blocksize);
-            if (u->played_file)
-                unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
-        }
-
-        pa_memblock_release(pchunk.memblock);
+        init_job(u, &job, DSP_JOB_PLAY);
+        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &job.pchunk);
         pa_memblockq_drop(u->sink_memblockq, u->sink_blocksize);
-        pa_memblock_unref(pchunk.memblock);
+
+        submit_job(u, &job);
 
         plen -= u->sink_blocksize;
     }
 
     /* And now the capture samples */
     while (rlen >= u->source_output_blocksize) {
-        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &rchunk);
-
-        rdata = pa_memblock_acquire(rchunk.memblock);
-        rdata += rchunk.index;
-
-        cchunk.index = 0;
-        cchunk.length = u->source_output_blocksize;
-        cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-        cdata = pa_memblock_acquire(cchunk.memblock);
-
-        u->ec->record(u->ec, rdata, cdata);
-
-        if (u->save_aec) {
-            if (u->drift_file)
-                fprintf(u->drift_file, "c %d\n", u->source_output_blocksize);
-            if (u->captured_file)
-                unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
-            if (u->canceled_file)
-                unused = fwrite(cdata, 1, u->source_output_blocksize, u->canceled_file);
-        }
-
-        pa_memblock_release(cchunk.memblock);
-        pa_memblock_release(rchunk.memblock);
+        init_job(u, &job, DSP_JOB_RECORD);
+        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &job.rchunk);
+        pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
 
-        pa_memblock_unref(rchunk.memblock);
+        job.cchunk.index = 0;
+        job.cchunk.length = u->source_output_blocksize;
+        job.cchunk.memblock = pa_memblock_new(u->source->core->mempool, job.cchunk.length);
 
-        pa_source_post(u->source, &cchunk);
-        pa_memblock_unref(cchunk.memblock);
+        submit_job(u, &job);
 
-        pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
         rlen -= u->source_output_blocksize;
     }
 }
@@ -798,69 +1039,41 @@ static void do_push_drift_comp(struct userdata *u) {
  * Called from source I/O thread context. */
 static void do_push(struct userdata *u) {
     size_t rlen, plen;
-    pa_memchunk rchunk, pchunk, cchunk;
-    uint8_t *rdata, *pdata, *cdata;
-    int unused PA_GCC_UNUSED;
+    struct dsp_job job;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
     plen = pa_memblockq_get_length(u->sink_memblockq);
 
     while (rlen >= u->source_output_blocksize) {
+        init_job(u, &job, DSP_JOB_RUN);
 
         /* take fixed blocks from recorded and played samples */
-        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &rchunk);
-        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &pchunk);
+        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &job.rchunk);
+        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &job.pchunk);
 
         /* we ran out of played data and pchunk has been filled with silence bytes */
         if (plen < u->sink_blocksize)
             pa_memblockq_seek(u->sink_memblockq, u->sink_blocksize - plen, PA_SEEK_RELATIVE, true);
 
-        rdata = pa_memblock_acquire(rchunk.memblock);
-        rdata += rchunk.index;
-        pdata = pa_memblock_acquire(pchunk.memblock);
-        pdata += pchunk.index;
-
-        cchunk.index = 0;
-        cchunk.length = u->source_blocksize;
-        cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-        cdata = pa_memblock_acquire(cchunk.memblock);
-
-        if (u->save_aec) {
-            if (u->captured_file)
-                unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
-            if (u->played_file)
-                unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
-        }
-
-        /* perform echo cancellation */
-        u->ec->run(u->ec, rdata, pdata, cdata);
-
-        if (u->save_aec) {
-            if (u->canceled_file)
-                unused = fwrite(cdata, 1, u->source_blocksize, u->canceled_file);
-        }
-
-        pa_memblock_release(cchunk.memblock);
-        pa_memblock_release(pchunk.memblock);
-        pa_memblock_release(rchunk.memblock);
+        job.cchunk.index = 0;
+        job.cchunk.length = u->source_blocksize;
+        job.cchunk.memblock = pa_memblock_new(u->source->core->mempool, job.cchunk.length);
 
         /* drop consumed source samples */
         pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
-        pa_memblock_unref(rchunk.memblock);
         rlen -= u->source_output_blocksize;
 
         /* drop consumed sink samples */
         pa_memblockq_drop(u->sink_memblockq, u->sink_blocksize);
-        pa_memblock_unref(pchunk.memblock);
 
         if (plen >= u->sink_blocksize)
             plen -= u->sink_blocksize;
         else
             plen = 0;
 
-        /* forward the (echo-canceled) data to the virtual source */
-        pa_source_post(u->source, &cchunk);
-        pa_memblock_unref(cchunk.memblock);
+        /* perform echo cancellation and forward the (echo-canceled) data
+         * to the virtual source */
+        submit_job(u, &job);
     }
 }
 
@@ -868,7 +1081,7 @@ static void do_push(struct userdata *u) {
 static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
     struct userdata *u;
     size_t rlen, plen, to_skip;
-    pa_memchunk rchunk;
+    struct dsp_job job;
 
     pa_source_output_assert_ref(o);
     pa_source_output_assert_io_context(o);
@@ -908,12 +1121,14 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
         to_skip -= to_skip % u->source_output_blocksize;
 
         if (to_skip) {
-            pa_memblockq_peek_fixed_size(u->source_memblockq, to_skip, &rchunk);
-            pa_source_post(u->source, &rchunk);
-
-            pa_memblock_unref(rchunk.memblock);
+            /* This has to queue up behind the blocks that are still being
+             * processed */
+            init_job(u, &job, DSP_JOB_SKIP);
+            pa_memblockq_peek_fixed_size(u->source_memblockq, to_skip, &job.cchunk);
             pa_memblockq_drop(u->source_memblockq, to_skip);
 
+            submit_job(u, &job);
+
             rlen -= to_skip;
             u->source_skip -= to_skip;
         }
@@ -1293,6 +1508,8 @@ static void source_output_detach_cb(pa_source_output *o) {
 
     pa_log_debug("Source output %d detach", o->index);
 
+    drain_jobs(u);
+
     if (u->rtpoll_item_read) {
         pa_rtpoll_item_free(u->rtpoll_item_read);
         u->rtpoll_item_read = NULL;
@@ -1544,22 +1761,23 @@ static int canceller_process_msg_cb(pa_msgobject *o, int code, void *userdata, i
     return 0;
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread or DSP thread context. */
 pa_volume_t pa_echo_canceller_get_capture_volume(pa_echo_canceller *ec) {
 #ifndef ECHO_CANCEL_TEST
-    return pa_cvolume_avg(&ec->msg->userdata->thread_info.current_volume);
+    return ec->msg->userdata->current_job->capture_volume;
 #else
     return PA_VOLUME_NORM;
 #endif
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread or DSP thread context. The
+ * volume is actually changed once the job is finished, see finish_job(). */
 void pa_echo_canceller_set_capture_volume(pa_echo_canceller *ec, pa_volume_t v) {
 #ifndef ECHO_CANCEL_TEST
-    if (pa_cvolume_avg(&ec->msg->userdata->thread_info.current_volume) != v) {
-        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME, PA_UINT_TO_PTR(v),
-                0, NULL, NULL);
-    }
+    struct dsp_job *job = ec->msg->userdata->current_job;
+
+    if (job->capture_volume != v)
+        job->new_capture_volume = v;
 #endif
 }
 
@@ -1753,6 +1971,12 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    u->use_worker_thread = DEFAULT_USE_WORKER_THREAD;
+    if (pa_modargs_get_value_boolean(ma, "use_worker_thread", &u->use_worker_thread) < 0) {
+        pa_log("use_worker_thread= expects a boolean argument");
+        goto fail;
+    }
+
     if (init_common(ma, u, &source_ss, &source_map) < 0)
         goto fail;
 
@@ -1795,6 +2019,9 @@ int pa__init(pa_module*m) {
     pa_proplist_sets(source_data.proplist, PA_PROP_DEVICE_CLASS, "filter");
     if (!autoloaded)
         pa_proplist_sets(source_data.proplist, PA_PROP_DEVICE_INTENDED_ROLES, "phone");
+    pa_proplist_setf(source_data.proplist, "echo_cancel.block_usec", "%llu",
+                     (unsigned long long) pa_bytes_to_usec(u->source_output_blocksize, &source_output_ss));
+    pa_proplist_sets(source_data.proplist, "echo_cancel.worker_thread", pa_yes_no(u->use_worker_thread));
 
     if (pa_modargs_get_proplist(ma, "source_properties", source_data.proplist, PA_UPDATE_REPLACE) < 0) {
         pa_log("Invalid properties");
@@ -2010,6 +2237,18 @@ int pa__init(pa_module*m) {
 
     u->thread_info.current_volume = u->source->reference_volume;
 
+    if (u->use_worker_thread) {
+        u->dsp_in = pa_asyncq_new(DSP_QUEUE_SIZE);
+        u->dsp_out = pa_asyncq_new(DSP_QUEUE_SIZE);
+
+        if (!(u->dsp_thread = pa_thread_new("echo-cancel-dsp", dsp_thread_func, u))) {
+            pa_log("Failed to create DSP thread.");
+            goto fail;
+        }
+    }
+
+    u->stats_event = pa_core_rttime_new(m->core, pa_rtclock_now() + STATS_INTERVAL_USEC, stats_callback, u);
+
     pa_sink_put(u->sink);
     pa_source_put(u->source);
 
@@ -2055,6 +2294,9 @@ void pa__done(pa_module*m) {
     if (u->time_event)
         u->core->mainloop->time_free(u->time_event);
 
+    if (u->stats_event)
+        u->core->mainloop->time_free(u->stats_event);
+
     if (u->source_output)
         pa_source_output_unlink(u->source_output);
     if (u->sink_input)
@@ -2080,6 +2322,22 @@ void pa__done(pa_module*m) {
     if (u->sink_memblockq)
         pa_memblockq_free(u->sink_memblockq);
 
+    /* The source output is gone, so the source IO thread won't give the DSP
+     * thread any more work */
+    if (u->dsp_thread) {
+        struct dsp_job quit = { .type = DSP_JOB_QUIT };
+
+        drain_jobs(u);
+
+        pa_assert_se(pa_asyncq_push(u->dsp_in, &quit, true) == 0);
+        pa_thread_free(u->dsp_thread);
+    }
+
+    if (u->dsp_in)
+        pa_asyncq_free(u->dsp_in, NULL);
+    if (u->dsp_out)
+        pa_asyncq_free(u->dsp_out, NULL);
+
     if (u->ec) {
         if (u->ec->done)
             u->ec->done(u->ec);
@@ -43,6 +43,7 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/rate-controller.h>
 #include <pulsecore/strlist.h>
 
 #include "module-combine-sink-symdef.h"
@@ -66,7 +67,7 @@ PA_MODULE_USAGE(
 
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*16)
 
-#define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
+#define DEFAULT_ADJUST_TIME_USEC (1*PA_USEC_PER_SEC)
 
 #define BLOCK_USEC (PA_USEC_PER_MSEC * 200)
 
@@ -115,6 +116,9 @@ struct output {
 
     pa_memblockq *memblockq;
 
+    /* Keeps this output's latency in line with the others, managed in main context */
+    pa_rate_controller *rate_controller;
+
     /* For communication of the stream latencies to the main thread */
     pa_usec_t total_latency;
 
@@ -185,7 +189,7 @@ static int output_create_sink_input(struct output *o);
 static void adjust_rates(struct userdata *u) {
     struct output *o;
     pa_usec_t max_sink_latency = 0, min_total_latency = (pa_usec_t) -1, target_latency, avg_total_latency = 0;
-    uint32_t base_rate;
+    pa_usec_t now;
     uint32_t idx;
     unsigned n = 0;
 
@@ -229,36 +233,28 @@ static void adjust_rates(struct userdata *u) {
 
     target_latency = max_sink_latency > min_total_latency ? max_sink_latency : min_total_latency;
 
-    pa_log_info("[%s] avg total latency is %0.2f msec.", u->sink->name, (double) avg_total_latency / PA_USEC_PER_MSEC);
-    pa_log_info("[%s] target latency is %0.2f msec.", u->sink->name, (double) target_latency / PA_USEC_PER_MSEC);
+    pa_log_debug("[%s] avg total latency is %0.2f msec.", u->sink->name, (double) avg_total_latency / PA_USEC_PER_MSEC);
+    pa_log_debug("[%s] target latency is %0.2f msec.", u->sink->name, (double) target_latency / PA_USEC_PER_MSEC);
 
-    base_rate = u->sink->sample_spec.rate;
+    now = pa_rtclock_now();
 
     PA_IDXSET_FOREACH(o, u->outputs, idx) {
-        uint32_t new_rate = base_rate;
-        uint32_t current_rate;
+        uint32_t new_rate;
 
         if (!o->sink_input || !PA_SINK_IS_OPENED(pa_sink_get_state(o->sink)))
             continue;
 
-        current_rate = o->sink_input->sample_spec.rate;
+        /* The rate of the combine sink is the nominal rate of all
+         * outputs, if it changed the old corrections are meaningless */
+        if (pa_rate_controller_get_base_rate(o->rate_controller) != u->sink->sample_spec.rate) {
+            pa_log_debug("[%s] sink rate changed to %u Hz, restarting rate control.", o->sink->name, u->sink->sample_spec.rate);
+            pa_rate_controller_reset(o->rate_controller, u->sink->sample_spec.rate);
+        }
 
-        if (o->total_latency != target_latency)
-            new_rate += (uint32_t) (((double) o->total_latency - (double) target_latency) / (double) u->adjust_time * (double) new_rate);
+        pa_rate_controller_set_target(o->rate_controller, target_latency);
+        new_rate = pa_rate_controller_update(o->rate_controller, now, o->total_latency);
 
-        if (new_rate < (uint32_t) (base_rate*0.8) || new_rate > (uint32_t) (base_rate*1.25)) {
-            pa_log_warn("[%s] sample rates too different, not adjusting (%u vs. %u).", o->sink_input->sink->name, base_rate, new_rate);
-            new_rate = base_rate;
-        } else {
-            if (base_rate < new_rate + 20 && new_rate < base_rate + 20)
-              new_rate = base_rate;
-            /* Do the adjustment in small steps; 2‰ can be considered inaudible */
-            if (new_rate < (uint32_t) (current_rate*0.998) || new_rate > (uint32_t) (current_rate*1.002)) {
-                pa_log_info("[%s] new rate of %u Hz not within 2‰ of %u Hz, forcing smaller adjustment", o->sink_input->sink->name, new_rate, current_rate);
-                new_rate = PA_CLAMP(new_rate, (uint32_t) (current_rate*0.998), (uint32_t) (current_rate*1.002));
-            }
-            pa_log_info("[%s] new rate is %u Hz; ratio is %0.3f; latency is %0.2f msec.", o->sink_input->sink->name, new_rate, (double) new_rate / base_rate, (double) o->total_latency / PA_USEC_PER_MSEC);
-        }
+        pa_log_debug("[%s] new rate is %u Hz; ratio is %0.5f; latency is %0.2f msec.", o->sink_input->sink->name, new_rate, pa_rate_controller_get_ratio(o->rate_controller), (double) o->total_latency / PA_USEC_PER_MSEC);
         pa_sink_input_set_rate(o->sink_input, new_rate);
     }
 
@@ -993,6 +989,9 @@ static int output_create_sink_input(struct output *o) {
     if (!o->sink_input)
         return -1;
 
+    /* The new stream starts out at the nominal rate */
+    pa_rate_controller_reset(o->rate_controller, u->sink->sample_spec.rate);
+
     o->sink_input->parent.process_msg = sink_input_process_msg;
     o->sink_input->pop = sink_input_pop_cb;
     o->sink_input->process_rewind = sink_input_process_rewind_cb;
@@ -1033,6 +1032,7 @@ static struct output *output_new(struct userdata *u, pa_sink *sink) {
             0,
             0,
             &u->sink->silence);
+    o->rate_controller = pa_rate_controller_new(u->sink->sample_spec.rate, 0, u->adjust_time);
 
     pa_assert_se(pa_idxset_put(u->outputs, o, NULL) == 0);
     update_description(u);
@@ -1074,6 +1074,9 @@ static void output_free(struct output *o) {
     if (o->memblockq)
         pa_memblockq_free(o->memblockq);
 
+    if (o->rate_controller)
+        pa_rate_controller_free(o->rate_controller);
+
     pa_xfree(o);
 }
 
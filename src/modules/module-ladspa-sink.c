@@ -435,12 +435,25 @@ static void sink_set_mute_cb(pa_sink *s) {
     pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
 }
 
+/* Called from I/O thread context */
+static void process_block(struct userdata *u, float *src, float *dst, unsigned n) {
+    unsigned h, c;
+
+    for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
+        for (c = 0; c < u->input_count; c++)
+            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), src+ h*u->max_ladspaport_count + c, u->channels*sizeof(float), n);
+        u->descriptor->run(u->handle[h], n);
+        for (c = 0; c < u->output_count; c++)
+            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + h*u->max_ladspaport_count + c, u->channels*sizeof(float), u->output[c], sizeof(float), n);
+    }
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
     float *src, *dst;
     size_t fs;
-    unsigned n, h, c;
+    unsigned n;
     pa_memchunk tchunk;
 
     pa_sink_input_assert_ref(i);
@@ -453,7 +466,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
         pa_memchunk nchunk;
 
-        pa_sink_render(u->sink, nbytes, &nchunk);
+        pa_sink_render_filter_chain(u->sink, nbytes, &nchunk);
         pa_memblockq_push(u->memblockq, &nchunk);
         pa_memblock_unref(nchunk.memblock);
     }
@@ -475,13 +488,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
-        for (c = 0; c < u->input_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), src+ h*u->max_ladspaport_count + c, u->channels*sizeof(float), n);
-        u->descriptor->run(u->handle[h], n);
-        for (c = 0; c < u->output_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + h*u->max_ladspaport_count + c, u->channels*sizeof(float), u->output[c], sizeof(float), n);
-    }
+    process_block(u, src, dst, n);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -491,6 +498,41 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     return 0;
 }
 
+/* Called from I/O thread context */
+static void sink_process_filter_cb(pa_sink *s, pa_memchunk *chunk) {
+    struct userdata *u;
+    float *p;
+    size_t fs;
+    unsigned left, n;
+
+    pa_sink_assert_ref(s);
+    pa_assert(chunk);
+    pa_assert_se(u = s->userdata);
+
+    /* We are called instead of our sink input's pop() callback, so
+     * whatever is left in our queue will not be played anymore */
+    pa_memblockq_flush_write(u->memblockq, true);
+
+    fs = pa_frame_size(&s->sample_spec);
+    left = (unsigned) (chunk->length / fs);
+
+    /* The plugin ports are copied in and out of separate buffers, so
+     * the chunk can be processed in place */
+    pa_memchunk_make_writable(chunk, 0);
+    p = pa_memblock_acquire_chunk(chunk);
+
+    while (left > 0) {
+        n = (unsigned) PA_MIN(left, u->block_size / fs);
+
+        process_block(u, p, p, n);
+
+        p += n * u->channels;
+        left -= n;
+    }
+
+    pa_memblock_release(chunk->memblock);
+}
+
 /* Called from I/O thread context */
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     struct userdata *u;
@@ -1246,6 +1288,7 @@ int pa__init(pa_module*m) {
     u->sink->set_state = sink_set_state_cb;
     u->sink->update_requested_latency = sink_update_requested_latency_cb;
     u->sink->request_rewind = sink_request_rewind_cb;
+    u->sink->process_filter = sink_process_filter_cb;
     pa_sink_set_set_mute_callback(u->sink, sink_set_mute_cb);
     u->sink->userdata = u;
 
@@ -32,6 +32,7 @@
 #include <pulsecore/namereg.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/rate-controller.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
@@ -61,7 +62,7 @@ PA_MODULE_USAGE(
 
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*16)
 
-#define DEFAULT_ADJUST_TIME_USEC (10*PA_USEC_PER_SEC)
+#define DEFAULT_ADJUST_TIME_USEC (1*PA_USEC_PER_SEC)
 
 struct userdata {
     pa_core *core;
@@ -77,6 +78,7 @@ struct userdata {
 
     pa_time_event *time_event;
     pa_usec_t adjust_time;
+    pa_rate_controller *rate_controller;
 
     int64_t recv_counter;
     int64_t send_counter;
@@ -169,8 +171,8 @@ static void teardown(struct userdata *u) {
 
 /* Called from main context */
 static void adjust_rates(struct userdata *u) {
-    size_t buffer, fs;
-    uint32_t old_rate, base_rate, new_rate;
+    size_t buffer;
+    uint32_t new_rate;
     pa_usec_t buffer_latency;
 
     pa_assert(u);
@@ -200,27 +202,10 @@ static void adjust_rates(struct userdata *u) {
                 u->latency_snapshot.max_request*2,
                 u->latency_snapshot.min_memblockq_length);
 
-    fs = pa_frame_size(&u->sink_input->sample_spec);
-    old_rate = u->sink_input->sample_spec.rate;
-    base_rate = u->source_output->sample_spec.rate;
+    pa_rate_controller_set_target(u->rate_controller, pa_bytes_to_usec(u->latency_snapshot.max_request*2, &u->sink_input->sample_spec));
 
-    if (u->latency_snapshot.min_memblockq_length < u->latency_snapshot.max_request*2)
-        new_rate = base_rate - (((u->latency_snapshot.max_request*2 - u->latency_snapshot.min_memblockq_length) / fs) *PA_USEC_PER_SEC)/u->adjust_time;
-    else
-        new_rate = base_rate + (((u->latency_snapshot.min_memblockq_length - u->latency_snapshot.max_request*2) / fs) *PA_USEC_PER_SEC)/u->adjust_time;
-
-    if (new_rate < (uint32_t) (base_rate*0.8) || new_rate > (uint32_t) (base_rate*1.25)) {
-        pa_log_warn("Sample rates too different, not adjusting (%u vs. %u).", base_rate, new_rate);
-        new_rate = base_rate;
-    } else {
-        if (base_rate < new_rate + 20 && new_rate < base_rate + 20)
-          new_rate = base_rate;
-        /* Do the adjustment in small steps; 2‰ can be considered inaudible */
-        if (new_rate < (uint32_t) (old_rate*0.998) || new_rate > (uint32_t) (old_rate*1.002)) {
-            pa_log_info("New rate of %u Hz not within 2‰ of %u Hz, forcing smaller adjustment", new_rate, old_rate);
-            new_rate = PA_CLAMP(new_rate, (uint32_t) (old_rate*0.998), (uint32_t) (old_rate*1.002));
-        }
-    }
+    new_rate = pa_rate_controller_update(u->rate_controller, pa_rtclock_now(),
+                                         pa_bytes_to_usec(u->latency_snapshot.min_memblockq_length, &u->sink_input->sample_spec));
 
     pa_sink_input_set_rate(u->sink_input, new_rate);
     pa_log_debug("[%s] Updated sampling rate to %lu Hz.", u->sink_input->sink->name, (unsigned long) new_rate);
@@ -255,6 +240,13 @@ static void enable_adjust_timer(struct userdata *u, bool enable) {
     }
 }
 
+/* Called from main context */
+static void reset_rate_control(struct userdata *u) {
+    /* The drift that was learned belongs to the old pair of devices */
+    pa_rate_controller_reset(u->rate_controller, u->source_output->sample_spec.rate);
+    pa_sink_input_set_rate(u->sink_input, u->source_output->sample_spec.rate);
+}
+
 /* Called from main context */
 static void update_adjust_timer(struct userdata *u) {
     if (u->sink_input->state == PA_SINK_INPUT_CORKED || u->source_output->state == PA_SOURCE_OUTPUT_CORKED)
@@ -422,6 +414,7 @@ static void source_output_moving_cb(pa_source_output *o, pa_source *dest) {
     else
         pa_sink_input_cork(u->sink_input, false);
 
+    reset_rate_control(u);
     update_adjust_timer(u);
 }
 
@@ -693,6 +686,7 @@ static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     else
         pa_source_output_cork(u->source_output, false);
 
+    reset_rate_control(u);
     update_adjust_timer(u);
 }
 
@@ -967,6 +961,8 @@ int pa__init(pa_module *m) {
 
     u->asyncmsgq = pa_asyncmsgq_new(0);
 
+    u->rate_controller = pa_rate_controller_new(u->source_output->sample_spec.rate, 0, u->adjust_time);
+
     if (!pa_proplist_contains(u->source_output->proplist, PA_PROP_MEDIA_NAME))
         pa_proplist_setf(u->source_output->proplist, PA_PROP_MEDIA_NAME, "Loopback to %s",
                          pa_strnull(pa_proplist_gets(u->sink_input->sink->proplist, PA_PROP_DEVICE_DESCRIPTION)));
@@ -1022,5 +1018,8 @@ void pa__done(pa_module*m) {
     if (u->asyncmsgq)
         pa_asyncmsgq_unref(u->asyncmsgq);
 
+    if (u->rate_controller)
+        pa_rate_controller_free(u->rate_controller);
+
     pa_xfree(u);
 }
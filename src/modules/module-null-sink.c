@@ -53,11 +53,24 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "cpu_affinity=<CPUs to run the IO thread on> "
+        "freewheel=<render as fast as the inputs provide data?>");
 
 #define DEFAULT_SINK_NAME "null"
 #define BLOCK_USEC (PA_USEC_PER_SEC * 2)
 
+/* How long to wait in freewheel mode for the client of an input that ran
+ * dry before playing on without it */
+#define FREEWHEEL_STALL_USEC (20 * PA_USEC_PER_MSEC)
+#define FREEWHEEL_REPORT_INTERVAL (PA_USEC_PER_SEC)
+
+#define PROP_FREEWHEEL_SPEED "null-sink.freewheel.speed"
+
+enum {
+    SINK_MESSAGE_GET_FREEWHEEL_USEC = PA_SINK_MESSAGE_MAX
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -69,6 +82,19 @@ struct userdata {
 
     pa_usec_t block_usec;
     pa_usec_t timestamp;
+
+    bool freewheel;
+
+    /* Freewheel state, accessed from the IO thread only */
+    bool stalled;
+    pa_usec_t stall_deadline;
+    pa_usec_t freewheel_usec;
+
+    /* For the speed reports of the main thread */
+    pa_time_event *report_event;
+    pa_usec_t report_time;
+    pa_usec_t report_freewheel_usec;
+    pa_usec_t freewheel_start;
 };
 
 static const char* const valid_modargs[] = {
@@ -78,6 +104,8 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "cpu_affinity",
+    "freewheel",
     NULL
 };
 
@@ -103,11 +131,26 @@ static int sink_process_msg(
         case PA_SINK_MESSAGE_GET_LATENCY: {
             pa_usec_t now;
 
+            /* In freewheel mode everything that was rendered has been
+             * played, the stream clocks follow the rendered data only */
+            if (u->freewheel) {
+                *((pa_usec_t*) data) = 0;
+                return 0;
+            }
+
             now = pa_rtclock_now();
             *((pa_usec_t*) data) = u->timestamp > now ? u->timestamp - now : 0ULL;
 
             return 0;
         }
+
+        case PA_SINK_MESSAGE_ADD_INPUT:
+            u->stalled = false;
+            break;
+
+        case SINK_MESSAGE_GET_FREEWHEEL_USEC:
+            *((pa_usec_t*) data) = u->freewheel_usec;
+            return 0;
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -141,6 +184,10 @@ static void process_rewind(struct userdata *u, pa_usec_t now) {
     if (!PA_SINK_IS_OPENED(u->sink->thread_info.state) || rewind_nbytes <= 0)
         goto do_nothing;
 
+    /* Nothing that was rendered is buffered in freewheel mode */
+    if (u->freewheel)
+        goto do_nothing;
+
     pa_log_debug("Requested to rewind %lu bytes.", (unsigned long) rewind_nbytes);
 
     if (u->timestamp <= now)
@@ -195,6 +242,48 @@ static void process_render(struct userdata *u, pa_usec_t now) {
 /*     pa_log_debug("Ate in sum %lu bytes (of %lu)", (unsigned long) ate, (unsigned long) nbytes); */
 }
 
+/* Renders one block without waiting for the clock. If none of the inputs
+ * had any data, or one that was playing ran dry in this block, we stall
+ * until new data arrives, so that slow clients are waited for instead of
+ * having their data skipped. An input that ran dry only gets
+ * FREEWHEEL_STALL_USEC to catch up though, it might have just finished. */
+static void process_freewheel(struct userdata *u, pa_usec_t now) {
+    pa_memchunk chunk;
+    pa_sink_input *i;
+    void *state = NULL;
+    bool playing = false, ran_dry = false;
+    pa_usec_t usec;
+
+    pa_assert(u);
+
+    pa_sink_render(u->sink, u->sink->thread_info.max_request, &chunk);
+    pa_memblock_unref(chunk.memblock);
+
+    usec = pa_bytes_to_usec(chunk.length, &u->sink->sample_spec);
+    u->timestamp += usec;
+    u->freewheel_usec += usec;
+
+    PA_HASHMAP_FOREACH(i, u->sink->thread_info.inputs, state) {
+
+        /* Corked or still prebuffering */
+        if (i->thread_info.state == PA_SINK_INPUT_CORKED || i->thread_info.underrun_for == (uint64_t) -1)
+            continue;
+
+        if (i->thread_info.underrun_for_sink == 0)
+            playing = true;
+        else if (i->thread_info.underrun_for_sink <= chunk.length)
+            ran_dry = true;
+    }
+
+    if (ran_dry) {
+        u->stalled = true;
+        u->stall_deadline = now + FREEWHEEL_STALL_USEC;
+    } else if (!playing) {
+        u->stalled = true;
+        u->stall_deadline = 0;
+    }
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -213,11 +302,31 @@ static void thread_func(void *userdata) {
         if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
             now = pa_rtclock_now();
 
-        if (PA_UNLIKELY(u->sink->thread_info.rewind_requested))
+        if (PA_UNLIKELY(u->sink->thread_info.rewind_requested)) {
             process_rewind(u, now);
 
+            /* Inputs ask for a rewind when their underrun ends */
+            u->stalled = false;
+        }
+
         /* Render some data and drop it immediately */
-        if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
+        if (PA_SINK_IS_OPENED(u->sink->thread_info.state) && u->freewheel) {
+            if (u->stalled && u->stall_deadline > 0 && u->stall_deadline <= now)
+                u->stalled = false;
+
+            if (!u->stalled)
+                process_freewheel(u, now);
+
+            /* Don't sleep at all unless we are stalled, but still let the
+             * messages in between the blocks */
+            if (!u->stalled)
+                pa_rtpoll_set_timer_relative(u->rtpoll, 0);
+            else if (u->stall_deadline > 0)
+                pa_rtpoll_set_timer_absolute(u->rtpoll, u->stall_deadline);
+            else
+                pa_rtpoll_set_timer_disabled(u->rtpoll);
+
+        } else if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
             if (u->timestamp <= now)
                 process_render(u, now);
 
@@ -243,6 +352,34 @@ finish:
     pa_log_debug("Thread shutting down");
 }
 
+/* Called from main context */
+static void report_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
+    struct userdata *u = userdata;
+    pa_usec_t now, freewheel_usec;
+    pa_proplist *pl;
+
+    pa_assert(u);
+
+    now = pa_rtclock_now();
+    pa_assert_se(pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_GET_FREEWHEEL_USEC, &freewheel_usec, 0, NULL) == 0);
+
+    if (now > u->report_time && freewheel_usec != u->report_freewheel_usec) {
+        double speed = (double) (freewheel_usec - u->report_freewheel_usec) / (double) (now - u->report_time);
+
+        pl = pa_proplist_new();
+        pa_proplist_setf(pl, PROP_FREEWHEEL_SPEED, "%0.2f", speed);
+        pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
+        pa_proplist_free(pl);
+
+        pa_log_debug("Freewheeling at %0.2f times real time.", speed);
+    }
+
+    u->report_time = now;
+    u->report_freewheel_usec = freewheel_usec;
+
+    pa_core_rttime_restart(u->core, e, now + FREEWHEEL_REPORT_INTERVAL);
+}
+
 int pa__init(pa_module*m) {
     struct userdata *u = NULL;
     pa_sample_spec ss;
@@ -250,6 +387,7 @@ int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     pa_sink_new_data data;
     size_t nbytes;
+    const char *cpus;
 
     pa_assert(m);
 
@@ -286,6 +424,23 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if ((cpus = pa_modargs_get_value(ma, "cpu_affinity", NULL))) {
+        if (pa_parse_cpu_list(cpus, NULL, 0) < 0) {
+            pa_log("Invalid CPU list '%s'.", cpus);
+            pa_sink_new_data_done(&data);
+            goto fail;
+        }
+
+        pa_sink_new_data_set_cpu_affinity(&data, cpus);
+    }
+
+    u->freewheel = false;
+    if (pa_modargs_get_value_boolean(ma, "freewheel", &u->freewheel) < 0) {
+        pa_log("Invalid freewheel argument.");
+        pa_sink_new_data_done(&data);
+        goto fail;
+    }
+
     u->sink = pa_sink_new(m->core, &data, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY);
     pa_sink_new_data_done(&data);
 
@@ -315,6 +470,11 @@ int pa__init(pa_module*m) {
 
     pa_sink_put(u->sink);
 
+    if (u->freewheel) {
+        u->freewheel_start = u->report_time = pa_rtclock_now();
+        u->report_event = pa_core_rttime_new(m->core, u->report_time + FREEWHEEL_REPORT_INTERVAL, report_cb, u);
+    }
+
     pa_modargs_free(ma);
 
     return 0;
@@ -345,6 +505,9 @@ void pa__done(pa_module*m) {
     if (!(u = m->userdata))
         return;
 
+    if (u->report_event)
+        u->core->mainloop->time_free(u->report_event);
+
     if (u->sink)
         pa_sink_unlink(u->sink);
 
@@ -355,6 +518,15 @@ void pa__done(pa_module*m) {
 
     pa_thread_mq_done(&u->thread_mq);
 
+    /* The IO thread is gone, so its counters can be read directly */
+    if (u->freewheel && u->freewheel_usec > 0) {
+        pa_usec_t elapsed = pa_rtclock_now() - u->freewheel_start;
+
+        pa_log_info("Freewheeled %0.1f s of audio in %0.1f s, %0.2f times real time.",
+                    (double) u->freewheel_usec / PA_USEC_PER_SEC, (double) elapsed / PA_USEC_PER_SEC,
+                    elapsed > 0 ? (double) u->freewheel_usec / (double) elapsed : 0.0);
+    }
+
     if (u->sink)
         pa_sink_unref(u->sink);
 
@@ -54,7 +54,8 @@ PA_MODULE_USAGE(
         "source_name=<name of source> "
         "channel_map=<channel map> "
         "description=<description for the source> "
-        "latency_time=<latency time in ms>");
+        "latency_time=<latency time in ms> "
+        "cpu_affinity=<CPUs to run the IO thread on>");
 
 #define DEFAULT_SOURCE_NAME "source.null"
 #define DEFAULT_LATENCY_TIME 20
@@ -84,6 +85,7 @@ static const char* const valid_modargs[] = {
     "channel_map",
     "description",
     "latency_time",
+    "cpu_affinity",
     NULL
 };
 
@@ -181,6 +183,7 @@ int pa__init(pa_module*m) {
     pa_modargs *ma = NULL;
     pa_source_new_data data;
     uint32_t latency_time = DEFAULT_LATENCY_TIME;
+    const char *cpus;
 
     pa_assert(m);
 
@@ -211,6 +214,16 @@ int pa__init(pa_module*m) {
     pa_proplist_sets(data.proplist, PA_PROP_DEVICE_DESCRIPTION, pa_modargs_get_value(ma, "description", "Null Input"));
     pa_proplist_sets(data.proplist, PA_PROP_DEVICE_CLASS, "abstract");
 
+    if ((cpus = pa_modargs_get_value(ma, "cpu_affinity", NULL))) {
+        if (pa_parse_cpu_list(cpus, NULL, 0) < 0) {
+            pa_log("Invalid CPU list '%s'.", cpus);
+            pa_source_new_data_done(&data);
+            goto fail;
+        }
+
+        pa_source_new_data_set_cpu_affinity(&data, cpus);
+    }
+
     u->source = pa_source_new(m->core, &data, PA_SOURCE_LATENCY | PA_SOURCE_DYNAMIC_LATENCY);
     pa_source_new_data_done(&data);
 
@@ -29,6 +29,10 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 
+#ifdef HAVE_VMSPLICE
+#include <sys/uio.h>
+#endif
+
 #ifdef HAVE_SYS_FILIO_H
 #include <sys/filio.h>
 #endif
@@ -59,11 +63,27 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "zero_copy=<use vmsplice() to hand the audio to the FIFO without copying?>");
 
 #define DEFAULT_FILE_NAME "fifo_output"
 #define DEFAULT_SINK_NAME "fifo_output"
 
+#ifdef HAVE_VMSPLICE
+/* Maximum number of memory blocks the FIFO may reference at the same time */
+#define SPLICED_MAX 64
+
+/* vmsplice() doesn't copy the audio into the FIFO but makes it point to the
+ * pages of the memory block. The block must stay untouched until the reader
+ * has consumed everything up to end, i.e. until no more than bytes_written -
+ * end bytes are left in the FIFO. Readers that splice() the data on instead
+ * of reading it may still see it change afterwards, hence this is opt-in. */
+struct spliced_block {
+    pa_memblock *memblock;
+    uint64_t end;
+};
+#endif
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -81,6 +101,14 @@ struct userdata {
     pa_rtpoll_item *rtpoll_item;
 
     int write_type;
+
+#ifdef HAVE_VMSPLICE
+    bool zero_copy;
+
+    struct spliced_block spliced[SPLICED_MAX];
+    unsigned spliced_idx, n_spliced;
+    uint64_t bytes_written;
+#endif
 };
 
 static const char* const valid_modargs[] = {
@@ -91,6 +119,7 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "zero_copy",
     NULL
 };
 
@@ -119,6 +148,109 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
     return pa_sink_process_msg(o, code, data, offset, chunk);
 }
 
+#ifdef HAVE_VMSPLICE
+/* Drops the blocks the reader is done with, or all of them */
+static void release_spliced(struct userdata *u, bool all) {
+    uint64_t consumed = u->bytes_written;
+
+    if (!all) {
+        int l;
+
+        if (ioctl(u->fd, FIONREAD, &l) < 0)
+            return;
+
+        /* Somebody else might be writing to the FIFO as well */
+        if (l > 0)
+            consumed = (uint64_t) l < consumed ? consumed - (uint64_t) l : 0;
+    }
+
+    while (u->n_spliced > 0 && u->spliced[u->spliced_idx].end <= consumed) {
+        pa_memblock_unref(u->spliced[u->spliced_idx].memblock);
+        u->spliced_idx = (u->spliced_idx + 1) % SPLICED_MAX;
+        u->n_spliced--;
+    }
+}
+
+/* Returns the entry the memory chunk goes to, or NULL if there is none left */
+static struct spliced_block *get_spliced_block(struct userdata *u) {
+    struct spliced_block *b;
+
+    if (u->n_spliced > 0) {
+        /* If the FIFO already references this block we just move its end */
+        b = &u->spliced[(u->spliced_idx + u->n_spliced - 1) % SPLICED_MAX];
+
+        if (b->memblock == u->memchunk.memblock)
+            return b;
+    }
+
+    if (u->n_spliced >= SPLICED_MAX)
+        return NULL;
+
+    b = &u->spliced[(u->spliced_idx + u->n_spliced) % SPLICED_MAX];
+    b->memblock = NULL;
+
+    return b;
+}
+
+static ssize_t splice_memchunk(struct userdata *u, struct spliced_block *b) {
+    struct iovec iov;
+    ssize_t l;
+
+    iov.iov_base = (uint8_t*) pa_memblock_acquire(u->memchunk.memblock) + u->memchunk.index;
+    iov.iov_len = u->memchunk.length;
+    l = vmsplice(u->fd, &iov, 1, SPLICE_F_NONBLOCK);
+    pa_memblock_release(u->memchunk.memblock);
+
+    if (l <= 0)
+        return l;
+
+    u->bytes_written += (uint64_t) l;
+
+    if (!b->memblock) {
+        b->memblock = pa_memblock_ref(u->memchunk.memblock);
+        u->n_spliced++;
+    }
+
+    b->end = u->bytes_written;
+
+    return l;
+}
+#endif
+
+static ssize_t write_memchunk(struct userdata *u) {
+    ssize_t l;
+    void *p;
+
+#ifdef HAVE_VMSPLICE
+    struct spliced_block *b;
+
+    if (u->n_spliced > 0)
+        release_spliced(u, false);
+
+    /* If too many blocks are in flight we copy this one */
+    if (u->zero_copy && (b = get_spliced_block(u))) {
+        l = splice_memchunk(u, b);
+
+        if (l >= 0 || errno == EINTR || errno == EAGAIN)
+            return l;
+
+        pa_log_info("vmsplice() failed, falling back to write(): %s", pa_cstrerror(errno));
+        u->zero_copy = false;
+    }
+#endif
+
+    p = pa_memblock_acquire(u->memchunk.memblock);
+    l = pa_write(u->fd, (uint8_t*) p + u->memchunk.index, u->memchunk.length, &u->write_type);
+    pa_memblock_release(u->memchunk.memblock);
+
+#ifdef HAVE_VMSPLICE
+    if (l > 0)
+        u->bytes_written += (uint64_t) l;
+#endif
+
+    return l;
+}
+
 static int process_render(struct userdata *u) {
     pa_assert(u);
 
@@ -129,11 +261,8 @@ static int process_render(struct userdata *u) {
 
     for (;;) {
         ssize_t l;
-        void *p;
 
-        p = pa_memblock_acquire(u->memchunk.memblock);
-        l = pa_write(u->fd, (uint8_t*) p + u->memchunk.index, u->memchunk.length, &u->write_type);
-        pa_memblock_release(u->memchunk.memblock);
+        l = write_memchunk(u);
 
         pa_assert(l != 0);
 
@@ -226,6 +355,7 @@ int pa__init(pa_module *m) {
     pa_modargs *ma;
     struct pollfd *pollfd;
     pa_sink_new_data data;
+    bool zero_copy = false;
 
     pa_assert(m);
 
@@ -250,6 +380,18 @@ int pa__init(pa_module *m) {
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
     u->write_type = 0;
 
+    if (pa_modargs_get_value_boolean(ma, "zero_copy", &zero_copy) < 0) {
+        pa_log("Failed to parse zero_copy argument.");
+        goto fail;
+    }
+
+#ifdef HAVE_VMSPLICE
+    u->zero_copy = zero_copy;
+#else
+    if (zero_copy)
+        pa_log_warn("vmsplice() is not available, ignoring zero_copy argument.");
+#endif
+
     u->filename = pa_runtime_path(pa_modargs_get_value(ma, "file", DEFAULT_FILE_NAME));
 
     if (mkfifo(u->filename, 0666) < 0) {
@@ -362,6 +504,10 @@ void pa__done(pa_module *m) {
     if (u->memchunk.memblock)
         pa_memblock_unref(u->memchunk.memblock);
 
+#ifdef HAVE_VMSPLICE
+    release_spliced(u, true);
+#endif
+
     if (u->rtpoll_item)
         pa_rtpoll_item_free(u->rtpoll_item);
 
@@ -142,8 +142,11 @@ static void thread_func(void *userdata) {
             ssize_t l;
             void *p;
 
+            /* Reading is a copy whatever we do, so read into whole tiles
+             * and post the data in pieces of that, which saves us a new
+             * block for every PIPE_BUF bytes. */
             if (!u->memchunk.memblock) {
-                u->memchunk.memblock = pa_memblock_new(u->core->mempool, pa_pipe_buf(u->fd));
+                u->memchunk.memblock = pa_memblock_new(u->core->mempool, (size_t) -1);
                 u->memchunk.index = u->memchunk.length = 0;
             }
 
@@ -158,7 +158,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     /* Hmm, process any rewind request that might be queued up */
     pa_sink_process_rewind(u->sink, 0);
 
-    pa_sink_render(u->sink, nbytes, chunk);
+    pa_sink_render_filter_chain(u->sink, nbytes, chunk);
     return 0;
 }
 
@@ -39,6 +39,7 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/proplist-util.h>
+#include <pulsecore/pcm-rice.h>
 
 #include "module-tunnel-sink-new-symdef.h"
 
@@ -55,7 +56,8 @@ PA_MODULE_USAGE(
         "channels=<number of channels> "
         "rate=<sample rate> "
         "channel_map=<channel map> "
-        "cookie=<cookie file path>"
+        "cookie=<cookie file path> "
+        "compression=<none or rice>"
         );
 
 #define MAX_LATENCY_USEC (200 * PA_USEC_PER_MSEC)
@@ -82,6 +84,9 @@ struct userdata {
 
     bool connected;
 
+    /* Send the audio PA_ENCODING_PCM_RICE encoded */
+    bool compression;
+
     char *cookie_file;
     char *remote_server;
     char *remote_sink_name;
@@ -97,6 +102,7 @@ static const char* const valid_modargs[] = {
     "rate",
     "channel_map",
     "cookie",
+    "compression",
    /* "reconnect", reconnect if server comes back again - unimplemented */
     NULL,
 };
@@ -140,6 +146,99 @@ static pa_proplist* tunnel_new_proplist(struct userdata *u) {
     return proplist;
 }
 
+/* Renders straight into the buffers of the stream, which live in the
+ * shared memory of the connection if there is any, so that the audio is
+ * not copied on its way out. */
+static int render_into_stream(struct userdata *u, size_t nbytes) {
+    pa_assert(u);
+
+    while (nbytes > 0) {
+        pa_memchunk memchunk;
+        void *p;
+        size_t l = nbytes;
+
+        if (pa_stream_begin_write(u->stream, &p, &l) < 0) {
+            pa_log_error("Could not get a buffer from the stream: %s", pa_strerror(pa_context_errno(u->context)));
+            return -1;
+        }
+
+        /* The buffer may be limited to the size of a memory block */
+        l = pa_frame_align(l, &u->sink->sample_spec);
+        pa_assert(l > 0);
+
+        memchunk.memblock = pa_memblock_new_fixed(u->module->core->mempool, p, l, false);
+        memchunk.index = 0;
+        memchunk.length = l;
+
+        pa_sink_render_into_full(u->sink, &memchunk);
+        pa_memblock_unref_fixed(memchunk.memblock);
+
+        if (pa_stream_write(u->stream, p, l, NULL, 0, PA_SEEK_RELATIVE) != 0) {
+            pa_log_error("Could not write data into the stream: %s", pa_strerror(pa_context_errno(u->context)));
+            return -1;
+        }
+
+        nbytes -= PA_MIN(l, nbytes);
+    }
+
+    return 0;
+}
+
+/* Like render_into_stream(), but encodes the rendered audio into the
+ * buffers of the stream */
+static int encode_into_stream(struct userdata *u, size_t nbytes) {
+    const pa_sample_spec *ss;
+    size_t bound;
+
+    pa_assert(u);
+
+    ss = &u->sink->sample_spec;
+
+    while (nbytes > 0) {
+        pa_memchunk memchunk;
+        void *p;
+        const void *src;
+        size_t l = pa_frame_align(nbytes, ss), n;
+
+        if (l == 0)
+            break;
+
+        n = pa_pcm_rice_encode_bound(ss, l);
+        if (pa_stream_begin_write(u->stream, &p, &n) < 0) {
+            pa_log_error("Could not get a buffer from the stream: %s", pa_strerror(pa_context_errno(u->context)));
+            return -1;
+        }
+
+        /* The buffer may be limited to the size of a memory block, so
+         * render only as much as surely fits once encoded */
+        while ((bound = pa_pcm_rice_encode_bound(ss, l)) > n)
+            l = pa_frame_align(l - PA_MIN(l, bound - n), ss);
+        pa_assert(l > 0);
+
+        pa_sink_render_full(u->sink, l, &memchunk);
+
+        src = pa_memblock_acquire_chunk(&memchunk);
+        n = pa_pcm_rice_encode(ss, src, l, p);
+        pa_memblock_release(memchunk.memblock);
+        pa_memblock_unref(memchunk.memblock);
+
+        /* The requests of the server count PCM bytes. The stream counts
+         * offset plus length against them, so the difference to the PCM
+         * length goes into the offset, which the server ignores for
+         * encoded data. It is negative where the audio did not compress,
+         * as for white noise. This also keeps the write index, and with
+         * it the latency, in PCM bytes. */
+        if (pa_stream_write(u->stream, p, n, NULL, (int64_t) l - (int64_t) n, PA_SEEK_RELATIVE) != 0) {
+            pa_log_error("Could not write data into the stream: %s", pa_strerror(pa_context_errno(u->context)));
+            return -1;
+        }
+
+        nbytes -= l;
+    }
+
+    return 0;
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
     pa_proplist *proplist;
@@ -190,34 +289,17 @@ static void thread_func(void *userdata) {
                 pa_stream_get_state(u->stream) == PA_STREAM_READY &&
                 PA_SINK_IS_LINKED(u->sink->thread_info.state)) {
             size_t writable;
+            int r;
 
             writable = pa_stream_writable_size(u->stream);
-            if (writable > 0) {
-                pa_memchunk memchunk;
-                const void *p;
-
-                pa_sink_render_full(u->sink, writable, &memchunk);
-
-                pa_assert(memchunk.length > 0);
-
-                /* we have new data to write */
-                p = pa_memblock_acquire(memchunk.memblock);
-                /* TODO: Use pa_stream_begin_write() to reduce copying. */
-                ret = pa_stream_write(u->stream,
-                                      (uint8_t*) p + memchunk.index,
-                                      memchunk.length,
-                                      NULL,     /**< A cleanup routine for the data or NULL to request an internal copy */
-                                      0,        /** offset */
-                                      PA_SEEK_RELATIVE);
-                pa_memblock_release(memchunk.memblock);
-                pa_memblock_unref(memchunk.memblock);
-
-                if (ret != 0) {
-                    pa_log_error("Could not write data into the stream ... ret = %i", ret);
-                    u->thread_mainloop_api->quit(u->thread_mainloop_api, TUNNEL_THREAD_FAILED_MAINLOOP);
-                }
 
-            }
+            if (u->compression)
+                r = writable > 0 ? encode_into_stream(u, writable) : 0;
+            else
+                r = writable > 0 ? render_into_stream(u, writable) : 0;
+
+            if (r < 0)
+                u->thread_mainloop_api->quit(u->thread_mainloop_api, TUNNEL_THREAD_FAILED_MAINLOOP);
         }
     }
 fail:
@@ -255,6 +337,17 @@ static void stream_state_cb(pa_stream *stream, void *userdata) {
             pa_log_debug("Stream terminated.");
             break;
         case PA_STREAM_READY:
+            if (u->compression) {
+                if (pa_stream_get_format_info(stream)->encoding != PA_ENCODING_PCM_RICE ||
+                    !pa_sample_spec_equal(pa_stream_get_sample_spec(stream), &u->sink->sample_spec)) {
+                    pa_log_error("The server did not accept the compressed stream.");
+                    u->thread_mainloop_api->quit(u->thread_mainloop_api, TUNNEL_THREAD_FAILED_MAINLOOP);
+                    break;
+                }
+
+                pa_log_debug("Sending the audio compressed.");
+            }
+
             if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
                 cork_stream(u, false);
 
@@ -311,12 +404,27 @@ static void context_state_cb(pa_context *c, void *userdata) {
             pa_log_debug("Connection successful. Creating stream.");
             pa_assert(!u->stream);
 
+            if (u->compression && pa_context_get_server_protocol_version(c) < 34) {
+                pa_log_warn("The server does not support compression, sending PCM.");
+                u->compression = false;
+            }
+
             proplist = tunnel_new_proplist(u);
-            u->stream = pa_stream_new_with_proplist(u->context,
-                                                    stream_name,
-                                                    &u->sink->sample_spec,
-                                                    &u->sink->channel_map,
-                                                    proplist);
+
+            if (u->compression) {
+                pa_format_info *format;
+
+                format = pa_format_info_from_sample_spec(&u->sink->sample_spec, &u->sink->channel_map);
+                format->encoding = PA_ENCODING_PCM_RICE;
+
+                u->stream = pa_stream_new_extended(u->context, stream_name, &format, 1, proplist);
+                pa_format_info_free(format);
+            } else
+                u->stream = pa_stream_new_with_proplist(u->context,
+                                                        stream_name,
+                                                        &u->sink->sample_spec,
+                                                        &u->sink->channel_map,
+                                                        proplist);
             pa_proplist_free(proplist);
             pa_xfree(stream_name);
 
@@ -461,6 +569,7 @@ int pa__init(pa_module *m) {
     pa_channel_map map;
     const char *remote_server = NULL;
     const char *sink_name = NULL;
+    const char *compression;
     char *default_sink_name = NULL;
 
     pa_assert(m);
@@ -496,6 +605,20 @@ int pa__init(pa_module *m) {
     u->cookie_file = pa_xstrdup(pa_modargs_get_value(ma, "cookie", NULL));
     u->remote_sink_name = pa_xstrdup(pa_modargs_get_value(ma, "sink", NULL));
 
+    if ((compression = pa_modargs_get_value(ma, "compression", NULL)) && !pa_streq(compression, "none")) {
+        if (!pa_streq(compression, "rice")) {
+            pa_log("Invalid compression %s.", compression);
+            goto fail;
+        }
+
+        if (!pa_pcm_rice_supported(&ss)) {
+            pa_log("Compression is not supported for sample format %s.", pa_sample_format_to_string(ss.format));
+            goto fail;
+        }
+
+        u->compression = true;
+    }
+
     u->thread_mq = pa_xnew0(pa_thread_mq, 1);
     pa_thread_mq_init_thread_mainloop(u->thread_mq, m->core->mainloop, u->thread_mainloop_api);
 
@@ -39,6 +39,7 @@
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/proplist-util.h>
+#include <pulsecore/pcm-rice.h>
 
 #include "module-tunnel-source-new-symdef.h"
 
@@ -55,7 +56,8 @@ PA_MODULE_USAGE(
         "channels=<number of channels> "
         "rate=<sample rate> "
         "channel_map=<channel map> "
-        "cookie=<cookie file path>"
+        "cookie=<cookie file path> "
+        "compression=<none or rice>"
         );
 
 #define TUNNEL_THREAD_FAILED_MAINLOOP 1
@@ -80,6 +82,10 @@ struct userdata {
     bool connected;
     bool new_data;
 
+    /* Receive the audio PA_ENCODING_PCM_RICE encoded */
+    bool compression;
+    pa_pcm_rice_decoder *decoder;
+
     char *cookie_file;
     char *remote_server;
     char *remote_source_name;
@@ -95,6 +101,7 @@ static const char* const valid_modargs[] = {
     "rate",
     "channel_map",
     "cookie",
+    "compression",
    /* "reconnect", reconnect if server comes back again - unimplemented */
     NULL,
 };
@@ -157,7 +164,22 @@ static void read_new_samples(struct userdata *u) {
             return;
         }
 
-        if (PA_LIKELY(p)) {
+        if (PA_LIKELY(p) && u->decoder) {
+            int r;
+
+            pa_pcm_rice_decoder_push(u->decoder, p, nbytes);
+
+            while ((r = pa_pcm_rice_decoder_pop(u->decoder, &memchunk)) > 0) {
+                pa_source_post(u->source, &memchunk);
+                pa_memblock_unref(memchunk.memblock);
+            }
+
+            if (r < 0) {
+                pa_log("Received corrupt compressed data.");
+                u->thread_mainloop_api->quit(u->thread_mainloop_api, TUNNEL_THREAD_FAILED_MAINLOOP);
+                return;
+            }
+        } else if (PA_LIKELY(p)) {
             /* we have valid data */
             memchunk.memblock = pa_memblock_new_fixed(u->module->core->mempool, (void *) p, nbytes, true);
             memchunk.length = nbytes;
@@ -168,7 +190,11 @@ static void read_new_samples(struct userdata *u) {
         } else {
             size_t bytes_to_generate = nbytes;
 
-            /* we have a hole. generate silence */
+            /* we have a hole. generate silence. Its length is only a guess
+             * for compressed data, where the next packet starts afresh. */
+            if (u->decoder)
+                pa_pcm_rice_decoder_reset(u->decoder);
+
             memchunk = u->source->silence;
             pa_memblock_ref(memchunk.memblock);
 
@@ -246,6 +272,11 @@ finish:
         u->stream = NULL;
     }
 
+    if (u->decoder) {
+        pa_pcm_rice_decoder_free(u->decoder);
+        u->decoder = NULL;
+    }
+
     if (u->context) {
         pa_context_disconnect(u->context);
         pa_context_unref(u->context);
@@ -270,6 +301,18 @@ static void stream_state_cb(pa_stream *stream, void *userdata) {
             pa_log_debug("Stream terminated.");
             break;
         case PA_STREAM_READY:
+            if (u->compression) {
+                if (pa_stream_get_format_info(stream)->encoding != PA_ENCODING_PCM_RICE ||
+                    !pa_sample_spec_equal(pa_stream_get_sample_spec(stream), &u->source->sample_spec)) {
+                    pa_log_error("The server did not accept the compressed stream.");
+                    u->thread_mainloop_api->quit(u->thread_mainloop_api, TUNNEL_THREAD_FAILED_MAINLOOP);
+                    break;
+                }
+
+                pa_log_debug("Receiving the audio compressed.");
+                u->decoder = pa_pcm_rice_decoder_new(u->module->core->mempool, &u->source->sample_spec);
+            }
+
             if (PA_SOURCE_IS_OPENED(u->source->thread_info.state))
                 cork_stream(u, false);
 
@@ -309,12 +352,27 @@ static void context_state_cb(pa_context *c, void *userdata) {
             pa_log_debug("Connection successful. Creating stream.");
             pa_assert(!u->stream);
 
+            if (u->compression && pa_context_get_server_protocol_version(c) < 34) {
+                pa_log_warn("The server does not support compression, receiving PCM.");
+                u->compression = false;
+            }
+
             proplist = tunnel_new_proplist(u);
-            u->stream = pa_stream_new_with_proplist(u->context,
-                                                    stream_name,
-                                                    &u->source->sample_spec,
-                                                    &u->source->channel_map,
-                                                    proplist);
+
+            if (u->compression) {
+                pa_format_info *format;
+
+                format = pa_format_info_from_sample_spec(&u->source->sample_spec, &u->source->channel_map);
+                format->encoding = PA_ENCODING_PCM_RICE;
+
+                u->stream = pa_stream_new_extended(u->context, stream_name, &format, 1, proplist);
+                pa_format_info_free(format);
+            } else
+                u->stream = pa_stream_new_with_proplist(u->context,
+                                                        stream_name,
+                                                        &u->source->sample_spec,
+                                                        &u->source->channel_map,
+                                                        proplist);
             pa_proplist_free(proplist);
             pa_xfree(stream_name);
 
@@ -460,6 +518,7 @@ int pa__init(pa_module *m) {
     pa_channel_map map;
     const char *remote_server = NULL;
     const char *source_name = NULL;
+    const char *compression;
     char *default_source_name = NULL;
 
     pa_assert(m);
@@ -495,6 +554,20 @@ int pa__init(pa_module *m) {
     u->cookie_file = pa_xstrdup(pa_modargs_get_value(ma, "cookie", NULL));
     u->remote_source_name = pa_xstrdup(pa_modargs_get_value(ma, "source", NULL));
 
+    if ((compression = pa_modargs_get_value(ma, "compression", NULL)) && !pa_streq(compression, "none")) {
+        if (!pa_streq(compression, "rice")) {
+            pa_log("Invalid compression %s.", compression);
+            goto fail;
+        }
+
+        if (!pa_pcm_rice_supported(&ss)) {
+            pa_log("Compression is not supported for sample format %s.", pa_sample_format_to_string(ss.format));
+            goto fail;
+        }
+
+        u->compression = true;
+    }
+
     u->thread_mq = pa_xnew0(pa_thread_mq, 1);
     pa_thread_mq_init_thread_mainloop(u->thread_mq, m->core->mainloop, u->thread_mainloop_api);
 
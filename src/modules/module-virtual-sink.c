@@ -213,7 +213,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
         pa_memchunk nchunk;
 
-        pa_sink_render(u->sink, nbytes, &nchunk);
+        pa_sink_render_filter_chain(u->sink, nbytes, &nchunk);
         pa_memblockq_push(u->memblockq, &nchunk);
         pa_memblock_unref(nchunk.memblock);
     }
@@ -263,6 +263,39 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     return 0;
 }
 
+/* Called from I/O thread context */
+static void sink_process_filter_cb(pa_sink *s, pa_memchunk *chunk) {
+    struct userdata *u;
+    float *src;
+    unsigned n, c;
+
+    pa_sink_assert_ref(s);
+    pa_assert(chunk);
+    pa_assert_se(u = s->userdata);
+
+    /* We are called instead of our sink input's pop() callback, so
+     * whatever is left in our queue will not be played anymore */
+    pa_memblockq_flush_write(u->memblockq, true);
+
+    n = (unsigned) (chunk->length / pa_frame_size(&s->sample_spec));
+
+    pa_memchunk_make_writable(chunk, 0);
+    src = pa_memblock_acquire_chunk(chunk);
+
+    /* (7) IF YOUR FILTER CAN WORK IN PLACE, ON ANY BLOCK SIZE AND
+     * WITHOUT BUFFERING, DO THE SAME AS IN (3) HERE. OTHERWISE DON'T
+     * SET u->sink->process_filter AT ALL. */
+
+    for (c = 0; c < u->channels; c++) {
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE,
+                        src+c, u->channels * sizeof(float),
+                        src+c, u->channels * sizeof(float),
+                        n);
+    }
+
+    pa_memblock_release(chunk->memblock);
+}
+
 /* Called from I/O thread context */
 static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
     struct userdata *u;
@@ -554,6 +587,7 @@ int pa__init(pa_module*m) {
     u->sink->set_state = sink_set_state_cb;
     u->sink->update_requested_latency = sink_update_requested_latency_cb;
     u->sink->request_rewind = sink_request_rewind_cb;
+    u->sink->process_filter = sink_process_filter_cb;
     pa_sink_set_set_mute_callback(u->sink, sink_set_mute_cb);
     if (!use_volume_sharing) {
         pa_sink_set_set_volume_callback(u->sink, sink_set_volume_cb);
@@ -0,0 +1,277 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "raop_encoder.h"
+
+struct pa_raop_encoder {
+    pa_mempool *mempool;
+
+    /* Holds the key schedule, so only the IV is set per packet */
+    EVP_CIPHER_CTX *aes;
+    uint8_t aes_iv[PA_RAOP_AES_BLOCK_SIZE];
+};
+
+/**
+ * Function to write bits into a buffer.
+ * @param buffer Handle to the buffer. It will be incremented if new data requires it.
+ * @param bit_pos A pointer to a position buffer to keep track the current write location (0 for MSB, 7 for LSB)
+ * @param size A pointer to the byte size currently written. This allows the calling function to do simple buffer overflow checks
+ * @param data The data to write
+ * @param data_bit_len The number of bits from data to write
+ */
+static inline void bit_writer(uint8_t **buffer, uint8_t *bit_pos, int *size, uint8_t data, uint8_t data_bit_len) {
+    int bits_left, bit_overflow;
+    uint8_t bit_data;
+
+    if (!data_bit_len)
+        return;
+
+    /* If bit pos is zero, we will definately use at least one bit from the current byte so size increments. */
+    if (!*bit_pos)
+        *size += 1;
+
+    /* Calc the number of bits left in the current byte of buffer */
+    bits_left = 7 - *bit_pos  + 1;
+    /* Calc the overflow of bits in relation to how much space we have left... */
+    bit_overflow = bits_left - data_bit_len;
+    if (bit_overflow >= 0) {
+        /* We can fit the new data in our current byte */
+        /* As we write from MSB->LSB we need to left shift by the overflow amount */
+        bit_data = data << bit_overflow;
+        if (*bit_pos)
+            **buffer |= bit_data;
+        else
+            **buffer = bit_data;
+        /* If our data fits exactly into the current byte, we need to increment our pointer */
+        if (0 == bit_overflow) {
+            /* Do not increment size as it will be incremented on next call as bit_pos is zero */
+            *buffer += 1;
+            *bit_pos = 0;
+        } else {
+            *bit_pos += data_bit_len;
+        }
+    } else {
+        /* bit_overflow is negative, there for we will need a new byte from our buffer */
+        /* Firstly fill up what's left in the current byte */
+        bit_data = data >> -bit_overflow;
+        **buffer |= bit_data;
+        /* Increment our buffer pointer and size counter*/
+        *buffer += 1;
+        *size += 1;
+        **buffer = data << (8 + bit_overflow);
+        *bit_pos = -bit_overflow;
+    }
+}
+
+static inline void write_be32(uint8_t *p, uint32_t v) {
+    v = PA_UINT32_TO_BE(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Appends the samples as big endian to a bit stream whose last byte at bp
+ * has its upper bit_pos bits in use. Instead of going through bit_writer()
+ * byte by byte, four samples at a time are shifted into place with 64 bit
+ * words. Returns the number of bytes from bp on that were touched. */
+static size_t pack_samples(uint8_t *bp, uint8_t bit_pos, const int16_t *src, size_t n_samples) {
+    const unsigned shift = bit_pos;
+    uint8_t *start = bp;
+    uint64_t carry, w, out;
+    size_t i;
+
+    pa_assert(shift > 0 && shift < 8);
+
+    carry = (uint64_t) *bp << 56;
+
+    for (i = 0; i + 4 <= n_samples; i += 4) {
+        w = ((uint64_t) (uint16_t) src[i] << 48) |
+            ((uint64_t) (uint16_t) src[i + 1] << 32) |
+            ((uint64_t) (uint16_t) src[i + 2] << 16) |
+            (uint64_t) (uint16_t) src[i + 3];
+
+        out = carry | (w >> shift);
+        carry = w << (64 - shift);
+
+        write_be32(bp, (uint32_t) (out >> 32));
+        write_be32(bp + 4, (uint32_t) out);
+        bp += 8;
+    }
+
+    for (; i + 2 <= n_samples; i += 2) {
+        w = ((uint64_t) (uint16_t) src[i] << 48) |
+            ((uint64_t) (uint16_t) src[i + 1] << 32);
+
+        out = carry | (w >> shift);
+        carry = out << 32;
+
+        write_be32(bp, (uint32_t) (out >> 32));
+        bp += 4;
+    }
+
+    *bp = (uint8_t) (carry >> 56);
+
+    return (size_t) (bp - start) + 1;
+}
+
+pa_raop_encoder* pa_raop_encoder_new(pa_mempool *pool, const uint8_t key[PA_RAOP_AES_BLOCK_SIZE], const uint8_t iv[PA_RAOP_AES_BLOCK_SIZE]) {
+    pa_raop_encoder *e;
+
+    pa_assert(pool);
+    pa_assert(key);
+    pa_assert(iv);
+
+    e = pa_xnew0(pa_raop_encoder, 1);
+    e->mempool = pool;
+    memcpy(e->aes_iv, iv, sizeof(e->aes_iv));
+
+    if (!(e->aes = EVP_CIPHER_CTX_new()) ||
+        !EVP_EncryptInit_ex(e->aes, EVP_aes_128_cbc(), NULL, key, iv) ||
+        !EVP_CIPHER_CTX_set_padding(e->aes, 0)) {
+        pa_log("Failed to set up AES: %s", ERR_error_string(ERR_get_error(), NULL));
+        pa_raop_encoder_free(e);
+        return NULL;
+    }
+
+    return e;
+}
+
+void pa_raop_encoder_free(pa_raop_encoder *e) {
+    pa_assert(e);
+
+    if (e->aes)
+        EVP_CIPHER_CTX_free(e->aes);
+
+    pa_xfree(e);
+}
+
+/* Encrypts all complete AES blocks in place, the remainder stays as it is.
+ * OpenSSL picks AES-NI or another accelerated implementation if the CPU
+ * has one. */
+static int aes_encrypt(pa_raop_encoder *e, uint8_t *data, size_t size) {
+    int length;
+
+    size -= size % PA_RAOP_AES_BLOCK_SIZE;
+
+    if (size == 0)
+        return 0;
+
+    if (!EVP_EncryptInit_ex(e->aes, NULL, NULL, NULL, e->aes_iv) ||
+        !EVP_EncryptUpdate(e->aes, data, &length, data, (int) size)) {
+        pa_log("AES encryption failed: %s", ERR_error_string(ERR_get_error(), NULL));
+        return -1;
+    }
+
+    pa_assert((size_t) length == size);
+
+    return 0;
+}
+
+int pa_raop_encoder_encode(pa_raop_encoder *e, pa_memchunk *raw, pa_memchunk *encoded) {
+    uint16_t len;
+    size_t bufmax;
+    uint8_t *bp, bpos;
+    int size;
+    uint8_t *b;
+    const int16_t *p;
+    uint32_t bsize;
+    size_t length;
+    static const uint8_t header[] = {
+        0x24, 0x00, 0x00, 0x00,
+        0xF0, 0xFF, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    const int header_size = sizeof(header);
+    int r;
+
+    pa_assert(e);
+    pa_assert(raw);
+    pa_assert(raw->memblock);
+    pa_assert(raw->length > 0);
+    pa_assert(encoded);
+
+    /* We have to send 4 byte chunks */
+    bsize = (uint32_t) (raw->length / 4);
+    length = bsize * 4;
+
+    /* Leave 16 bytes extra to allow for the ALAC header which is about 55 bits */
+    bufmax = length + header_size + 16;
+    pa_memchunk_reset(encoded);
+    encoded->memblock = pa_memblock_new(e->mempool, bufmax);
+    b = pa_memblock_acquire(encoded->memblock);
+    memcpy(b, header, header_size);
+
+    bp = b + header_size;
+    size = bpos = 0;
+    bit_writer(&bp,&bpos,&size,1,3); /* channel=1, stereo */
+    bit_writer(&bp,&bpos,&size,0,4); /* unknown */
+    bit_writer(&bp,&bpos,&size,0,8); /* unknown */
+    bit_writer(&bp,&bpos,&size,0,4); /* unknown */
+    bit_writer(&bp,&bpos,&size,1,1); /* hassize */
+    bit_writer(&bp,&bpos,&size,0,2); /* unused */
+    bit_writer(&bp,&bpos,&size,1,1); /* is-not-compressed */
+
+    /* size of data, integer, big endian */
+    bit_writer(&bp,&bpos,&size,(bsize>>24)&0xff,8);
+    bit_writer(&bp,&bpos,&size,(bsize>>16)&0xff,8);
+    bit_writer(&bp,&bpos,&size,(bsize>>8)&0xff,8);
+    bit_writer(&bp,&bpos,&size,(bsize)&0xff,8);
+
+    /* Now write the actual samples, the byte bp points to is shared with
+     * the header */
+    p = pa_memblock_acquire_chunk(raw);
+    size += (int) pack_samples(bp, bpos, p, bsize * 2) - 1;
+    pa_memblock_release(raw->memblock);
+
+    raw->index += length;
+    raw->length -= length;
+
+    encoded->length = header_size + size;
+
+    /* store the length (endian swapped: make this better) */
+    len = size + header_size - 4;
+    *(b + 2) = len >> 8;
+    *(b + 3) = len & 0xff;
+
+    /* encrypt our data */
+    r = aes_encrypt(e, b + header_size, size);
+
+    /* We're done with the chunk */
+    pa_memblock_release(encoded->memblock);
+
+    /* Never hand out data that is not encrypted */
+    if (r < 0) {
+        pa_memblock_unref(encoded->memblock);
+        pa_memchunk_reset(encoded);
+    }
+
+    return r;
+}
@@ -0,0 +1,42 @@
+#ifndef fooraopencoderfoo
+#define fooraopencoderfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+#define PA_RAOP_AES_BLOCK_SIZE 16
+
+/* Turns S16NE audio into the packets RAOP receivers expect: an
+ * uncompressed ALAC frame with the audio in big endian, AES-128-CBC
+ * encrypted with the session key. The IV is restarted for every packet, and
+ * a trailing partial AES block is sent in the clear. */
+
+typedef struct pa_raop_encoder pa_raop_encoder;
+
+pa_raop_encoder* pa_raop_encoder_new(pa_mempool *pool, const uint8_t key[PA_RAOP_AES_BLOCK_SIZE], const uint8_t iv[PA_RAOP_AES_BLOCK_SIZE]);
+void pa_raop_encoder_free(pa_raop_encoder *e);
+
+/* Encodes all complete stereo frames of raw into one packet, and advances
+ * raw past them. */
+int pa_raop_encoder_encode(pa_raop_encoder *e, pa_memchunk *raw, pa_memchunk *encoded);
+
+#endif
@@ -0,0 +1,534 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include <pulse/timeval.h>
+#include <pulse/volume.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/flist.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mix.h>
+#include <pulsecore/sample-util.h>
+
+#include "jitter-buffer.h"
+
+/* The target covers this many times the mean interarrival jitter */
+#define JITTER_MULTIPLIER 4
+
+/* How quickly the peak delay variation is forgotten */
+#define PEAK_DECAY_USEC (20*PA_USEC_PER_SEC)
+
+/* How much the clocks of sender and receiver may drift apart, used to let the
+ * minimal transit time estimate follow a sender that is slower than us */
+#define MAX_DRIFT 200e-6
+
+/* Concealment fades the repeated audio out within this time. If the buffer
+ * is still empty by then, playback stops and the buffer fills up again. */
+#define CONCEAL_FADE_USEC (30*PA_USEC_PER_MSEC)
+
+/* Audio is dropped only if the latency exceeds the target by this much and
+ * by the target itself. Everything below is left to the rate controller. */
+#define SKIP_THRESHOLD_USEC (20*PA_USEC_PER_MSEC)
+
+/* Timestamp jumps larger than this are not jitter, but a restarted sender */
+#define RESYNC_MIN_USEC (1*PA_USEC_PER_SEC)
+
+struct packet {
+    PA_LLIST_FIELDS(struct packet);
+    int64_t index;
+    pa_memchunk chunk;
+};
+
+PA_STATIC_FLIST_DECLARE(packets, 0, pa_xfree);
+
+struct pa_jitter_buffer {
+    pa_sample_spec sample_spec;
+    size_t frame_size;
+    pa_mempool *mempool;
+    pa_memchunk silence;
+
+    pa_usec_t min_latency, max_latency;
+
+    /* Sorted by index. All indexes are in frames, relative to the first
+     * packet of the stream. */
+    PA_LLIST_HEAD(struct packet, packets);
+    struct packet *tail;
+
+    bool synced;
+    bool playing;
+
+    int64_t ref_index;
+    uint32_t ref_timestamp;
+    int64_t ref_sequence, base_sequence;
+    uint16_t ref_sequence_raw;
+    uint64_t n_received;
+
+    int64_t read_index, write_index;
+
+    /* The last packet that was played, repeated to conceal gaps */
+    pa_memchunk last;
+    size_t conceal_offset;
+    pa_usec_t concealed;
+
+    /* Transit times are measured relative to the RTP timestamps, all in
+     * microseconds */
+    bool have_transit;
+    double transit, min_transit, peak, jitter;
+    pa_usec_t last_arrival;
+
+    pa_usec_t packet_duration;
+    double max_request;
+
+    double margin;
+    pa_usec_t target;
+
+    pa_jitter_buffer_stats stats;
+};
+
+static pa_usec_t frames_to_usec(pa_jitter_buffer *jb, int64_t frames) {
+    return frames > 0 ? ((pa_usec_t) frames * PA_USEC_PER_SEC) / jb->sample_spec.rate : 0;
+}
+
+static int64_t usec_to_frames(pa_jitter_buffer *jb, pa_usec_t usec) {
+    return (int64_t) ((usec * jb->sample_spec.rate) / PA_USEC_PER_SEC);
+}
+
+static void update_target(pa_jitter_buffer *jb) {
+    pa_usec_t target;
+
+    jb->margin = PA_MAX(JITTER_MULTIPLIER * jb->jitter, jb->peak);
+
+    /* A packet has to be there before the previous one and a full request
+     * of the sink have been consumed */
+    target = jb->packet_duration + (pa_usec_t) jb->max_request + (pa_usec_t) jb->margin;
+
+    jb->target = PA_CLAMP(target, jb->min_latency, jb->max_latency);
+}
+
+pa_jitter_buffer* pa_jitter_buffer_new(
+        const pa_sample_spec *ss,
+        pa_mempool *pool,
+        pa_usec_t min_latency,
+        pa_usec_t max_latency,
+        const pa_memchunk *silence) {
+
+    pa_jitter_buffer *jb;
+
+    pa_assert(ss);
+    pa_assert(pa_sample_spec_valid(ss));
+    pa_assert(pool);
+    pa_assert(min_latency <= max_latency);
+    pa_assert(silence);
+    pa_assert(silence->memblock);
+
+    jb = pa_xnew0(pa_jitter_buffer, 1);
+    jb->sample_spec = *ss;
+    jb->frame_size = pa_frame_size(ss);
+    jb->mempool = pool;
+    jb->min_latency = min_latency;
+    jb->max_latency = max_latency;
+
+    jb->silence = *silence;
+    pa_memblock_ref(jb->silence.memblock);
+
+    PA_LLIST_HEAD_INIT(struct packet, jb->packets);
+
+    pa_jitter_buffer_reset(jb);
+
+    return jb;
+}
+
+static void free_packet(pa_jitter_buffer *jb, struct packet *p) {
+    if (p == jb->tail)
+        jb->tail = p->prev;
+
+    PA_LLIST_REMOVE(struct packet, jb->packets, p);
+
+    pa_memblock_unref(p->chunk.memblock);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(packets), p) < 0)
+        pa_xfree(p);
+}
+
+static uint64_t get_lost(pa_jitter_buffer *jb) {
+    int64_t expected;
+
+    if (!jb->synced)
+        return 0;
+
+    expected = jb->ref_sequence - jb->base_sequence + 1;
+
+    return expected > (int64_t) jb->n_received ? (uint64_t) expected - jb->n_received : 0;
+}
+
+static void reset_concealment(pa_jitter_buffer *jb) {
+    if (jb->last.memblock)
+        pa_memblock_unref(jb->last.memblock);
+
+    pa_memchunk_reset(&jb->last);
+    jb->conceal_offset = 0;
+    jb->concealed = 0;
+}
+
+void pa_jitter_buffer_free(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    pa_jitter_buffer_reset(jb);
+    pa_memblock_unref(jb->silence.memblock);
+
+    pa_xfree(jb);
+}
+
+void pa_jitter_buffer_reset(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    while (jb->packets)
+        free_packet(jb, jb->packets);
+
+    reset_concealment(jb);
+
+    jb->stats.lost += get_lost(jb);
+
+    jb->synced = false;
+    jb->n_received = 0;
+    jb->playing = false;
+    jb->read_index = jb->write_index = 0;
+    jb->have_transit = false;
+    jb->transit = jb->min_transit = jb->peak = jb->jitter = 0;
+    jb->packet_duration = 0;
+
+    update_target(jb);
+}
+
+/* Frees all packets that are completely before the read index */
+static void drop_old_packets(pa_jitter_buffer *jb) {
+    while (jb->packets &&
+           jb->packets->index + (int64_t) (jb->packets->chunk.length / jb->frame_size) <= jb->read_index)
+        free_packet(jb, jb->packets);
+}
+
+static void update_transit(pa_jitter_buffer *jb, int64_t index, pa_usec_t arrival) {
+    double transit, d, dt = 0;
+
+    transit = (double) arrival - (double) index * PA_USEC_PER_SEC / jb->sample_spec.rate;
+
+    if (!jb->have_transit) {
+        jb->have_transit = true;
+        jb->transit = jb->min_transit = transit;
+        jb->last_arrival = arrival;
+        return;
+    }
+
+    if (arrival > jb->last_arrival) {
+        dt = (double) (arrival - jb->last_arrival);
+        jb->last_arrival = arrival;
+    }
+
+    /* RFC 3550, A.8 */
+    d = fabs(transit - jb->transit);
+    jb->jitter += (d - jb->jitter) / 16;
+    jb->transit = transit;
+
+    /* Peak delay relative to the fastest packet recently seen */
+    jb->min_transit = PA_MIN(jb->min_transit + dt * MAX_DRIFT, transit);
+    jb->peak -= jb->peak * PA_MIN(dt / PEAK_DECAY_USEC, 1.0);
+    jb->peak = PA_MAX(jb->peak, transit - jb->min_transit);
+    jb->max_request -= jb->max_request * PA_MIN(dt / PEAK_DECAY_USEC, 1.0);
+}
+
+static void start_playback(pa_jitter_buffer *jb) {
+    int64_t target;
+
+    pa_assert(!jb->playing);
+
+    drop_old_packets(jb);
+
+    if (!jb->packets)
+        return;
+
+    target = usec_to_frames(jb, jb->target);
+
+    if (jb->write_index - jb->packets->index < target)
+        return;
+
+    jb->read_index = PA_MAX(jb->read_index, jb->write_index - target);
+    drop_old_packets(jb);
+
+    jb->playing = true;
+
+    pa_log_debug("Starting playback at %0.2f ms latency", (double) jb->target / PA_USEC_PER_MSEC);
+}
+
+void pa_jitter_buffer_push(pa_jitter_buffer *jb, uint16_t sequence, uint32_t timestamp, pa_usec_t arrival, const pa_memchunk *chunk) {
+    struct packet *p, *n;
+    int64_t index, sequence_index, frames, resync;
+
+    pa_assert(jb);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+
+    frames = (int64_t) (chunk->length / jb->frame_size);
+
+    if (frames <= 0)
+        return;
+
+    if (jb->synced) {
+        index = jb->ref_index + (int32_t) (timestamp - jb->ref_timestamp);
+        resync = usec_to_frames(jb, PA_MAX(2 * jb->max_latency, RESYNC_MIN_USEC));
+
+        if (index > jb->write_index + resync || index + resync < jb->read_index) {
+            pa_log_debug("Timestamp jumped by %lli frames, resyncing.", (long long) (index - jb->write_index));
+            pa_jitter_buffer_reset(jb);
+        }
+    }
+
+    if (!jb->synced) {
+        jb->synced = true;
+        jb->ref_index = jb->write_index = 0;
+        jb->ref_timestamp = timestamp;
+        jb->ref_sequence = jb->base_sequence = 0;
+        jb->ref_sequence_raw = sequence;
+
+        /* Leave room for packets that were overtaken by the first one */
+        jb->read_index = -usec_to_frames(jb, jb->max_latency);
+    }
+
+    index = jb->ref_index + (int32_t) (timestamp - jb->ref_timestamp);
+    if (index > jb->ref_index) {
+        jb->ref_index = index;
+        jb->ref_timestamp = timestamp;
+    }
+
+    sequence_index = jb->ref_sequence + (int16_t) (sequence - jb->ref_sequence_raw);
+    if (sequence_index > jb->ref_sequence) {
+        jb->ref_sequence = sequence_index;
+        jb->ref_sequence_raw = sequence;
+    }
+    jb->base_sequence = PA_MIN(jb->base_sequence, sequence_index);
+
+    /* Find the last packet that starts before this one */
+    for (p = jb->tail; p && p->index > index; p = p->prev)
+        ;
+
+    if (p && p->index == index) {
+        jb->stats.duplicates++;
+        return;
+    }
+
+    jb->stats.received++;
+    jb->n_received++;
+
+    update_transit(jb, index, arrival);
+    jb->packet_duration = frames_to_usec(jb, frames);
+    update_target(jb);
+
+    if (index + frames <= jb->read_index) {
+        jb->stats.late++;
+        return;
+    }
+
+    if (!(n = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
+        n = pa_xnew(struct packet, 1);
+
+    n->index = index;
+    n->chunk = *chunk;
+    pa_memblock_ref(n->chunk.memblock);
+
+    if (p) {
+        PA_LLIST_INSERT_AFTER(struct packet, jb->packets, p, n);
+    } else
+        PA_LLIST_PREPEND(struct packet, jb->packets, n);
+
+    if (p == jb->tail)
+        jb->tail = n;
+
+    jb->write_index = PA_MAX(jb->write_index, index + frames);
+
+    if (!jb->playing) {
+        start_playback(jb);
+        return;
+    }
+
+    /* The latency is far too high, e.g. because the target went down or the
+     * network delivered a burst after a stall. Catching up with the rate
+     * controller would take ages. */
+    if (pa_jitter_buffer_get_latency(jb) > 2 * jb->target &&
+        pa_jitter_buffer_get_latency(jb) > jb->target + SKIP_THRESHOLD_USEC) {
+
+        int64_t skip = jb->write_index - jb->read_index - usec_to_frames(jb, jb->target);
+
+        pa_log_debug("Latency %0.2f ms exceeds target %0.2f ms, skipping.",
+                     (double) pa_jitter_buffer_get_latency(jb) / PA_USEC_PER_MSEC,
+                     (double) jb->target / PA_USEC_PER_MSEC);
+
+        jb->read_index += skip;
+        jb->stats.skips++;
+        jb->stats.skipped_frames += (uint64_t) skip;
+
+        drop_old_packets(jb);
+        reset_concealment(jb);
+    }
+}
+
+/* Repeats the last packet, attenuated the more the longer the gap is */
+static void conceal(pa_jitter_buffer *jb, size_t length, pa_memchunk *chunk) {
+    double gain;
+
+    if (jb->concealed == 0)
+        jb->stats.concealments++;
+
+    gain = 1.0 - (double) jb->concealed / CONCEAL_FADE_USEC;
+
+    if (!jb->last.memblock || gain <= 0) {
+        *chunk = jb->silence;
+        chunk->length = PA_MIN(chunk->length, length);
+        pa_memblock_ref(chunk->memblock);
+    } else {
+        pa_cvolume volume;
+        void *src, *dst;
+
+        length = PA_MIN(length, jb->last.length - jb->conceal_offset);
+
+        chunk->memblock = pa_memblock_new(jb->mempool, length);
+        chunk->index = 0;
+        chunk->length = length;
+
+        src = pa_memblock_acquire_chunk(&jb->last);
+        dst = pa_memblock_acquire(chunk->memblock);
+        memcpy(dst, (uint8_t*) src + jb->conceal_offset, length);
+        pa_memblock_release(chunk->memblock);
+        pa_memblock_release(jb->last.memblock);
+
+        pa_cvolume_set(&volume, jb->sample_spec.channels, pa_sw_volume_from_linear(gain));
+        pa_volume_memchunk(chunk, &jb->sample_spec, &volume);
+
+        jb->conceal_offset = (jb->conceal_offset + length) % jb->last.length;
+    }
+
+    jb->concealed += frames_to_usec(jb, (int64_t) (chunk->length / jb->frame_size));
+    jb->stats.concealed_frames += chunk->length / jb->frame_size;
+}
+
+int pa_jitter_buffer_pop(pa_jitter_buffer *jb, size_t length, pa_memchunk *chunk) {
+    struct packet *p;
+    double request;
+
+    pa_assert(jb);
+    pa_assert(chunk);
+
+    length = PA_MAX(pa_frame_align(length, &jb->sample_spec), jb->frame_size);
+
+    request = (double) frames_to_usec(jb, (int64_t) (length / jb->frame_size));
+    if (request > jb->max_request) {
+        jb->max_request = request;
+        update_target(jb);
+    }
+
+    if (!jb->playing)
+        return -1;
+
+    drop_old_packets(jb);
+
+    if ((p = jb->packets) && p->index <= jb->read_index) {
+        size_t skip = (size_t) (jb->read_index - p->index) * jb->frame_size;
+
+        *chunk = p->chunk;
+        chunk->index += skip;
+        chunk->length = PA_MIN(chunk->length - skip, length);
+        pa_memblock_ref(chunk->memblock);
+
+        if (jb->last.memblock != p->chunk.memblock || jb->last.index != p->chunk.index) {
+            reset_concealment(jb);
+            jb->last = p->chunk;
+            pa_memblock_ref(jb->last.memblock);
+        }
+
+        jb->concealed = 0;
+        jb->conceal_offset = 0;
+
+        jb->read_index += (int64_t) (chunk->length / jb->frame_size);
+        drop_old_packets(jb);
+
+        return 0;
+    }
+
+    if (!p && jb->concealed >= CONCEAL_FADE_USEC) {
+        pa_log_debug("Jitter buffer underrun.");
+
+        jb->playing = false;
+        jb->stats.underruns++;
+        reset_concealment(jb);
+
+        return -1;
+    }
+
+    if (p)
+        length = PA_MIN(length, (size_t) (p->index - jb->read_index) * jb->frame_size);
+
+    conceal(jb, length, chunk);
+
+    /* Unless audio that was sent a good deal later has already arrived, the
+     * missing audio is probably just late. In that case the concealment is
+     * inserted rather than replacing it, which is also how the latency grows
+     * quickly when the network gets worse. */
+    if (p && jb->write_index - p->index >= usec_to_frames(jb, (pa_usec_t) jb->margin))
+        jb->read_index += (int64_t) (chunk->length / jb->frame_size);
+
+    return 0;
+}
+
+bool pa_jitter_buffer_is_readable(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    return jb->playing;
+}
+
+pa_usec_t pa_jitter_buffer_get_latency(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    if (!jb->playing)
+        return jb->packets ? frames_to_usec(jb, jb->write_index - jb->packets->index) : 0;
+
+    return frames_to_usec(jb, jb->write_index - jb->read_index);
+}
+
+pa_usec_t pa_jitter_buffer_get_target(pa_jitter_buffer *jb) {
+    pa_assert(jb);
+
+    return jb->target;
+}
+
+void pa_jitter_buffer_get_stats(pa_jitter_buffer *jb, pa_jitter_buffer_stats *stats) {
+    pa_assert(jb);
+    pa_assert(stats);
+
+    *stats = jb->stats;
+    stats->lost += get_lost(jb);
+
+    stats->jitter = (pa_usec_t) jb->jitter;
+    stats->target = jb->target;
+    stats->latency = pa_jitter_buffer_get_latency(jb);
+}
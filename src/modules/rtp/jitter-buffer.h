@@ -0,0 +1,90 @@
+#ifndef foojitterbufferhfoo
+#define foojitterbufferhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* A jitter buffer for RTP audio streams. Packets are placed by their RTP
+ * timestamp, so reordered packets end up where they belong, duplicates and
+ * packets that arrive after their playout time are dropped, and gaps are
+ * concealed by repeating the last packet with a fade out.
+ *
+ * The depth of the buffer follows the network: the interarrival jitter
+ * (RFC 3550, A.8) and the peak transit delay variation are tracked, and the
+ * target latency is derived from them, bounded by a minimum and maximum.
+ * While below the target, gaps are concealed without skipping the missing
+ * audio, so the latency grows quickly when the network gets worse. Audio is
+ * dropped only if the target is grossly exceeded, smaller deviations are
+ * meant to be corrected by varying the playback rate, see
+ * pa_rate_controller.
+ *
+ * Packets are pushed with their arrival time in the local clock domain,
+ * audio is popped without any notion of time. There is no locking. */
+
+typedef struct pa_jitter_buffer pa_jitter_buffer;
+
+typedef struct pa_jitter_buffer_stats {
+    uint64_t received;          /* Packets received, including late ones */
+    uint64_t lost;              /* Packets never received, from the sequence numbers */
+    uint64_t late;              /* Packets that arrived after their playout time */
+    uint64_t duplicates;
+    uint64_t concealments;      /* Gaps that were filled in */
+    uint64_t concealed_frames;
+    uint64_t underruns;         /* Playback stopped because the buffer ran dry */
+    uint64_t skips;             /* Audio dropped to reduce the latency */
+    uint64_t skipped_frames;
+    pa_usec_t jitter;
+    pa_usec_t target;
+    pa_usec_t latency;
+} pa_jitter_buffer_stats;
+
+pa_jitter_buffer* pa_jitter_buffer_new(
+        const pa_sample_spec *ss,
+        pa_mempool *pool,
+        pa_usec_t min_latency,
+        pa_usec_t max_latency,
+        const pa_memchunk *silence);
+
+void pa_jitter_buffer_free(pa_jitter_buffer *jb);
+
+/* Drops all buffered audio and forgets the stream state. The next packet
+ * starts a new stream. */
+void pa_jitter_buffer_reset(pa_jitter_buffer *jb);
+
+/* Takes its own reference to the memblock of chunk */
+void pa_jitter_buffer_push(pa_jitter_buffer *jb, uint16_t sequence, uint32_t timestamp, pa_usec_t arrival, const pa_memchunk *chunk);
+
+/* Returns at most length bytes of audio, which is either received or
+ * concealed. Returns a negative value if the buffer is not playing, i.e. it
+ * is still filling up to the target latency. */
+int pa_jitter_buffer_pop(pa_jitter_buffer *jb, size_t length, pa_memchunk *chunk);
+
+bool pa_jitter_buffer_is_readable(pa_jitter_buffer *jb);
+
+/* The audio buffered beyond the read position, including gaps */
+pa_usec_t pa_jitter_buffer_get_latency(pa_jitter_buffer *jb);
+pa_usec_t pa_jitter_buffer_get_target(pa_jitter_buffer *jb);
+
+void pa_jitter_buffer_get_stats(pa_jitter_buffer *jb, pa_jitter_buffer_stats *stats);
+
+#endif
@@ -52,10 +52,12 @@
 #include <pulsecore/once.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/arpa-inet.h>
+#include <pulsecore/rate-controller.h>
 
 #include "module-rtp-recv-symdef.h"
 
 #include "rtp.h"
+#include "jitter-buffer.h"
 #include "sdp.h"
 #include "sap.h"
 
@@ -66,21 +68,26 @@ PA_MODULE_LOAD_ONCE(false);
 PA_MODULE_USAGE(
         "sink=<name of the sink> "
         "sap_address=<multicast address to listen on> "
-        "latency_msec=<latency in ms> "
+        "latency_msec=<fixed latency in ms> "
+        "min_latency_msec=<lowest latency the jitter buffer may choose in ms> "
+        "max_latency_msec=<highest latency the jitter buffer may choose in ms> "
 );
 
 #define SAP_PORT 9875
 #define DEFAULT_SAP_ADDRESS "224.0.0.56"
-#define DEFAULT_LATENCY_MSEC 500
+#define DEFAULT_MIN_LATENCY_MSEC 20
+#define DEFAULT_MAX_LATENCY_MSEC 500
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*40)
 #define MAX_SESSIONS 16
 #define DEATH_TIMEOUT 20
-#define RATE_UPDATE_INTERVAL (5*PA_USEC_PER_SEC)
+#define RATE_UPDATE_INTERVAL (1*PA_USEC_PER_SEC)
 
 static const char* const valid_modargs[] = {
     "sink",
     "sap_address",
     "latency_msec",
+    "min_latency_msec",
+    "max_latency_msec",
     NULL
 };
 
@@ -89,11 +96,13 @@ struct session {
     PA_LLIST_FIELDS(struct session);
 
     pa_sink_input *sink_input;
+    pa_jitter_buffer *jitter_buffer;
+
+    /* Holds what was taken from the jitter buffer, for rewinding */
     pa_memblockq *memblockq;
 
     bool first_packet;
     uint32_t ssrc;
-    uint32_t offset;
 
     struct pa_sdp_info sdp_info;
 
@@ -103,14 +112,10 @@ struct session {
 
     pa_atomic_t timestamp;
 
-    pa_usec_t intended_latency;
     pa_usec_t sink_latency;
 
-    unsigned int base_rate;
+    pa_rate_controller *rate_controller;
     pa_usec_t last_rate_update;
-    pa_usec_t last_latency;
-    double estimated_rate;
-    double avg_estimated_rate;
 };
 
 struct userdata {
@@ -128,7 +133,7 @@ struct userdata {
     pa_hashmap *by_origin;
     int n_sessions;
 
-    pa_usec_t latency;
+    pa_usec_t min_latency, max_latency;
 };
 
 static void session_free(struct session *s);
@@ -139,7 +144,9 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *data, int64_t
 
     switch (code) {
         case PA_SINK_INPUT_MESSAGE_GET_LATENCY:
-            *((pa_usec_t*) data) = pa_bytes_to_usec(pa_memblockq_get_length(s->memblockq), &s->sink_input->sample_spec);
+            *((pa_usec_t*) data) =
+                pa_bytes_to_usec(pa_memblockq_get_length(s->memblockq), &s->sink_input->sample_spec) +
+                pa_jitter_buffer_get_latency(s->jitter_buffer);
 
             /* Fall through, the default handler will add in the extra
              * latency added by the resampler */
@@ -155,6 +162,16 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk
     pa_sink_input_assert_ref(i);
     pa_assert_se(s = i->userdata);
 
+    if (pa_memblockq_get_length(s->memblockq) == 0) {
+        pa_memchunk c;
+
+        if (pa_jitter_buffer_pop(s->jitter_buffer, length, &c) < 0)
+            return -1;
+
+        pa_memblockq_push_align(s->memblockq, &c);
+        pa_memblock_unref(c.memblock);
+    }
+
     if (pa_memblockq_peek(s->memblockq, chunk) < 0)
         return -1;
 
@@ -198,171 +215,72 @@ static void sink_input_suspend_within_thread(pa_sink_input* i, bool b) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(s = i->userdata);
 
-    if (b)
+    if (b) {
         pa_memblockq_flush_read(s->memblockq);
-    else
+        pa_jitter_buffer_reset(s->jitter_buffer);
+    } else
         s->first_packet = false;
 }
 
 /* Called from I/O thread context */
-static int rtpoll_work_cb(pa_rtpoll_item *i) {
-    pa_memchunk chunk;
-    int64_t k, j, delta;
-    struct timeval now = { 0, 0 };
-    struct session *s;
-    struct pollfd *p;
-
-    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
-
-    p = pa_rtpoll_item_get_pollfd(i, NULL);
-
-    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
-        pa_log("poll() signalled bad revents.");
-        return -1;
-    }
-
-    if ((p->revents & POLLIN) == 0)
-        return 0;
-
-    p->revents = 0;
-
-    if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
-        return 0;
+static void session_push_packet(struct session *s, pa_memchunk *chunk, struct timeval *now) {
+    pa_usec_t arrival;
 
     if (s->sdp_info.payload != s->rtp_context.payload ||
         !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state)) {
-        pa_memblock_unref(chunk.memblock);
-        return 0;
+        pa_memblock_unref(chunk->memblock);
+        return;
     }
 
     if (!s->first_packet) {
         s->first_packet = true;
 
         s->ssrc = s->rtp_context.ssrc;
-        s->offset = s->rtp_context.timestamp;
 
         if (s->ssrc == s->userdata->module->core->cookie)
             pa_log_warn("Detected RTP packet loop!");
     } else {
         if (s->ssrc != s->rtp_context.ssrc) {
-            pa_memblock_unref(chunk.memblock);
-            return 0;
+            pa_memblock_unref(chunk->memblock);
+            return;
         }
     }
 
-    /* Check whether there was a timestamp overflow */
-    k = (int64_t) s->rtp_context.timestamp - (int64_t) s->offset;
-    j = (int64_t) 0x100000000LL - (int64_t) s->offset + (int64_t) s->rtp_context.timestamp;
-
-    if ((k < 0 ? -k : k) < (j < 0 ? -j : j))
-        delta = k;
-    else
-        delta = j;
-
-    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, true);
-
-    if (now.tv_sec == 0) {
+    if (now->tv_sec == 0) {
         PA_ONCE_BEGIN {
             pa_log_warn("Using artificial time instead of timestamp");
         } PA_ONCE_END;
-        pa_rtclock_get(&now);
+        pa_rtclock_get(now);
     } else
-        pa_rtclock_from_wallclock(&now);
+        pa_rtclock_from_wallclock(now);
 
-    if (pa_memblockq_push(s->memblockq, &chunk) < 0) {
-        pa_log_warn("Queue overrun");
-        pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, true);
-    }
+    arrival = pa_timeval_load(now);
 
-/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
+    pa_jitter_buffer_push(s->jitter_buffer, s->rtp_context.sequence, s->rtp_context.timestamp, arrival, chunk);
+    pa_memblock_unref(chunk->memblock);
 
-    pa_memblock_unref(chunk.memblock);
+    pa_atomic_store(&s->timestamp, (int) now->tv_sec);
 
-    /* The next timestamp we expect */
-    s->offset = s->rtp_context.timestamp + (uint32_t) (chunk.length / s->rtp_context.frame_size);
+    if (pa_jitter_buffer_is_readable(s->jitter_buffer) && s->last_rate_update + RATE_UPDATE_INTERVAL < arrival) {
+        pa_jitter_buffer_stats stats;
+        uint32_t new_rate;
 
-    pa_atomic_store(&s->timestamp, (int) now.tv_sec);
+        pa_jitter_buffer_get_stats(s->jitter_buffer, &stats);
+
+        pa_log_debug("Jitter buffer at %0.2f ms, target %0.2f ms, jitter %0.2f ms, "
+                     "%llu lost, %llu late, %llu concealments, %llu underruns, %llu skips",
+                     (double) stats.latency / PA_USEC_PER_MSEC,
+                     (double) stats.target / PA_USEC_PER_MSEC,
+                     (double) stats.jitter / PA_USEC_PER_MSEC,
+                     (unsigned long long) stats.lost,
+                     (unsigned long long) stats.late,
+                     (unsigned long long) stats.concealments,
+                     (unsigned long long) stats.underruns,
+                     (unsigned long long) stats.skips);
+
+        pa_rate_controller_set_target(s->rate_controller, stats.target);
+        new_rate = pa_rate_controller_update(s->rate_controller, arrival, stats.latency);
 
-    if (s->last_rate_update + RATE_UPDATE_INTERVAL < pa_timeval_load(&now)) {
-        pa_usec_t wi, ri, render_delay, sink_delay = 0, latency;
-        uint32_t current_rate = s->sink_input->sample_spec.rate;
-        uint32_t new_rate;
-        double estimated_rate, alpha = 0.02;
-
-        pa_log_debug("Updating sample rate");
-
-        wi = pa_bytes_to_usec((uint64_t) pa_memblockq_get_write_index(s->memblockq), &s->sink_input->sample_spec);
-        ri = pa_bytes_to_usec((uint64_t) pa_memblockq_get_read_index(s->memblockq), &s->sink_input->sample_spec);
-
-        pa_log_debug("wi=%lu ri=%lu", (unsigned long) wi, (unsigned long) ri);
-
-        sink_delay = pa_sink_get_latency_within_thread(s->sink_input->sink);
-        render_delay = pa_bytes_to_usec(pa_memblockq_get_length(s->sink_input->thread_info.render_memblockq), &s->sink_input->sink->sample_spec);
-
-        if (ri > render_delay+sink_delay)
-            ri -= render_delay+sink_delay;
-        else
-            ri = 0;
-
-        if (wi < ri)
-            latency = 0;
-        else
-            latency = wi - ri;
-
-        pa_log_debug("Write index deviates by %0.2f ms, expected %0.2f ms", (double) latency/PA_USEC_PER_MSEC, (double) s->intended_latency/PA_USEC_PER_MSEC);
-
-        /* The buffer is filling with some unknown rate R̂ samples/second. If the rate of reading in
-         * the last T seconds was Rⁿ, then the increase in buffer latency ΔLⁿ = Lⁿ - Lⁿ⁻ⁱ in that
-         * same period is ΔLⁿ = (TR̂ - TRⁿ) / R̂, giving the estimated target rate
-         *                                           T
-         *                                 R̂ = ─────────────── Rⁿ .                             (1)
-         *                                     T - (Lⁿ - Lⁿ⁻ⁱ)
-         *
-         * Setting the sample rate to R̂ results in the latency being constant (if the estimate of R̂
-         * is correct).  But there is also the requirement to keep the buffer at a predefined target
-         * latency L̂.  So instead of setting Rⁿ⁺ⁱ to R̂ immediately, the strategy will be to reduce R
-         * from Rⁿ⁺ⁱ to R̂ in a steps of T seconds, where Rⁿ⁺ⁱ is chosen such that in the total time
-         * aT the latency is reduced from Lⁿ to L̂.  This strategy translates to the requirements
-         *            ₐ      R̂ - Rⁿ⁺ʲ                            a-j+1         j-1
-         *            Σ  T ────────── = L̂ - Lⁿ    with    Rⁿ⁺ʲ = ───── Rⁿ⁺ⁱ + ───── R̂ .
-         *           ʲ⁼ⁱ        R̂                                  a            a
-         * Solving for Rⁿ⁺ⁱ gives
-         *                                     T - ²∕ₐ₊₁(L̂ - Lⁿ)
-         *                              Rⁿ⁺ⁱ = ───────────────── R̂ .                            (2)
-         *                                            T
-         * In the code below a = 7 is used.
-         *
-         * Equation (1) is not directly used in (2), but instead an exponentially weighted average
-         * of the estimated rate R̂ is used.  This average R̅ is defined as
-         *                                R̅ⁿ = α R̂ⁿ + (1-α) R̅ⁿ⁻ⁱ .
-         * Because it is difficult to find a fixed value for the coefficient α such that the
-         * averaging is without significant lag but oscillations are filtered out, a heuristic is
-         * used.  When the successive estimates R̂ⁿ do not change much then α→1, but when there is a
-         * sudden spike in the estimated rate α→0, such that the deviation is given little weight.
-         */
-        estimated_rate = (double) current_rate * (double) RATE_UPDATE_INTERVAL / (double) (RATE_UPDATE_INTERVAL + s->last_latency - latency);
-        if (fabs(s->estimated_rate - s->avg_estimated_rate) > 1) {
-          double ratio = (estimated_rate + s->estimated_rate - 2*s->avg_estimated_rate) / (s->estimated_rate - s->avg_estimated_rate);
-          alpha = PA_CLAMP(2 * (ratio + fabs(ratio)) / (4 + ratio*ratio), 0.02, 0.8);
-        }
-        s->avg_estimated_rate = alpha * estimated_rate + (1-alpha) * s->avg_estimated_rate;
-        s->estimated_rate = estimated_rate;
-        pa_log_debug("Estimated target rate: %.0f Hz, using average of %.0f Hz  (α=%.3f)", estimated_rate, s->avg_estimated_rate, alpha);
-        new_rate = (uint32_t) ((double) (RATE_UPDATE_INTERVAL + latency/4 - s->intended_latency/4) / (double) RATE_UPDATE_INTERVAL * s->avg_estimated_rate);
-        s->last_latency = latency;
-
-        if (new_rate < (uint32_t) (s->base_rate*0.8) || new_rate > (uint32_t) (s->base_rate*1.25)) {
-            pa_log_warn("Sample rates too different, not adjusting (%u vs. %u).", s->base_rate, new_rate);
-            new_rate = s->base_rate;
-        } else {
-            if (s->base_rate < new_rate + 20 && new_rate < s->base_rate + 20)
-                new_rate = s->base_rate;
-            /* Do the adjustment in small steps; 2‰ can be considered inaudible */
-            if (new_rate < (uint32_t) (current_rate*0.998) || new_rate > (uint32_t) (current_rate*1.002)) {
-                pa_log_info("New rate of %u Hz not within 2‰ of %u Hz, forcing smaller adjustment", new_rate, current_rate);
-                new_rate = PA_CLAMP(new_rate, (uint32_t) (current_rate*0.998), (uint32_t) (current_rate*1.002));
-            }
-        }
         s->sink_input->sample_spec.rate = new_rate;
 
         pa_assert(pa_sample_spec_valid(&s->sink_input->sample_spec));
@@ -371,10 +289,45 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
         pa_log_debug("Updated sampling rate to %lu Hz.", (unsigned long) s->sink_input->sample_spec.rate);
 
-        s->last_rate_update = pa_timeval_load(&now);
+        s->last_rate_update = arrival;
+    }
+}
+
+/* Called from I/O thread context */
+static int rtpoll_work_cb(pa_rtpoll_item *i) {
+    pa_memchunk chunk;
+    struct timeval now = { 0, 0 };
+    struct session *s;
+    struct pollfd *p;
+    unsigned n = 0;
+
+    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+
+    p = pa_rtpoll_item_get_pollfd(i, NULL);
+
+    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
+        pa_log("poll() signalled bad revents.");
+        return -1;
     }
 
-    if (pa_memblockq_is_readable(s->memblockq) &&
+    if ((p->revents & POLLIN) == 0)
+        return 0;
+
+    p->revents = 0;
+
+    /* Handle all packets that were read with the same syscall */
+    do {
+        if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
+            continue;
+
+        session_push_packet(s, &chunk, &now);
+        n++;
+    } while (pa_rtp_recv_pending(&s->rtp_context));
+
+    if (n == 0)
+        return 0;
+
+    if (pa_jitter_buffer_is_readable(s->jitter_buffer) &&
         s->sink_input->thread_info.underrun_for > 0) {
         pa_log_debug("Requesting rewind due to end of underrun");
         pa_sink_input_request_rewind(s->sink_input,
@@ -518,9 +471,7 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     s->first_packet = false;
     s->sdp_info = *sdp_info;
     s->rtpoll_item = NULL;
-    s->intended_latency = u->latency;
     s->last_rate_update = pa_timeval_load(&now);
-    s->last_latency = u->latency;
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
     if ((fd = mcast_socket((const struct sockaddr*) &sdp_info->sa, sdp_info->salen)) < 0)
@@ -552,10 +503,6 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
         goto fail;
     }
 
-    s->base_rate = (double) s->sink_input->sample_spec.rate;
-    s->estimated_rate = (double) s->sink_input->sample_spec.rate;
-    s->avg_estimated_rate = (double) s->sink_input->sample_spec.rate;
-
     s->sink_input->userdata = s;
 
     s->sink_input->parent.process_msg = sink_input_process_msg;
@@ -569,10 +516,16 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
 
     pa_sink_input_get_silence(s->sink_input, &silence);
 
-    s->sink_latency = pa_sink_input_set_requested_latency(s->sink_input, s->intended_latency/2);
+    s->sink_latency = pa_sink_input_set_requested_latency(s->sink_input, u->min_latency/2);
 
-    if (s->intended_latency < s->sink_latency*2)
-        s->intended_latency = s->sink_latency*2;
+    /* The jitter buffer adds the sink latency to its target by itself, as
+     * that is how much audio it is asked for in one go */
+    s->jitter_buffer = pa_jitter_buffer_new(
+            &s->sink_input->sample_spec,
+            u->module->core->mempool,
+            u->min_latency,
+            u->max_latency,
+            &silence);
 
     s->memblockq = pa_memblockq_new(
             "module-rtp-recv memblockq",
@@ -580,13 +533,15 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
             MEMBLOCKQ_MAXLENGTH,
             MEMBLOCKQ_MAXLENGTH,
             &s->sink_input->sample_spec,
-            pa_usec_to_bytes(s->intended_latency - s->sink_latency, &s->sink_input->sample_spec),
+            0,
             0,
             0,
             &silence);
 
     pa_memblock_unref(silence.memblock);
 
+    s->rate_controller = pa_rate_controller_new(s->sink_input->sample_spec.rate, u->min_latency, RATE_UPDATE_INTERVAL);
+
     pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
 
     pa_hashmap_put(s->userdata->by_origin, s->sdp_info.origin, s);
@@ -621,6 +576,8 @@ static void session_free(struct session *s) {
     s->userdata->n_sessions--;
 
     pa_memblockq_free(s->memblockq);
+    pa_jitter_buffer_free(s->jitter_buffer);
+    pa_rate_controller_free(s->rate_controller);
     pa_sdp_info_destroy(&s->sdp_info);
     pa_rtp_context_destroy(&s->rtp_context);
 
@@ -701,7 +658,7 @@ int pa__init(pa_module*m) {
     struct sockaddr *sa;
     socklen_t salen;
     const char *sap_address;
-    uint32_t latency_msec;
+    uint32_t latency_msec, min_latency_msec, max_latency_msec;
     int fd = -1;
 
     pa_assert(m);
@@ -730,8 +687,22 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    latency_msec = DEFAULT_LATENCY_MSEC;
-    if (pa_modargs_get_value_u32(ma, "latency_msec", &latency_msec) < 0 || latency_msec < 1 || latency_msec > 300000) {
+    min_latency_msec = DEFAULT_MIN_LATENCY_MSEC;
+    max_latency_msec = DEFAULT_MAX_LATENCY_MSEC;
+
+    /* A fixed latency turns off the adaptation of the jitter buffer */
+    if (pa_modargs_get_value(ma, "latency_msec", NULL)) {
+        if (pa_modargs_get_value_u32(ma, "latency_msec", &latency_msec) < 0 || latency_msec < 1 || latency_msec > 300000) {
+            pa_log("Invalid latency specification");
+            goto fail;
+        }
+
+        min_latency_msec = max_latency_msec = latency_msec;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "min_latency_msec", &min_latency_msec) < 0 ||
+        pa_modargs_get_value_u32(ma, "max_latency_msec", &max_latency_msec) < 0 ||
+        min_latency_msec < 1 || max_latency_msec > 300000 || min_latency_msec > max_latency_msec) {
         pa_log("Invalid latency specification");
         goto fail;
     }
@@ -743,7 +714,8 @@ int pa__init(pa_module*m) {
     u->module = m;
     u->core = m->core;
     u->sink_name = pa_xstrdup(pa_modargs_get_value(ma, "sink", NULL));
-    u->latency = (pa_usec_t) latency_msec * PA_USEC_PER_MSEC;
+    u->min_latency = (pa_usec_t) min_latency_msec * PA_USEC_PER_MSEC;
+    u->max_latency = (pa_usec_t) max_latency_msec * PA_USEC_PER_MSEC;
 
     u->sap_event = m->core->mainloop->io_new(m->core->mainloop, fd, PA_IO_EVENT_INPUT, sap_event_cb, u);
     pa_sap_context_init_recv(&u->sap_context, fd);
@@ -35,6 +35,8 @@
 #include <sys/uio.h>
 #endif
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/core-error.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -43,6 +45,40 @@
 
 #include "rtp.h"
 
+/* Packets are sent and received in batches of this many per syscall */
+#define MAX_BATCH 32
+
+/* Room for the SCM_TIMESTAMP control message of a received packet */
+#define AUX_SIZE 128
+
+#ifdef HAVE_SENDMMSG
+typedef struct mmsghdr rtp_mmsghdr;
+#else
+typedef struct rtp_mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} rtp_mmsghdr;
+#endif
+
+struct pa_rtp_recv_batch {
+    /* Packets are read into consecutive slots of this block, starting at
+     * offset. The block is reused for the next batch as long as there is
+     * room left in it. */
+    pa_memblock *memblock;
+    size_t offset;
+    size_t slot_size;
+
+    /* The largest packet we know of */
+    size_t max_packet_size;
+
+    unsigned n_packets;
+    unsigned next;
+
+    rtp_mmsghdr msgs[MAX_BATCH];
+    struct iovec iov[MAX_BATCH];
+    uint8_t aux[MAX_BATCH][AUX_SIZE];
+};
+
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size) {
     pa_assert(c);
     pa_assert(fd >= 0);
@@ -53,19 +89,59 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
     c->ssrc = ssrc ? ssrc : (uint32_t) (rand()*rand());
     c->payload = (uint8_t) (payload & 127U);
     c->frame_size = frame_size;
+    c->dropped = 0;
 
-    pa_memchunk_reset(&c->memchunk);
+    c->recv_batch = NULL;
 
     return c;
 }
 
 #define MAX_IOVECS 16
 
+/* Sends all n packets, continuing after partial and interrupted sends.
+ * This runs in the IO thread, so we never wait for a full socket buffer
+ * to drain. Returns the number of packets sent, if that is less than n
+ * errno is set to the error that stopped us. */
+static unsigned send_packets(pa_rtp_context *c, rtp_mmsghdr *m, unsigned n) {
+    unsigned i = 0;
+#ifdef HAVE_SENDMMSG
+    bool use_sendmmsg = true;
+#endif
+
+    while (i < n) {
+        int r;
+
+#ifdef HAVE_SENDMMSG
+        if (use_sendmmsg) {
+            if ((r = sendmmsg(c->fd, m + i, n - i, MSG_DONTWAIT)) < 0 && errno == ENOSYS) {
+                use_sendmmsg = false;
+                continue;
+            }
+        } else
+#endif
+            r = sendmsg(c->fd, &m[i].msg_hdr, MSG_DONTWAIT) < 0 ? -1 : 1;
+
+        if (r > 0) {
+            i += (unsigned) r;
+            continue;
+        }
+
+        if (errno != EINTR)
+            break;
+    }
+
+    return i;
+}
+
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
-    struct iovec iov[MAX_IOVECS];
-    pa_memblock* mb[MAX_IOVECS];
+    struct iovec iov[MAX_BATCH][MAX_IOVECS];
+    pa_memblock* mb[MAX_BATCH][MAX_IOVECS];
+    uint32_t header[MAX_BATCH][3];
+    rtp_mmsghdr m[MAX_BATCH];
+    unsigned n_packets = 0;
     int iov_idx = 1;
     size_t n = 0;
+    int ret = 0;
 
     pa_assert(c);
     pa_assert(size > 0);
@@ -74,8 +150,13 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
     if (pa_memblockq_get_length(q) < size)
         return 0;
 
+    /* Packets are collected in m[] and handed to the kernel with a single
+     * sendmmsg() once MAX_BATCH of them are ready or the queue runs dry. The
+     * memblocks stay acquired until then. */
+
     for (;;) {
         int r;
+        bool done;
         pa_memchunk chunk;
 
         pa_memchunk_reset(&chunk);
@@ -86,9 +167,9 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
 
             pa_assert(chunk.memblock);
 
-            iov[iov_idx].iov_base = pa_memblock_acquire_chunk(&chunk);
-            iov[iov_idx].iov_len = k;
-            mb[iov_idx] = chunk.memblock;
+            iov[n_packets][iov_idx].iov_base = pa_memblock_acquire_chunk(&chunk);
+            iov[n_packets][iov_idx].iov_len = k;
+            mb[n_packets][iov_idx] = chunk.memblock;
             iov_idx ++;
 
             n += k;
@@ -98,47 +179,56 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
         pa_assert(n % c->frame_size == 0);
 
         if (r < 0 || n >= size || iov_idx >= MAX_IOVECS) {
-            uint32_t header[3];
-            struct msghdr m;
-            ssize_t k;
-            int i;
 
             if (n > 0) {
-                header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
-                header[1] = htonl(c->timestamp);
-                header[2] = htonl(c->ssrc);
-
-                iov[0].iov_base = (void*)header;
-                iov[0].iov_len = sizeof(header);
-
-                m.msg_name = NULL;
-                m.msg_namelen = 0;
-                m.msg_iov = iov;
-                m.msg_iovlen = (size_t) iov_idx;
-                m.msg_control = NULL;
-                m.msg_controllen = 0;
-                m.msg_flags = 0;
-
-                k = sendmsg(c->fd, &m, MSG_DONTWAIT);
-
-                for (i = 1; i < iov_idx; i++) {
-                    pa_memblock_release(mb[i]);
-                    pa_memblock_unref(mb[i]);
-                }
+                header[n_packets][0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+                header[n_packets][1] = htonl(c->timestamp);
+                header[n_packets][2] = htonl(c->ssrc);
+
+                iov[n_packets][0].iov_base = (void*) header[n_packets];
+                iov[n_packets][0].iov_len = sizeof(header[n_packets]);
 
+                pa_zero(m[n_packets]);
+                m[n_packets].msg_hdr.msg_iov = iov[n_packets];
+                m[n_packets].msg_hdr.msg_iovlen = (size_t) iov_idx;
+
+                n_packets++;
                 c->sequence++;
-            } else
-                k = 0;
+            }
 
             c->timestamp += (unsigned) (n/c->frame_size);
 
-            if (k < 0) {
-                if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
-                    pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
-                return -1;
+            done = r < 0 || pa_memblockq_get_length(q) < size;
+
+            if (n_packets > 0 && (done || n_packets >= MAX_BATCH)) {
+                unsigned i, sent;
+                int j;
+
+                if ((sent = send_packets(c, m, n_packets)) < n_packets) {
+                    /* If the socket buffer is full, the rest of the batch is
+                     * dropped. The receiver sees the gap in the sequence
+                     * numbers and conceals it. */
+                    if (errno == EAGAIN) {
+                        c->dropped += n_packets - sent;
+
+                        if (pa_log_ratelimit(PA_LOG_WARN))
+                            pa_log_warn("Socket buffer full, dropped %u RTP packets (%llu in total).",
+                                        n_packets - sent, (unsigned long long) c->dropped);
+                    } else
+                        pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
+                    ret = -1;
+                }
+
+                for (i = 0; i < n_packets; i++)
+                    for (j = 1; j < (int) m[i].msg_hdr.msg_iovlen; j++) {
+                        pa_memblock_release(mb[i][j]);
+                        pa_memblock_unref(mb[i][j]);
+                    }
+
+                n_packets = 0;
             }
 
-            if (r < 0 || pa_memblockq_get_length(q) < size)
+            if (done || ret < 0)
                 break;
 
             n = 0;
@@ -146,7 +236,7 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
         }
     }
 
-    return 0;
+    return ret;
 }
 
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size) {
@@ -155,102 +245,141 @@ pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame
     c->fd = fd;
     c->frame_size = frame_size;
 
-    pa_memchunk_reset(&c->memchunk);
+    c->recv_batch = pa_xnew0(struct pa_rtp_recv_batch, 1);
+
     return c;
 }
 
-int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
-    int size;
-    struct msghdr m;
-    struct cmsghdr *cm;
-    struct iovec iov;
-    uint32_t header;
-    unsigned cc;
-    ssize_t r;
-    uint8_t aux[1024];
-    bool found_tstamp = false;
-
-    pa_assert(c);
-    pa_assert(chunk);
+/* Reads as many packets as are queued on the socket, up to MAX_BATCH, with a
+ * single recvmmsg() call into consecutive slots of one memblock. */
+static int recv_batch(pa_rtp_context *c, pa_mempool *pool) {
+    struct pa_rtp_recv_batch *b = c->recv_batch;
+    unsigned i, n_slots;
+    uint8_t *d;
+    int size, r;
 
-    pa_memchunk_reset(chunk);
+    /* The slots of the previous batch are all handed out by now */
+    b->offset += b->n_packets * b->slot_size;
+    b->n_packets = b->next = 0;
 
     if (ioctl(c->fd, FIONREAD, &size) < 0) {
         pa_log_warn("FIONREAD failed: %s", pa_cstrerror(errno));
-        goto fail;
+        return -1;
+    }
+
+    /* size can be 0 if somebody sent us a perfectly valid zero-length UDP
+     * packet, or one with a bad CRC. In the first case, the packet has to be
+     * read out, otherwise the kernel will tell us again and again about it,
+     * thus preventing reception of any further packets. It is discarded
+     * later when parsing the header. In the second case, recvmmsg() will
+     * fail, thus allowing us to return the error. FIONREAD only reports the
+     * size of the first packet, so the slots are sized for the largest
+     * packet seen so far. */
+    b->max_packet_size = PA_MAX(b->max_packet_size, (size_t) PA_MAX(size, 1));
+    b->slot_size = PA_ALIGN(b->max_packet_size);
+
+    if (b->memblock && pa_memblock_get_length(b->memblock) - b->offset < b->slot_size) {
+        pa_memblock_unref(b->memblock);
+        b->memblock = NULL;
     }
 
-    if (size <= 0) {
-        /* size can be 0 due to any of the following reasons:
-         *
-         * 1. Somebody sent us a perfectly valid zero-length UDP packet.
-         * 2. Somebody sent us a UDP packet with a bad CRC.
-         *
-         * It is unknown whether size can actually be less than zero.
-         *
-         * In the first case, the packet has to be read out, otherwise the
-         * kernel will tell us again and again about it, thus preventing
-         * reception of any further packets. So let's just read it out
-         * now and discard it later, when comparing the number of bytes
-         * received (0) with the number of bytes wanted (1, see below).
-         *
-         * In the second case, recvmsg() will fail, thus allowing us to
-         * return the error.
-         *
-         * Just to avoid passing zero-sized memchunks and NULL pointers to
-         * recvmsg(), let's force allocation of at least one byte by setting
-         * size to 1.
-         */
-        size = 1;
+    if (!b->memblock) {
+        b->memblock = pa_memblock_new(pool, PA_MAX(b->slot_size, pa_mempool_block_size_max(pool)));
+        b->offset = 0;
     }
 
-    if (c->memchunk.length < (unsigned) size) {
-        size_t l;
+    n_slots = (unsigned) PA_MIN((pa_memblock_get_length(b->memblock) - b->offset) / b->slot_size, (size_t) MAX_BATCH);
 
-        if (c->memchunk.memblock)
-            pa_memblock_unref(c->memchunk.memblock);
+    d = (uint8_t*) pa_memblock_acquire(b->memblock) + b->offset;
 
-        l = PA_MAX((size_t) size, pa_mempool_block_size_max(pool));
+    for (i = 0; i < n_slots; i++) {
+        b->iov[i].iov_base = d + i * b->slot_size;
+        b->iov[i].iov_len = b->slot_size;
 
-        c->memchunk.memblock = pa_memblock_new(pool, l);
-        c->memchunk.index = 0;
-        c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock);
+        pa_zero(b->msgs[i]);
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+        b->msgs[i].msg_hdr.msg_control = b->aux[i];
+        b->msgs[i].msg_hdr.msg_controllen = sizeof(b->aux[i]);
     }
 
-    pa_assert(c->memchunk.length >= (size_t) size);
+#ifdef HAVE_RECVMMSG
+    if ((r = recvmmsg(c->fd, b->msgs, n_slots, MSG_DONTWAIT, NULL)) < 0 && errno == ENOSYS)
+#endif
+    {
+        ssize_t l;
+
+        if ((l = recvmsg(c->fd, &b->msgs[0].msg_hdr, MSG_DONTWAIT)) >= 0) {
+            b->msgs[0].msg_len = (unsigned) l;
+            r = 1;
+        } else
+            r = -1;
+    }
 
-    chunk->memblock = pa_memblock_ref(c->memchunk.memblock);
-    chunk->index = c->memchunk.index;
+    pa_memblock_release(b->memblock);
 
-    iov.iov_base = pa_memblock_acquire_chunk(chunk);
-    iov.iov_len = (size_t) size;
+    if (r <= 0) {
+        if (r < 0 && errno != EAGAIN && errno != EINTR)
+            pa_log_warn("recvmmsg() failed: %s", pa_cstrerror(errno));
 
-    m.msg_name = NULL;
-    m.msg_namelen = 0;
-    m.msg_iov = &iov;
-    m.msg_iovlen = 1;
-    m.msg_control = aux;
-    m.msg_controllen = sizeof(aux);
-    m.msg_flags = 0;
+        return -1;
+    }
 
-    r = recvmsg(c->fd, &m, 0);
-    pa_memblock_release(chunk->memblock);
+    b->n_packets = (unsigned) r;
 
-    if (r != size) {
-        if (r < 0 && errno != EAGAIN && errno != EINTR)
-            pa_log_warn("recvmsg() failed: %s", r < 0 ? pa_cstrerror(errno) : "size mismatch");
+    return 0;
+}
+
+bool pa_rtp_recv_pending(pa_rtp_context *c) {
+    pa_assert(c);
+    pa_assert(c->recv_batch);
 
-        goto fail;
+    return c->recv_batch->next < c->recv_batch->n_packets;
+}
+
+int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
+    struct pa_rtp_recv_batch *b;
+    struct msghdr *m;
+    struct cmsghdr *cm;
+    uint32_t header;
+    unsigned cc, i;
+    size_t size;
+    uint8_t *d;
+    bool found_tstamp = false;
+
+    pa_assert(c);
+    pa_assert(chunk);
+    pa_assert_se(b = c->recv_batch);
+
+    pa_memchunk_reset(chunk);
+
+    if (!pa_rtp_recv_pending(c))
+        if (recv_batch(c, pool) < 0)
+            return -1;
+
+    i = b->next++;
+    m = &b->msgs[i].msg_hdr;
+    size = b->msgs[i].msg_len;
+
+    if (m->msg_flags & MSG_TRUNC) {
+        /* The slot was too small, make room for this packet size next time */
+        pa_log_warn("RTP packet larger than %zu bytes truncated, dropping it and increasing slot size.", b->slot_size);
+        b->max_packet_size = b->slot_size * 2;
+        return -1;
     }
 
     if (size < 12) {
         pa_log_warn("RTP packet too short.");
-        goto fail;
+        return -1;
     }
 
-    memcpy(&header, iov.iov_base, sizeof(uint32_t));
-    memcpy(&c->timestamp, (uint8_t*) iov.iov_base + 4, sizeof(uint32_t));
-    memcpy(&c->ssrc, (uint8_t*) iov.iov_base + 8, sizeof(uint32_t));
+    d = (uint8_t*) pa_memblock_acquire(b->memblock) + b->offset + i * b->slot_size;
+
+    memcpy(&header, d, sizeof(uint32_t));
+    memcpy(&c->timestamp, d + 4, sizeof(uint32_t));
+    memcpy(&c->ssrc, d + 8, sizeof(uint32_t));
+
+    pa_memblock_release(b->memblock);
 
     header = ntohl(header);
     c->timestamp = ntohl(c->timestamp);
@@ -258,45 +387,40 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
 
     if ((header >> 30) != 2) {
         pa_log_warn("Unsupported RTP version.");
-        goto fail;
+        return -1;
     }
 
     if ((header >> 29) & 1) {
         pa_log_warn("RTP padding not supported.");
-        goto fail;
+        return -1;
     }
 
     if ((header >> 28) & 1) {
         pa_log_warn("RTP header extensions not supported.");
-        goto fail;
+        return -1;
     }
 
     cc = (header >> 24) & 0xF;
     c->payload = (uint8_t) ((header >> 16) & 127U);
     c->sequence = (uint16_t) (header & 0xFFFFU);
 
-    if (12 + cc*4 > (unsigned) size) {
+    if (12 + cc*4 > size) {
         pa_log_warn("RTP packet too short. (CSRC)");
-        goto fail;
+        return -1;
     }
 
-    chunk->index += 12 + cc*4;
-    chunk->length = (size_t) size - 12 + cc*4;
+    chunk->index = b->offset + i * b->slot_size + 12 + cc*4;
+    chunk->length = size - (12 + cc*4);
 
     if (chunk->length % c->frame_size != 0) {
         pa_log_warn("Bad RTP packet size.");
-        goto fail;
+        return -1;
     }
 
-    c->memchunk.index = chunk->index + chunk->length;
-    c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock) - c->memchunk.index;
-
-    if (c->memchunk.length <= 0) {
-        pa_memblock_unref(c->memchunk.memblock);
-        pa_memchunk_reset(&c->memchunk);
-    }
+    /* The payload stays where recvmmsg() put it, no copying */
+    chunk->memblock = pa_memblock_ref(b->memblock);
 
-    for (cm = CMSG_FIRSTHDR(&m); cm; cm = CMSG_NXTHDR(&m, cm))
+    for (cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR(m, cm))
         if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP) {
             memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
             found_tstamp = true;
@@ -309,12 +433,6 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
     }
 
     return 0;
-
-fail:
-    if (chunk->memblock)
-        pa_memblock_unref(chunk->memblock);
-
-    return -1;
 }
 
 uint8_t pa_rtp_payload_from_sample_spec(const pa_sample_spec *ss) {
@@ -395,8 +513,12 @@ void pa_rtp_context_destroy(pa_rtp_context *c) {
 
     pa_assert_se(pa_close(c->fd) == 0);
 
-    if (c->memchunk.memblock)
-        pa_memblock_unref(c->memchunk.memblock);
+    if (c->recv_batch) {
+        if (c->recv_batch->memblock)
+            pa_memblock_unref(c->recv_batch->memblock);
+
+        pa_xfree(c->recv_batch);
+    }
 }
 
 const char* pa_rtp_format_to_string(pa_sample_format_t f) {
@@ -23,6 +23,7 @@
 #include <inttypes.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <pulsecore/macro.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/memchunk.h>
 
@@ -34,7 +35,11 @@ typedef struct pa_rtp_context {
     uint8_t payload;
     size_t frame_size;
 
-    pa_memchunk memchunk;
+    /* Packets not sent because the socket buffer was full */
+    uint64_t dropped;
+
+    /* Packets read ahead by recvmmsg() that have not been returned yet */
+    struct pa_rtp_recv_batch *recv_batch;
 } pa_rtp_context;
 
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size);
@@ -44,7 +49,12 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q);
 
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size);
+/* Packets are read from the socket in batches, so after pa_rtp_recv() the
+ * caller has to keep calling it as long as pa_rtp_recv_pending() returns
+ * true. Otherwise packets may be left waiting until the socket becomes
+ * readable again. */
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp);
+bool pa_rtp_recv_pending(pa_rtp_context *c);
 
 void pa_rtp_context_destroy(pa_rtp_context *c);
 
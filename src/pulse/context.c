@@ -179,11 +179,11 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
            ((!c->memfd_on_local) ?
                PA_MEM_TYPE_SHARED_POSIX : PA_MEM_TYPE_SHARED_MEMFD);
 
-    if (!(c->mempool = pa_mempool_new(type, c->conf->shm_size, true))) {
+    if (!(c->mempool = pa_mempool_new(type, c->conf->shm_size, true, c->conf->hugepages))) {
 
         if (!c->conf->disable_shm) {
             pa_log_warn("Failed to allocate shared memory pool. Falling back to a normal private one.");
-            c->mempool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, c->conf->shm_size, true);
+            c->mempool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, c->conf->shm_size, true, c->conf->hugepages);
         }
 
         if (!c->mempool) {
@@ -540,6 +540,10 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
             pa_log_debug("Negotiated SHM: %s", pa_yes_no(c->do_shm));
             pa_pstream_enable_shm(c->pstream, c->do_shm);
 
+            /* Older servers can't import as many blocks at a time */
+            if (c->do_shm && c->version >= 33)
+                pa_pstream_enable_large_export(c->pstream);
+
             c->shm_type = PA_MEM_TYPE_PRIVATE;
             if (c->do_shm) {
                 if (c->version >= 31 && memfd_on_remote && c->memfd_on_local) {
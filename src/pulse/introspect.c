@@ -78,8 +78,126 @@ pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdat
     return pa_context_send_simple_command(c, PA_COMMAND_STAT, context_stat_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/* More than any server will ever send, guards the allocation below */
+#define MAX_HISTOGRAM_BUCKETS 1024
+
+static int histogram_info_get(pa_tagstruct *t, pa_histogram_info *h) {
+    uint32_t i;
+
+    if (pa_tagstruct_getu64(t, &h->count) < 0 ||
+        pa_tagstruct_getu64(t, &h->min) < 0 ||
+        pa_tagstruct_getu64(t, &h->max) < 0 ||
+        pa_tagstruct_getu64(t, &h->sum) < 0 ||
+        pa_tagstruct_getu32(t, &h->n_buckets) < 0 ||
+        h->n_buckets > MAX_HISTOGRAM_BUCKETS)
+        return -1;
+
+    if (h->n_buckets > 0)
+        h->buckets = pa_xnew0(pa_histogram_bucket, h->n_buckets);
+
+    for (i = 0; i < h->n_buckets; i++)
+        if (pa_tagstruct_getu64(t, &h->buckets[i].upper_bound) < 0 ||
+            pa_tagstruct_getu64(t, &h->buckets[i].count) < 0)
+            return -1;
+
+    return 0;
+}
+
+static void io_timing_info_free(pa_io_timing_info *i) {
+    pa_xfree(i->process_usec.buckets);
+    pa_xfree(i->resample_usec.buckets);
+    pa_xfree(i->wakeup_lateness_usec.buckets);
+    pa_xfree(i->rewind_bytes.buckets);
+}
+
+static void context_get_io_timing_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        while (!pa_tagstruct_eof(t)) {
+            pa_io_timing_info i;
+
+            pa_zero(i);
+
+            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+                pa_tagstruct_gets(t, &i.name) < 0 ||
+                histogram_info_get(t, &i.process_usec) < 0 ||
+                histogram_info_get(t, &i.resample_usec) < 0 ||
+                histogram_info_get(t, &i.wakeup_lateness_usec) < 0 ||
+                histogram_info_get(t, &i.rewind_bytes) < 0) {
+                io_timing_info_free(&i);
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            if (o->callback) {
+                pa_io_timing_info_cb_t cb = (pa_io_timing_info_cb_t) o->callback;
+                cb(o->context, &i, 0, o->userdata);
+            }
+
+            io_timing_info_free(&i);
+        }
+    }
+
+    if (o->callback) {
+        pa_io_timing_info_cb_t cb = (pa_io_timing_info_cb_t) o->callback;
+        cb(o->context, NULL, eol, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+pa_operation* pa_context_get_sink_timing_info_list(pa_context *c, pa_io_timing_info_cb_t cb, void *userdata) {
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 32, PA_ERR_NOTSUPPORTED);
+
+    return pa_context_send_simple_command(c, PA_COMMAND_GET_SINK_TIMING_INFO_LIST, context_get_io_timing_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
+pa_operation* pa_context_get_source_timing_info_list(pa_context *c, pa_io_timing_info_cb_t cb, void *userdata) {
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 32, PA_ERR_NOTSUPPORTED);
+
+    return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_TIMING_INFO_LIST, context_get_io_timing_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Server Info ***/
 
+static int server_info_get(pa_context *c, pa_tagstruct *t, pa_server_info *i) {
+    pa_zero(*i);
+
+    if (pa_tagstruct_gets(t, &i->server_name) < 0 ||
+        pa_tagstruct_gets(t, &i->server_version) < 0 ||
+        pa_tagstruct_gets(t, &i->user_name) < 0 ||
+        pa_tagstruct_gets(t, &i->host_name) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_gets(t, &i->default_sink_name) < 0 ||
+        pa_tagstruct_gets(t, &i->default_source_name) < 0 ||
+        pa_tagstruct_getu32(t, &i->cookie) < 0 ||
+        (c->version >= 15 &&
+         pa_tagstruct_get_channel_map(t, &i->channel_map) < 0))
+        return -1;
+
+    if (c->version < 15)
+        pa_channel_map_init_extend(&i->channel_map, i->sample_spec.channels, PA_CHANNEL_MAP_DEFAULT);
+
+    return 0;
+}
+
 static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     pa_server_info i, *p = &i;
@@ -98,25 +216,13 @@ static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command,
             goto finish;
 
         p = NULL;
-    } else if (pa_tagstruct_gets(t, &i.server_name) < 0 ||
-               pa_tagstruct_gets(t, &i.server_version) < 0 ||
-               pa_tagstruct_gets(t, &i.user_name) < 0 ||
-               pa_tagstruct_gets(t, &i.host_name) < 0 ||
-               pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-               pa_tagstruct_gets(t, &i.default_sink_name) < 0 ||
-               pa_tagstruct_gets(t, &i.default_source_name) < 0 ||
-               pa_tagstruct_getu32(t, &i.cookie) < 0 ||
-               (o->context->version >= 15 &&
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0) ||
+    } else if (server_info_get(o->context, t, &i) < 0 ||
                !pa_tagstruct_eof(t)) {
 
         pa_context_fail(o->context, PA_ERR_PROTOCOL);
         goto finish;
     }
 
-    if (p && o->context->version < 15)
-        pa_channel_map_init_extend(&i.channel_map, i.sample_spec.channels, PA_CHANNEL_MAP_DEFAULT);
-
     if (o->callback) {
         pa_server_info_cb_t cb = (pa_server_info_cb_t) o->callback;
         cb(o->context, p, o->userdata);
@@ -133,144 +239,157 @@ pa_operation* pa_context_get_server_info(pa_context *c, pa_server_info_cb_t cb,
 
 /*** Sink Info ***/
 
-static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_operation *o = userdata;
-    int eol = 1;
-    pa_sink_info i;
+static void sink_info_free(pa_sink_info *i) {
     uint32_t j;
 
-    pa_assert(pd);
-    pa_assert(o);
-    pa_assert(PA_REFCNT_VALUE(o) >= 1);
-
-    /* For safety in case someone use fail: outside the while loop below */
-    pa_zero(i);
+    if (i->formats) {
+        for (j = 0; j < i->n_formats; j++)
+            pa_format_info_free(i->formats[j]);
+        pa_xfree(i->formats);
+    }
+    if (i->ports) {
+        pa_xfree(i->ports[0]);
+        pa_xfree(i->ports);
+    }
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
 
-    if (!o->context)
-        goto finish;
+static int sink_info_get(pa_context *c, pa_tagstruct *t, pa_sink_info *i) {
+    bool mute = false;
+    uint32_t flags;
+    uint32_t state = PA_SINK_INVALID_STATE;
+    const char *ap = NULL;
+    uint32_t j;
 
-    if (command != PA_COMMAND_REPLY) {
-        if (pa_context_handle_error(o->context, command, t, false) < 0)
-            goto finish;
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->base_volume = PA_VOLUME_NORM;
+    i->n_volume_steps = PA_VOLUME_NORM+1;
+    i->card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i->monitor_source) < 0 ||
+        pa_tagstruct_gets(t, &i->monitor_source_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i->latency) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (pa_tagstruct_get_proplist(t, i->proplist) < 0 ||
+          pa_tagstruct_get_usec(t, &i->configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i->base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i->n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i->card) < 0)) ||
+        (c->version >= 16 &&
+         (pa_tagstruct_getu32(t, &i->n_ports)))) {
+
+        return -1;
+    }
 
-        eol = -1;
-    } else {
+    if (c->version >= 16) {
+        if (i->n_ports > 0) {
+            i->ports = pa_xnew(pa_sink_port_info*, i->n_ports+1);
+            i->ports[0] = pa_xnew(pa_sink_port_info, i->n_ports);
 
-        while (!pa_tagstruct_eof(t)) {
-            bool mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap = NULL;
+            for (j = 0; j < i->n_ports; j++) {
+                i->ports[j] = &i->ports[0][j];
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = false;
-            state = PA_SINK_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
+                if (pa_tagstruct_gets(t, &i->ports[j]->name) < 0 ||
+                    pa_tagstruct_gets(t, &i->ports[j]->description) < 0 ||
+                    pa_tagstruct_getu32(t, &i->ports[j]->priority) < 0) {
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_source) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_source_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
+                    return -1;
+                }
 
-                goto fail;
+                i->ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        return -1;
+                    i->ports[j]->available = av;
+                }
             }
 
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_sink_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_sink_port_info, i.n_ports);
+            i->ports[j] = NULL;
+        }
 
-                    for (j = 0; j < i.n_ports; j++) {
-                        i.ports[j] = &i.ports[0][j];
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            return -1;
 
-                        if (pa_tagstruct_gets(t, &i.ports[j]->name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[j]->description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[j]->priority) < 0) {
+        if (ap) {
+            for (j = 0; j < i->n_ports; j++)
+                if (pa_streq(i->ports[j]->name, ap)) {
+                    i->active_port = i->ports[j];
+                    break;
+                }
+        }
+    }
 
-                            goto fail;
-                        }
+    if (c->version >= 21) {
+        uint8_t n_formats;
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
+            return -1;
 
-                        i.ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[j]->available = av;
-                        }
-                    }
+        i->formats = pa_xnew0(pa_format_info*, n_formats);
 
-                    i.ports[j] = NULL;
-                }
+        for (j = 0; j < n_formats; j++) {
+            i->n_formats++;
+            i->formats[j] = pa_format_info_new();
 
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
+            if (pa_tagstruct_get_format_info(t, i->formats[j]) < 0)
+                return -1;
+        }
+    }
 
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
-                }
-            }
+    i->mute = (int) mute;
+    i->flags = (pa_sink_flags_t) flags;
+    i->state = (pa_sink_state_t) state;
 
-            if (o->context->version >= 21) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
+    return 0;
+}
 
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
+static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
 
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
 
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
+    if (!o->context)
+        goto finish;
 
-            i.mute = (int) mute;
-            i.flags = (pa_sink_flags_t) flags;
-            i.state = (pa_sink_state_t) state;
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        while (!pa_tagstruct_eof(t)) {
+            pa_sink_info i;
+
+            if (sink_info_get(o->context, t, &i) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                sink_info_free(&i);
+                goto finish;
+            }
 
             if (o->callback) {
                 pa_sink_info_cb_t cb = (pa_sink_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            sink_info_free(&i);
         }
     }
 
@@ -282,25 +401,6 @@ static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, u
 finish:
     pa_operation_done(o);
     pa_operation_unref(o);
-    return;
-
-fail:
-    pa_assert(i.proplist);
-
-    pa_context_fail(o->context, PA_ERR_PROTOCOL);
-
-    if (i.formats) {
-        for (j = 0; j < i.n_formats; j++)
-            pa_format_info_free(i.formats[j]);
-        pa_xfree(i.formats);
-    }
-    if (i.ports) {
-        pa_xfree(i.ports[0]);
-        pa_xfree(i.ports);
-    }
-    pa_proplist_free(i.proplist);
-
-    goto finish;
 }
 
 pa_operation* pa_context_get_sink_info_list(pa_context *c, pa_sink_info_cb_t cb, void *userdata) {
@@ -406,144 +506,157 @@ pa_operation* pa_context_set_sink_port_by_name(pa_context *c, const char *name,
 
 /*** Source info ***/
 
-static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_operation *o = userdata;
-    int eol = 1;
-    pa_source_info i;
+static void source_info_free(pa_source_info *i) {
     uint32_t j;
 
-    pa_assert(pd);
-    pa_assert(o);
-    pa_assert(PA_REFCNT_VALUE(o) >= 1);
-
-    /* For safety in case someone use fail: outside the while loop below */
-    pa_zero(i);
+    if (i->formats) {
+        for (j = 0; j < i->n_formats; j++)
+            pa_format_info_free(i->formats[j]);
+        pa_xfree(i->formats);
+    }
+    if (i->ports) {
+        pa_xfree(i->ports[0]);
+        pa_xfree(i->ports);
+    }
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
 
-    if (!o->context)
-        goto finish;
+static int source_info_get(pa_context *c, pa_tagstruct *t, pa_source_info *i) {
+    bool mute = false;
+    uint32_t flags;
+    uint32_t state = PA_SOURCE_INVALID_STATE;
+    const char *ap = NULL;
+    uint32_t j;
 
-    if (command != PA_COMMAND_REPLY) {
-        if (pa_context_handle_error(o->context, command, t, false) < 0)
-            goto finish;
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->base_volume = PA_VOLUME_NORM;
+    i->n_volume_steps = PA_VOLUME_NORM+1;
+    i->card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i->monitor_of_sink) < 0 ||
+        pa_tagstruct_gets(t, &i->monitor_of_sink_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i->latency) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (pa_tagstruct_get_proplist(t, i->proplist) < 0 ||
+          pa_tagstruct_get_usec(t, &i->configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i->base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i->n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i->card) < 0)) ||
+        (c->version >= 16 &&
+         (pa_tagstruct_getu32(t, &i->n_ports)))) {
+
+        return -1;
+    }
 
-        eol = -1;
-    } else {
+    if (c->version >= 16) {
+        if (i->n_ports > 0) {
+            i->ports = pa_xnew(pa_source_port_info*, i->n_ports+1);
+            i->ports[0] = pa_xnew(pa_source_port_info, i->n_ports);
 
-        while (!pa_tagstruct_eof(t)) {
-            bool mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap;
+            for (j = 0; j < i->n_ports; j++) {
+                i->ports[j] = &i->ports[0][j];
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = false;
-            state = PA_SOURCE_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
+                if (pa_tagstruct_gets(t, &i->ports[j]->name) < 0 ||
+                    pa_tagstruct_gets(t, &i->ports[j]->description) < 0 ||
+                    pa_tagstruct_getu32(t, &i->ports[j]->priority) < 0) {
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_of_sink) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_of_sink_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
+                    return -1;
+                }
 
-                goto fail;
+                i->ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        return -1;
+                    i->ports[j]->available = av;
+                }
             }
 
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_source_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_source_port_info, i.n_ports);
+            i->ports[j] = NULL;
+        }
 
-                    for (j = 0; j < i.n_ports; j++) {
-                        i.ports[j] = &i.ports[0][j];
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            return -1;
 
-                        if (pa_tagstruct_gets(t, &i.ports[j]->name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[j]->description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[j]->priority) < 0) {
+        if (ap) {
+            for (j = 0; j < i->n_ports; j++)
+                if (pa_streq(i->ports[j]->name, ap)) {
+                    i->active_port = i->ports[j];
+                    break;
+                }
+        }
+    }
 
-                            goto fail;
-                        }
+    if (c->version >= 22) {
+        uint8_t n_formats;
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
+            return -1;
 
-                        i.ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[j]->available = av;
-                        }
-                    }
+        i->formats = pa_xnew0(pa_format_info*, n_formats);
 
-                    i.ports[j] = NULL;
-                }
+        for (j = 0; j < n_formats; j++) {
+            i->n_formats++;
+            i->formats[j] = pa_format_info_new();
 
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
+            if (pa_tagstruct_get_format_info(t, i->formats[j]) < 0)
+                return -1;
+        }
+    }
 
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
-                }
-            }
+    i->mute = (int) mute;
+    i->flags = (pa_source_flags_t) flags;
+    i->state = (pa_source_state_t) state;
 
-            if (o->context->version >= 22) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
+    return 0;
+}
 
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
+static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
 
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
 
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
+    if (!o->context)
+        goto finish;
 
-            i.mute = (int) mute;
-            i.flags = (pa_source_flags_t) flags;
-            i.state = (pa_source_state_t) state;
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        while (!pa_tagstruct_eof(t)) {
+            pa_source_info i;
+
+            if (source_info_get(o->context, t, &i) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                source_info_free(&i);
+                goto finish;
+            }
 
             if (o->callback) {
                 pa_source_info_cb_t cb = (pa_source_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            source_info_free(&i);
         }
     }
 
@@ -555,25 +668,6 @@ static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command,
 finish:
     pa_operation_done(o);
     pa_operation_unref(o);
-    return;
-
-fail:
-    pa_assert(i.proplist);
-
-    pa_context_fail(o->context, PA_ERR_PROTOCOL);
-
-    if (i.formats) {
-        for (j = 0; j < i.n_formats; j++)
-            pa_format_info_free(i.formats[j]);
-        pa_xfree(i.formats);
-    }
-    if (i.ports) {
-        pa_xfree(i.ports[0]);
-        pa_xfree(i.ports);
-    }
-    pa_proplist_free(i.proplist);
-
-    goto finish;
 }
 
 pa_operation* pa_context_get_source_info_list(pa_context *c, pa_source_info_cb_t cb, void *userdata) {
@@ -679,6 +773,25 @@ pa_operation* pa_context_set_source_port_by_name(pa_context *c, const char *name
 
 /*** Client info ***/
 
+static void client_info_free(pa_client_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+static int client_info_get(pa_context *c, pa_tagstruct *t, pa_client_info *i) {
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -1;
+
+    return 0;
+}
+
 static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -700,17 +813,9 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
         while (!pa_tagstruct_eof(t)) {
             pa_client_info i;
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
-
+            if (client_info_get(o->context, t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
+                client_info_free(&i);
                 goto finish;
             }
 
@@ -719,7 +824,7 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
+            client_info_free(&i);
         }
     }
 
@@ -903,10 +1008,50 @@ static int fill_card_profile_info(pa_context *context, pa_tagstruct* t, pa_card_
     return 0;
 }
 
+static int card_info_get(pa_context *c, pa_tagstruct *t, pa_card_info *i) {
+    uint32_t j;
+    const char *ap;
+
+    pa_zero(*i);
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &i->n_profiles) < 0)
+        return -1;
+
+    if (i->n_profiles > 0) {
+        if (fill_card_profile_info(c, t, i) < 0)
+            return -1;
+    }
+
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_gets(t, &ap) < 0 ||
+        pa_tagstruct_get_proplist(t, i->proplist) < 0)
+        return -1;
+
+    if (ap) {
+        for (j = 0; j < i->n_profiles; j++)
+            if (pa_streq(i->profiles[j].name, ap)) {
+                i->active_profile = &i->profiles[j];
+                i->active_profile2 = i->profiles2[j];
+                break;
+            }
+    }
+
+    if (c->version >= 26) {
+        if (fill_card_port_info(c, t, i) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
-    pa_card_info i;
 
     pa_assert(pd);
     pa_assert(o);
@@ -923,47 +1068,14 @@ static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, u
     } else {
 
         while (!pa_tagstruct_eof(t)) {
-            uint32_t j;
-            const char*ap;
-
-            pa_zero(i);
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_profiles) < 0)
-                    goto fail;
-
-            if (i.n_profiles > 0) {
-                if (fill_card_profile_info(o->context, t, &i) < 0)
-                    goto fail;
-            }
-
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_gets(t, &ap) < 0 ||
-                pa_tagstruct_get_proplist(t, i.proplist) < 0) {
+            pa_card_info i;
 
+            if (card_info_get(o->context, t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
                 card_info_free(&i);
                 goto finish;
             }
 
-            if (ap) {
-                for (j = 0; j < i.n_profiles; j++)
-                    if (pa_streq(i.profiles[j].name, ap)) {
-                        i.active_profile = &i.profiles[j];
-                        i.active_profile2 = i.profiles2[j];
-                        break;
-                    }
-            }
-
-            if (o->context->version >= 26) {
-                if (fill_card_port_info(o->context, t, &i) < 0)
-                    goto fail;
-            }
-
             if (o->callback) {
                 pa_card_info_cb_t cb = (pa_card_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
@@ -981,12 +1093,6 @@ static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, u
 finish:
     pa_operation_done(o);
     pa_operation_unref(o);
-    return;
-
-fail:
-    pa_context_fail(o->context, PA_ERR_PROTOCOL);
-    card_info_free(&i);
-    goto finish;
 }
 
 pa_operation* pa_context_get_card_info_by_index(pa_context *c, uint32_t idx, pa_card_info_cb_t cb, void *userdata) {
@@ -1097,6 +1203,30 @@ pa_operation* pa_context_set_card_profile_by_name(pa_context *c, const char *nam
 
 /*** Module info ***/
 
+static void module_info_free(pa_module_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+static int module_info_get(pa_context *c, pa_tagstruct *t, pa_module_info *i) {
+    bool auto_unload = false;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->argument) < 0 ||
+        pa_tagstruct_getu32(t, &i->n_used) < 0 ||
+        (c->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
+        (c->version >= 15 && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -1;
+
+    i->auto_unload = (int) auto_unload;
+
+    return 0;
+}
+
 static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1117,29 +1247,19 @@ static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command,
 
         while (!pa_tagstruct_eof(t)) {
             pa_module_info i;
-            bool auto_unload = false;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.argument) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_used) < 0 ||
-                (o->context->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
-                (o->context->version >= 15 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
+            if (module_info_get(o->context, t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                module_info_free(&i);
                 goto finish;
             }
 
-            i.auto_unload = (int) auto_unload;
-
             if (o->callback) {
                 pa_module_info_cb_t cb = (pa_module_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
+            module_info_free(&i);
         }
     }
 
@@ -1182,6 +1302,48 @@ pa_operation* pa_context_get_module_info_list(pa_context *c, pa_module_info_cb_t
 
 /*** Sink input info ***/
 
+static void sink_input_info_free(pa_sink_input_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+    if (i->format)
+        pa_format_info_free(i->format);
+}
+
+static int sink_input_info_get(pa_context *c, pa_tagstruct *t, pa_sink_input_info *i) {
+    bool mute = false, corked = false, has_volume = false, volume_writable = true;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i->client) < 0 ||
+        pa_tagstruct_getu32(t, &i->sink) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_usec(t, &i->buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i->sink_usec) < 0 ||
+        pa_tagstruct_gets(t, &i->resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
+        (c->version >= 21 && pa_tagstruct_get_format_info(t, i->format) < 0))
+        return -1;
+
+    i->mute = (int) mute;
+    i->corked = (int) corked;
+    i->has_volume = (int) has_volume;
+    i->volume_writable = (int) volume_writable;
+
+    return 0;
+}
+
 static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1202,49 +1364,19 @@ static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t comm
 
         while (!pa_tagstruct_eof(t)) {
             pa_sink_input_info i;
-            bool mute = false, corked = false, has_volume = false, volume_writable = true;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.sink) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.sink_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
-                (o->context->version >= 21 && pa_tagstruct_get_format_info(t, i.format) < 0)) {
 
+            if (sink_input_info_get(o->context, t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
-                pa_format_info_free(i.format);
+                sink_input_info_free(&i);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
             if (o->callback) {
                 pa_sink_input_info_cb_t cb = (pa_sink_input_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
-            pa_format_info_free(i.format);
+            sink_input_info_free(&i);
         }
     }
 
@@ -1287,6 +1419,48 @@ pa_operation* pa_context_get_sink_input_info_list(pa_context *c, void (*cb)(pa_c
 
 /*** Source output info ***/
 
+static void source_output_info_free(pa_source_output_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+    if (i->format)
+        pa_format_info_free(i->format);
+}
+
+static int source_output_info_get(pa_context *c, pa_tagstruct *t, pa_source_output_info *i) {
+    bool mute = false, corked = false, has_volume = false, volume_writable = true;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i->client) < 0 ||
+        pa_tagstruct_getu32(t, &i->source) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_usec(t, &i->buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i->source_usec) < 0 ||
+        pa_tagstruct_gets(t, &i->resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 22 && (pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &mute) < 0 ||
+                              pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
+                              pa_tagstruct_get_format_info(t, i->format) < 0)))
+        return -1;
+
+    i->mute = (int) mute;
+    i->corked = (int) corked;
+    i->has_volume = (int) has_volume;
+    i->volume_writable = (int) volume_writable;
+
+    return 0;
+}
+
 static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1307,49 +1481,19 @@ static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t c
 
         while (!pa_tagstruct_eof(t)) {
             pa_source_output_info i;
-            bool mute = false, corked = false, has_volume = false, volume_writable = true;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.source) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.source_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 22 && (pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
-                                               pa_tagstruct_get_format_info(t, i.format) < 0))) {
 
+            if (source_output_info_get(o->context, t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
-                pa_format_info_free(i.format);
+                source_output_info_free(&i);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
             if (o->callback) {
                 pa_source_output_info_cb_t cb = (pa_source_output_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
-            pa_format_info_free(i.format);
+            source_output_info_free(&i);
         }
     }
 
@@ -1693,6 +1837,34 @@ pa_operation* pa_context_set_source_output_mute(pa_context *c, uint32_t idx, int
 
 /** Sample Cache **/
 
+static void sample_info_free(pa_sample_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+static int sample_info_get(pa_context *c, pa_tagstruct *t, pa_sample_info *i) {
+    bool lazy = false;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_usec(t, &i->duration) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->bytes) < 0 ||
+        pa_tagstruct_get_boolean(t, &lazy) < 0 ||
+        pa_tagstruct_gets(t, &i->filename) < 0 ||
+        (c->version >= 13 && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -1;
+
+    i->lazy = (int) lazy;
+
+    return 0;
+}
+
 static void context_get_sample_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1713,34 +1885,19 @@ static void context_get_sample_info_callback(pa_pdispatch *pd, uint32_t command,
 
         while (!pa_tagstruct_eof(t)) {
             pa_sample_info i;
-            bool lazy = false;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_usec(t, &i.duration) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.bytes) < 0 ||
-                pa_tagstruct_get_boolean(t, &lazy) < 0 ||
-                pa_tagstruct_gets(t, &i.filename) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
 
+            if (sample_info_get(o->context, t, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                sample_info_free(&i);
                 goto finish;
             }
 
-            i.lazy = (int) lazy;
-
             if (o->callback) {
                 pa_sample_info_cb_t cb = (pa_sample_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
+            sample_info_free(&i);
         }
     }
 
@@ -1806,6 +1963,293 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SAMPLE_INFO_LIST, context_get_sample_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/*** Snapshots ***/
+
+static void snapshot_info_free(pa_snapshot_info *i) {
+    uint32_t j;
+
+    for (j = 0; j < i->n_modules; j++)
+        module_info_free((pa_module_info*) &i->modules[j]);
+    for (j = 0; j < i->n_clients; j++)
+        client_info_free((pa_client_info*) &i->clients[j]);
+    for (j = 0; j < i->n_cards; j++)
+        card_info_free((pa_card_info*) &i->cards[j]);
+    for (j = 0; j < i->n_sinks; j++)
+        sink_info_free((pa_sink_info*) &i->sinks[j]);
+    for (j = 0; j < i->n_sources; j++)
+        source_info_free((pa_source_info*) &i->sources[j]);
+    for (j = 0; j < i->n_sink_inputs; j++)
+        sink_input_info_free((pa_sink_input_info*) &i->sink_inputs[j]);
+    for (j = 0; j < i->n_source_outputs; j++)
+        source_output_info_free((pa_source_output_info*) &i->source_outputs[j]);
+    for (j = 0; j < i->n_samples; j++)
+        sample_info_free((pa_sample_info*) &i->samples[j]);
+
+    pa_xfree((void*) i->modules);
+    pa_xfree((void*) i->clients);
+    pa_xfree((void*) i->cards);
+    pa_xfree((void*) i->sinks);
+    pa_xfree((void*) i->sources);
+    pa_xfree((void*) i->sink_inputs);
+    pa_xfree((void*) i->source_outputs);
+    pa_xfree((void*) i->samples);
+    pa_xfree((void*) i->removed);
+}
+
+/* Reads the objects of one section of the reply. The array is allocated
+ * zeroed and counted in full right away, so that snapshot_info_free()
+ * can clean up after a partially read section. */
+static int snapshot_section_get(pa_context *c, pa_tagstruct *t, pa_snapshot_info *i, pa_server_info *server_info, uint32_t facility, uint32_t n) {
+    uint32_t j;
+
+    if (facility > PA_SUBSCRIPTION_EVENT_CARD || facility == PA_SUBSCRIPTION_EVENT_AUTOLOAD)
+        return -1;
+
+    if (n == 0)
+        return 0;
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SERVER:
+            if (n > 1 || i->server_info)
+                return -1;
+
+            if (server_info_get(c, t, server_info) < 0)
+                return -1;
+
+            i->server_info = server_info;
+            return 0;
+
+        case PA_SUBSCRIPTION_EVENT_MODULE: {
+            pa_module_info *modules;
+
+            if (i->modules)
+                return -1;
+
+            i->modules = modules = pa_xnew0(pa_module_info, n);
+            i->n_modules = n;
+
+            for (j = 0; j < n; j++)
+                if (module_info_get(c, t, &modules[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_CLIENT: {
+            pa_client_info *clients;
+
+            if (i->clients)
+                return -1;
+
+            i->clients = clients = pa_xnew0(pa_client_info, n);
+            i->n_clients = n;
+
+            for (j = 0; j < n; j++)
+                if (client_info_get(c, t, &clients[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_CARD: {
+            pa_card_info *cards;
+
+            if (i->cards)
+                return -1;
+
+            i->cards = cards = pa_xnew0(pa_card_info, n);
+            i->n_cards = n;
+
+            for (j = 0; j < n; j++)
+                if (card_info_get(c, t, &cards[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SINK: {
+            pa_sink_info *sinks;
+
+            if (i->sinks)
+                return -1;
+
+            i->sinks = sinks = pa_xnew0(pa_sink_info, n);
+            i->n_sinks = n;
+
+            for (j = 0; j < n; j++)
+                if (sink_info_get(c, t, &sinks[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE: {
+            pa_source_info *sources;
+
+            if (i->sources)
+                return -1;
+
+            i->sources = sources = pa_xnew0(pa_source_info, n);
+            i->n_sources = n;
+
+            for (j = 0; j < n; j++)
+                if (source_info_get(c, t, &sources[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT: {
+            pa_sink_input_info *sink_inputs;
+
+            if (i->sink_inputs)
+                return -1;
+
+            i->sink_inputs = sink_inputs = pa_xnew0(pa_sink_input_info, n);
+            i->n_sink_inputs = n;
+
+            for (j = 0; j < n; j++)
+                if (sink_input_info_get(c, t, &sink_inputs[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: {
+            pa_source_output_info *source_outputs;
+
+            if (i->source_outputs)
+                return -1;
+
+            i->source_outputs = source_outputs = pa_xnew0(pa_source_output_info, n);
+            i->n_source_outputs = n;
+
+            for (j = 0; j < n; j++)
+                if (source_output_info_get(c, t, &source_outputs[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE: {
+            pa_sample_info *samples;
+
+            if (i->samples)
+                return -1;
+
+            i->samples = samples = pa_xnew0(pa_sample_info, n);
+            i->n_samples = n;
+
+            for (j = 0; j < n; j++)
+                if (sample_info_get(c, t, &samples[j]) < 0)
+                    return -1;
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void context_get_snapshot_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    pa_snapshot_info i, *p = &i;
+    pa_server_info server_info;
+    pa_snapshot_removed *removed = NULL;
+    bool complete;
+    size_t length;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    pa_zero(i);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        p = NULL;
+    } else {
+        if (pa_tagstruct_getu64(t, &i.generation) < 0 ||
+            pa_tagstruct_get_boolean(t, &complete) < 0)
+            goto fail;
+
+        i.complete = (int) complete;
+
+        /* Every object takes more than one byte, so this bounds what a
+         * broken reply can make us allocate */
+        pa_tagstruct_data(t, &length);
+
+        while (!pa_tagstruct_eof(t)) {
+            uint32_t facility, n, n_removed, j;
+
+            if (pa_tagstruct_getu32(t, &facility) < 0 ||
+                pa_tagstruct_getu32(t, &n) < 0 ||
+                n > length ||
+                snapshot_section_get(o->context, t, &i, &server_info, facility, n) < 0 ||
+                pa_tagstruct_getu32(t, &n_removed) < 0 ||
+                n_removed > length)
+                goto fail;
+
+            if (n_removed > 0) {
+                i.removed = removed = pa_xrenew(pa_snapshot_removed, removed, i.n_removed + n_removed);
+
+                for (j = 0; j < n_removed; j++) {
+                    removed[i.n_removed].facility = (pa_subscription_event_type_t) facility;
+
+                    if (pa_tagstruct_getu32(t, &removed[i.n_removed].index) < 0)
+                        goto fail;
+
+                    i.n_removed++;
+                }
+            }
+        }
+    }
+
+    if (o->callback) {
+        pa_snapshot_info_cb_t cb = (pa_snapshot_info_cb_t) o->callback;
+        cb(o->context, p, o->userdata);
+    }
+
+finish:
+    snapshot_info_free(&i);
+
+    pa_operation_done(o);
+    pa_operation_unref(o);
+    return;
+
+fail:
+    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+    goto finish;
+}
+
+pa_operation* pa_context_get_snapshot(pa_context *c, uint64_t since_generation, pa_snapshot_info_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 32, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_GET_SNAPSHOT, &tag);
+    pa_tagstruct_putu64(t, since_generation);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_snapshot_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 static pa_operation* command_kill(pa_context *c, uint32_t command, uint32_t idx, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
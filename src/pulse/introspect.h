@@ -134,6 +134,21 @@
  * either pa_context_get_client_info() or pa_context_get_client_info_list().
  * The information structure is called pa_client_info.
  *
+ * \subsection snapshot_subsec Snapshots
+ *
+ * pa_context_get_snapshot() fetches the server information and the lists of
+ * modules, clients, cards, sinks, sources, sink inputs, source outputs and
+ * samples in a single request. All of them are taken at the same point in
+ * time, and passed to the callback at once in a pa_snapshot_info structure.
+ *
+ * Every snapshot carries a generation number. Passing it to the next call
+ * of pa_context_get_snapshot() makes the server only send the objects that
+ * were created or changed since then, and the indexes of the ones that were
+ * removed. The changes are tracked with the same events that are sent to
+ * \ref subscribe "subscriptions", so values that change without an event,
+ * like latencies, are not updated in such a partial snapshot. The server may
+ * send a complete snapshot instead of a partial one at any time.
+ *
  * \section ctrl_sec Control
  *
  * Some parts of the server are only possible to read, but most can also be
@@ -675,6 +690,45 @@ typedef void (*pa_stat_info_cb_t) (pa_context *c, const pa_stat_info *i, void *u
 /** Get daemon memory block statistics */
 pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdata);
 
+/** A bucket of a pa_histogram_info. \since 10.0 */
+typedef struct pa_histogram_bucket {
+    uint64_t upper_bound;              /**< The largest value counted in this bucket */
+    uint64_t count;                    /**< The number of values counted in this bucket */
+} pa_histogram_bucket;
+
+/** A histogram of the values of some measurement since the sink or source
+ * was created. \since 10.0 */
+typedef struct pa_histogram_info {
+    uint64_t count;                    /**< The number of values */
+    uint64_t min;                      /**< The smallest value, 0 if there are none */
+    uint64_t max;                      /**< The largest value, 0 if there are none */
+    uint64_t sum;                      /**< The sum of all values */
+    uint32_t n_buckets;                /**< Number of entries in the bucket array */
+    pa_histogram_bucket *buckets;      /**< Array of the non-empty buckets, in ascending order */
+} pa_histogram_info;
+
+/** Timing statistics of the IO thread of a sink or source. Please note
+ * that this structure can be extended as part of evolutionary API
+ * updates at any time in any new release. \since 10.0 */
+typedef struct pa_io_timing_info {
+    uint32_t index;                    /**< Index of the sink or source */
+    const char *name;                  /**< Name of the sink or source */
+    pa_histogram_info process_usec;    /**< Time spent in each mixing pass of the sink, or in posting each chunk of the source, in usec */
+    pa_histogram_info resample_usec;   /**< Time spent in each resampler run for the streams, in usec */
+    pa_histogram_info wakeup_lateness_usec; /**< How late the IO thread woke up for its timer, in usec */
+    pa_histogram_info rewind_bytes;    /**< The size of each rewind, in bytes */
+} pa_io_timing_info;
+
+/** Callback prototype for pa_context_get_sink_timing_info_list() and
+ * pa_context_get_source_timing_info_list(). \since 10.0 */
+typedef void (*pa_io_timing_info_cb_t) (pa_context *c, const pa_io_timing_info *i, int eol, void *userdata);
+
+/** Get the IO thread timing statistics of all sinks. \since 10.0 */
+pa_operation* pa_context_get_sink_timing_info_list(pa_context *c, pa_io_timing_info_cb_t cb, void *userdata);
+
+/** Get the IO thread timing statistics of all sources. \since 10.0 */
+pa_operation* pa_context_get_source_timing_info_list(pa_context *c, pa_io_timing_info_cb_t cb, void *userdata);
+
 /** @} */
 
 /** @{ \name Cached Samples */
@@ -709,6 +763,54 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
 
 /** @} */
 
+/** @{ \name Snapshots */
+
+/** An object that was removed since the generation a partial snapshot was
+ * asked for. \since 10.0 */
+typedef struct pa_snapshot_removed {
+    pa_subscription_event_type_t facility; /**< The kind of object, one of the PA_SUBSCRIPTION_EVENT_xxx facilities */
+    uint32_t index;                        /**< Index of the object */
+} pa_snapshot_removed;
+
+/** The state of the server at one point in time. Please note that this
+ * structure can be extended as part of evolutionary API updates at any
+ * time in any new release. \since 10.0 */
+typedef struct pa_snapshot_info {
+    uint64_t generation;                   /**< Generation of the server state, to be passed to the next pa_context_get_snapshot() call */
+    int complete;                          /**< Non-zero if this snapshot has all objects, zero if it only has the ones that changed since the generation that was asked for */
+    const pa_server_info *server_info;     /**< Server information, NULL if it did not change */
+    uint32_t n_modules;                    /**< Number of entries in modules */
+    const pa_module_info *modules;         /**< Array of modules */
+    uint32_t n_clients;                    /**< Number of entries in clients */
+    const pa_client_info *clients;         /**< Array of clients */
+    uint32_t n_cards;                      /**< Number of entries in cards */
+    const pa_card_info *cards;             /**< Array of cards */
+    uint32_t n_sinks;                      /**< Number of entries in sinks */
+    const pa_sink_info *sinks;             /**< Array of sinks */
+    uint32_t n_sources;                    /**< Number of entries in sources */
+    const pa_source_info *sources;         /**< Array of sources */
+    uint32_t n_sink_inputs;                /**< Number of entries in sink_inputs */
+    const pa_sink_input_info *sink_inputs; /**< Array of sink inputs */
+    uint32_t n_source_outputs;             /**< Number of entries in source_outputs */
+    const pa_source_output_info *source_outputs; /**< Array of source outputs */
+    uint32_t n_samples;                    /**< Number of entries in samples */
+    const pa_sample_info *samples;         /**< Array of cached samples */
+    uint32_t n_removed;                    /**< Number of entries in removed, always 0 for a complete snapshot */
+    const pa_snapshot_removed *removed;    /**< Array of the objects that were removed */
+} pa_snapshot_info;
+
+/** Callback prototype for pa_context_get_snapshot(). i is NULL if the
+ * request failed. \since 10.0 */
+typedef void (*pa_snapshot_info_cb_t)(pa_context *c, const pa_snapshot_info *i, void *userdata);
+
+/** Get a snapshot of all objects on the server in a single request. If
+ * since_generation is 0, the snapshot is complete. Otherwise it is the
+ * generation of an earlier snapshot, and only the changes since then are
+ * sent, if the server still has them. \since 10.0 */
+pa_operation* pa_context_get_snapshot(pa_context *c, uint64_t since_generation, pa_snapshot_info_cb_t cb, void *userdata);
+
+/** @} */
+
 /** \cond fulldocs */
 
 /** @{ \name Autoload Entries */
@@ -27,20 +27,126 @@
 #include <pulse/xmalloc.h>
 #include <pulse/utf8.h>
 
-#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
 #include "proplist.h"
 
+/* Properties are kept in a flat array in the order they were added, which
+ * is cheaper to search, copy and serialize than a hashmap for the few dozen
+ * properties a proplist usually has. Unset properties leave a hole (key ==
+ * NULL) behind until the array is compacted, so that they may be unset
+ * while iterating. */
 struct property {
-    char *key;
+    const char *key;
+    unsigned hash;
+    bool interned;
     void *value;
     size_t nbytes;
 };
 
-#define MAKE_HASHMAP(p) ((pa_hashmap*) (p))
-#define MAKE_PROPLIST(p) ((pa_proplist*) (p))
+struct pa_proplist {
+    struct property *properties;
+    unsigned n_used, n_allocated;
+    unsigned size;
+};
+
+#define N_INITIAL 8
+
+/* The well-known keys are not copied into every proplist, but shared.
+ * Sorted by strcmp() for bsearch(). */
+static const char * const interned_keys[] = {
+    PA_PROP_APPLICATION_ICON,
+    PA_PROP_APPLICATION_ICON_NAME,
+    PA_PROP_APPLICATION_ID,
+    PA_PROP_APPLICATION_LANGUAGE,
+    PA_PROP_APPLICATION_NAME,
+    PA_PROP_APPLICATION_PROCESS_BINARY,
+    PA_PROP_APPLICATION_PROCESS_HOST,
+    PA_PROP_APPLICATION_PROCESS_ID,
+    PA_PROP_APPLICATION_PROCESS_MACHINE_ID,
+    PA_PROP_APPLICATION_PROCESS_SESSION_ID,
+    PA_PROP_APPLICATION_PROCESS_USER,
+    PA_PROP_APPLICATION_VERSION,
+    PA_PROP_DEVICE_ACCESS_MODE,
+    PA_PROP_DEVICE_API,
+    PA_PROP_DEVICE_BUFFERING_BUFFER_SIZE,
+    PA_PROP_DEVICE_BUFFERING_FRAGMENT_SIZE,
+    PA_PROP_DEVICE_BUS,
+    PA_PROP_DEVICE_BUS_PATH,
+    PA_PROP_DEVICE_CLASS,
+    PA_PROP_DEVICE_DESCRIPTION,
+    PA_PROP_DEVICE_FORM_FACTOR,
+    PA_PROP_DEVICE_ICON,
+    PA_PROP_DEVICE_ICON_NAME,
+    PA_PROP_DEVICE_INTENDED_ROLES,
+    PA_PROP_DEVICE_MASTER_DEVICE,
+    PA_PROP_DEVICE_PRODUCT_ID,
+    PA_PROP_DEVICE_PRODUCT_NAME,
+    PA_PROP_DEVICE_PROFILE_DESCRIPTION,
+    PA_PROP_DEVICE_PROFILE_NAME,
+    PA_PROP_DEVICE_SERIAL,
+    PA_PROP_DEVICE_STRING,
+    PA_PROP_DEVICE_VENDOR_ID,
+    PA_PROP_DEVICE_VENDOR_NAME,
+    PA_PROP_EVENT_DESCRIPTION,
+    PA_PROP_EVENT_ID,
+    PA_PROP_EVENT_MOUSE_BUTTON,
+    PA_PROP_EVENT_MOUSE_HPOS,
+    PA_PROP_EVENT_MOUSE_VPOS,
+    PA_PROP_EVENT_MOUSE_X,
+    PA_PROP_EVENT_MOUSE_Y,
+    PA_PROP_FILTER_APPLY,
+    PA_PROP_FILTER_SUPPRESS,
+    PA_PROP_FILTER_WANT,
+    PA_PROP_FORMAT_CHANNEL_MAP,
+    PA_PROP_FORMAT_CHANNELS,
+    PA_PROP_FORMAT_RATE,
+    PA_PROP_FORMAT_SAMPLE_FORMAT,
+    PA_PROP_MEDIA_ARTIST,
+    PA_PROP_MEDIA_COPYRIGHT,
+    PA_PROP_MEDIA_FILENAME,
+    PA_PROP_MEDIA_ICON,
+    PA_PROP_MEDIA_ICON_NAME,
+    PA_PROP_MEDIA_LANGUAGE,
+    PA_PROP_MEDIA_NAME,
+    PA_PROP_MEDIA_ROLE,
+    PA_PROP_MEDIA_SOFTWARE,
+    PA_PROP_MEDIA_TITLE,
+    PA_PROP_MODULE_AUTHOR,
+    PA_PROP_MODULE_DESCRIPTION,
+    PA_PROP_MODULE_USAGE,
+    PA_PROP_MODULE_VERSION,
+    PA_PROP_WINDOW_DESKTOP,
+    PA_PROP_WINDOW_HEIGHT,
+    PA_PROP_WINDOW_HPOS,
+    PA_PROP_WINDOW_ICON,
+    PA_PROP_WINDOW_ICON_NAME,
+    PA_PROP_WINDOW_ID,
+    PA_PROP_WINDOW_NAME,
+    PA_PROP_WINDOW_VPOS,
+    PA_PROP_WINDOW_WIDTH,
+    PA_PROP_WINDOW_X,
+    PA_PROP_WINDOW_X11_DISPLAY,
+    PA_PROP_WINDOW_X11_MONITOR,
+    PA_PROP_WINDOW_X11_SCREEN,
+    PA_PROP_WINDOW_X11_XID,
+    PA_PROP_WINDOW_Y,
+};
+
+static int key_compare(const void *a, const void *b) {
+    return strcmp(a, *(const char * const *) b);
+}
+
+static const char *key_intern(const char *key) {
+    const char * const *k;
+
+    if (!(k = bsearch(key, interned_keys, PA_ELEMENTSOF(interned_keys), sizeof(interned_keys[0]), key_compare)))
+        return NULL;
+
+    return *k;
+}
 
 int pa_proplist_key_valid(const char *key) {
 
@@ -56,25 +162,109 @@ int pa_proplist_key_valid(const char *key) {
 static void property_free(struct property *prop) {
     pa_assert(prop);
 
-    pa_xfree(prop->key);
+    if (!prop->interned)
+        pa_xfree((char *) prop->key);
     pa_xfree(prop->value);
-    pa_xfree(prop);
+
+    prop->key = NULL;
+}
+
+static struct property *proplist_find(const pa_proplist *p, const char *key, unsigned hash) {
+    unsigned i;
+
+    for (i = 0; i < p->n_used; i++) {
+        struct property *prop = &p->properties[i];
+
+        if (prop->key && prop->hash == hash && (prop->key == key || pa_streq(prop->key, key)))
+            return prop;
+    }
+
+    return NULL;
+}
+
+static struct property *proplist_get(const pa_proplist *p, const char *key) {
+    return proplist_find(p, key, pa_idxset_string_hash_func(key));
+}
+
+/* Drops the holes left by unset properties */
+static void proplist_compact(pa_proplist *p) {
+    unsigned i, j;
+
+    for (i = j = 0; i < p->n_used; i++)
+        if (p->properties[i].key) {
+            if (i != j)
+                p->properties[j] = p->properties[i];
+            j++;
+        }
+
+    p->n_used = j;
+}
+
+/* Appends a property for key without a value. interned says that key is
+ * one of interned_keys already, key_copy is a copy of key that may be
+ * taken over, or NULL. */
+static struct property *proplist_add(pa_proplist *p, const char *key, unsigned hash, bool interned, char *key_copy) {
+    struct property *prop;
+    const char *k;
+
+    if (p->n_used >= p->n_allocated) {
+        if (p->size < p->n_used)
+            proplist_compact(p);
+        else {
+            p->n_allocated = PA_MAX(p->n_allocated * 2, (unsigned) N_INITIAL);
+            p->properties = pa_xrenew(struct property, p->properties, p->n_allocated);
+        }
+    }
+
+    prop = &p->properties[p->n_used++];
+    p->size++;
+
+    prop->hash = hash;
+    prop->value = NULL;
+    prop->nbytes = 0;
+
+    if (interned || (k = key_intern(key))) {
+        prop->key = interned ? key : k;
+        prop->interned = true;
+        pa_xfree(key_copy);
+    } else {
+        prop->key = key_copy ? key_copy : pa_xstrdup(key);
+        prop->interned = false;
+    }
+
+    return prop;
+}
+
+/* Returns the property for key with its old value freed, or a new one.
+ * Takes ownership of key_copy, see proplist_add(). */
+static struct property *proplist_get_or_add(pa_proplist *p, const char *key, char *key_copy) {
+    struct property *prop;
+    unsigned hash = pa_idxset_string_hash_func(key);
+
+    if ((prop = proplist_find(p, key, hash))) {
+        pa_xfree(key_copy);
+        pa_xfree(prop->value);
+        return prop;
+    }
+
+    return proplist_add(p, key, hash, false, key_copy);
 }
 
 pa_proplist* pa_proplist_new(void) {
-    return MAKE_PROPLIST(pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, NULL, (pa_free_cb_t) property_free));
+    return pa_xnew0(pa_proplist, 1);
 }
 
 void pa_proplist_free(pa_proplist* p) {
     pa_assert(p);
 
-    pa_hashmap_free(MAKE_HASHMAP(p));
+    pa_proplist_clear(p);
+    pa_xfree(p->properties);
+    pa_xfree(p);
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     struct property *prop;
-    bool add = false;
 
     pa_assert(p);
     pa_assert(key);
@@ -83,26 +273,16 @@ int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     if (!pa_proplist_key_valid(key) || !pa_utf8_valid(value))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = true;
-    } else
-        pa_xfree(prop->value);
-
+    prop = proplist_get_or_add(p, key, NULL);
     prop->value = pa_xstrdup(value);
     prop->nbytes = strlen(value)+1;
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
     struct property *prop;
-    bool add = false;
     char *k, *v;
 
     pa_assert(p);
@@ -118,21 +298,10 @@ static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, con
         return -1;
     }
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = true;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
+    prop = proplist_get_or_add(p, k, k);
     prop->value = v;
     prop->nbytes = strlen(v)+1;
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
     return 0;
 }
 
@@ -153,7 +322,6 @@ int pa_proplist_setp(pa_proplist *p, const char *pair) {
 
 static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
     struct property *prop;
-    bool add = false;
     char *k, *v;
     uint8_t *d;
     size_t dn;
@@ -181,29 +349,18 @@ static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, c
 
     pa_xfree(v);
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = true;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
+    prop = proplist_get_or_add(p, k, k);
 
     d[dn] = 0;
     prop->value = d;
     prop->nbytes = dn;
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     struct property *prop;
-    bool add = false;
     va_list ap;
     char *v;
 
@@ -221,19 +378,10 @@ int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     if (!pa_utf8_valid(v))
         goto fail;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = true;
-    } else
-        pa_xfree(prop->value);
-
+    prop = proplist_get_or_add(p, key, NULL);
     prop->value = v;
     prop->nbytes = strlen(v)+1;
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
     return 0;
 
 fail:
@@ -243,7 +391,6 @@ fail:
 
 int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nbytes) {
     struct property *prop;
-    bool add = false;
 
     pa_assert(p);
     pa_assert(key);
@@ -252,22 +399,13 @@ int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nb
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = true;
-    } else
-        pa_xfree(prop->value);
-
+    prop = proplist_get_or_add(p, key, NULL);
     prop->value = pa_xmalloc(nbytes+1);
     if (nbytes > 0)
         memcpy(prop->value, data, nbytes);
     ((char*) prop->value)[nbytes] = 0;
     prop->nbytes = nbytes;
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
-
     return 0;
 }
 
@@ -280,7 +418,7 @@ const char *pa_proplist_gets(pa_proplist *p, const char *key) {
     if (!pa_proplist_key_valid(key))
         return NULL;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = proplist_get(p, key)))
         return NULL;
 
     if (prop->nbytes <= 0)
@@ -309,7 +447,7 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = proplist_get(p, key)))
         return -1;
 
     *data = prop->value;
@@ -319,8 +457,8 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
 }
 
 void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, const pa_proplist *other) {
-    struct property *prop;
-    void *state = NULL;
+    unsigned i;
+    bool empty;
 
     pa_assert(p);
     pa_assert(mode == PA_UPDATE_SET || mode == PA_UPDATE_MERGE || mode == PA_UPDATE_REPLACE);
@@ -329,27 +467,60 @@ void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, const pa_proplist
     if (mode == PA_UPDATE_SET)
         pa_proplist_clear(p);
 
-    /* MAKE_HASHMAP turns the const pointer into a non-const pointer, but
-     * that's ok, because we don't modify the hashmap contents. */
-    while ((prop = pa_hashmap_iterate(MAKE_HASHMAP(other), &state, NULL))) {
+    /* Copying into an empty proplist is common, there is nothing to look
+     * up then and the array can be sized right away */
+    if ((empty = p->size == 0)) {
+        p->n_used = 0;
 
-        if (mode == PA_UPDATE_MERGE && pa_proplist_contains(p, prop->key))
+        if (p->n_allocated < other->size) {
+            pa_xfree(p->properties);
+            p->n_allocated = other->size;
+            p->properties = pa_xnew(struct property, p->n_allocated);
+        }
+    }
+
+    for (i = 0; i < other->n_used; i++) {
+        const struct property *o = &other->properties[i];
+        struct property *prop;
+
+        if (!o->key)
             continue;
 
-        pa_assert_se(pa_proplist_set(p, prop->key, prop->value, prop->nbytes) == 0);
+        if (!empty && (prop = proplist_find(p, o->key, o->hash))) {
+            if (mode == PA_UPDATE_MERGE)
+                continue;
+
+            pa_xfree(prop->value);
+        } else
+            prop = proplist_add(p, o->key, o->hash, o->interned, NULL);
+
+        prop->value = pa_xmalloc(o->nbytes+1);
+        if (o->nbytes > 0)
+            memcpy(prop->value, o->value, o->nbytes);
+        ((char*) prop->value)[o->nbytes] = 0;
+        prop->nbytes = o->nbytes;
     }
 }
 
 int pa_proplist_unset(pa_proplist *p, const char *key) {
+    struct property *prop;
+
     pa_assert(p);
     pa_assert(key);
 
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (pa_hashmap_remove_and_free(MAKE_HASHMAP(p), key) < 0)
+    if (!(prop = proplist_get(p, key)))
         return -2;
 
+    property_free(prop);
+    p->size--;
+
+    /* Holes at the end can go right away */
+    while (p->n_used > 0 && !p->properties[p->n_used-1].key)
+        p->n_used--;
+
     return 0;
 }
 
@@ -372,12 +543,20 @@ int pa_proplist_unset_many(pa_proplist *p, const char * const keys[]) {
 }
 
 const char *pa_proplist_iterate(pa_proplist *p, void **state) {
-    struct property *prop;
+    unsigned i;
 
-    if (!(prop = pa_hashmap_iterate(MAKE_HASHMAP(p), state, NULL)))
-        return NULL;
+    pa_assert(p);
+    pa_assert(state);
+
+    /* The state is the index of the next property */
+    for (i = PA_PTR_TO_UINT(*state); i < p->n_used; i++)
+        if (p->properties[i].key) {
+            *state = PA_UINT_TO_PTR(i+1);
+            return p->properties[i].key;
+        }
 
-    return prop->key;
+    *state = PA_UINT_TO_PTR(i);
+    return NULL;
 }
 
 char *pa_proplist_to_string_sep(pa_proplist *p, const char *sep) {
@@ -626,7 +805,7 @@ pa_proplist *pa_proplist_from_string(const char *s) {
     }
 
 success:
-    return MAKE_PROPLIST(pl);
+    return pl;
 
 fail:
     pa_proplist_free(pl);
@@ -640,16 +819,22 @@ int pa_proplist_contains(pa_proplist *p, const char *key) {
     if (!pa_proplist_key_valid(key))
         return -1;
 
-    if (!(pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!proplist_get(p, key))
         return 0;
 
     return 1;
 }
 
 void pa_proplist_clear(pa_proplist *p) {
+    unsigned i;
+
     pa_assert(p);
 
-    pa_hashmap_remove_all(MAKE_HASHMAP(p));
+    for (i = 0; i < p->n_used; i++)
+        if (p->properties[i].key)
+            property_free(&p->properties[i]);
+
+    p->n_used = p->size = 0;
 }
 
 pa_proplist* pa_proplist_copy(const pa_proplist *p) {
@@ -666,20 +851,17 @@ pa_proplist* pa_proplist_copy(const pa_proplist *p) {
 unsigned pa_proplist_size(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_size(MAKE_HASHMAP(p));
+    return p->size;
 }
 
 int pa_proplist_isempty(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_isempty(MAKE_HASHMAP(p));
+    return p->size == 0;
 }
 
 int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
-    const void *key = NULL;
-    struct property *a_prop = NULL;
-    struct property *b_prop = NULL;
-    void *state = NULL;
+    unsigned i;
 
     pa_assert(a);
     pa_assert(b);
@@ -690,8 +872,14 @@ int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
     if (pa_proplist_size(a) != pa_proplist_size(b))
         return 0;
 
-    while ((a_prop = pa_hashmap_iterate(MAKE_HASHMAP(a), &state, &key))) {
-        if (!(b_prop = pa_hashmap_get(MAKE_HASHMAP(b), key)))
+    for (i = 0; i < a->n_used; i++) {
+        const struct property *a_prop = &a->properties[i];
+        const struct property *b_prop;
+
+        if (!a_prop->key)
+            continue;
+
+        if (!(b_prop = proplist_find(b, a_prop->key, a_prop->hash)))
             return 0;
 
         if (a_prop->nbytes != b_prop->nbytes)
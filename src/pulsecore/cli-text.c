@@ -230,13 +230,58 @@ static const char *source_state_to_string(pa_source_state_t state) {
     }
 }
 
+static void append_cpu_placement(pa_strbuf *s, pa_cpu_placement *p) {
+    pa_strbuf_puts(s, "\tio thread: ");
+
+    if (p->cpu >= 0)
+        pa_strbuf_printf(s, "cpu %i", p->cpu);
+    else
+        pa_strbuf_puts(s, "cpu n/a");
+
+    if (p->node >= 0)
+        pa_strbuf_printf(s, ", node %i", p->node);
+
+    pa_strbuf_printf(s, "; allowed cpus: %s\n", p->cpus ? p->cpus : "n/a");
+
+    pa_xfree(p->cpus);
+}
+
+static void append_histogram(pa_strbuf *s, const char *name, const pa_histogram *h, const char *unit) {
+    if (h->count == 0) {
+        pa_strbuf_printf(s, "\t\t%s: n/a\n", name);
+        return;
+    }
+
+    pa_strbuf_printf(s, "\t\t%s: %llu samples, min %llu %s, median %llu %s, 99%% %llu %s, max %llu %s\n",
+                     name, (unsigned long long) h->count,
+                     (unsigned long long) h->min, unit,
+                     (unsigned long long) pa_histogram_quantile(h, 0.5), unit,
+                     (unsigned long long) pa_histogram_quantile(h, 0.99), unit,
+                     (unsigned long long) h->max, unit);
+}
+
+static void append_timing(pa_strbuf *s, const char *process, pa_io_timing *t, int r) {
+    if (r < 0) {
+        pa_strbuf_puts(s, "\tio timing: n/a\n");
+        return;
+    }
+
+    pa_strbuf_puts(s, "\tio timing:\n");
+    append_histogram(s, process, &t->process_usec, "usec");
+    append_histogram(s, "resample", &t->resample_usec, "usec");
+    append_histogram(s, "wakeup lateness", &t->wakeup_lateness_usec, "usec");
+    append_histogram(s, "rewind", &t->rewind_bytes, "bytes");
+}
+
 char *pa_sink_list_to_string(pa_core *c) {
     pa_strbuf *s;
     pa_sink *sink, *default_sink;
+    pa_io_timing *timing;
     uint32_t idx = PA_IDXSET_INVALID;
     pa_assert(c);
 
     s = pa_strbuf_new();
+    timing = pa_xnew(pa_io_timing, 1);
 
     pa_strbuf_printf(s, "%u sink(s) available.\n", pa_idxset_size(c->sinks));
 
@@ -248,6 +293,7 @@ char *pa_sink_list_to_string(pa_core *c) {
             v[PA_VOLUME_SNPRINT_VERBOSE_MAX],
             cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
         const char *cmn;
+        pa_cpu_placement placement;
 
         cmn = pa_channel_map_to_pretty_name(&sink->channel_map);
 
@@ -327,6 +373,10 @@ char *pa_sink_list_to_string(pa_core *c) {
                     "\tfixed latency: %0.2f ms\n",
                     (double) pa_sink_get_fixed_latency(sink) / PA_USEC_PER_MSEC);
 
+        pa_sink_get_cpu_placement(sink, &placement);
+        append_cpu_placement(s, &placement);
+        append_timing(s, "render", timing, pa_sink_get_timing(sink, timing));
+
         if (sink->card)
             pa_strbuf_printf(s, "\tcard: %u <%s>\n", sink->card->index, sink->card->name);
         if (sink->module)
@@ -345,16 +395,20 @@ char *pa_sink_list_to_string(pa_core *c) {
                     sink->active_port->name);
     }
 
+    pa_xfree(timing);
+
     return pa_strbuf_to_string_free(s);
 }
 
 char *pa_source_list_to_string(pa_core *c) {
     pa_strbuf *s;
     pa_source *source, *default_source;
+    pa_io_timing *timing;
     uint32_t idx = PA_IDXSET_INVALID;
     pa_assert(c);
 
     s = pa_strbuf_new();
+    timing = pa_xnew(pa_io_timing, 1);
 
     pa_strbuf_printf(s, "%u source(s) available.\n", pa_idxset_size(c->sources));
 
@@ -366,6 +420,7 @@ char *pa_source_list_to_string(pa_core *c) {
             v[PA_VOLUME_SNPRINT_VERBOSE_MAX],
             cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
         const char *cmn;
+        pa_cpu_placement placement;
 
         cmn = pa_channel_map_to_pretty_name(&source->channel_map);
 
@@ -440,6 +495,10 @@ char *pa_source_list_to_string(pa_core *c) {
                     "\tfixed latency: %0.2f ms\n",
                     (double) pa_source_get_fixed_latency(source) / PA_USEC_PER_MSEC);
 
+        pa_source_get_cpu_placement(source, &placement);
+        append_cpu_placement(s, &placement);
+        append_timing(s, "post", timing, pa_source_get_timing(source, timing));
+
         if (source->monitor_of)
             pa_strbuf_printf(s, "\tmonitor_of: %u\n", source->monitor_of->index);
         if (source->card)
@@ -460,6 +519,8 @@ char *pa_source_list_to_string(pa_core *c) {
                     source->active_port->name);
     }
 
+    pa_xfree(timing);
+
     return pa_strbuf_to_string_free(s);
 }
 
@@ -845,6 +845,151 @@ int pa_make_realtime(int rtprio) {
     return -1;
 }
 
+#define CPU_LIST_MAX 4096
+
+int pa_parse_cpu_list(const char *s, unsigned *cpus, unsigned n) {
+    const char *state = NULL;
+    char *k;
+    unsigned count = 0;
+
+    pa_assert(s);
+
+    while ((k = pa_split(s, ",", &state))) {
+        uint32_t first, last, cpu;
+        char *from, *to;
+        bool valid;
+
+        if ((to = strchr(k, '-')))
+            *(to++) = 0;
+
+        /* Allow whitespace around the CPU numbers */
+        from = pa_strip(k);
+        to = to ? pa_strip(to) : from;
+
+        valid = pa_atou(from, &first) >= 0 && pa_atou(to, &last) >= 0;
+        pa_xfree(k);
+
+        if (!valid || first > last || last >= CPU_LIST_MAX)
+            return -1;
+
+        for (cpu = first; cpu <= last; cpu++, count++)
+            if (cpus && count < n)
+                cpus[count] = cpu;
+    }
+
+    return count > 0 ? (int) count : -1;
+}
+
+int pa_set_cpu_affinity(const char *cpus) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    unsigned list[CPU_LIST_MAX];
+    cpu_set_t mask;
+    int i, n, r;
+
+    pa_assert(cpus);
+
+    if ((n = pa_parse_cpu_list(cpus, list, PA_ELEMENTSOF(list))) < 0) {
+        pa_log("Invalid CPU list '%s'.", cpus);
+        return -1;
+    }
+
+    /* Only the first CPUs of a list that names some more than once are stored */
+    n = PA_MIN(n, (int) PA_ELEMENTSOF(list));
+
+    CPU_ZERO(&mask);
+    for (i = 0; i < n; i++)
+        if (list[i] < CPU_SETSIZE)
+            CPU_SET(list[i], &mask);
+
+    if ((r = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask)) != 0) {
+        pa_log_warn("Failed to restrict thread to CPUs %s: %s", cpus, pa_cstrerror(r));
+        return -1;
+    }
+
+    pa_log_info("Restricted thread to CPUs %s.", cpus);
+    return 0;
+#else
+    pa_log_warn("Setting the CPU affinity of threads is not supported on this platform.");
+    return -1;
+#endif
+}
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+/* Formats the mask as a list that pa_parse_cpu_list() understands */
+static char *cpu_set_to_list(const cpu_set_t *mask) {
+    pa_strbuf *buf = pa_strbuf_new();
+    int cpu, first = -1;
+
+    for (cpu = 0; cpu <= CPU_SETSIZE; cpu++) {
+        bool set = cpu < CPU_SETSIZE && CPU_ISSET(cpu, mask);
+
+        if (set && first < 0)
+            first = cpu;
+        else if (!set && first >= 0) {
+            if (!pa_strbuf_isempty(buf))
+                pa_strbuf_puts(buf, ",");
+
+            if (cpu - 1 > first)
+                pa_strbuf_printf(buf, "%i-%i", first, cpu - 1);
+            else
+                pa_strbuf_printf(buf, "%i", first);
+
+            first = -1;
+        }
+    }
+
+    return pa_strbuf_to_string_free(buf);
+}
+#endif
+
+#ifdef __linux__
+/* The node a CPU belongs to shows up as a nodeN entry in its sysfs directory */
+static int cpu_to_node(int cpu) {
+    char path[64];
+    struct dirent *de;
+    DIR *d;
+    int node = -1;
+
+    pa_snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%i", cpu);
+
+    if (!(d = opendir(path)))
+        return -1;
+
+    while ((de = readdir(d)))
+        if (strncmp(de->d_name, "node", 4) == 0 && pa_atoi(de->d_name + 4, &node) >= 0)
+            break;
+
+    closedir(d);
+    return node;
+}
+#endif
+
+void pa_get_cpu_placement(pa_cpu_placement *p) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    cpu_set_t mask;
+#endif
+
+    pa_assert(p);
+
+    p->cpu = -1;
+    p->node = -1;
+    p->cpus = NULL;
+
+#ifdef HAVE_SCHED_GETCPU
+    p->cpu = sched_getcpu();
+#endif
+
+#ifdef __linux__
+    if (p->cpu >= 0)
+        p->node = cpu_to_node(p->cpu);
+#endif
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    if (pthread_getaffinity_np(pthread_self(), sizeof(mask), &mask) == 0)
+        p->cpus = cpu_set_to_list(&mask);
+#endif
+}
+
 #ifdef HAVE_SYS_RESOURCE_H
 static int set_nice(int nice_level) {
 #ifdef HAVE_DBUS
@@ -85,6 +85,23 @@ int pa_make_realtime(int rtprio);
 int pa_raise_priority(int nice_level);
 void pa_reset_priority(void);
 
+/* Parses a list of CPUs like "0,2,4-7". Up to n of the CPUs are stored
+ * in cpus in the order they appear in the list. Returns the number of
+ * CPUs in the list, or -1 if it is invalid. */
+int pa_parse_cpu_list(const char *s, unsigned *cpus, unsigned n);
+
+/* Restricts the calling thread to the CPUs in the list */
+int pa_set_cpu_affinity(const char *cpus);
+
+typedef struct pa_cpu_placement {
+    int cpu;    /* The CPU the thread is running on, or -1 if unknown */
+    int node;   /* The NUMA node of that CPU, or -1 if unknown */
+    char *cpus; /* The CPUs the thread may run on, or NULL if unknown */
+} pa_cpu_placement;
+
+/* Fills in where the calling thread runs. Free p->cpus with pa_xfree() */
+void pa_get_cpu_placement(pa_cpu_placement *p);
+
 int pa_parse_boolean(const char *s) PA_GCC_PURE;
 
 int pa_parse_volume(const char *s, pa_volume_t *volume);
@@ -61,7 +61,7 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
 
 static void core_free(pa_object *o);
 
-pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size) {
+pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size, bool hugepages) {
     pa_core* c;
     pa_mempool *pool;
     pa_mem_type_t type;
@@ -71,7 +71,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     if (shared) {
         type = (enable_memfd) ? PA_MEM_TYPE_SHARED_MEMFD : PA_MEM_TYPE_SHARED_POSIX;
-        if (!(pool = pa_mempool_new(type, shm_size, false))) {
+        if (!(pool = pa_mempool_new(type, shm_size, false, hugepages))) {
             pa_log_warn("Failed to allocate %s memory pool. Falling back to a normal memory pool.",
                         pa_mem_type_to_string(type));
             shared = false;
@@ -79,7 +79,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     }
 
     if (!shared) {
-        if (!(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, shm_size, false))) {
+        if (!(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, shm_size, false, hugepages))) {
             pa_log("pa_mempool_new() failed.");
             return NULL;
         }
@@ -127,6 +127,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     c->mempool = pool;
     c->shm_size = shm_size;
+    c->hugepages = hugepages;
     pa_silence_cache_init(&c->silence_cache);
 
     c->exit_event = NULL;
@@ -141,6 +142,9 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->running_as_daemon = false;
     c->realtime_scheduling = false;
     c->realtime_priority = 5;
+    c->io_thread_cpus = NULL;
+    c->io_thread_spread = false;
+    c->io_thread_next_cpu = 0;
     c->disable_remixing = false;
     c->disable_lfe_remixing = false;
     c->lfe_crossover_freq = 120;
@@ -220,6 +224,7 @@ static void core_free(pa_object *o) {
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
         pa_hook_done(&c->hooks[j]);
 
+    pa_xfree(c->io_thread_cpus);
     pa_xfree(c);
 }
 
@@ -282,6 +287,49 @@ void pa_core_maybe_vacuum(pa_core *c) {
     pa_mempool_vacuum(c->mempool);
 }
 
+char *pa_core_get_io_thread_cpus(pa_core *c) {
+    unsigned *cpus;
+    char *r;
+    int n;
+
+    pa_assert(c);
+
+    if (!c->io_thread_cpus)
+        return NULL;
+
+    if (!c->io_thread_spread)
+        return pa_xstrdup(c->io_thread_cpus);
+
+    if ((n = pa_parse_cpu_list(c->io_thread_cpus, NULL, 0)) < 0)
+        return NULL;
+
+    cpus = pa_xnew(unsigned, n);
+    pa_parse_cpu_list(c->io_thread_cpus, cpus, n);
+    r = pa_sprintf_malloc("%u", cpus[c->io_thread_next_cpu++ % n]);
+    pa_xfree(cpus);
+
+    return r;
+}
+
+bool pa_core_io_thread_is_placed(pa_core *c, pa_asyncmsgq *q) {
+    pa_sink *si;
+    pa_source *so;
+    uint32_t idx;
+
+    pa_assert(c);
+    pa_assert(q);
+
+    PA_IDXSET_FOREACH(si, c->sinks, idx)
+        if (si->asyncmsgq == q && PA_SINK_IS_LINKED(si->state) && !si->input_to_master)
+            return true;
+
+    PA_IDXSET_FOREACH(so, c->sources, idx)
+        if (so->asyncmsgq == q && PA_SOURCE_IS_LINKED(so->state) && !so->monitor_of && !so->output_from_master)
+            return true;
+
+    return false;
+}
+
 pa_time_event* pa_core_rttime_new(pa_core *c, pa_usec_t usec, pa_time_event_cb_t cb, void *userdata) {
     struct timeval tv;
 
@@ -185,6 +185,9 @@ struct pa_core {
      * or PA daemon defaults (~ 64 MiB). */
     size_t shm_size;
 
+    /* Whether memory pools should be backed by huge pages */
+    bool hugepages;
+
     pa_silence_cache silence_cache;
 
     pa_time_event *exit_event;
@@ -204,6 +207,12 @@ struct pa_core {
     pa_resample_method_t resample_method;
     int realtime_priority;
 
+    /* The CPUs IO threads are restricted to, or NULL. If io_thread_spread
+     * is set, every IO thread gets one of them, in turn. */
+    char *io_thread_cpus;
+    bool io_thread_spread;
+    unsigned io_thread_next_cpu;
+
     pa_server_type_t server_type;
     pa_cpu_info cpu_info;
 
@@ -219,7 +228,7 @@ enum {
     PA_CORE_MESSAGE_MAX
 };
 
-pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size);
+pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size, bool hugepages);
 
 /* Check whether no one is connected to this core */
 void pa_core_check_idle(pa_core *c);
@@ -228,6 +237,15 @@ int pa_core_exit(pa_core *c, bool force, int retval);
 
 void pa_core_maybe_vacuum(pa_core *c);
 
+/* Returns the CPUs the IO thread of a new sink or source shall run on,
+ * or NULL if it may run anywhere. Free the result with pa_xfree(). */
+char *pa_core_get_io_thread_cpus(pa_core *c);
+
+/* Returns true if a sink or source that is already put runs its IO thread
+ * on q, like the sink and source of a bluez5 card. That thread has been
+ * restricted to its CPUs already. */
+bool pa_core_io_thread_is_placed(pa_core *c, pa_asyncmsgq *q);
+
 /* wrapper for c->mainloop->time_*() RT time events */
 pa_time_event* pa_core_rttime_new(pa_core *c, pa_usec_t usec, pa_time_event_cb_t cb, void *userdata);
 void pa_core_rttime_restart(pa_core *c, pa_time_event *e, pa_usec_t usec);
@@ -7,91 +7,163 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulsecore/macro.h>
 
 #include "crossover.h"
 
-void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq)
+void lr4_multi_init(struct lr4_multi *lr4, int channels)
 {
-	biquad_set(&lr4->bq, type, freq);
-	lr4->x1 = 0;
-	lr4->x2 = 0;
-	lr4->y1 = 0;
-	lr4->y2 = 0;
-	lr4->z1 = 0;
-	lr4->z2 = 0;
+	pa_assert(channels > 0 && channels <= (int) LR4_MAX_CHANNELS);
+
+	memset(lr4, 0, sizeof(*lr4));
+	lr4->channels = channels;
 }
 
-void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest)
+void lr4_multi_set(struct lr4_multi *lr4, int channel, enum biquad_type type, float freq)
 {
-	float lx1 = lr4->x1;
-	float lx2 = lr4->x2;
-	float ly1 = lr4->y1;
-	float ly2 = lr4->y2;
-	float lz1 = lr4->z1;
-	float lz2 = lr4->z2;
-	float lb0 = lr4->bq.b0;
-	float lb1 = lr4->bq.b1;
-	float lb2 = lr4->bq.b2;
-	float la1 = lr4->bq.a1;
-	float la2 = lr4->bq.a2;
-
-	int i;
-	for (i = 0; i < samples * channels; i += channels) {
-		float x, y, z;
-		x = src[i];
-		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
-		z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
-		lx2 = lx1;
-		lx1 = x;
-		ly2 = ly1;
-		ly1 = y;
-		lz2 = lz1;
-		lz1 = z;
-		dest[i] = z;
-	}
+	struct biquad bq;
 
-	lr4->x1 = lx1;
-	lr4->x2 = lx2;
-	lr4->y1 = ly1;
-	lr4->y2 = ly2;
-	lr4->z1 = lz1;
-	lr4->z2 = lz2;
+	pa_assert(channel >= 0 && channel < lr4->channels);
+
+	biquad_set(&bq, type, freq);
+	lr4->b0[channel] = bq.b0;
+	lr4->b1[channel] = bq.b1;
+	lr4->b2[channel] = bq.b2;
+	lr4->a1[channel] = bq.a1;
+	lr4->a2[channel] = bq.a2;
 }
 
-void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest)
+void lr4_multi_reset(struct lr4_multi *lr4)
 {
-	float lx1 = lr4->x1;
-	float lx2 = lr4->x2;
-	float ly1 = lr4->y1;
-	float ly2 = lr4->y2;
-	float lz1 = lr4->z1;
-	float lz2 = lr4->z2;
-	float lb0 = lr4->bq.b0;
-	float lb1 = lr4->bq.b1;
-	float lb2 = lr4->bq.b2;
-	float la1 = lr4->bq.a1;
-	float la2 = lr4->bq.a2;
-
-	int i;
-	for (i = 0; i < samples * channels; i += channels) {
-		float x, y, z;
-		x = src[i];
-		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
-		z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
-		lx2 = lx1;
-		lx1 = x;
-		ly2 = ly1;
-		ly1 = y;
-		lz2 = lz1;
-		lz1 = z;
-		dest[i] = PA_CLAMP_UNLIKELY((int) z, -0x8000, 0x7fff);
+	memset(&lr4->state, 0, sizeof(lr4->state));
+}
+
+void lr4_multi_save(const struct lr4_multi *lr4, struct lr4_state *state)
+{
+	*state = lr4->state;
+}
+
+void lr4_multi_restore(struct lr4_multi *lr4, const struct lr4_state *state)
+{
+	lr4->state = *state;
+}
+
+/* The generic versions filter one channel after the other. The optimized
+ * ones must produce exactly the same output, so they have to evaluate the
+ * expressions below in the same order. */
+static void lr4_multi_process_float32_c(struct lr4_multi *lr4, int frames, const float *src, float *dest)
+{
+	struct lr4_state *s = &lr4->state;
+	int c, i, channels = lr4->channels;
+
+	for (c = 0; c < channels; c++) {
+		float lx1 = s->x1[c];
+		float lx2 = s->x2[c];
+		float ly1 = s->y1[c];
+		float ly2 = s->y2[c];
+		float lz1 = s->z1[c];
+		float lz2 = s->z2[c];
+		float lb0 = lr4->b0[c];
+		float lb1 = lr4->b1[c];
+		float lb2 = lr4->b2[c];
+		float la1 = lr4->a1[c];
+		float la2 = lr4->a2[c];
+
+		for (i = c; i < frames * channels; i += channels) {
+			float x, y, z;
+			x = src[i];
+			y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
+			z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
+			lx2 = lx1;
+			lx1 = x;
+			ly2 = ly1;
+			ly1 = y;
+			lz2 = lz1;
+			lz1 = z;
+			dest[i] = z;
+		}
+
+		s->x1[c] = lx1;
+		s->x2[c] = lx2;
+		s->y1[c] = ly1;
+		s->y2[c] = ly2;
+		s->z1[c] = lz1;
+		s->z2[c] = lz2;
 	}
+}
+
+static void lr4_multi_process_s16_c(struct lr4_multi *lr4, int frames, const short *src, short *dest)
+{
+	struct lr4_state *s = &lr4->state;
+	int c, i, channels = lr4->channels;
+
+	for (c = 0; c < channels; c++) {
+		float lx1 = s->x1[c];
+		float lx2 = s->x2[c];
+		float ly1 = s->y1[c];
+		float ly2 = s->y2[c];
+		float lz1 = s->z1[c];
+		float lz2 = s->z2[c];
+		float lb0 = lr4->b0[c];
+		float lb1 = lr4->b1[c];
+		float lb2 = lr4->b2[c];
+		float la1 = lr4->a1[c];
+		float la2 = lr4->a2[c];
+
+		for (i = c; i < frames * channels; i += channels) {
+			float x, y, z;
+			x = src[i];
+			y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
+			z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
+			lx2 = lx1;
+			lx1 = x;
+			ly2 = ly1;
+			ly1 = y;
+			lz2 = lz1;
+			lz1 = z;
+			dest[i] = PA_CLAMP_UNLIKELY((int) z, -0x8000, 0x7fff);
+		}
 
-	lr4->x1 = lx1;
-	lr4->x2 = lx2;
-	lr4->y1 = ly1;
-	lr4->y2 = ly2;
-	lr4->z1 = lz1;
-	lr4->z2 = lz2;
+		s->x1[c] = lx1;
+		s->x2[c] = lx2;
+		s->y1[c] = ly1;
+		s->y2[c] = ly2;
+		s->z1[c] = lz1;
+		s->z2[c] = lz2;
+	}
+}
+
+static lr4_multi_float32_func_t process_float32_func = lr4_multi_process_float32_c;
+static lr4_multi_s16_func_t process_s16_func = lr4_multi_process_s16_c;
+
+void lr4_multi_process_float32(struct lr4_multi *lr4, int frames, const float *src, float *dest)
+{
+	process_float32_func(lr4, frames, src, dest);
+}
+
+void lr4_multi_process_s16(struct lr4_multi *lr4, int frames, const short *src, short *dest)
+{
+	process_s16_func(lr4, frames, src, dest);
+}
+
+lr4_multi_float32_func_t lr4_multi_get_float32_func(void)
+{
+	return process_float32_func;
+}
+
+void lr4_multi_set_float32_func(lr4_multi_float32_func_t func)
+{
+	process_float32_func = func;
+}
+
+lr4_multi_s16_func_t lr4_multi_get_s16_func(void)
+{
+	return process_s16_func;
+}
+
+void lr4_multi_set_s16_func(lr4_multi_s16_func_t func)
+{
+	process_s16_func = func;
 }
@@ -6,6 +6,8 @@
 #ifndef CROSSOVER_H_
 #define CROSSOVER_H_
 
+#include <pulse/sample.h>
+
 #include "biquad.h"
 /* An LR4 filter is two biquads with the same parameters connected in series:
  *
@@ -13,17 +15,46 @@
  *
  * Both biquad filter has the same parameter b[012] and a[12],
  * The variable [xyz][12] keep the history values.
+ *
+ * struct lr4_multi runs one such filter for each channel of interleaved
+ * audio. Every channel has its own parameters, and parameters and history
+ * are stored channel by channel so that the optimized implementations can
+ * advance several channels with one vector instruction.
  */
-struct lr4 {
-	struct biquad bq;
-	float x1, x2;
-	float y1, y2;
-	float z1, z2;
+#define LR4_MAX_CHANNELS PA_CHANNELS_MAX
+
+/* The history of all channels. It can be saved and restored on its own,
+ * e.g. to rewind the filter. */
+struct lr4_state {
+	float x1[LR4_MAX_CHANNELS], x2[LR4_MAX_CHANNELS];
+	float y1[LR4_MAX_CHANNELS], y2[LR4_MAX_CHANNELS];
+	float z1[LR4_MAX_CHANNELS], z2[LR4_MAX_CHANNELS];
 };
 
-void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq);
+struct lr4_multi {
+	int channels;
+	float b0[LR4_MAX_CHANNELS], b1[LR4_MAX_CHANNELS], b2[LR4_MAX_CHANNELS];
+	float a1[LR4_MAX_CHANNELS], a2[LR4_MAX_CHANNELS];
+	struct lr4_state state;
+};
+
+void lr4_multi_init(struct lr4_multi *lr4, int channels);
+/* Only changes the parameters of the channel, its history is kept. */
+void lr4_multi_set(struct lr4_multi *lr4, int channel, enum biquad_type type, float freq);
+void lr4_multi_reset(struct lr4_multi *lr4);
+void lr4_multi_save(const struct lr4_multi *lr4, struct lr4_state *state);
+void lr4_multi_restore(struct lr4_multi *lr4, const struct lr4_state *state);
+
+/* src and dest may be the same buffer */
+void lr4_multi_process_float32(struct lr4_multi *lr4, int frames, const float *src, float *dest);
+void lr4_multi_process_s16(struct lr4_multi *lr4, int frames, const short *src, short *dest);
+
+typedef void (*lr4_multi_float32_func_t)(struct lr4_multi *lr4, int frames, const float *src, float *dest);
+typedef void (*lr4_multi_s16_func_t)(struct lr4_multi *lr4, int frames, const short *src, short *dest);
 
-void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest);
-void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest);
+lr4_multi_float32_func_t lr4_multi_get_float32_func(void);
+void lr4_multi_set_float32_func(lr4_multi_float32_func_t func);
+lr4_multi_s16_func_t lr4_multi_get_s16_func(void);
+void lr4_multi_set_s16_func(lr4_multi_s16_func_t func);
 
 #endif /* CROSSOVER_H_ */
@@ -0,0 +1,170 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "crossover.h"
+
+#include <immintrin.h>
+
+/* The filters of up to 8 channels are run side by side, one channel per
+ * lane. A frame is loaded with a masked load, so lanes past the last channel
+ * just filter zeros. */
+
+typedef struct lr4_lanes {
+    __m256 b0, b1, b2, a1, a2;
+    __m256 x1, x2, y1, y2, z1, z2;
+} lr4_lanes;
+
+static inline __m256i lane_mask(int n) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+static void lanes_load(lr4_lanes *l, const struct lr4_multi *lr4, int c) {
+    const struct lr4_state *s = &lr4->state;
+
+    l->b0 = _mm256_loadu_ps(lr4->b0 + c);
+    l->b1 = _mm256_loadu_ps(lr4->b1 + c);
+    l->b2 = _mm256_loadu_ps(lr4->b2 + c);
+    l->a1 = _mm256_loadu_ps(lr4->a1 + c);
+    l->a2 = _mm256_loadu_ps(lr4->a2 + c);
+    l->x1 = _mm256_loadu_ps(s->x1 + c);
+    l->x2 = _mm256_loadu_ps(s->x2 + c);
+    l->y1 = _mm256_loadu_ps(s->y1 + c);
+    l->y2 = _mm256_loadu_ps(s->y2 + c);
+    l->z1 = _mm256_loadu_ps(s->z1 + c);
+    l->z2 = _mm256_loadu_ps(s->z2 + c);
+}
+
+static void lanes_store(const lr4_lanes *l, struct lr4_multi *lr4, int c) {
+    struct lr4_state *s = &lr4->state;
+
+    _mm256_storeu_ps(s->x1 + c, l->x1);
+    _mm256_storeu_ps(s->x2 + c, l->x2);
+    _mm256_storeu_ps(s->y1 + c, l->y1);
+    _mm256_storeu_ps(s->y2 + c, l->y2);
+    _mm256_storeu_ps(s->z1 + c, l->z1);
+    _mm256_storeu_ps(s->z2 + c, l->z2);
+}
+
+/* Same order of operations as the generic version */
+static inline __m256 biquad(const lr4_lanes *l, __m256 x, __m256 x1, __m256 x2, __m256 y1, __m256 y2) {
+    __m256 t;
+
+    t = _mm256_add_ps(_mm256_mul_ps(l->b0, x), _mm256_mul_ps(l->b1, x1));
+    t = _mm256_add_ps(t, _mm256_mul_ps(l->b2, x2));
+    t = _mm256_sub_ps(t, _mm256_mul_ps(l->a1, y1));
+    return _mm256_sub_ps(t, _mm256_mul_ps(l->a2, y2));
+}
+
+static inline __m256 lanes_run(lr4_lanes *l, __m256 x) {
+    __m256 y, z;
+
+    y = biquad(l, x, l->x1, l->x2, l->y1, l->y2);
+    z = biquad(l, y, l->y1, l->y2, l->z1, l->z2);
+    l->x2 = l->x1;
+    l->x1 = x;
+    l->y2 = l->y1;
+    l->y1 = y;
+    l->z2 = l->z1;
+    l->z1 = z;
+
+    return z;
+}
+
+static void lr4_multi_process_float32_avx2(struct lr4_multi *lr4, int frames, const float *src, float *dest) {
+    int c, i, channels = lr4->channels;
+
+    if (frames <= 0)
+        return;
+
+    for (c = 0; c < channels; c += 8) {
+        const __m256i mask = lane_mask(channels - c);
+        const float *s = src + c;
+        float *d = dest + c;
+        lr4_lanes l;
+        __m256 x, x1;
+
+        lanes_load(&l, lr4, c);
+
+        /* When filtering in place, a masked store stalls the masked loads
+         * after it that touch the same 32 bytes, which are the next two
+         * frames with three or more channels. So those are loaded early. */
+        x = _mm256_maskload_ps(s, mask);
+        x1 = frames > 1 ? _mm256_maskload_ps(s + channels, mask) : x;
+
+        for (i = 0; i < frames; i++, s += channels, d += channels) {
+            __m256 x2 = i + 2 < frames ? _mm256_maskload_ps(s + 2 * channels, mask) : x1;
+
+            _mm256_maskstore_ps(d, mask, lanes_run(&l, x));
+            x = x1;
+            x1 = x2;
+        }
+
+        lanes_store(&l, lr4, c);
+    }
+}
+
+/* s16 is converted to float a block at a time, the conversions then work
+ * on whole vectors of samples */
+#define S16_BLOCK_SAMPLES 2048
+
+static void lr4_multi_process_s16_avx2(struct lr4_multi *lr4, int frames, const short *src, short *dest) {
+    float buf[S16_BLOCK_SAMPLES];
+    int channels = lr4->channels;
+    int block = S16_BLOCK_SAMPLES / channels;
+
+    while (frames > 0) {
+        int i, n = PA_MIN(frames, block) * channels;
+
+        for (i = 0; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i)));
+            _mm256_storeu_ps(buf + i, _mm256_cvtepi32_ps(x));
+        }
+        for (; i < n; i++)
+            buf[i] = src[i];
+
+        lr4_multi_process_float32_avx2(lr4, n / channels, buf, buf);
+
+        /* Truncate like the generic version, the pack clamps */
+        for (i = 0; i + 8 <= n; i += 8) {
+            __m256i z = _mm256_cvttps_epi32(_mm256_loadu_ps(buf + i));
+            _mm_storeu_si128((__m128i *) (dest + i), _mm_packs_epi32(_mm256_castsi256_si128(z), _mm256_extracti128_si256(z, 1)));
+        }
+        for (; i < n; i++)
+            dest[i] = PA_CLAMP_UNLIKELY((int) buf[i], -0x8000, 0x7fff);
+
+        src += n;
+        dest += n;
+        frames -= n / channels;
+    }
+}
+
+void pa_lr4_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized LR4 filters.");
+
+        lr4_multi_set_float32_func(lr4_multi_process_float32_avx2);
+        lr4_multi_set_s16_func(lr4_multi_process_s16_avx2);
+    }
+}
@@ -0,0 +1,157 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "crossover.h"
+
+#include <arm_neon.h>
+
+/* The filters of up to 4 channels are run side by side, one channel per
+ * lane. Lanes past the last channel filter zeros. */
+
+typedef struct lr4_lanes {
+    float32x4_t b0, b1, b2, a1, a2;
+    float32x4_t x1, x2, y1, y2, z1, z2;
+} lr4_lanes;
+
+static void lanes_load(lr4_lanes *l, const struct lr4_multi *lr4, int c) {
+    const struct lr4_state *s = &lr4->state;
+
+    l->b0 = vld1q_f32(lr4->b0 + c);
+    l->b1 = vld1q_f32(lr4->b1 + c);
+    l->b2 = vld1q_f32(lr4->b2 + c);
+    l->a1 = vld1q_f32(lr4->a1 + c);
+    l->a2 = vld1q_f32(lr4->a2 + c);
+    l->x1 = vld1q_f32(s->x1 + c);
+    l->x2 = vld1q_f32(s->x2 + c);
+    l->y1 = vld1q_f32(s->y1 + c);
+    l->y2 = vld1q_f32(s->y2 + c);
+    l->z1 = vld1q_f32(s->z1 + c);
+    l->z2 = vld1q_f32(s->z2 + c);
+}
+
+static void lanes_store(const lr4_lanes *l, struct lr4_multi *lr4, int c) {
+    struct lr4_state *s = &lr4->state;
+
+    vst1q_f32(s->x1 + c, l->x1);
+    vst1q_f32(s->x2 + c, l->x2);
+    vst1q_f32(s->y1 + c, l->y1);
+    vst1q_f32(s->y2 + c, l->y2);
+    vst1q_f32(s->z1 + c, l->z1);
+    vst1q_f32(s->z2 + c, l->z2);
+}
+
+/* Separate multiplies and adds, in the order of the generic version */
+static inline float32x4_t biquad(const lr4_lanes *l, float32x4_t x, float32x4_t x1, float32x4_t x2, float32x4_t y1, float32x4_t y2) {
+    float32x4_t t;
+
+    t = vaddq_f32(vmulq_f32(l->b0, x), vmulq_f32(l->b1, x1));
+    t = vaddq_f32(t, vmulq_f32(l->b2, x2));
+    t = vsubq_f32(t, vmulq_f32(l->a1, y1));
+    return vsubq_f32(t, vmulq_f32(l->a2, y2));
+}
+
+static inline float32x4_t lanes_run(lr4_lanes *l, float32x4_t x) {
+    float32x4_t y, z;
+
+    y = biquad(l, x, l->x1, l->x2, l->y1, l->y2);
+    z = biquad(l, y, l->y1, l->y2, l->z1, l->z2);
+    l->x2 = l->x1;
+    l->x1 = x;
+    l->y2 = l->y1;
+    l->y1 = y;
+    l->z2 = l->z1;
+    l->z1 = z;
+
+    return z;
+}
+
+static void lr4_multi_process_float32_neon(struct lr4_multi *lr4, int frames, const float *src, float *dest) {
+    int c, i, k, channels = lr4->channels;
+
+    for (c = 0; c < channels; c += 4) {
+        const int n = PA_MIN(channels - c, 4);
+        const float *s = src + c;
+        float *d = dest + c;
+        lr4_lanes l;
+
+        lanes_load(&l, lr4, c);
+
+        if (n == 4) {
+            for (i = 0; i < frames; i++, s += channels, d += channels)
+                vst1q_f32(d, lanes_run(&l, vld1q_f32(s)));
+        } else {
+            for (i = 0; i < frames; i++, s += channels, d += channels) {
+                float t[4] = { 0 };
+
+                for (k = 0; k < n; k++)
+                    t[k] = s[k];
+
+                vst1q_f32(t, lanes_run(&l, vld1q_f32(t)));
+
+                for (k = 0; k < n; k++)
+                    d[k] = t[k];
+            }
+        }
+
+        lanes_store(&l, lr4, c);
+    }
+}
+
+static void lr4_multi_process_s16_neon(struct lr4_multi *lr4, int frames, const short *src, short *dest) {
+    int c, i, k, channels = lr4->channels;
+
+    for (c = 0; c < channels; c += 4) {
+        const int n = PA_MIN(channels - c, 4);
+        const short *s = src + c;
+        short *d = dest + c;
+        lr4_lanes l;
+
+        lanes_load(&l, lr4, c);
+
+        for (i = 0; i < frames; i++, s += channels, d += channels) {
+            int16_t t[4] = { 0 };
+            int32x4_t z;
+
+            for (k = 0; k < n; k++)
+                t[k] = s[k];
+
+            /* Truncate like the generic version, the narrowing clamps */
+            z = vcvtq_s32_f32(lanes_run(&l, vcvtq_f32_s32(vmovl_s16(vld1_s16(t)))));
+            vst1_s16(t, vqmovn_s32(z));
+
+            for (k = 0; k < n; k++)
+                d[k] = t[k];
+        }
+
+        lanes_store(&l, lr4, c);
+    }
+}
+
+void pa_lr4_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized LR4 filters.");
+
+    lr4_multi_set_float32_func(lr4_multi_process_float32_neon);
+    lr4_multi_set_s16_func(lr4_multi_process_s16_neon);
+}
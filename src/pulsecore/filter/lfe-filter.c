@@ -32,7 +32,7 @@ struct saved_state {
     PA_LLIST_FIELDS(struct saved_state);
     pa_memchunk chunk;
     int64_t index;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_state state;
 };
 
 PA_STATIC_FLIST_DECLARE(lfe_state, 0, pa_xfree);
@@ -53,7 +53,7 @@ struct pa_lfe_filter {
     pa_sample_spec ss;
     size_t maxrewind;
     bool active;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_multi lr4;
 };
 
 static void remove_state(pa_lfe_filter_t *f, struct saved_state *s) {
@@ -69,6 +69,7 @@ pa_lfe_filter_t * pa_lfe_filter_new(const pa_sample_spec* ss, const pa_channel_m
     f->cm = *cm;
     f->ss = *ss;
     f->maxrewind = maxrewind;
+    lr4_multi_init(&f->lr4, cm->channels);
     pa_lfe_filter_update_rate(f, ss->rate);
     return f;
 }
@@ -81,7 +82,11 @@ void pa_lfe_filter_free(pa_lfe_filter_t *f) {
 }
 
 void pa_lfe_filter_reset(pa_lfe_filter_t *f) {
-    pa_lfe_filter_update_rate(f, f->ss.rate);
+    while (f->saved)
+        remove_state(f, f->saved);
+
+    f->index = 0;
+    lr4_multi_reset(&f->lr4);
 }
 
 static void process_block(pa_lfe_filter_t *f, pa_memchunk *buf, bool store_result) {
@@ -90,17 +95,13 @@ static void process_block(pa_lfe_filter_t *f, pa_memchunk *buf, bool store_resul
     void *garbage = store_result ? NULL : pa_xmalloc(buf->length);
 
     if (f->ss.format == PA_SAMPLE_FLOAT32NE) {
-        int i;
         float *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_float32(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
+        lr4_multi_process_float32(&f->lr4, samples, data, garbage ? garbage : data);
         pa_memblock_release(buf->memblock);
     }
     else if (f->ss.format == PA_SAMPLE_S16NE) {
-        int i;
         short *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_s16(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
+        lr4_multi_process_s16(&f->lr4, samples, data, garbage ? garbage : data);
         pa_memblock_release(buf->memblock);
     }
     else pa_assert_not_reached();
@@ -138,21 +139,21 @@ pa_memchunk * pa_lfe_filter_process(pa_lfe_filter_t *f, pa_memchunk *buf) {
     pa_mempool_unref(pool), pool = NULL;
 
     s->index = f->index;
-    memcpy(s->lr4, f->lr4, sizeof(struct lr4) * f->cm.channels);
+    lr4_multi_save(&f->lr4, &s->state);
     PA_LLIST_PREPEND(struct saved_state, f->saved, s);
 
     process_block(f, buf, true);
     return buf;
 }
 
+/* Only the filter parameters change here. Rate updates happen all the time
+   when the stream is adjusted to a clock, so the history and the saved states
+   are kept: they stay good enough for the new parameters, while throwing them
+   away would make the filter start over and make the next rewind fail. */
 void pa_lfe_filter_update_rate(pa_lfe_filter_t *f, uint32_t new_rate) {
     int i;
     float biquad_freq = f->crossover / (new_rate / 2);
 
-    while (f->saved)
-        remove_state(f, f->saved);
-
-    f->index = 0;
     f->ss.rate = new_rate;
     if (biquad_freq <= 0 || biquad_freq >= 1) {
         pa_log_warn("Crossover frequency (%f) outside range for sample rate %d", f->crossover, new_rate);
@@ -160,32 +161,39 @@ void pa_lfe_filter_update_rate(pa_lfe_filter_t *f, uint32_t new_rate) {
         return;
     }
 
+    /* The history is stale if we have been inactive */
+    if (!f->active)
+        pa_lfe_filter_reset(f);
+
     for (i = 0; i < f->cm.channels; i++)
-        lr4_set(&f->lr4[i], f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
+        lr4_multi_set(&f->lr4, i, f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
 
     f->active = true;
 }
 
 void pa_lfe_filter_rewind(pa_lfe_filter_t *f, size_t amount) {
-    struct saved_state *i, *s = NULL;
+    struct saved_state *i, *i2, *s = NULL;
     size_t samples = amount / pa_frame_size(&f->ss);
     f->index -= samples;
 
-    /* Find the closest saved position */
-    PA_LLIST_FOREACH(i, f->saved) {
-        if (i->index > f->index)
+    /* Find the closest saved position. States past it are for audio that
+       is going to be rewritten. */
+    PA_LLIST_FOREACH_SAFE(i, i2, f->saved) {
+        if (i->index > f->index) {
+            remove_state(f, i);
             continue;
+        }
         if (s == NULL || i->index > s->index)
             s = i;
     }
     if (s == NULL) {
         pa_log_debug("Rewinding LFE filter %zu samples to position %lli. No saved state found", samples, (long long) f->index);
-        pa_lfe_filter_update_rate(f, f->ss.rate);
+        pa_lfe_filter_reset(f);
         return;
     }
     pa_log_debug("Rewinding LFE filter %zu samples to position %lli. Found saved state at position %lli",
         samples, (long long) f->index, (long long) s->index);
-    memcpy(f->lr4, s->lr4, sizeof(struct lr4) * f->cm.channels);
+    lr4_multi_restore(&f->lr4, &s->state);
 
     /* now fast forward to the actual position */
     if (f->index > s->index) {
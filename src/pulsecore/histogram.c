@@ -0,0 +1,71 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "histogram.h"
+
+void pa_histogram_reset(pa_histogram *h) {
+    pa_assert(h);
+
+    pa_zero(*h);
+}
+
+uint64_t pa_histogram_bucket_upper_bound(unsigned i) {
+    unsigned shift;
+    uint64_t top;
+
+    pa_assert(i < PA_HISTOGRAM_N_BUCKETS);
+
+    if (i < PA_HISTOGRAM_SUB_BUCKETS)
+        return i;
+
+    i -= PA_HISTOGRAM_SUB_BUCKETS;
+    shift = i / (PA_HISTOGRAM_SUB_BUCKETS / 2) + 1;
+    top = i % (PA_HISTOGRAM_SUB_BUCKETS / 2) + PA_HISTOGRAM_SUB_BUCKETS / 2;
+
+    /* For the very last bucket this wraps around to UINT64_MAX */
+    return ((top + 1) << shift) - 1;
+}
+
+uint64_t pa_histogram_quantile(const pa_histogram *h, double q) {
+    uint64_t n, seen = 0;
+    unsigned i;
+
+    pa_assert(h);
+    pa_assert(q >= 0.0 && q <= 1.0);
+
+    if (h->count == 0)
+        return 0;
+
+    n = (uint64_t) (q * (double) h->count + 0.5);
+    if (n < 1)
+        n = 1;
+
+    for (i = 0; i < PA_HISTOGRAM_N_BUCKETS; i++) {
+        seen += h->buckets[i];
+
+        if (seen >= n)
+            return PA_MIN(pa_histogram_bucket_upper_bound(i), h->max);
+    }
+
+    return h->max;
+}
@@ -0,0 +1,85 @@
+#ifndef foopulsecorehistogramhfoo
+#define foopulsecorehistogramhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+/* A fixed size histogram of 64 bit values, cheap enough to be updated from
+ * the IO threads on every cycle. Values below PA_HISTOGRAM_SUB_BUCKETS get a
+ * bucket of their own, above that every power of two is split into
+ * PA_HISTOGRAM_SUB_BUCKETS / 2 buckets, so the relative error of any
+ * value is below 2 / PA_HISTOGRAM_SUB_BUCKETS. No locking is done, a
+ * histogram may only be updated by one thread. */
+
+#define PA_HISTOGRAM_SUB_BITS 4
+#define PA_HISTOGRAM_SUB_BUCKETS (1U << PA_HISTOGRAM_SUB_BITS)
+#define PA_HISTOGRAM_N_BUCKETS (PA_HISTOGRAM_SUB_BUCKETS + (64 - PA_HISTOGRAM_SUB_BITS) * (PA_HISTOGRAM_SUB_BUCKETS / 2))
+
+typedef struct pa_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[PA_HISTOGRAM_N_BUCKETS];
+} pa_histogram;
+
+void pa_histogram_reset(pa_histogram *h);
+
+/* Returns the largest value that is counted in bucket i */
+uint64_t pa_histogram_bucket_upper_bound(unsigned i);
+
+/* Returns the smallest value v for which at least the fraction q of all
+ * values is <= v, rounded up to the bucket upper bound. */
+uint64_t pa_histogram_quantile(const pa_histogram *h, double q);
+
+/* A snapshot of the timing statistics of the IO thread of a sink or
+ * source, see pa_sink_get_timing() and pa_source_get_timing() */
+typedef struct pa_io_timing {
+    pa_histogram process_usec;
+    pa_histogram resample_usec;
+    pa_histogram wakeup_lateness_usec;
+    pa_histogram rewind_bytes;
+} pa_io_timing;
+
+static inline unsigned pa_histogram_bucket_index(uint64_t v) {
+    unsigned m, shift;
+
+    if (v < PA_HISTOGRAM_SUB_BUCKETS)
+        return (unsigned) v;
+
+    /* Index of the most significant bit, >= PA_HISTOGRAM_SUB_BITS here */
+    m = 63 - (unsigned) __builtin_clzll(v);
+    shift = m - PA_HISTOGRAM_SUB_BITS + 1;
+
+    return PA_HISTOGRAM_SUB_BUCKETS + (m - PA_HISTOGRAM_SUB_BITS) * (PA_HISTOGRAM_SUB_BUCKETS / 2) +
+        (unsigned) (v >> shift) - PA_HISTOGRAM_SUB_BUCKETS / 2;
+}
+
+static inline void pa_histogram_add(pa_histogram *h, uint64_t v) {
+    if (h->count == 0 || v < h->min)
+        h->min = v;
+    if (v > h->max)
+        h->max = v;
+
+    h->count++;
+    h->sum += v;
+    h->buckets[pa_histogram_bucket_index(v)]++;
+}
+
+#endif
@@ -47,6 +47,7 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/memtrap.h>
+#include <pulsecore/trace.h>
 
 #include "memblock.h"
 
@@ -57,10 +58,15 @@
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
-#define PA_MEMEXPORT_SLOTS_MAX 128
+/* The export slot table grows by this many slots at a time. Each chunk
+ * of slots gets its own range of block ids, so that ids stay unique
+ * across all memexports of the process. */
+#define PA_MEMEXPORT_SLOTS_CHUNK 128
 
-#define PA_MEMIMPORT_SLOTS_MAX 160
-#define PA_MEMIMPORT_SEGMENTS_MAX 16
+/* The import tables grow as needed, these only limit how much a peer
+ * can make us import */
+#define PA_MEMIMPORT_SLOTS_MAX (64*1024)
+#define PA_MEMIMPORT_SEGMENTS_MAX 64
 
 struct pa_memblock {
     PA_REFCNT_DECLARE; /* the reference counter */
@@ -141,18 +147,20 @@ struct pa_memimport {
 struct memexport_slot {
     PA_LLIST_FIELDS(struct memexport_slot);
     pa_memblock *block;
+    uint32_t id;
 };
 
 struct pa_memexport {
     pa_mutex *mutex;
     pa_mempool *pool;
 
-    struct memexport_slot slots[PA_MEMEXPORT_SLOTS_MAX];
+    /* Arrays of PA_MEMEXPORT_SLOTS_CHUNK slots, indexed by block id /
+     * PA_MEMEXPORT_SLOTS_CHUNK */
+    pa_hashmap *chunks;
 
     PA_LLIST_HEAD(struct memexport_slot, free_slots);
     PA_LLIST_HEAD(struct memexport_slot, used_slots);
-    unsigned n_init;
-    unsigned baseidx;
+    unsigned n_slots, max_slots;
 
     /* Called whenever a client from which we imported a memory block
        which we in turn exported to another client dies and we need to
@@ -212,6 +220,8 @@ static void stat_add(pa_memblock*b) {
     pa_assert(b);
     pa_assert(b->pool);
 
+    PA_TRACE3(memblock_alloc, b, b->length, b->type);
+
     pa_atomic_inc(&b->pool->stat.n_allocated);
     pa_atomic_add(&b->pool->stat.allocated_size, (int) b->length);
 
@@ -232,6 +242,8 @@ static void stat_remove(pa_memblock *b) {
     pa_assert(b);
     pa_assert(b->pool);
 
+    PA_TRACE2(memblock_free, b, b->length);
+
     pa_assert(pa_atomic_load(&b->pool->stat.n_allocated) > 0);
     pa_assert(pa_atomic_load(&b->pool->stat.allocated_size) >= (int) b->length);
 
@@ -824,8 +836,11 @@ static void memblock_replace_import(pa_memblock *b) {
  * for the pool's fd to be always open :-(
  *
  * TODO-1: Transform the global core mempool to a per-client one
- * TODO-2: Remove global mempools support */
-pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
+ * TODO-2: Remove global mempools support
+ *
+ *@hugepages: Back the pool with huge pages if possible, which saves
+ * TLB misses when mixing streams scattered all over the pool. */
+pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client, bool hugepages) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
 
@@ -845,7 +860,7 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
             p->n_blocks = 2;
     }
 
-    if (pa_shm_create_rw(&p->memory, type, p->n_blocks * p->block_size, 0700) < 0) {
+    if (pa_shm_create_rw(&p->memory, type, p->n_blocks * p->block_size, 0700, hugepages) < 0) {
         pa_xfree(p);
         return NULL;
     }
@@ -946,6 +961,14 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
     return &p->stat;
 }
 
+/* No lock necessary */
+void pa_mempool_stat_add_export_copy(pa_mempool *p, size_t length) {
+    pa_assert(p);
+
+    pa_atomic_inc(&p->stat.n_exported_by_copy);
+    pa_atomic_add(&p->stat.exported_by_copy_size, (int) length);
+}
+
 /* No lock necessary */
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
@@ -1312,12 +1335,12 @@ finish:
     return ret;
 }
 
+static pa_atomic_t export_baseidx = PA_ATOMIC_INIT(0);
+
 /* For sending blocks to other nodes */
 pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void *userdata) {
     pa_memexport *e;
 
-    static pa_atomic_t export_baseidx = PA_ATOMIC_INIT(0);
-
     pa_assert(p);
     pa_assert(cb);
 
@@ -1328,27 +1351,70 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     e->mutex = pa_mutex_new(true, true);
     e->pool = p;
     pa_mempool_ref(e->pool);
+    e->chunks = pa_hashmap_new_full(NULL, NULL, NULL, pa_xfree);
     PA_LLIST_HEAD_INIT(struct memexport_slot, e->free_slots);
     PA_LLIST_HEAD_INIT(struct memexport_slot, e->used_slots);
-    e->n_init = 0;
+    e->n_slots = 0;
+    e->max_slots = PA_MEMEXPORT_SLOTS_DEFAULT;
     e->revoke_cb = cb;
     e->userdata = userdata;
 
     pa_mutex_lock(p->mutex);
-
     PA_LLIST_PREPEND(pa_memexport, p->exports, e);
-    e->baseidx = (uint32_t) pa_atomic_add(&export_baseidx, PA_MEMEXPORT_SLOTS_MAX);
-
     pa_mutex_unlock(p->mutex);
+
     return e;
 }
 
+void pa_memexport_set_max_slots(pa_memexport *e, unsigned n) {
+    pa_assert(e);
+    pa_assert(n >= PA_MEMEXPORT_SLOTS_DEFAULT && n <= PA_MEMEXPORT_SLOTS_MAX);
+
+    pa_mutex_lock(e->mutex);
+    e->max_slots = PA_MAX(n, e->n_slots);
+    pa_mutex_unlock(e->mutex);
+}
+
+/* Should be called locked. Adds a chunk of free slots with a fresh range of
+ * block ids. */
+static int memexport_grow(pa_memexport *e) {
+    struct memexport_slot *chunk;
+    uint32_t baseidx;
+    unsigned i;
+
+    if (e->n_slots >= e->max_slots)
+        return -1;
+
+    baseidx = (uint32_t) pa_atomic_add(&export_baseidx, PA_MEMEXPORT_SLOTS_CHUNK);
+    chunk = pa_xnew0(struct memexport_slot, PA_MEMEXPORT_SLOTS_CHUNK);
+
+    for (i = PA_MEMEXPORT_SLOTS_CHUNK; i > 0; i--) {
+        chunk[i - 1].id = baseidx + i - 1;
+        PA_LLIST_PREPEND(struct memexport_slot, e->free_slots, &chunk[i - 1]);
+    }
+
+    pa_assert_se(pa_hashmap_put(e->chunks, PA_UINT32_TO_PTR(baseidx / PA_MEMEXPORT_SLOTS_CHUNK), chunk) == 0);
+    e->n_slots += PA_MEMEXPORT_SLOTS_CHUNK;
+
+    return 0;
+}
+
+/* Should be called locked */
+static struct memexport_slot *memexport_get_slot(pa_memexport *e, uint32_t id) {
+    struct memexport_slot *chunk;
+
+    if (!(chunk = pa_hashmap_get(e->chunks, PA_UINT32_TO_PTR(id / PA_MEMEXPORT_SLOTS_CHUNK))))
+        return NULL;
+
+    return &chunk[id % PA_MEMEXPORT_SLOTS_CHUNK];
+}
+
 void pa_memexport_free(pa_memexport *e) {
     pa_assert(e);
 
     pa_mutex_lock(e->mutex);
     while (e->used_slots)
-        pa_memexport_process_release(e, (uint32_t) (e->used_slots - e->slots + e->baseidx));
+        pa_memexport_process_release(e, e->used_slots->id);
     pa_mutex_unlock(e->mutex);
 
     pa_mutex_lock(e->pool->mutex);
@@ -1356,33 +1422,31 @@ void pa_memexport_free(pa_memexport *e) {
     pa_mutex_unlock(e->pool->mutex);
 
     pa_mempool_unref(e->pool);
+    pa_hashmap_free(e->chunks);
     pa_mutex_free(e->mutex);
     pa_xfree(e);
 }
 
 /* Self-locked */
 int pa_memexport_process_release(pa_memexport *e, uint32_t id) {
+    struct memexport_slot *slot;
     pa_memblock *b;
 
     pa_assert(e);
 
     pa_mutex_lock(e->mutex);
 
-    if (id < e->baseidx)
-        goto fail;
-    id -= e->baseidx;
-
-    if (id >= e->n_init)
+    if (!(slot = memexport_get_slot(e, id)))
         goto fail;
 
-    if (!e->slots[id].block)
+    if (!slot->block)
         goto fail;
 
-    b = e->slots[id].block;
-    e->slots[id].block = NULL;
+    b = slot->block;
+    slot->block = NULL;
 
-    PA_LLIST_REMOVE(struct memexport_slot, e->used_slots, &e->slots[id]);
-    PA_LLIST_PREPEND(struct memexport_slot, e->free_slots, &e->slots[id]);
+    PA_LLIST_REMOVE(struct memexport_slot, e->used_slots, slot);
+    PA_LLIST_PREPEND(struct memexport_slot, e->free_slots, slot);
 
     pa_mutex_unlock(e->mutex);
 
@@ -1420,7 +1484,7 @@ static void memexport_revoke_blocks(pa_memexport *e, pa_memimport *i) {
             slot->block->per_type.imported.segment->import != i)
             continue;
 
-        idx = (uint32_t) (slot - e->slots + e->baseidx);
+        idx = slot->id;
         e->revoke_cb(e, idx, e->userdata);
         pa_memexport_process_release(e, idx);
     }
@@ -1470,20 +1534,18 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint3
 
     pa_mutex_lock(e->mutex);
 
-    if (e->free_slots) {
-        slot = e->free_slots;
-        PA_LLIST_REMOVE(struct memexport_slot, e->free_slots, slot);
-    } else if (e->n_init < PA_MEMEXPORT_SLOTS_MAX)
-        slot = &e->slots[e->n_init++];
-    else {
+    if (!e->free_slots && memexport_grow(e) < 0) {
         pa_mutex_unlock(e->mutex);
         pa_memblock_unref(b);
         return -1;
     }
 
+    slot = e->free_slots;
+    PA_LLIST_REMOVE(struct memexport_slot, e->free_slots, slot);
+
     PA_LLIST_PREPEND(struct memexport_slot, e->used_slots, slot);
     slot->block = b;
-    *block_id = (uint32_t) (slot - e->slots + e->baseidx);
+    *block_id = slot->id;
 
     pa_mutex_unlock(e->mutex);
 /*     pa_log("Got block id %u", *block_id); */
@@ -74,6 +74,11 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Blocks that were sent to another process by copy because they
+     * could not be exported */
+    pa_atomic_t n_exported_by_copy;
+    pa_atomic_t exported_by_copy_size;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
 };
@@ -124,7 +129,7 @@ pa_mempool * pa_memblock_get_pool(pa_memblock *b);
 pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
 /* The memory block manager */
-pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client);
+pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client, bool hugepages);
 void pa_mempool_unref(pa_mempool *p);
 pa_mempool* pa_mempool_ref(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
@@ -149,11 +154,22 @@ pa_memblock* pa_memimport_get(pa_memimport *i, pa_mem_type_t type, uint32_t bloc
                               uint32_t shm_id, size_t offset, size_t size, bool writable);
 int pa_memimport_process_revoke(pa_memimport *i, uint32_t block_id);
 
+/* How many blocks a memexport can have in flight. Peers before protocol
+ * version 33 import no more than 160 blocks at a time, so more than the
+ * default must only be allowed once the peer is known to be newer. */
+#define PA_MEMEXPORT_SLOTS_DEFAULT 128
+#define PA_MEMEXPORT_SLOTS_MAX (64*1024)
+
 /* For sending blocks to other nodes */
 pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void *userdata);
 void pa_memexport_free(pa_memexport *e);
+void pa_memexport_set_max_slots(pa_memexport *e, unsigned n);
 int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint32_t *block_id,
                      uint32_t *shm_id, size_t *offset, size_t * size);
 int pa_memexport_process_release(pa_memexport *e, uint32_t id);
 
+/* Accounts for a block of the given length that was sent by copy
+ * instead, for example because pa_memexport_put() failed */
+void pa_mempool_stat_add_export_copy(pa_mempool *p, size_t length);
+
 #endif
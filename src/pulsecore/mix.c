@@ -724,3 +724,50 @@ void pa_volume_memchunk(
 
     pa_memblock_release(c->memblock);
 }
+
+void pa_volume_memchunk_ramp(
+        pa_memchunk*c,
+        const pa_sample_spec *spec,
+        const pa_cvolume *start,
+        const pa_cvolume *end) {
+
+    void *ptr;
+    float linear_start[PA_CHANNELS_MAX], linear_step[PA_CHANNELS_MAX];
+    pa_do_volume_ramp_func_t do_volume_ramp;
+    size_t n_frames;
+    unsigned channel;
+
+    pa_assert(c);
+    pa_assert(spec);
+    pa_assert(pa_sample_spec_valid(spec));
+    pa_assert(pa_frame_aligned(c->length, spec));
+    pa_assert(start);
+    pa_assert(end);
+    pa_assert(start->channels == spec->channels);
+    pa_assert(end->channels == spec->channels);
+
+    if (pa_memblock_is_silence(c->memblock))
+        return;
+
+    /* Formats without a ramp function get the target volume right away */
+    if (pa_cvolume_equal(start, end) || !(do_volume_ramp = pa_get_volume_ramp_func(spec->format))) {
+        pa_volume_memchunk(c, spec, end);
+        return;
+    }
+
+    n_frames = c->length / pa_frame_size(spec);
+
+    for (channel = 0; channel < spec->channels; channel++) {
+        double a = pa_sw_volume_to_linear(start->values[channel]);
+        double b = pa_sw_volume_to_linear(end->values[channel]);
+
+        linear_start[channel] = (float) a;
+        linear_step[channel] = (float) ((b - a) / n_frames);
+    }
+
+    ptr = pa_memblock_acquire_chunk(c);
+
+    do_volume_ramp(ptr, linear_start, linear_step, spec->channels, c->length);
+
+    pa_memblock_release(c->memblock);
+}
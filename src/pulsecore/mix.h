@@ -59,4 +59,12 @@ void pa_volume_memchunk(
     const pa_sample_spec *spec,
     const pa_cvolume *volume);
 
+/* Like pa_volume_memchunk(), but fades linearly from start at the first
+ * frame to end after the last one */
+void pa_volume_memchunk_ramp(
+    pa_memchunk*c,
+    const pa_sample_spec *spec,
+    const pa_cvolume *start,
+    const pa_cvolume *end);
+
 #endif
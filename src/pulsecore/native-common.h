@@ -187,6 +187,11 @@ enum {
      * BOTH DIRECTIONS */
     PA_COMMAND_REGISTER_MEMFD_SHMID,
 
+    /* Supported since protocol v32 (10.0) */
+    PA_COMMAND_GET_SINK_TIMING_INFO_LIST,
+    PA_COMMAND_GET_SOURCE_TIMING_INFO_LIST,
+    PA_COMMAND_GET_SNAPSHOT,
+
     PA_COMMAND_MAX
 };
 
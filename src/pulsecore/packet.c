@@ -34,7 +34,7 @@
 
 struct pa_packet {
     PA_REFCNT_DECLARE;
-    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
+    enum { PA_PACKET_APPENDED, PA_PACKET_POOLED, PA_PACKET_DYNAMIC } type;
     size_t length;
     uint8_t *data;
     union {
@@ -44,6 +44,9 @@ struct pa_packet {
 
 PA_STATIC_FLIST_DECLARE(packets, 0, pa_xfree);
 
+/* Buffers of PA_PACKET_POOL_SIZE bytes */
+PA_STATIC_FLIST_DECLARE(buffers, 64, pa_xfree);
+
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
 
@@ -53,9 +56,13 @@ pa_packet* pa_packet_new(size_t length) {
         p = pa_xnew(pa_packet, 1);
     PA_REFCNT_INIT(p);
     p->length = length;
-    if (length > MAX_APPENDED_SIZE) {
+    if (length > PA_PACKET_POOL_SIZE) {
         p->data = pa_xmalloc(length);
         p->type = PA_PACKET_DYNAMIC;
+    } else if (length > MAX_APPENDED_SIZE) {
+        if (!(p->data = pa_flist_pop(PA_STATIC_FLIST_GET(buffers))))
+            p->data = pa_xmalloc(PA_PACKET_POOL_SIZE);
+        p->type = PA_PACKET_POOLED;
     } else {
         p->data = p->per_type.appended;
         p->type = PA_PACKET_APPENDED;
@@ -101,6 +108,14 @@ const void* pa_packet_data(pa_packet *p, size_t *l) {
     return p->data;
 }
 
+void pa_packet_set_length(pa_packet *p, size_t length) {
+    pa_assert(PA_REFCNT_VALUE(p) == 1);
+    pa_assert(length > 0);
+    pa_assert(length <= p->length);
+
+    p->length = length;
+}
+
 pa_packet* pa_packet_ref(pa_packet *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
@@ -116,6 +131,10 @@ void pa_packet_unref(pa_packet *p) {
     if (PA_REFCNT_DEC(p) <= 0) {
         if (p->type == PA_PACKET_DYNAMIC)
             pa_xfree(p->data);
+        else if (p->type == PA_PACKET_POOLED) {
+            if (pa_flist_push(PA_STATIC_FLIST_GET(buffers), p->data) < 0)
+                pa_xfree(p->data);
+        }
         if (pa_flist_push(PA_STATIC_FLIST_GET(packets), p) < 0)
             pa_xfree(p);
     }
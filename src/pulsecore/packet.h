@@ -25,8 +25,12 @@
 
 typedef struct pa_packet pa_packet;
 
-/* create empty packet (either of type appended or dynamic depending
- * on length) */
+/* Packets up to this length get their data from a pool of buffers instead
+ * of from malloc() */
+#define PA_PACKET_POOL_SIZE (8*1024)
+
+/* create empty packet (either of type appended, pooled or dynamic
+ * depending on length) */
 pa_packet* pa_packet_new(size_t length);
 
 /* create packet (either of type appended or dynamic depending on length)
@@ -39,6 +43,10 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
 const void* pa_packet_data(pa_packet *p, size_t *l);
 
+/* Cut off the end of a packet that has not been shared yet, e.g. when
+ * less data was written into it than it was created for */
+void pa_packet_set_length(pa_packet *p, size_t length);
+
 pa_packet* pa_packet_ref(pa_packet *p);
 void pa_packet_unref(pa_packet *p);
 
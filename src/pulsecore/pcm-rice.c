@@ -0,0 +1,528 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/macro.h>
+
+#include "pcm-rice.h"
+
+#define HEADER_SIZE 6
+
+/* Residuals whose Rice quotient reaches this are stored as they are, after
+ * as many one bits */
+#define ESCAPE 24
+
+#define ORDER_VERBATIM 3
+
+struct pa_pcm_rice_decoder {
+    pa_mempool *mempool;
+    pa_sample_spec sample_spec;
+    unsigned bits;
+
+    /* Pushed data that is not decoded yet starts at index */
+    uint8_t *buffer;
+    size_t index, length, allocated;
+};
+
+struct bit_writer {
+    uint8_t *p;
+    uint64_t acc;
+    unsigned n;
+};
+
+struct bit_reader {
+    const uint8_t *data;
+    size_t pos, size;
+    uint64_t acc;
+    unsigned n;
+};
+
+static unsigned sample_bits(pa_sample_format_t format) {
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+        case PA_SAMPLE_S16BE:
+            return 16;
+
+        case PA_SAMPLE_S24LE:
+        case PA_SAMPLE_S24BE:
+            return 24;
+
+        case PA_SAMPLE_S32LE:
+        case PA_SAMPLE_S32BE:
+        case PA_SAMPLE_S24_32LE:
+        case PA_SAMPLE_S24_32BE:
+        case PA_SAMPLE_FLOAT32LE:
+        case PA_SAMPLE_FLOAT32BE:
+            return 32;
+
+        default:
+            return 0;
+    }
+}
+
+/* Reads the samples of one channel, floating point ones by their bit
+ * patterns */
+static void read_channel(pa_sample_format_t format, const uint8_t *src, size_t stride, unsigned n, int32_t *x) {
+    unsigned i;
+
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+            for (i = 0; i < n; i++, src += stride)
+                x[i] = PA_INT16_FROM_LE(*(const int16_t*) src);
+            break;
+
+        case PA_SAMPLE_S16BE:
+            for (i = 0; i < n; i++, src += stride)
+                x[i] = PA_INT16_FROM_BE(*(const int16_t*) src);
+            break;
+
+        case PA_SAMPLE_S24LE:
+            for (i = 0; i < n; i++, src += stride)
+                x[i] = (int32_t) (PA_READ24LE(src) << 8) >> 8;
+            break;
+
+        case PA_SAMPLE_S24BE:
+            for (i = 0; i < n; i++, src += stride)
+                x[i] = (int32_t) (PA_READ24BE(src) << 8) >> 8;
+            break;
+
+        case PA_SAMPLE_S32LE:
+        case PA_SAMPLE_S24_32LE:
+        case PA_SAMPLE_FLOAT32LE:
+            for (i = 0; i < n; i++, src += stride)
+                x[i] = (int32_t) PA_UINT32_FROM_LE(*(const uint32_t*) src);
+            break;
+
+        case PA_SAMPLE_S32BE:
+        case PA_SAMPLE_S24_32BE:
+        case PA_SAMPLE_FLOAT32BE:
+            for (i = 0; i < n; i++, src += stride)
+                x[i] = (int32_t) PA_UINT32_FROM_BE(*(const uint32_t*) src);
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void write_channel(pa_sample_format_t format, uint8_t *dst, size_t stride, unsigned n, const int32_t *x) {
+    unsigned i;
+
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+            for (i = 0; i < n; i++, dst += stride)
+                *(int16_t*) dst = PA_INT16_TO_LE((int16_t) x[i]);
+            break;
+
+        case PA_SAMPLE_S16BE:
+            for (i = 0; i < n; i++, dst += stride)
+                *(int16_t*) dst = PA_INT16_TO_BE((int16_t) x[i]);
+            break;
+
+        case PA_SAMPLE_S24LE:
+            for (i = 0; i < n; i++, dst += stride)
+                PA_WRITE24LE(dst, (uint32_t) x[i]);
+            break;
+
+        case PA_SAMPLE_S24BE:
+            for (i = 0; i < n; i++, dst += stride)
+                PA_WRITE24BE(dst, (uint32_t) x[i]);
+            break;
+
+        case PA_SAMPLE_S32LE:
+        case PA_SAMPLE_S24_32LE:
+        case PA_SAMPLE_FLOAT32LE:
+            for (i = 0; i < n; i++, dst += stride)
+                *(uint32_t*) dst = PA_UINT32_TO_LE((uint32_t) x[i]);
+            break;
+
+        case PA_SAMPLE_S32BE:
+        case PA_SAMPLE_S24_32BE:
+        case PA_SAMPLE_FLOAT32BE:
+            for (i = 0; i < n; i++, dst += stride)
+                *(uint32_t*) dst = PA_UINT32_TO_BE((uint32_t) x[i]);
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+/* Cuts v down to a signed value of the given width. All arithmetic on
+ * samples wraps around like this, so nothing is lost even where the
+ * prediction overflows. */
+static inline int32_t wrap(int64_t v, unsigned bits) {
+    return (int32_t) ((uint32_t) v << (32 - bits)) >> (32 - bits);
+}
+
+static inline uint32_t zigzag(int32_t r) {
+    return ((uint32_t) r << 1) ^ (uint32_t) (r >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u) {
+    return (int32_t) (u >> 1) ^ -(int32_t) (u & 1);
+}
+
+static inline int32_t predict(const int32_t *x, unsigned i, unsigned order) {
+    int64_t p1 = i > 0 ? x[i - 1] : 0, p2 = i > 1 ? x[i - 2] : 0;
+
+    switch (order) {
+        case 0:
+            return 0;
+        case 1:
+            return (int32_t) p1;
+        default:
+            return (int32_t) (2 * p1 - p2);
+    }
+}
+
+static inline void put_bits(struct bit_writer *w, uint32_t v, unsigned bits) {
+    w->acc = (w->acc << bits) | (v & (uint32_t) ((UINT64_C(1) << bits) - 1));
+    w->n += bits;
+
+    while (w->n >= 8) {
+        w->n -= 8;
+        *(w->p++) = (uint8_t) (w->acc >> w->n);
+    }
+}
+
+static void flush_bits(struct bit_writer *w) {
+    if (w->n > 0)
+        *(w->p++) = (uint8_t) (w->acc << (8 - w->n));
+
+    w->n = 0;
+}
+
+/* Reads zeros past the end, which the caller detects from pos */
+static inline uint32_t get_bits(struct bit_reader *r, unsigned bits) {
+    while (r->n < bits) {
+        r->acc = (r->acc << 8) | (r->pos < r->size ? r->data[r->pos] : 0);
+        r->pos++;
+        r->n += 8;
+    }
+
+    r->n -= bits;
+    return (uint32_t) (r->acc >> r->n) & (uint32_t) ((UINT64_C(1) << bits) - 1);
+}
+
+/* Writes the bit stream of one channel and returns its mode byte */
+static uint8_t encode_channel(struct bit_writer *w, const int32_t *x, uint32_t *u, unsigned n, unsigned bits) {
+    uint64_t sum[3] = { 0, 0, 0 }, mean, cost, best_cost;
+    unsigned i, order, k, k_guess, best_k = 0;
+
+    for (i = 0; i < n; i++) {
+        int64_t p1 = i > 0 ? x[i - 1] : 0, p2 = i > 1 ? x[i - 2] : 0;
+
+        sum[0] += zigzag(x[i]);
+        sum[1] += zigzag(wrap(x[i] - p1, bits));
+        sum[2] += zigzag(wrap(x[i] - 2 * p1 + p2, bits));
+    }
+
+    if (sum[0] <= sum[1] && sum[0] <= sum[2])
+        order = 0;
+    else if (sum[1] <= sum[2])
+        order = 1;
+    else
+        order = 2;
+
+    for (i = 0; i < n; i++)
+        u[i] = zigzag(wrap((int64_t) x[i] - predict(x, i, order), bits));
+
+    /* The best Rice parameter is close to log2 of the mean residual, so
+     * only its neighbours are tried */
+    mean = sum[order] / n;
+    for (k_guess = 0; k_guess + 1 < bits && (mean >> (k_guess + 1)) > 0; k_guess++)
+        ;
+
+    best_cost = (uint64_t) n * bits;
+
+    for (k = k_guess > 0 ? k_guess - 1 : 0; k <= k_guess + 1 && k < bits; k++) {
+        cost = 0;
+
+        for (i = 0; i < n; i++) {
+            uint32_t q = u[i] >> k;
+            cost += q < ESCAPE ? q + 1 + k : ESCAPE + bits;
+        }
+
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_k = k + 1;
+        }
+    }
+
+    /* Coding would not make the channel any smaller */
+    if (best_k == 0) {
+        for (i = 0; i < n; i++)
+            put_bits(w, (uint32_t) x[i], bits);
+
+        return ORDER_VERBATIM << 6;
+    }
+
+    k = best_k - 1;
+
+    for (i = 0; i < n; i++) {
+        uint32_t q = u[i] >> k;
+
+        if (q < ESCAPE) {
+            put_bits(w, ((1U << q) - 1) << 1, q + 1);
+            put_bits(w, u[i], k);
+        } else {
+            put_bits(w, (1U << ESCAPE) - 1, ESCAPE);
+            put_bits(w, u[i], bits);
+        }
+    }
+
+    return (uint8_t) (order << 6 | k);
+}
+
+static void decode_channel(struct bit_reader *r, int32_t *x, unsigned n, unsigned order, unsigned k, unsigned bits) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        uint32_t q = 0, u;
+
+        if (order == ORDER_VERBATIM) {
+            x[i] = wrap(get_bits(r, bits), bits);
+            continue;
+        }
+
+        while (q < ESCAPE && get_bits(r, 1))
+            q++;
+
+        if (q < ESCAPE)
+            u = (q << k) | get_bits(r, k);
+        else
+            u = get_bits(r, bits);
+
+        x[i] = wrap((int64_t) predict(x, i, order) + unzigzag(u), bits);
+    }
+}
+
+static void write_header(uint8_t *p, size_t size, unsigned n) {
+    uint32_t s = PA_UINT32_TO_BE((uint32_t) size);
+    uint16_t f = PA_UINT16_TO_BE((uint16_t) n);
+
+    memcpy(p, &s, sizeof(s));
+    memcpy(p + sizeof(s), &f, sizeof(f));
+}
+
+static void read_header(const uint8_t *p, size_t *size, unsigned *n) {
+    uint32_t s;
+    uint16_t f;
+
+    memcpy(&s, p, sizeof(s));
+    memcpy(&f, p + sizeof(s), sizeof(f));
+
+    *size = PA_UINT32_FROM_BE(s);
+    *n = PA_UINT16_FROM_BE(f);
+}
+
+static unsigned frames_max(const pa_sample_spec *ss) {
+    return PA_MIN(PA_PCM_RICE_FRAMES_MAX, PA_PCM_RICE_PCM_MAX / (unsigned) pa_frame_size(ss));
+}
+
+bool pa_pcm_rice_supported(const pa_sample_spec *ss) {
+    pa_assert(ss);
+
+    return pa_sample_spec_valid(ss) && sample_bits(ss->format) > 0;
+}
+
+size_t pa_pcm_rice_encode_bound(const pa_sample_spec *ss, size_t length) {
+    size_t fs, n_frames, n_packets;
+
+    pa_assert(pa_pcm_rice_supported(ss));
+
+    fs = pa_frame_size(ss);
+    n_frames = length / fs;
+    n_packets = (n_frames + frames_max(ss) - 1) / frames_max(ss);
+
+    /* A channel is never coded into more bits than it has as PCM, and one
+     * byte per packet is lost to the last partial byte. The padding comes
+     * on top. */
+    return n_packets * (HEADER_SIZE + ss->channels + 1) +
+        n_frames * ss->channels * (sample_bits(ss->format) / 8) + fs;
+}
+
+size_t pa_pcm_rice_encode(const pa_sample_spec *ss, const void *src, size_t length, void *dst) {
+    int32_t x[PA_PCM_RICE_FRAMES_MAX];
+    uint32_t u[PA_PCM_RICE_FRAMES_MAX];
+    const uint8_t *s = src;
+    uint8_t *d = dst, *packet = NULL;
+    size_t fs, sample_size, n_frames, pad;
+    unsigned bits, n = 0, c;
+
+    pa_assert(pa_pcm_rice_supported(ss));
+    pa_assert(src);
+    pa_assert(dst);
+
+    fs = pa_frame_size(ss);
+    sample_size = pa_sample_size(ss);
+    bits = sample_bits(ss->format);
+
+    pa_assert(length % fs == 0);
+
+    for (n_frames = length / fs; n_frames > 0; n_frames -= n) {
+        struct bit_writer w;
+
+        n = (unsigned) PA_MIN(n_frames, frames_max(ss));
+        packet = d;
+
+        w.p = packet + HEADER_SIZE + ss->channels;
+        w.acc = 0;
+        w.n = 0;
+
+        for (c = 0; c < ss->channels; c++) {
+            read_channel(ss->format, s + c * sample_size, fs, n, x);
+            packet[HEADER_SIZE + c] = encode_channel(&w, x, u, n, bits);
+        }
+
+        flush_bits(&w);
+        d = w.p;
+
+        write_header(packet, (size_t) (d - packet), n);
+        s += n * fs;
+    }
+
+    /* The last packet takes the padding */
+    if ((pad = (fs - (size_t) (d - (uint8_t*) dst) % fs) % fs) > 0) {
+        pa_assert(packet);
+
+        memset(d, 0, pad);
+        d += pad;
+
+        write_header(packet, (size_t) (d - packet), n);
+    }
+
+    return (size_t) (d - (uint8_t*) dst);
+}
+
+pa_pcm_rice_decoder* pa_pcm_rice_decoder_new(pa_mempool *pool, const pa_sample_spec *ss) {
+    pa_pcm_rice_decoder *d;
+
+    pa_assert(pool);
+    pa_assert(pa_pcm_rice_supported(ss));
+
+    d = pa_xnew0(pa_pcm_rice_decoder, 1);
+    d->mempool = pool;
+    d->sample_spec = *ss;
+    d->bits = sample_bits(ss->format);
+
+    return d;
+}
+
+void pa_pcm_rice_decoder_free(pa_pcm_rice_decoder *d) {
+    pa_assert(d);
+
+    pa_xfree(d->buffer);
+    pa_xfree(d);
+}
+
+void pa_pcm_rice_decoder_reset(pa_pcm_rice_decoder *d) {
+    pa_assert(d);
+
+    d->index = d->length = 0;
+}
+
+void pa_pcm_rice_decoder_push(pa_pcm_rice_decoder *d, const void *data, size_t length) {
+    pa_assert(d);
+    pa_assert(data || length == 0);
+
+    if (d->index > 0) {
+        memmove(d->buffer, d->buffer + d->index, d->length);
+        d->index = 0;
+    }
+
+    if (d->length + length > d->allocated) {
+        d->allocated = PA_MAX(d->allocated * 2, d->length + length);
+        d->buffer = pa_xrealloc(d->buffer, d->allocated);
+    }
+
+    memcpy(d->buffer + d->length, data, length);
+    d->length += length;
+}
+
+int pa_pcm_rice_decoder_pop(pa_pcm_rice_decoder *d, pa_memchunk *chunk) {
+    int32_t x[PA_PCM_RICE_FRAMES_MAX];
+    const uint8_t *packet;
+    struct bit_reader r;
+    size_t fs, sample_size, size;
+    unsigned n, c;
+    uint8_t *dst;
+
+    pa_assert(d);
+    pa_assert(chunk);
+
+    if (d->length < HEADER_SIZE)
+        return 0;
+
+    packet = d->buffer + d->index;
+    read_header(packet, &size, &n);
+
+    fs = pa_frame_size(&d->sample_spec);
+    sample_size = pa_sample_size(&d->sample_spec);
+
+    if (n == 0 || n > frames_max(&d->sample_spec) ||
+        size < HEADER_SIZE + d->sample_spec.channels ||
+        size > pa_pcm_rice_encode_bound(&d->sample_spec, n * fs))
+        return -1;
+
+    if (d->length < size)
+        return 0;
+
+    r.data = packet + HEADER_SIZE + d->sample_spec.channels;
+    r.size = size - HEADER_SIZE - d->sample_spec.channels;
+    r.pos = 0;
+    r.acc = 0;
+    r.n = 0;
+
+    chunk->memblock = pa_memblock_new(d->mempool, n * fs);
+    chunk->index = 0;
+    chunk->length = n * fs;
+
+    dst = pa_memblock_acquire(chunk->memblock);
+
+    for (c = 0; c < d->sample_spec.channels; c++) {
+        unsigned order = packet[HEADER_SIZE + c] >> 6, k = packet[HEADER_SIZE + c] & 63;
+
+        if (order != ORDER_VERBATIM && k >= d->bits)
+            break;
+
+        decode_channel(&r, x, n, order, k, d->bits);
+        write_channel(d->sample_spec.format, dst + c * sample_size, fs, n, x);
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    d->index += size;
+    d->length -= size;
+
+    if (c < d->sample_spec.channels || r.pos > r.size) {
+        pa_memblock_unref(chunk->memblock);
+        pa_memchunk_reset(chunk);
+        return -1;
+    }
+
+    return 1;
+}
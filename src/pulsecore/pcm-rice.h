@@ -0,0 +1,72 @@
+#ifndef foopulsepcmricehfoo
+#define foopulsepcmricehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/sample.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* The lossless codec of PA_ENCODING_PCM_RICE streams, which PulseAudio
+ * servers use among each other to cut down the bandwidth of tunnels.
+ *
+ * The audio is cut into packets of at most PA_PCM_RICE_FRAMES_MAX frames
+ * and PA_PCM_RICE_PCM_MAX bytes of PCM, which can be decoded on their own
+ * into a single memory block. A packet starts with its size in
+ * bytes, as a big endian uint32_t, and the number of frames in it, as a
+ * big endian uint16_t. One mode byte per channel follows, then the bit
+ * stream of each channel in turn. The channels are predicted with a fixed
+ * polynomial predictor of order 0, 1 or 2, and the prediction residuals
+ * are Rice coded. The upper two bits of the mode byte hold the order, the
+ * lower six bits the Rice parameter. An order of 3 means that the samples
+ * are stored as they are. Padding may follow the bit stream, so that the
+ * encoded data ends on a frame boundary of the PCM sample spec.
+ *
+ * All sample formats but 8 bit ones are supported. Floating point samples
+ * are coded by their bit patterns, which is lossless but does not save as
+ * much as for integer samples. */
+
+#define PA_PCM_RICE_FRAMES_MAX 4096U
+#define PA_PCM_RICE_PCM_MAX (32U*1024U)
+
+typedef struct pa_pcm_rice_decoder pa_pcm_rice_decoder;
+
+bool pa_pcm_rice_supported(const pa_sample_spec *ss);
+
+/* The most that pa_pcm_rice_encode() writes for length bytes of PCM */
+size_t pa_pcm_rice_encode_bound(const pa_sample_spec *ss, size_t length);
+
+/* Encodes length bytes of PCM, which has to be a multiple of the frame
+ * size, into dst and returns the number of bytes written. That is a
+ * multiple of the frame size as well. */
+size_t pa_pcm_rice_encode(const pa_sample_spec *ss, const void *src, size_t length, void *dst);
+
+pa_pcm_rice_decoder* pa_pcm_rice_decoder_new(pa_mempool *pool, const pa_sample_spec *ss);
+void pa_pcm_rice_decoder_free(pa_pcm_rice_decoder *d);
+
+/* Drops whatever was pushed but not decoded yet */
+void pa_pcm_rice_decoder_reset(pa_pcm_rice_decoder *d);
+
+/* Encoded data may be pushed in pieces of any size. */
+void pa_pcm_rice_decoder_push(pa_pcm_rice_decoder *d, const void *data, size_t length);
+
+/* Decodes the next packet into a new memory block. Returns 1 if it did, 0
+ * if the packet is not complete yet, and -1 if the data is corrupt. */
+int pa_pcm_rice_decoder_pop(pa_pcm_rice_decoder *d, pa_memchunk *chunk);
+
+#endif
@@ -199,6 +199,11 @@ static const char *command_names[PA_COMMAND_MAX] = {
     /* Supported since protocol v31 (9.0) */
     /* BOTH DIRECTIONS */
     [PA_COMMAND_REGISTER_MEMFD_SHMID] = "REGISTER_MEMFD_SHMID",
+
+    /* Supported since protocol v32 (10.0) */
+    [PA_COMMAND_GET_SINK_TIMING_INFO_LIST] = "GET_SINK_TIMING_INFO_LIST",
+    [PA_COMMAND_GET_SOURCE_TIMING_INFO_LIST] = "GET_SOURCE_TIMING_INFO_LIST",
+    [PA_COMMAND_GET_SNAPSHOT] = "GET_SNAPSHOT",
 };
 
 #endif
@@ -57,6 +57,7 @@
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/mem.h>
+#include <pulsecore/pcm-rice.h>
 
 #include "protocol-native.h"
 
@@ -69,6 +70,9 @@
 #define MAX_CONNECTIONS 64
 
 #define MAX_MEMBLOCKQ_LENGTH (4*1024*1024) /* 4MB */
+
+/* How many removed objects are remembered for partial snapshots */
+#define MAX_SNAPSHOT_REMOVED 1024
 #define DEFAULT_TLENGTH_MSEC 2000 /* 2s */
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
 #define DEFAULT_FRAGSIZE_MSEC DEFAULT_TLENGTH_MSEC
@@ -96,6 +100,9 @@ typedef struct record_stream {
     pa_usec_t configured_source_latency;
     size_t drop_initial;
 
+    /* The data is sent PA_ENCODING_PCM_RICE encoded */
+    bool encode;
+
     /* Only updated after SOURCE_OUTPUT_MESSAGE_UPDATE_LATENCY */
     size_t on_the_fly_snapshot;
     pa_usec_t current_monitor_latency;
@@ -121,6 +128,9 @@ typedef struct playback_stream {
     pa_sink_input *sink_input;
     pa_memblockq *memblockq;
 
+    /* For data that comes PA_ENCODING_PCM_RICE encoded */
+    pa_pcm_rice_decoder *decoder;
+
     bool adjust_latency:1;
     bool early_requests:1;
 
@@ -203,8 +213,22 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+    /* For PA_COMMAND_GET_SNAPSHOT: every subscription event starts a new
+     * generation, and for every facility we remember in which generation
+     * each object was last created, changed or removed */
+    pa_subscription *snapshot_subscription;
+    uint64_t snapshot_generation;
+    uint64_t snapshot_oldest; /* Removals before this were forgotten */
+    unsigned snapshot_n_removed;
+    pa_hashmap *snapshot_changes[PA_SUBSCRIPTION_EVENT_CARD+1];
 };
 
+typedef struct snapshot_change {
+    uint64_t generation;
+    bool removed;
+} snapshot_change;
+
 enum {
     SOURCE_OUTPUT_MESSAGE_UPDATE_LATENCY = PA_SOURCE_OUTPUT_MESSAGE_MAX
 };
@@ -278,7 +302,9 @@ static void command_play_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag
 static void command_remove_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_timing_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_volume(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_mute(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -343,7 +369,10 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_GET_SINK_INPUT_INFO_LIST] = command_get_info_list,
     [PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST] = command_get_info_list,
     [PA_COMMAND_GET_SAMPLE_INFO_LIST] = command_get_info_list,
+    [PA_COMMAND_GET_SINK_TIMING_INFO_LIST] = command_get_timing_info_list,
+    [PA_COMMAND_GET_SOURCE_TIMING_INFO_LIST] = command_get_timing_info_list,
     [PA_COMMAND_GET_SERVER_INFO] = command_get_server_info,
+    [PA_COMMAND_GET_SNAPSHOT] = command_get_snapshot,
     [PA_COMMAND_SUBSCRIBE] = command_subscribe,
 
     [PA_COMMAND_SET_SINK_VOLUME] = command_set_volume,
@@ -804,6 +833,9 @@ static void playback_stream_free(pa_object* o) {
 
     playback_stream_unlink(s);
 
+    if (s->decoder)
+        pa_pcm_rice_decoder_free(s->decoder);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
@@ -1413,7 +1445,24 @@ static void native_connection_send_memblock(pa_native_connection *c) {
             if (schunk.length > r->buffer_attr.fragsize)
                 schunk.length = r->buffer_attr.fragsize;
 
-            pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &schunk);
+            if (r->encode) {
+                pa_memchunk echunk;
+                const pa_sample_spec *ss = &r->source_output->sample_spec;
+                void *src, *dst;
+
+                echunk.memblock = pa_memblock_new(c->protocol->core->mempool, pa_pcm_rice_encode_bound(ss, schunk.length));
+                echunk.index = 0;
+
+                src = pa_memblock_acquire_chunk(&schunk);
+                dst = pa_memblock_acquire(echunk.memblock);
+                echunk.length = pa_pcm_rice_encode(ss, src, schunk.length, dst);
+                pa_memblock_release(echunk.memblock);
+                pa_memblock_release(schunk.memblock);
+
+                pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &echunk);
+                pa_memblock_unref(echunk.memblock);
+            } else
+                pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &schunk);
 
             pa_memblockq_drop(r->memblockq, schunk.length);
             pa_memblock_unref(schunk.memblock);
@@ -1973,6 +2022,35 @@ static void protocol_error(pa_native_connection *c) {
     native_connection_unlink(c);
 }
 
+/* Since protocol version 34 a client may offer PA_ENCODING_PCM_RICE as the
+ * first format of a stream. The stream is then set up like a PCM one, and
+ * only the data on the wire is encoded. Returns true if the client asked
+ * for that, after turning the format into a PCM one. */
+static bool take_pcm_rice_format(pa_native_connection *c, pa_idxset *formats) {
+    pa_format_info *f;
+
+    if (c->version < 34 || !formats || !(f = pa_idxset_first(formats, NULL)))
+        return false;
+
+    if (f->encoding != PA_ENCODING_PCM_RICE)
+        return false;
+
+    f->encoding = PA_ENCODING_PCM;
+    return true;
+}
+
+/* Sends back the negotiated format, as PA_ENCODING_PCM_RICE if the data is
+ * coded that way */
+static void reply_put_format(pa_tagstruct *reply, const pa_format_info *format, bool pcm_rice) {
+    pa_format_info *f = format ? pa_format_info_copy(format) : pa_format_info_new();
+
+    if (pcm_rice)
+        f->encoding = PA_ENCODING_PCM_RICE;
+
+    pa_tagstruct_put_format_info(reply, f);
+    pa_format_info_free(f);
+}
+
 #define CHECK_VALIDITY(pstream, expression, tag, error) do { \
 if (!(expression)) { \
     pa_pstream_send_error((pstream), (tag), (error)); \
@@ -2032,6 +2110,7 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
     uint8_t n_formats = 0;
     pa_format_info *format;
     pa_idxset *formats = NULL;
+    bool pcm_rice;
     uint32_t i;
 
     pa_native_connection_assert_ref(c);
@@ -2201,12 +2280,18 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
      * flag. For older versions we synthesize it here */
     muted_set = muted_set || muted;
 
+    pcm_rice = take_pcm_rice_format(c, formats);
+
     s = playback_stream_new(c, sink, &ss, &map, formats, &attr, volume_set ? &volume : NULL, muted, muted_set, flags, p, adjust_latency, early_requests, relative_volume, syncid, &missing, &ret);
     /* We no longer own the formats idxset */
     formats = NULL;
 
     CHECK_VALIDITY_GOTO(c->pstream, s, tag, ret, finish);
 
+    if (pcm_rice && s->sink_input->format && pa_format_info_is_pcm(s->sink_input->format) &&
+        pa_pcm_rice_supported(&s->sink_input->sample_spec))
+        s->decoder = pa_pcm_rice_decoder_new(c->protocol->core->mempool, &s->sink_input->sample_spec);
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->sink_input);
@@ -2245,13 +2330,7 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
 
     if (c->version >= 21) {
         /* Send back the format we negotiated */
-        if (s->sink_input->format)
-            pa_tagstruct_put_format_info(reply, s->sink_input->format);
-        else {
-            pa_format_info *f = pa_format_info_new();
-            pa_tagstruct_put_format_info(reply, f);
-            pa_format_info_free(f);
-        }
+        reply_put_format(reply, s->sink_input->format, !!s->decoder);
     }
 
     pa_pstream_send_tagstruct(c->pstream, reply);
@@ -2360,6 +2439,7 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
     uint8_t n_formats = 0;
     pa_format_info *format;
     pa_idxset *formats = NULL;
+    bool pcm_rice;
     uint32_t i;
 
     pa_native_connection_assert_ref(c);
@@ -2524,10 +2604,17 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
         (fail_on_suspend ? PA_SOURCE_OUTPUT_NO_CREATE_ON_SUSPEND|PA_SOURCE_OUTPUT_KILL_ON_SUSPEND : 0) |
         (passthrough ? PA_SOURCE_OUTPUT_PASSTHROUGH : 0);
 
+    pcm_rice = take_pcm_rice_format(c, formats);
+
     s = record_stream_new(c, source, &ss, &map, formats, &attr, volume_set ? &volume : NULL, muted, muted_set, flags, p, adjust_latency, early_requests, relative_volume, peak_detect, direct_on_input, &ret);
+    /* We no longer own the formats idxset */
+    formats = NULL;
 
     CHECK_VALIDITY_GOTO(c->pstream, s, tag, ret, finish);
 
+    s->encode = pcm_rice && s->source_output->format && pa_format_info_is_pcm(s->source_output->format) &&
+        pa_pcm_rice_supported(&s->source_output->sample_spec);
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->source_output);
@@ -2559,13 +2646,7 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
 
     if (c->version >= 22) {
         /* Send back the format we negotiated */
-        if (s->source_output->format)
-            pa_tagstruct_put_format_info(reply, s->source_output->format);
-        else {
-            pa_format_info *f = pa_format_info_new();
-            pa_tagstruct_put_format_info(reply, f);
-            pa_format_info_free(f);
-        }
+        reply_put_format(reply, s->source_output->format, s->encode);
     }
 
     pa_pstream_send_tagstruct(c->pstream, reply);
@@ -2631,7 +2712,7 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         return;
     }
 
-    if (!(c->rw_mempool = pa_mempool_new(shm_type, c->protocol->core->shm_size, true))) {
+    if (!(c->rw_mempool = pa_mempool_new(shm_type, c->protocol->core->shm_size, true, c->protocol->core->hugepages))) {
         pa_log_warn("Disabling srbchannel, reason: Failed to allocate shared "
                     "writable memory pool.");
         return;
@@ -2815,6 +2896,10 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_log_debug("Negotiated SHM: %s", pa_yes_no(do_shm));
     pa_pstream_enable_shm(c->pstream, do_shm);
 
+    /* Older clients can't import as many blocks at a time */
+    if (do_shm && c->version >= 33)
+        pa_pstream_enable_large_export(c->pstream);
+
     do_memfd =
         do_shm && pa_mempool_is_memfd_backed(c->protocol->core->mempool);
 
@@ -3785,13 +3870,33 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+/* Only the non-empty buckets are sent, most of the histogram is usually
+ * empty */
+static void histogram_fill_tagstruct(pa_tagstruct *t, const pa_histogram *h) {
+    unsigned i, n = 0;
+
+    for (i = 0; i < PA_HISTOGRAM_N_BUCKETS; i++)
+        if (h->buckets[i] > 0)
+            n++;
+
+    pa_tagstruct_putu64(t, h->count);
+    pa_tagstruct_putu64(t, h->min);
+    pa_tagstruct_putu64(t, h->max);
+    pa_tagstruct_putu64(t, h->sum);
+    pa_tagstruct_putu32(t, n);
+
+    for (i = 0; i < PA_HISTOGRAM_N_BUCKETS; i++)
+        if (h->buckets[i] > 0) {
+            pa_tagstruct_putu64(t, pa_histogram_bucket_upper_bound(i));
+            pa_tagstruct_putu64(t, h->buckets[i]);
+        }
+}
+
+static void command_get_timing_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_io_timing *timing;
     pa_tagstruct *reply;
-    pa_sink *def_sink;
-    pa_source *def_source;
-    pa_sample_spec fixed_ss;
-    char *h, *u;
+    uint32_t idx;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -3804,33 +3909,290 @@ static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
 
     reply = reply_new(tag);
-    pa_tagstruct_puts(reply, PACKAGE_NAME);
-    pa_tagstruct_puts(reply, PACKAGE_VERSION);
+    timing = pa_xnew(pa_io_timing, 1);
+
+    if (command == PA_COMMAND_GET_SINK_TIMING_INFO_LIST) {
+        pa_sink *sink;
+
+        PA_IDXSET_FOREACH(sink, c->protocol->core->sinks, idx) {
+            if (pa_sink_get_timing(sink, timing) < 0)
+                continue;
+
+            pa_tagstruct_putu32(reply, sink->index);
+            pa_tagstruct_puts(reply, sink->name);
+            histogram_fill_tagstruct(reply, &timing->process_usec);
+            histogram_fill_tagstruct(reply, &timing->resample_usec);
+            histogram_fill_tagstruct(reply, &timing->wakeup_lateness_usec);
+            histogram_fill_tagstruct(reply, &timing->rewind_bytes);
+        }
+    } else {
+        pa_source *source;
+
+        pa_assert(command == PA_COMMAND_GET_SOURCE_TIMING_INFO_LIST);
+
+        PA_IDXSET_FOREACH(source, c->protocol->core->sources, idx) {
+            if (pa_source_get_timing(source, timing) < 0)
+                continue;
+
+            pa_tagstruct_putu32(reply, source->index);
+            pa_tagstruct_puts(reply, source->name);
+            histogram_fill_tagstruct(reply, &timing->process_usec);
+            histogram_fill_tagstruct(reply, &timing->resample_usec);
+            histogram_fill_tagstruct(reply, &timing->wakeup_lateness_usec);
+            histogram_fill_tagstruct(reply, &timing->rewind_bytes);
+        }
+    }
+
+    pa_xfree(timing);
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+static void server_info_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t) {
+    pa_sink *def_sink;
+    pa_source *def_source;
+    pa_sample_spec fixed_ss;
+    char *h, *u;
+
+    pa_tagstruct_puts(t, PACKAGE_NAME);
+    pa_tagstruct_puts(t, PACKAGE_VERSION);
 
     u = pa_get_user_name_malloc();
-    pa_tagstruct_puts(reply, u);
+    pa_tagstruct_puts(t, u);
     pa_xfree(u);
 
     h = pa_get_host_name_malloc();
-    pa_tagstruct_puts(reply, h);
+    pa_tagstruct_puts(t, h);
     pa_xfree(h);
 
     fixup_sample_spec(c, &fixed_ss, &c->protocol->core->default_sample_spec);
-    pa_tagstruct_put_sample_spec(reply, &fixed_ss);
+    pa_tagstruct_put_sample_spec(t, &fixed_ss);
 
     def_sink = pa_namereg_get_default_sink(c->protocol->core);
-    pa_tagstruct_puts(reply, def_sink ? def_sink->name : NULL);
+    pa_tagstruct_puts(t, def_sink ? def_sink->name : NULL);
     def_source = pa_namereg_get_default_source(c->protocol->core);
-    pa_tagstruct_puts(reply, def_source ? def_source->name : NULL);
+    pa_tagstruct_puts(t, def_source ? def_source->name : NULL);
 
-    pa_tagstruct_putu32(reply, c->protocol->core->cookie);
+    pa_tagstruct_putu32(t, c->protocol->core->cookie);
 
     if (c->version >= 15)
-        pa_tagstruct_put_channel_map(reply, &c->protocol->core->default_channel_map);
+        pa_tagstruct_put_channel_map(t, &c->protocol->core->default_channel_map);
+}
+
+static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_tagstruct *reply;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (!pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    reply = reply_new(tag);
+    server_info_fill_tagstruct(c, reply);
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+static bool snapshot_changed(pa_native_protocol *p, pa_subscription_event_type_t facility, uint32_t idx, uint64_t since) {
+    snapshot_change *change;
+
+    if (!(change = pa_hashmap_get(p->snapshot_changes[facility], PA_UINT32_TO_PTR(idx))))
+        return false;
+
+    return change->generation > since;
+}
+
+/* Puts one section of a snapshot: all objects of the facility, or only
+ * the ones that changed since the given generation and the indexes of
+ * the ones that were removed */
+static void snapshot_fill_section(pa_native_connection *c, pa_tagstruct *reply, pa_subscription_event_type_t facility, bool complete, uint64_t since) {
+    pa_native_protocol *p = c->protocol;
+    pa_idxset *objects;
+    snapshot_change *change;
+    void *object, *state;
+    uint32_t idx, n = 0;
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            objects = p->core->modules;
+            break;
+        case PA_SUBSCRIPTION_EVENT_CLIENT:
+            objects = p->core->clients;
+            break;
+        case PA_SUBSCRIPTION_EVENT_CARD:
+            objects = p->core->cards;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            objects = p->core->sinks;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            objects = p->core->sources;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            objects = p->core->sink_inputs;
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            objects = p->core->source_outputs;
+            break;
+        default:
+            pa_assert(facility == PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE);
+            objects = p->core->scache;
+            break;
+    }
+
+    if (objects)
+        PA_IDXSET_FOREACH(object, objects, idx)
+            if (complete || snapshot_changed(p, facility, idx, since))
+                n++;
+
+    pa_tagstruct_putu32(reply, facility);
+    pa_tagstruct_putu32(reply, n);
+
+    if (n > 0)
+        PA_IDXSET_FOREACH(object, objects, idx) {
+            if (!complete && !snapshot_changed(p, facility, idx, since))
+                continue;
+
+            switch (facility) {
+                case PA_SUBSCRIPTION_EVENT_MODULE:
+                    module_fill_tagstruct(c, reply, object);
+                    break;
+                case PA_SUBSCRIPTION_EVENT_CLIENT:
+                    client_fill_tagstruct(c, reply, object);
+                    break;
+                case PA_SUBSCRIPTION_EVENT_CARD:
+                    card_fill_tagstruct(c, reply, object);
+                    break;
+                case PA_SUBSCRIPTION_EVENT_SINK:
+                    sink_fill_tagstruct(c, reply, object);
+                    break;
+                case PA_SUBSCRIPTION_EVENT_SOURCE:
+                    source_fill_tagstruct(c, reply, object);
+                    break;
+                case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+                    sink_input_fill_tagstruct(c, reply, object);
+                    break;
+                case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+                    source_output_fill_tagstruct(c, reply, object);
+                    break;
+                default:
+                    scache_fill_tagstruct(c, reply, object);
+                    break;
+            }
+        }
+
+    n = 0;
+
+    if (!complete)
+        PA_HASHMAP_FOREACH(change, p->snapshot_changes[facility], state)
+            if (change->removed && change->generation > since)
+                n++;
+
+    pa_tagstruct_putu32(reply, n);
+
+    if (n > 0)
+        PA_HASHMAP_FOREACH_KV(object, change, p->snapshot_changes[facility], state)
+            if (change->removed && change->generation > since)
+                pa_tagstruct_putu32(reply, PA_PTR_TO_UINT32(object));
+}
+
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_native_protocol *p;
+    pa_tagstruct *reply;
+    uint64_t since;
+    bool complete;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu64(t, &since) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    p = c->protocol;
+
+    /* If we don't know what happened since the generation the client
+     * asks about, it gets everything */
+    complete = since == 0 || since < p->snapshot_oldest || since > p->snapshot_generation;
+
+    reply = reply_new(tag);
+    pa_tagstruct_putu64(reply, p->snapshot_generation);
+    pa_tagstruct_put_boolean(reply, complete);
+
+    pa_tagstruct_putu32(reply, PA_SUBSCRIPTION_EVENT_SERVER);
+
+    if (complete || snapshot_changed(p, PA_SUBSCRIPTION_EVENT_SERVER, PA_INVALID_INDEX, since)) {
+        pa_tagstruct_putu32(reply, 1);
+        server_info_fill_tagstruct(c, reply);
+    } else
+        pa_tagstruct_putu32(reply, 0);
+
+    pa_tagstruct_putu32(reply, 0);
+
+    /* In the order in which the objects refer to each other */
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_MODULE, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_CLIENT, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_CARD, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_SINK, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_SOURCE, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_SINK_INPUT, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT, complete, since);
+    snapshot_fill_section(c, reply, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE, complete, since);
 
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+/* Once too many removed objects pile up, forget all of them. Partial
+ * snapshots since before that are then answered with complete ones. */
+static void snapshot_forget_removed(pa_native_protocol *p) {
+    snapshot_change *change;
+    void *key, *state;
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(p->snapshot_changes); i++)
+        PA_HASHMAP_FOREACH_KV(key, change, p->snapshot_changes[i], state)
+            if (change->removed)
+                pa_hashmap_remove_and_free(p->snapshot_changes[i], key);
+
+    p->snapshot_n_removed = 0;
+    p->snapshot_oldest = p->snapshot_generation;
+}
+
+static void snapshot_subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
+    pa_native_protocol *p = userdata;
+    pa_subscription_event_type_t facility = e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    snapshot_change *change;
+
+    pa_assert(p);
+
+    p->snapshot_generation++;
+
+    if (facility >= PA_ELEMENTSOF(p->snapshot_changes) || facility == PA_SUBSCRIPTION_EVENT_AUTOLOAD)
+        return;
+
+    if (!(change = pa_hashmap_get(p->snapshot_changes[facility], PA_UINT32_TO_PTR(idx)))) {
+        change = pa_xnew0(snapshot_change, 1);
+        pa_hashmap_put(p->snapshot_changes[facility], PA_UINT32_TO_PTR(idx), change);
+    } else if (change->removed)
+        p->snapshot_n_removed--;
+
+    change->generation = p->snapshot_generation;
+    change->removed = (e & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE;
+
+    if (change->removed && ++p->snapshot_n_removed > MAX_SNAPSHOT_REMOVED)
+        snapshot_forget_removed(p);
+}
+
 static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
     pa_tagstruct *t;
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
@@ -5010,7 +5372,37 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
     pa_log("got %lu bytes from client", (unsigned long) chunk->length);
 #endif
 
-    if (playback_stream_isinstance(stream)) {
+    if (playback_stream_isinstance(stream) && PLAYBACK_STREAM(stream)->decoder) {
+        playback_stream *ps = PLAYBACK_STREAM(stream);
+        pa_memchunk pcm;
+        int r;
+
+        /* Seeking would need offsets in PCM, which the client does not
+         * know for encoded data. The offset of relative writes only makes
+         * up for the difference between encoded and PCM lengths in the
+         * accounting of the client, see PROTOCOL. */
+        if (!chunk->memblock || seek != PA_SEEK_RELATIVE) {
+            pa_log_warn("Client sent a hole or seek on an encoded stream, ignoring.");
+
+            if (!chunk->memblock)
+                return;
+        }
+
+        pa_pcm_rice_decoder_push(ps->decoder, (uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index, chunk->length);
+        pa_memblock_release(chunk->memblock);
+
+        while ((r = pa_pcm_rice_decoder_pop(ps->decoder, &pcm)) > 0) {
+            pa_atomic_inc(&ps->seek_or_post_in_queue);
+            pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, &pcm, NULL);
+            pa_memblock_unref(pcm.memblock);
+        }
+
+        if (r < 0) {
+            pa_log("Client sent corrupt encoded data.");
+            protocol_error(c);
+        }
+
+    } else if (playback_stream_isinstance(stream)) {
         playback_stream *ps = PLAYBACK_STREAM(stream);
 
         size_t frame_size = pa_frame_size(&ps->sink_input->sample_spec);
@@ -5258,6 +5650,7 @@ void pa_native_protocol_disconnect(pa_native_protocol *p, pa_module *m) {
 static pa_native_protocol* native_protocol_new(pa_core *c) {
     pa_native_protocol *p;
     pa_native_hook_t h;
+    unsigned i;
 
     pa_assert(c);
 
@@ -5273,6 +5666,15 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
         pa_hook_init(&p->hooks[h], p);
 
+    p->snapshot_generation = 1;
+    p->snapshot_oldest = 1;
+    p->snapshot_n_removed = 0;
+
+    for (i = 0; i < PA_ELEMENTSOF(p->snapshot_changes); i++)
+        p->snapshot_changes[i] = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL, pa_xfree);
+
+    p->snapshot_subscription = pa_subscription_new(c, PA_SUBSCRIPTION_MASK_ALL, snapshot_subscription_cb, p);
+
     pa_assert_se(pa_shared_set(c, "native-protocol", p) >= 0);
 
     return p;
@@ -5299,6 +5701,7 @@ pa_native_protocol* pa_native_protocol_ref(pa_native_protocol *p) {
 void pa_native_protocol_unref(pa_native_protocol *p) {
     pa_native_connection *c;
     pa_native_hook_t h;
+    unsigned i;
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
@@ -5318,6 +5721,11 @@ void pa_native_protocol_unref(pa_native_protocol *p) {
 
     pa_hashmap_free(p->extensions);
 
+    pa_subscription_free(p->snapshot_subscription);
+
+    for (i = 0; i < PA_ELEMENTSOF(p->snapshot_changes); i++)
+        pa_hashmap_free(p->snapshot_changes[i]);
+
     pa_assert_se(pa_shared_remove(p->core, "native-protocol") >= 0);
 
     pa_xfree(p);
@@ -26,6 +26,10 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #ifdef HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
@@ -40,6 +44,7 @@
 #include <pulsecore/refcnt.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/trace.h>
 
 #include "pstream.h"
 
@@ -82,6 +87,9 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
  */
 #define FRAME_SIZE_MAX_ALLOW (1024*1024*16)
 
+/* How many queued items may be gathered into a single writev() */
+#define WRITE_ITEMS_MAX (16)
+
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
 struct item_info {
@@ -109,6 +117,21 @@ struct item_info {
     uint32_t block_id;
 };
 
+struct pstream_write {
+    union {
+        uint8_t minibuf[MINIBUF_SIZE];
+        pa_pstream_descriptor descriptor;
+    };
+    struct item_info* current;
+    void *data;
+    size_t index;
+    int minibuf_validsize;
+    pa_memchunk memchunk;
+#ifdef HAVE_CREDS
+    bool send_ancil_data_now;
+#endif
+};
+
 struct pstream_read {
     pa_pstream_descriptor descriptor;
     pa_memblock *memblock;
@@ -131,17 +154,11 @@ struct pa_pstream {
 
     bool dead;
 
-    struct {
-        union {
-            uint8_t minibuf[MINIBUF_SIZE];
-            pa_pstream_descriptor descriptor;
-        };
-        struct item_info* current;
-        void *data;
-        size_t index;
-        int minibuf_validsize;
-        pa_memchunk memchunk;
-    } write;
+    /* Items taken off the send queue, in a ring starting at write_idx. The
+     * first one is being written, the others have been prepared to be
+     * written along with it. */
+    struct pstream_write write[WRITE_ITEMS_MAX];
+    unsigned write_idx, n_write;
 
     struct pstream_read readio, readsrb;
 
@@ -154,6 +171,9 @@ struct pa_pstream {
      * @registered_memfd_ids: registered memfd pools SHM IDs. Check
      * pa_pstream_register_memfd_mempool() for more information. */
     bool use_shm, use_memfd;
+
+    /* The peer imports up to PA_MEMEXPORT_SLOTS_MAX blocks at a time */
+    bool large_export;
     pa_idxset *registered_memfd_ids;
 
     pa_memimport *import;
@@ -180,8 +200,7 @@ struct pa_pstream {
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
-    pa_cmsg_ancil_data read_ancil_data, *write_ancil_data;
-    bool send_ancil_data_now;
+    pa_cmsg_ancil_data read_ancil_data;
 #endif
 };
 
@@ -375,6 +394,29 @@ static void item_free(void *item) {
         pa_xfree(i);
 }
 
+static struct pstream_write *write_item(pa_pstream *p, unsigned i) {
+    pa_assert(i < p->n_write);
+
+    return &p->write[(p->write_idx + i) % WRITE_ITEMS_MAX];
+}
+
+/* Drops the first item of the write ring */
+static void write_item_done(pa_pstream *p) {
+    struct pstream_write *w = write_item(p, 0);
+
+    pa_assert(w->current);
+    item_free(w->current);
+    w->current = NULL;
+
+    if (w->memchunk.memblock)
+        pa_memblock_unref(w->memchunk.memblock);
+
+    pa_memchunk_reset(&w->memchunk);
+
+    p->write_idx = (p->write_idx + 1) % WRITE_ITEMS_MAX;
+    p->n_write--;
+}
+
 static void pstream_free(pa_pstream *p) {
     pa_assert(p);
 
@@ -382,11 +424,8 @@ static void pstream_free(pa_pstream *p) {
 
     pa_queue_free(p->send_queue, item_free);
 
-    if (p->write.current)
-        item_free(p->write.current);
-
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
+    while (p->n_write > 0)
+        write_item_done(p);
 
     if (p->readsrb.memblock)
         pa_memblock_unref(p->readsrb.memblock);
@@ -559,77 +598,91 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+/* Takes the next item off the send queue and appends it to the write ring */
+static struct pstream_write *prepare_next_write_item(pa_pstream *p) {
+    struct pstream_write *w;
+    struct item_info *current;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->n_write < WRITE_ITEMS_MAX);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    if (!(current = pa_queue_pop(p->send_queue)))
+        return NULL;
 
-    if (!p->write.current)
-        return;
-    p->write.index = 0;
-    p->write.data = NULL;
-    p->write.minibuf_validsize = 0;
-    pa_memchunk_reset(&p->write.memchunk);
-
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
-
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+    p->n_write++;
+    w = write_item(p, p->n_write - 1);
+
+    w->current = current;
+    w->index = 0;
+    w->data = NULL;
+    w->minibuf_validsize = 0;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
         size_t plen;
 
-        pa_assert(p->write.current->packet);
+        pa_assert(w->current->packet);
+
+        w->data = (void *) pa_packet_data(w->current->packet, &plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
 
-        p->write.data = (void *) pa_packet_data(p->write.current->packet, &plen);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+        PA_TRACE2(pstream_send_packet, p, plen);
 
         if (plen <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
-            memcpy(&p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], p->write.data, plen);
-            p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, plen);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
         }
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
     } else {
         uint32_t flags;
         bool send_payload = true;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             pa_mem_type_t type;
             uint32_t block_id, shm_id;
             size_t offset, length;
-            uint32_t *shm_info = (uint32_t *) &p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+            uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
             size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
-            pa_mempool *current_pool = pa_memblock_get_pool(p->write.current->chunk.memblock);
+            pa_mempool *current_pool = pa_memblock_get_pool(w->current->chunk.memblock);
             pa_memexport *current_export;
 
             if (p->mempool == current_pool)
                 pa_assert_se(current_export = p->export);
-            else
+            else {
                 pa_assert_se(current_export = pa_memexport_new(current_pool, memexport_revoke_cb, p));
 
+                if (p->large_export)
+                    pa_memexport_set_max_slots(current_export, PA_MEMEXPORT_SLOTS_MAX);
+            }
+
             if (pa_memexport_put(current_export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &type,
                                  &block_id,
                                  &shm_id,
@@ -660,35 +713,39 @@ static void prepare_next_write_item(pa_pstream *p) {
 
                     shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
                     shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-                    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
-                    p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+                    w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
                 }
             }
 /*             else */
 /*                 FIXME: Avoid memexport slot leaks. Call pa_memexport_process_release() */
 /*                 pa_log_warn("Failed to export memory block."); */
 
+            if (send_payload)
+                pa_mempool_stat_add_export_copy(p->mempool, w->current->chunk.length);
+
             if (current_export != p->export)
                 pa_memexport_free(current_export);
             pa_mempool_unref(current_pool);
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
 
 #ifdef HAVE_CREDS
-    if ((p->send_ancil_data_now = p->write.current->with_ancil_data))
-        p->write_ancil_data = &p->write.current->ancil_data;
+    w->send_ancil_data_now = w->current->with_ancil_data;
 #endif
+
+    return w;
 }
 
 static void check_srbpending(pa_pstream *p) {
@@ -705,8 +762,118 @@ static void check_srbpending(pa_pstream *p) {
         pa_srbchannel_set_callback(p->srb, srb_callback, p);
 }
 
+static size_t write_item_size(struct pstream_write *w) {
+    return PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+}
+
+/* Returns the length of the contiguous piece of the item that starts at
+ * index, and its address in *d. payload is the item's payload data. */
+static size_t write_item_segment(struct pstream_write *w, size_t index, const void *payload, const void **d) {
+    if (w->minibuf_validsize > 0) {
+        *d = w->minibuf + index;
+        return w->minibuf_validsize - index;
+    }
+
+    if (index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        *d = (uint8_t*) w->descriptor + index;
+        return PA_PSTREAM_DESCRIPTOR_SIZE - index;
+    }
+
+    pa_assert(payload);
+
+    *d = (const uint8_t*) payload + index - PA_PSTREAM_DESCRIPTOR_SIZE;
+    return write_item_size(w) - index;
+}
+
+/* Advances the write ring by the r bytes that have just been written,
+ * and returns true if that completed any item */
+static bool write_items_advance(pa_pstream *p, size_t r) {
+    bool done = false;
+
+    while (r > 0) {
+        struct pstream_write *w = write_item(p, 0);
+        size_t k = PA_MIN(r, write_item_size(w) - w->index);
+
+        w->index += k;
+        r -= k;
+
+        if (w->index >= write_item_size(w)) {
+            write_item_done(p);
+            done = true;
+        }
+    }
+
+    return done;
+}
+
+#ifdef HAVE_SYS_UIO_H
+/* Writes the item in progress together with as many queued items as fit
+ * into the socket buffer, with a single writev() */
+static int do_writev(pa_pstream *p) {
+    struct iovec iov[WRITE_ITEMS_MAX * 2];
+    pa_memblock *release_memblocks[WRITE_ITEMS_MAX];
+    unsigned i, n_iov = 0, n_release = 0;
+    size_t l = 0, max_l;
+    ssize_t r;
+
+    max_l = pa_mempool_block_size_max(p->mempool);
+
+    for (i = 0; i < WRITE_ITEMS_MAX; i++) {
+        struct pstream_write *w;
+        const void *payload, *d;
+        size_t index;
+
+        if (i < p->n_write)
+            w = write_item(p, i);
+        else if (l >= max_l || !(w = prepare_next_write_item(p)))
+            break;
+
+#ifdef HAVE_CREDS
+        /* Ancillary data is sent along with the first bytes of its item,
+         * so an item that has some needs to start its own write */
+        if (i > 0 && w->send_ancil_data_now)
+            break;
+#endif
+
+        payload = w->data;
+
+        if (w->memchunk.memblock && w->minibuf_validsize == 0) {
+            payload = pa_memblock_acquire_chunk(&w->memchunk);
+            release_memblocks[n_release++] = w->memchunk.memblock;
+        }
+
+        for (index = w->index; index < write_item_size(w); n_iov++) {
+            size_t k = write_item_segment(w, index, payload, &d);
+
+            iov[n_iov].iov_base = (void*) d;
+            iov[n_iov].iov_len = k;
+
+            index += k;
+            l += k;
+        }
+    }
+
+    pa_assert(l > 0);
+
+    r = pa_iochannel_writev(p->io, iov, (int) n_iov);
+
+    for (i = 0; i < n_release; i++)
+        pa_memblock_release(release_memblocks[i]);
+
+    if (r < 0)
+        return -1;
+
+    if (write_items_advance(p, (size_t) r))
+        if (p->drain_callback && !pa_pstream_is_pending(p))
+            p->drain_callback(p, p->drain_callback_userdata);
+
+    return (size_t) r == l ? 1 : 0;
+}
+#endif
+
 static int do_write(pa_pstream *p) {
-    void *d;
+    struct pstream_write *w;
+    const void *d, *payload;
     size_t l;
     ssize_t r;
     pa_memblock *release_memblock = NULL;
@@ -714,50 +881,49 @@ static int do_write(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
-
-    if (!p->write.current) {
+    if (p->n_write > 0)
+        w = write_item(p, 0);
+    else if (!(w = prepare_next_write_item(p))) {
         /* The out queue is empty, so switching channels is safe */
         check_srbpending(p);
         return 0;
     }
 
-    if (p->write.minibuf_validsize > 0) {
-        d = p->write.minibuf + p->write.index;
-        l = p->write.minibuf_validsize - p->write.index;
-    } else if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
-    } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+#ifdef HAVE_SYS_UIO_H
+    if (!p->srb
+#ifdef HAVE_CREDS
+        && !w->send_ancil_data_now
+#endif
+        )
+        return do_writev(p);
+#endif
 
-        if (p->write.data)
-            d = p->write.data;
-        else {
-            d = pa_memblock_acquire_chunk(&p->write.memchunk);
-            release_memblock = p->write.memchunk.memblock;
-        }
+    payload = w->data;
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
+    if (w->memchunk.memblock && w->minibuf_validsize == 0 && w->index >= PA_PSTREAM_DESCRIPTOR_SIZE) {
+        payload = pa_memblock_acquire_chunk(&w->memchunk);
+        release_memblock = w->memchunk.memblock;
     }
 
+    l = write_item_segment(w, w->index, payload, &d);
+
     pa_assert(l > 0);
 
 #ifdef HAVE_CREDS
-    if (p->send_ancil_data_now) {
-        if (p->write_ancil_data->creds_valid) {
-            pa_assert(p->write_ancil_data->nfd == 0);
-            if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_ancil_data->creds)) < 0)
+    if (w->send_ancil_data_now) {
+        pa_cmsg_ancil_data *ancil_data = &w->current->ancil_data;
+
+        if (ancil_data->creds_valid) {
+            pa_assert(ancil_data->nfd == 0);
+            if ((r = pa_iochannel_write_with_creds(p->io, d, l, &ancil_data->creds)) < 0)
                 goto fail;
         }
         else
-            if ((r = pa_iochannel_write_with_fds(p->io, d, l, p->write_ancil_data->nfd, p->write_ancil_data->fds)) < 0)
+            if ((r = pa_iochannel_write_with_fds(p->io, d, l, ancil_data->nfd, ancil_data->fds)) < 0)
                 goto fail;
 
-        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
-        p->send_ancil_data_now = false;
+        pa_cmsg_ancil_data_close_fds(ancil_data);
+        w->send_ancil_data_now = false;
     } else
 #endif
     if (p->srb)
@@ -768,28 +934,16 @@ static int do_write(pa_pstream *p) {
     if (release_memblock)
         pa_memblock_release(release_memblock);
 
-    p->write.index += (size_t) r;
-
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
-
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
-
-        pa_memchunk_reset(&p->write.memchunk);
-
+    if (write_items_advance(p, (size_t) r))
         if (p->drain_callback && !pa_pstream_is_pending(p))
             p->drain_callback(p, p->drain_callback_userdata);
-    }
 
     return (size_t) r == l ? 1 : 0;
 
 fail:
 #ifdef HAVE_CREDS
-    if (p->send_ancil_data_now)
-        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
+    if (w->send_ancil_data_now)
+        pa_cmsg_ancil_data_close_fds(&w->current->ancil_data);
 #endif
 
     if (release_memblock)
@@ -982,6 +1136,8 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
 
         } else if (re->packet) {
 
+            PA_TRACE2(pstream_receive_packet, p, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]));
+
             if (p->receive_packet_callback)
 #ifdef HAVE_CREDS
                 p->receive_packet_callback(p, re->packet, &p->read_ancil_data, p->receive_packet_callback_userdata);
@@ -1132,7 +1288,7 @@ bool pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = false;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->n_write > 0 || !pa_queue_isempty(p->send_queue);
 
     return b;
 }
@@ -1198,9 +1354,13 @@ void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
 
     if (enable) {
 
-        if (!p->export)
+        if (!p->export) {
             p->export = pa_memexport_new(p->mempool, memexport_revoke_cb, p);
 
+            if (p->export && p->large_export)
+                pa_memexport_set_max_slots(p->export, PA_MEMEXPORT_SLOTS_MAX);
+        }
+
     } else {
 
         if (p->export) {
@@ -1210,6 +1370,16 @@ void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
     }
 }
 
+void pa_pstream_enable_large_export(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->large_export = true;
+
+    if (p->export)
+        pa_memexport_set_max_slots(p->export, PA_MEMEXPORT_SLOTS_MAX);
+}
+
 void pa_pstream_enable_memfd(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
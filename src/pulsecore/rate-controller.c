@@ -0,0 +1,182 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include "rate-controller.h"
+
+/* The loop time constant is a multiple of the update interval, so that the
+ * discrete controller stays well damped regardless of how often it is run. */
+#define TIME_CONSTANT_FACTOR 8
+#define MIN_TIME_CONSTANT (5*PA_USEC_PER_SEC)
+
+/* Never deviate more than 1% from the base rate, and never change the rate
+ * by more than 2‰ in one step; 2‰ can be considered inaudible. */
+#define MAX_DEVIATION 0.01
+#define MAX_STEP 0.002
+
+struct pa_rate_controller {
+    uint32_t base_rate;
+    pa_usec_t target_latency;
+
+    /* In seconds */
+    double time_constant;
+
+    bool primed;
+    pa_usec_t last_time;
+
+    /* All in seconds, relative to the target latency */
+    double filtered_error;
+    double integral;
+
+    /* Relative deviation from the base rate applied in the last step */
+    double correction;
+};
+
+pa_rate_controller* pa_rate_controller_new(uint32_t base_rate, pa_usec_t target_latency, pa_usec_t update_interval) {
+    pa_rate_controller *c;
+
+    pa_assert(base_rate > 0);
+
+    c = pa_xnew0(pa_rate_controller, 1);
+    c->target_latency = target_latency;
+    c->time_constant = (double) PA_MAX(update_interval * TIME_CONSTANT_FACTOR, MIN_TIME_CONSTANT) / PA_USEC_PER_SEC;
+
+    pa_rate_controller_reset(c, base_rate);
+
+    return c;
+}
+
+void pa_rate_controller_free(pa_rate_controller *c) {
+    pa_assert(c);
+
+    pa_xfree(c);
+}
+
+void pa_rate_controller_reset(pa_rate_controller *c, uint32_t base_rate) {
+    pa_assert(c);
+    pa_assert(base_rate > 0);
+
+    c->base_rate = base_rate;
+    c->primed = false;
+    c->last_time = 0;
+    c->filtered_error = 0;
+    c->integral = 0;
+    c->correction = 0;
+}
+
+uint32_t pa_rate_controller_get_base_rate(pa_rate_controller *c) {
+    pa_assert(c);
+
+    return c->base_rate;
+}
+
+void pa_rate_controller_set_target(pa_rate_controller *c, pa_usec_t target_latency) {
+    pa_assert(c);
+
+    /* Keep the filtered error continuous, otherwise a target change would
+     * show up as a step in the proportional term only after filtering. */
+    if (c->primed)
+        c->filtered_error -= ((double) target_latency - (double) c->target_latency) / PA_USEC_PER_SEC;
+
+    c->target_latency = target_latency;
+}
+
+pa_usec_t pa_rate_controller_get_target(pa_rate_controller *c) {
+    pa_assert(c);
+
+    return c->target_latency;
+}
+
+/* The buffer latency L changes with the difference between the (unknown)
+ * relative clock drift d and the relative rate correction x we apply:
+ *
+ *                                 dL/dt = d - x
+ *
+ * With the latency error e = L - L̂ and the PI control law
+ *
+ *                          x = Kp e + Ki ∫ e dt
+ *
+ * this gives e'' + Kp e' + Ki e = d' = 0 for constant drift. Choosing
+ * Kp = 1/τ and Ki = 1/(4τ²) makes the loop critically damped, so the error
+ * decays within a few τ without overshoot, while the integral term converges
+ * to d and hence removes any steady state error.
+ *
+ * Latency measurements are noisy (scheduling jitter, block sized buffers), so
+ * the error is passed through a first order low pass with a time constant of
+ * τ/8 before it enters the control law. If the correction hits the limits,
+ * the integral is not updated any further (conditional integration), so it
+ * does not wind up while the rate is saturated. */
+uint32_t pa_rate_controller_update(pa_rate_controller *c, pa_usec_t now, pa_usec_t latency) {
+    double error, dt, tau, integral, correction;
+
+    pa_assert(c);
+
+    error = ((double) latency - (double) c->target_latency) / PA_USEC_PER_SEC;
+
+    if (!c->primed || now <= c->last_time) {
+        if (!c->primed)
+            c->filtered_error = error;
+
+        c->primed = true;
+        c->last_time = now;
+
+        return (uint32_t) lrint(c->base_rate * (1.0 + c->correction));
+    }
+
+    tau = c->time_constant;
+    dt = PA_MIN((double) (now - c->last_time) / PA_USEC_PER_SEC, tau);
+    c->last_time = now;
+
+    c->filtered_error += (error - c->filtered_error) * dt / (dt + tau / 8);
+
+    integral = c->integral + c->filtered_error * dt;
+    correction = c->filtered_error / tau + integral / (4 * tau * tau);
+
+    if (correction > MAX_DEVIATION || correction < -MAX_DEVIATION)
+        correction = PA_CLAMP(correction, -MAX_DEVIATION, MAX_DEVIATION);
+    else
+        c->integral = integral;
+
+    correction = PA_CLAMP(correction, c->correction - MAX_STEP, c->correction + MAX_STEP);
+    c->correction = correction;
+
+    return (uint32_t) lrint(c->base_rate * (1.0 + correction));
+}
+
+double pa_rate_controller_get_ratio(pa_rate_controller *c) {
+    pa_assert(c);
+
+    return 1.0 + c->correction;
+}
+
+pa_usec_t pa_rate_controller_get_filtered_latency(pa_rate_controller *c) {
+    double l;
+
+    pa_assert(c);
+
+    l = (double) c->target_latency + c->filtered_error * PA_USEC_PER_SEC;
+
+    return l > 0 ? (pa_usec_t) l : 0;
+}
@@ -0,0 +1,64 @@
+#ifndef foopulseratecontrollerhfoo
+#define foopulseratecontrollerhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/sample.h>
+#include <pulsecore/macro.h>
+
+/* A closed-loop controller that keeps the latency of a buffer between two
+ * independent clock domains at a target value by slightly varying the sample
+ * rate of the reading side. It is fed latency observations and returns the
+ * rate that should be passed to pa_sink_input_set_rate() or
+ * pa_resampler_set_input_rate(). A larger latency than the target yields a
+ * higher rate, i.e. the buffer is drained faster.
+ *
+ * The controller does no locking and holds no references, so it can be used
+ * from whichever context owns the stream, be it the main thread or an IO
+ * thread. */
+
+typedef struct pa_rate_controller pa_rate_controller;
+
+/* update_interval is the expected time between two calls to
+ * pa_rate_controller_update(). The reaction time of the loop is derived
+ * from it, but never drops below a few seconds to keep rate changes
+ * inaudible. */
+pa_rate_controller* pa_rate_controller_new(uint32_t base_rate, pa_usec_t target_latency, pa_usec_t update_interval);
+void pa_rate_controller_free(pa_rate_controller *c);
+
+/* Forgets all history, e.g. after a stream was moved or resumed. The next
+ * call to pa_rate_controller_update() only primes the controller. */
+void pa_rate_controller_reset(pa_rate_controller *c, uint32_t base_rate);
+
+/* The nominal rate the controller adjusts around */
+uint32_t pa_rate_controller_get_base_rate(pa_rate_controller *c);
+
+void pa_rate_controller_set_target(pa_rate_controller *c, pa_usec_t target_latency);
+pa_usec_t pa_rate_controller_get_target(pa_rate_controller *c);
+
+/* Feeds the latency observed at time now (in the local clock domain) into
+ * the controller and returns the new rate. */
+uint32_t pa_rate_controller_update(pa_rate_controller *c, pa_usec_t now, pa_usec_t latency);
+
+/* The rate returned by the last update, as ratio of the base rate. */
+double pa_rate_controller_get_ratio(pa_rate_controller *c);
+
+/* The latency after smoothing out measurement noise */
+pa_usec_t pa_rate_controller_get_filtered_latency(pa_rate_controller *c);
+
+#endif
@@ -0,0 +1,382 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/sample.h>
+#include <pulse/xmalloc.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "remap.h"
+
+#include <immintrin.h>
+
+/* The matrix remappers keep one column of the mixing matrix per input
+ * channel, i.e. the contribution of that input to all output channels, and
+ * accumulate broadcast input samples times these columns. Output frames of
+ * up to 4 channels are processed two at a time, one per 128 bit lane, and
+ * the columns are duplicated into both lanes for this. Larger output frames
+ * fill one vector each.
+ *
+ * Like the generic C code, s16 products are shifted down individually
+ * before they are summed up, gains are clamped to [0, 1]. */
+
+typedef struct remap_avx2_state {
+    float f[PA_CHANNELS_MAX][8];
+    int32_t i[PA_CHANNELS_MAX][8];
+    int32_t mask[8];
+} remap_avx2_state;
+
+static const int32_t lane_index[4][8] = {
+    { 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 1, 1, 1, 1, 1, 1, 1, 1 },
+    { 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 3, 3, 3, 3, 3, 3, 3, 3 },
+};
+
+/* Frames at the end that we cannot handle with vector loads and stores */
+static void remap_matrix_float32ne_tail(const remap_avx2_state *s, float *dst, const float *src,
+        unsigned n, unsigned n_ic, unsigned n_oc) {
+    unsigned oc, ic;
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        for (oc = 0; oc < n_oc; oc++) {
+            float sum = 0.0f;
+
+            for (ic = 0; ic < n_ic; ic++)
+                sum += src[ic] * s->f[ic][oc];
+
+            dst[oc] = sum;
+        }
+    }
+}
+
+static void remap_matrix_s16ne_tail(const remap_avx2_state *s, int16_t *dst, const int16_t *src,
+        unsigned n, unsigned n_ic, unsigned n_oc) {
+    unsigned oc, ic;
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        for (oc = 0; oc < n_oc; oc++) {
+            int32_t sum = 0;
+
+            for (ic = 0; ic < n_ic; ic++)
+                sum += ((int32_t) src[ic] * s->i[ic][oc]) >> 16;
+
+            dst[oc] = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        }
+    }
+}
+
+/* Returns how many frames from src on we can process k at a time when
+ * loading whole groups of 4 input channels per frame */
+static inline unsigned pair_frames(unsigned n, unsigned n_ic, unsigned k) {
+    unsigned span = n_ic > 4 ? 8 : 4;
+    unsigned m = n;
+
+    /* The groups of the last frame must not read past the input */
+    while (m > 0 && (m - 1) * n_ic + span > n * n_ic)
+        m--;
+
+    return m - m % k;
+}
+
+static inline __m256 load_frames_float(const float *src, unsigned n_ic) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src)), _mm_loadu_ps(src + n_ic), 1);
+}
+
+static inline __m256i load_frames_s16(const int16_t *src, unsigned n_ic) {
+    __m128i a = _mm_loadl_epi64((const __m128i *) src);
+    __m128i b = _mm_loadl_epi64((const __m128i *) (src + n_ic));
+
+    return _mm256_cvtepi16_epi32(_mm_unpacklo_epi64(a, b));
+}
+
+static inline __m256 mix_frames_float(const remap_avx2_state *s, const float *src, unsigned n_ic) {
+    __m256 acc = _mm256_setzero_ps();
+    unsigned g, ic;
+
+    for (g = 0; g < n_ic; g += 4) {
+        const __m256 v = load_frames_float(src + g, n_ic);
+
+        for (ic = g; ic < n_ic && ic < g + 4; ic++) {
+            const __m256 b = _mm256_permutevar_ps(v, _mm256_loadu_si256((const __m256i *) lane_index[ic - g]));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(b, _mm256_loadu_ps(s->f[ic])));
+        }
+    }
+
+    return acc;
+}
+
+static inline __m256i mix_frames_s16(const remap_avx2_state *s, const int16_t *src, unsigned n_ic) {
+    __m256i acc = _mm256_setzero_si256();
+    unsigned g, ic;
+
+    for (g = 0; g < n_ic; g += 4) {
+        const __m256 v = _mm256_castsi256_ps(load_frames_s16(src + g, n_ic));
+
+        for (ic = g; ic < n_ic && ic < g + 4; ic++) {
+            const __m256i b = _mm256_castps_si256(
+                _mm256_permutevar_ps(v, _mm256_loadu_si256((const __m256i *) lane_index[ic - g])));
+            const __m256i p = _mm256_mullo_epi32(b, _mm256_loadu_si256((const __m256i *) s->i[ic]));
+            acc = _mm256_add_epi32(acc, _mm256_srai_epi32(p, 16));
+        }
+    }
+
+    return acc;
+}
+
+static inline __m128i pack_s32(__m256i v) {
+    return _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+/* Two frames per vector, for up to 8 input and 2 or 4 output channels */
+static inline void remap_pairs_float32ne(const remap_avx2_state *s, float *dst, const float *src,
+        unsigned n, unsigned n_ic, unsigned n_oc) {
+    unsigned k = n_oc == 2 ? 4 : 2;
+    unsigned i, n_vec = pair_frames(n, n_ic, k);
+
+    for (i = 0; i < n_vec; i += k) {
+        __m256 a = mix_frames_float(s, src, n_ic);
+
+        if (n_oc == 2) {
+            __m256 b = mix_frames_float(s, src + 2 * n_ic, n_ic);
+
+            /* [f0 f2 | f1 f3] -> [f0 f1 f2 f3] */
+            a = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 1, 0));
+            a = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(a), _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+
+        _mm256_storeu_ps(dst, a);
+        src += k * n_ic;
+        dst += k * n_oc;
+    }
+
+    remap_matrix_float32ne_tail(s, dst, src, n - n_vec, n_ic, n_oc);
+}
+
+static inline void remap_pairs_s16ne(const remap_avx2_state *s, int16_t *dst, const int16_t *src,
+        unsigned n, unsigned n_ic, unsigned n_oc) {
+    unsigned k = n_oc == 2 ? 4 : 2;
+    unsigned i, n_vec = pair_frames(n, n_ic, k);
+
+    for (i = 0; i < n_vec; i += k) {
+        __m256i a = mix_frames_s16(s, src, n_ic);
+
+        if (n_oc == 2) {
+            __m256i b = mix_frames_s16(s, src + 2 * n_ic, n_ic);
+
+            a = _mm256_unpacklo_epi64(a, b);
+            a = _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+
+        _mm_storeu_si128((__m128i *) dst, pack_s32(a));
+
+        src += k * n_ic;
+        dst += k * n_oc;
+    }
+
+    remap_matrix_s16ne_tail(s, dst, src, n - n_vec, n_ic, n_oc);
+}
+
+/* One frame per vector, for up to 8 output channels */
+static inline void remap_frames_float32ne(const remap_avx2_state *s, float *dst, const float *src,
+        unsigned n, unsigned n_ic, unsigned n_oc) {
+    const __m256i mask = _mm256_loadu_si256((const __m256i *) s->mask);
+    unsigned ic;
+
+    for (; n > 0; n--) {
+        __m256 acc = _mm256_setzero_ps();
+
+        for (ic = 0; ic < n_ic; ic++)
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_broadcast_ss(src + ic), _mm256_loadu_ps(s->f[ic])));
+
+        /* The unused lanes spill into the next frame, which overwrites
+         * them again */
+        if (n * n_oc >= 8)
+            _mm256_storeu_ps(dst, acc);
+        else
+            _mm256_maskstore_ps(dst, mask, acc);
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+static inline void remap_frames_s16ne(const remap_avx2_state *s, int16_t *dst, const int16_t *src,
+        unsigned n, unsigned n_ic, unsigned n_oc) {
+    unsigned ic;
+
+    for (; n > 0; n--) {
+        __m256i acc = _mm256_setzero_si256();
+        __m128i out;
+
+        for (ic = 0; ic < n_ic; ic++) {
+            const __m256i p = _mm256_mullo_epi32(_mm256_set1_epi32(src[ic]),
+                                                 _mm256_loadu_si256((const __m256i *) s->i[ic]));
+            acc = _mm256_add_epi32(acc, _mm256_srai_epi32(p, 16));
+        }
+
+        out = pack_s32(acc);
+
+        if (n * n_oc >= 8)
+            _mm_storeu_si128((__m128i *) dst, out);
+        else {
+            int16_t t[8];
+
+            _mm_storeu_si128((__m128i *) t, out);
+            memcpy(dst, t, n_oc * sizeof(int16_t));
+        }
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+/* Instances for the common layouts, where the channel counts are known at
+ * compile time */
+static void remap_ch6_to_stereo_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_pairs_float32ne(m->state, dst, src, n, 6, 2);
+}
+
+static void remap_ch6_to_stereo_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_pairs_s16ne(m->state, dst, src, n, 6, 2);
+}
+
+static void remap_ch8_to_stereo_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_pairs_float32ne(m->state, dst, src, n, 8, 2);
+}
+
+static void remap_ch8_to_stereo_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_pairs_s16ne(m->state, dst, src, n, 8, 2);
+}
+
+static void remap_stereo_to_ch6_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_frames_float32ne(m->state, dst, src, n, 2, 6);
+}
+
+static void remap_stereo_to_ch6_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_frames_s16ne(m->state, dst, src, n, 2, 6);
+}
+
+static void remap_stereo_to_ch8_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_frames_float32ne(m->state, dst, src, n, 2, 8);
+}
+
+static void remap_stereo_to_ch8_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_frames_s16ne(m->state, dst, src, n, 2, 8);
+}
+
+/* ... and for everything else */
+static void remap_pairs_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_pairs_float32ne(m->state, dst, src, n, m->i_ss.channels, m->o_ss.channels);
+}
+
+static void remap_pairs_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_pairs_s16ne(m->state, dst, src, n, m->i_ss.channels, m->o_ss.channels);
+}
+
+static void remap_frames_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_frames_float32ne(m->state, dst, src, n, m->i_ss.channels, m->o_ss.channels);
+}
+
+static void remap_frames_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_frames_s16ne(m->state, dst, src, n, m->i_ss.channels, m->o_ss.channels);
+}
+
+static pa_init_remap_func_t init_remap_fallback;
+
+static void init_remap_avx2(pa_remap_t *m) {
+    unsigned n_oc, n_ic, ic, oc;
+    int8_t arrange[PA_CHANNELS_MAX];
+    remap_avx2_state *s;
+    bool pairs;
+
+    n_oc = m->o_ss.channels;
+    n_ic = m->i_ss.channels;
+
+    /* Leave the mono cases and the plain copies the generic code has
+     * special functions for to the others */
+    if (n_ic < 2 || n_oc < 2 || n_oc > 8 ||
+            ((n_oc == 2 || n_oc == 4) && pa_setup_remap_arrange(m, arrange))) {
+        init_remap_fallback(m);
+        return;
+    }
+
+    pairs = (n_oc == 2 || n_oc == 4) && n_ic <= 8;
+
+    if (n_ic == 6 && n_oc == 2) {
+        pa_log_info("Using AVX2 6-channel to stereo remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_ch6_to_stereo_s16ne_avx2,
+            (pa_do_remap_func_t) remap_ch6_to_stereo_float32ne_avx2);
+    } else if (n_ic == 8 && n_oc == 2) {
+        pa_log_info("Using AVX2 8-channel to stereo remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_ch8_to_stereo_s16ne_avx2,
+            (pa_do_remap_func_t) remap_ch8_to_stereo_float32ne_avx2);
+    } else if (n_ic == 2 && n_oc == 6) {
+        pa_log_info("Using AVX2 stereo to 6-channel remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_stereo_to_ch6_s16ne_avx2,
+            (pa_do_remap_func_t) remap_stereo_to_ch6_float32ne_avx2);
+    } else if (n_ic == 2 && n_oc == 8) {
+        pa_log_info("Using AVX2 stereo to 8-channel remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_stereo_to_ch8_s16ne_avx2,
+            (pa_do_remap_func_t) remap_stereo_to_ch8_float32ne_avx2);
+    } else if (pairs) {
+        pa_log_info("Using AVX2 matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_pairs_s16ne_avx2,
+            (pa_do_remap_func_t) remap_pairs_float32ne_avx2);
+    } else {
+        pa_log_info("Using AVX2 matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_frames_s16ne_avx2,
+            (pa_do_remap_func_t) remap_frames_float32ne_avx2);
+    }
+
+    /* setup state */
+    s = m->state = pa_xnew0(remap_avx2_state, 1);
+
+    for (ic = 0; ic < n_ic; ic++) {
+        for (oc = 0; oc < n_oc; oc++) {
+            float f = PA_CLAMP_UNLIKELY(m->map_table_f[oc][ic], 0.0f, 1.0f);
+            int32_t i = PA_CLAMP_UNLIKELY(m->map_table_i[oc][ic], 0, 0x10000);
+
+            s->f[ic][oc] = f;
+            s->i[ic][oc] = i;
+
+            /* Both lanes get the column when processing frame pairs */
+            if (pairs) {
+                s->f[ic][oc + 4] = f;
+                s->i[ic][oc + 4] = i;
+            }
+        }
+    }
+
+    for (oc = 0; oc < n_oc; oc++)
+        s->mask[oc] = -1;
+}
+
+void pa_remap_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized remappers.");
+        init_remap_fallback = pa_get_init_remap_func();
+        pa_set_init_remap_func((pa_init_remap_func_t) init_remap_avx2);
+    }
+}
@@ -61,6 +61,7 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_SOXR_MQ,
     PA_RESAMPLER_SOXR_HQ,
     PA_RESAMPLER_SOXR_VHQ,
+    PA_RESAMPLER_POLYPHASE,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -172,6 +173,39 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_polyphase_init(pa_resampler *r);
+
+/* Inner products used by the polyphase resampler: out[c] is the product of
+ * the n samples at x + c * stride with h, for every channel c. n is a
+ * multiple of 8. */
+typedef void (*pa_polyphase_dot_func_t) (float *out, const float *x, unsigned stride, unsigned channels, const float *h, unsigned n);
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void);
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func);
+
+/* Max-abs reduction used by the peaks resampler: raises max[c] to the largest
+ * absolute value of channel c in n interleaved frames. max and src are
+ * int16_t for PA_SAMPLE_S16NE and float for PA_SAMPLE_FLOAT32NE. */
+typedef void (*pa_peaks_func_t) (void *max, const void *src, unsigned channels, unsigned n);
+
+pa_peaks_func_t pa_get_peaks_func(pa_sample_format_t f);
+void pa_set_peaks_func(pa_sample_format_t f, pa_peaks_func_t func);
+
+/* Peak detecting resamplers with the same parameters that are run on the
+ * same chunks, like all the VU meters of one source, can share a single pass
+ * over the audio through this cache. It may only be used from one thread. */
+typedef struct pa_peaks_cache pa_peaks_cache;
+
+pa_peaks_cache *pa_peaks_cache_new(void);
+void pa_peaks_cache_free(pa_peaks_cache *c);
+/* Drops all cached chunks */
+void pa_peaks_cache_flush(pa_peaks_cache *c);
+
+/* Like pa_resampler_run() for a PA_RESAMPLER_PEAKS resampler. If another
+ * resampler has already run on in, its output is returned. A resampler whose
+ * state differs, e.g. because it was created later, takes over the state of
+ * that one, so that the two stay in step afterwards. */
+void pa_resampler_run_peaks_cached(pa_resampler *r, pa_peaks_cache *c, const pa_memchunk *in, pa_memchunk *out);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
@@ -23,6 +23,7 @@
 
 #include <pulse/xmalloc.h>
 #include <math.h>
+#include <string.h>
 
 #include <pulsecore/resampler.h>
 
@@ -34,6 +35,71 @@ struct peaks_data { /* data specific to the peak finder pseudo resampler */
     int16_t max_i[PA_CHANNELS_MAX];
 };
 
+static void peaks_s16ne_c(int16_t *max, const int16_t *src, unsigned channels, unsigned n) {
+    unsigned c;
+
+    for (; n > 0; n--)
+        for (c = 0; c < channels; c++) {
+            /* The absolute value of -0x8000 does not fit */
+            int16_t v = PA_MIN(abs(*src++), 0x7FFF);
+
+            if (v > max[c])
+                max[c] = v;
+        }
+}
+
+static void peaks_float32ne_c(float *max, const float *src, unsigned channels, unsigned n) {
+    unsigned c;
+
+    /* 1ch is treated separately, because that is the common case */
+    if (channels == 1) {
+        for (; n > 0; n--) {
+            float v = fabsf(*src++);
+
+            if (v > max[0])
+                max[0] = v;
+        }
+        return;
+    }
+
+    for (; n > 0; n--)
+        for (c = 0; c < channels; c++) {
+            float v = fabsf(*src++);
+
+            if (v > max[c])
+                max[c] = v;
+        }
+}
+
+static pa_peaks_func_t peaks_s16ne_func = (pa_peaks_func_t) peaks_s16ne_c;
+static pa_peaks_func_t peaks_float32ne_func = (pa_peaks_func_t) peaks_float32ne_c;
+
+pa_peaks_func_t pa_get_peaks_func(pa_sample_format_t f) {
+    switch (f) {
+        case PA_SAMPLE_S16NE:
+            return peaks_s16ne_func;
+        case PA_SAMPLE_FLOAT32NE:
+            return peaks_float32ne_func;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+void pa_set_peaks_func(pa_sample_format_t f, pa_peaks_func_t func) {
+    pa_assert(func);
+
+    switch (f) {
+        case PA_SAMPLE_S16NE:
+            peaks_s16ne_func = func;
+            break;
+        case PA_SAMPLE_FLOAT32NE:
+            peaks_float32ne_func = func;
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
 static unsigned peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
     unsigned c, o_index = 0;
     unsigned i, i_end = 0;
@@ -53,39 +119,22 @@ static unsigned peaks_resample(pa_resampler *r, const pa_memchunk *input, unsign
     i = i > peaks_data->i_counter ? i - peaks_data->i_counter : 0;
 
     while (i_end < in_n_frames) {
+        unsigned n;
+
         i_end = ((uint64_t) (peaks_data->o_counter + 1) * r->i_ss.rate) / r->o_ss.rate;
         i_end = i_end > peaks_data->i_counter ? i_end - peaks_data->i_counter : 0;
 
         pa_assert_fp(o_index * r->w_fz < pa_memblock_get_length(output->memblock));
 
-        /* 1ch float is treated separately, because that is the common case */
-        if (r->work_channels == 1 && r->work_format == PA_SAMPLE_FLOAT32NE) {
-            float *s = (float*) src + i;
-            float *d = (float*) dst + o_index;
+        /* Number of frames of this output frame that are in the input */
+        n = PA_MIN(i_end, in_n_frames);
+        n = n > i ? n - i : 0;
 
-            for (; i < i_end && i < in_n_frames; i++) {
-                float n = fabsf(*s++);
-
-                if (n > peaks_data->max_f[0])
-                    peaks_data->max_f[0] = n;
-            }
-
-            if (i == i_end) {
-                *d = peaks_data->max_f[0];
-                peaks_data->max_f[0] = 0;
-                o_index++, peaks_data->o_counter++;
-            }
-        } else if (r->work_format == PA_SAMPLE_S16NE) {
-            int16_t *s = (int16_t*) src + r->work_channels * i;
+        if (r->work_format == PA_SAMPLE_S16NE) {
             int16_t *d = (int16_t*) dst + r->work_channels * o_index;
 
-            for (; i < i_end && i < in_n_frames; i++)
-                for (c = 0; c < r->work_channels; c++) {
-                    int16_t n = abs(*s++);
-
-                    if (n > peaks_data->max_i[c])
-                        peaks_data->max_i[c] = n;
-                }
+            peaks_s16ne_func(peaks_data->max_i, (int16_t*) src + r->work_channels * i, r->work_channels, n);
+            i += n;
 
             if (i == i_end) {
                 for (c = 0; c < r->work_channels; c++, d++) {
@@ -95,16 +144,10 @@ static unsigned peaks_resample(pa_resampler *r, const pa_memchunk *input, unsign
                 o_index++, peaks_data->o_counter++;
             }
         } else {
-            float *s = (float*) src + r->work_channels * i;
             float *d = (float*) dst + r->work_channels * o_index;
 
-            for (; i < i_end && i < in_n_frames; i++)
-                for (c = 0; c < r->work_channels; c++) {
-                    float n = fabsf(*s++);
-
-                    if (n > peaks_data->max_f[c])
-                        peaks_data->max_f[c] = n;
-                }
+            peaks_float32ne_func(peaks_data->max_f, (float*) src + r->work_channels * i, r->work_channels, n);
+            i += n;
 
             if (i == i_end) {
                 for (c = 0; c < r->work_channels; c++, d++) {
@@ -159,3 +202,127 @@ int pa_resampler_peaks_init(pa_resampler*r) {
 
     return 0;
 }
+
+/* The output of a peaks resampler only depends on its parameters, its
+ * peaks_data and the input, so the cache remembers, for the last few input
+ * chunks, the parameters, the output and the peaks_data after the run. The
+ * chunks are referenced so that their memblocks cannot be reused for other
+ * audio while they are in the cache. */
+#define PEAKS_CACHE_ENTRIES 8
+
+struct peaks_cache_entry {
+    pa_resample_flags_t flags;
+    pa_sample_spec i_ss, o_ss;
+    pa_channel_map i_cm, o_cm;
+
+    pa_memchunk in, out;
+    struct peaks_data after;
+};
+
+struct pa_peaks_cache {
+    struct peaks_cache_entry entries[PEAKS_CACHE_ENTRIES];
+    unsigned next;
+};
+
+static void cache_entry_done(struct peaks_cache_entry *e) {
+    if (e->in.memblock)
+        pa_memblock_unref(e->in.memblock);
+    if (e->out.memblock)
+        pa_memblock_unref(e->out.memblock);
+
+    pa_memchunk_reset(&e->in);
+    pa_memchunk_reset(&e->out);
+}
+
+static bool cache_entry_matches(struct peaks_cache_entry *e, pa_resampler *r, const pa_memchunk *in) {
+    return e->in.memblock == in->memblock &&
+        e->in.index == in->index &&
+        e->in.length == in->length &&
+        e->flags == r->flags &&
+        pa_sample_spec_equal(&e->i_ss, &r->i_ss) &&
+        pa_sample_spec_equal(&e->o_ss, &r->o_ss) &&
+        pa_channel_map_equal(&e->i_cm, &r->i_cm) &&
+        pa_channel_map_equal(&e->o_cm, &r->o_cm);
+}
+
+pa_peaks_cache *pa_peaks_cache_new(void) {
+    return pa_xnew0(pa_peaks_cache, 1);
+}
+
+void pa_peaks_cache_free(pa_peaks_cache *c) {
+    pa_assert(c);
+
+    pa_peaks_cache_flush(c);
+    pa_xfree(c);
+}
+
+void pa_peaks_cache_flush(pa_peaks_cache *c) {
+    unsigned i;
+
+    pa_assert(c);
+
+    for (i = 0; i < PEAKS_CACHE_ENTRIES; i++)
+        cache_entry_done(&c->entries[i]);
+
+    c->next = 0;
+}
+
+void pa_resampler_run_peaks_cached(pa_resampler *r, pa_peaks_cache *c, const pa_memchunk *in, pa_memchunk *out) {
+    struct peaks_data *peaks_data;
+    struct peaks_cache_entry *e;
+    unsigned i;
+
+    pa_assert(r);
+    pa_assert(c);
+    pa_assert(in);
+    pa_assert(out);
+    pa_assert(r->method == PA_RESAMPLER_PEAKS);
+
+    peaks_data = r->impl.data;
+
+    /* The LFE filter has state of its own */
+    if (r->lfe_filter) {
+        pa_resampler_run(r, in, out);
+        return;
+    }
+
+    for (i = 0; i < PEAKS_CACHE_ENTRIES; i++) {
+        e = &c->entries[i];
+
+        if (!cache_entry_matches(e, r, in))
+            continue;
+
+        /* Already ran on this very chunk, which happens with chunks that are
+         * posted more than once, like the shared silence block */
+        if (memcmp(peaks_data, &e->after, sizeof(*peaks_data)) == 0) {
+            pa_resampler_run(r, in, out);
+            return;
+        }
+
+        *peaks_data = e->after;
+        *out = e->out;
+        if (out->memblock)
+            pa_memblock_ref(out->memblock);
+
+        return;
+    }
+
+    e = &c->entries[c->next];
+    c->next = (c->next + 1) % PEAKS_CACHE_ENTRIES;
+    cache_entry_done(e);
+
+    pa_resampler_run(r, in, out);
+    e->after = *peaks_data;
+
+    e->flags = r->flags;
+    e->i_ss = r->i_ss;
+    e->o_ss = r->o_ss;
+    e->i_cm = r->i_cm;
+    e->o_cm = r->o_cm;
+
+    e->in = *in;
+    pa_memblock_ref(e->in.memblock);
+    e->out = *out;
+    if (e->out.memblock)
+        pa_memblock_ref(e->out.memblock);
+}
@@ -0,0 +1,158 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#include <immintrin.h>
+
+/* Samples are reduced in blocks of vectors that also hold a whole number of
+ * frames, so that every lane always sees the same channel. The lanes are
+ * folded into the channels at the end. Short blocks are repeated to have at
+ * least 4 independent accumulators. */
+#define MAX_VECTORS 32
+
+static unsigned block_vectors(unsigned channels, unsigned lanes) {
+    unsigned samples = channels;
+
+    while (samples % lanes)
+        samples += channels;
+
+    while (samples < 4 * lanes)
+        samples *= 2;
+
+    return samples / lanes;
+}
+
+/* Inlined with a constant k for the common channel counts, which keeps the
+ * accumulators in registers */
+static inline __attribute__((always_inline)) unsigned reduce_float32(__m256 *acc, unsigned k, const float *src, unsigned samples) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    unsigned v, done;
+
+    /* max_ps returns its second operand for NaN, so NaN is ignored like in
+     * the generic version */
+    for (done = 0; samples - done >= k * 8; done += k * 8, src += k * 8)
+        for (v = 0; v < k; v++)
+            acc[v] = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(src + v * 8), abs_mask), acc[v]);
+
+    return done;
+}
+
+static void peaks_float32ne_avx2(float *max, const float *src, unsigned channels, unsigned n) {
+    __m256 acc[MAX_VECTORS];
+    float lanes[MAX_VECTORS * 8];
+    unsigned i, k, done, samples = n * channels;
+
+    k = block_vectors(channels, 8);
+
+    for (i = 0; i < k * 8; i++)
+        lanes[i] = max[i % channels];
+    for (i = 0; i < k; i++)
+        acc[i] = _mm256_loadu_ps(lanes + i * 8);
+
+    switch (k) {
+        case 4: done = reduce_float32(acc, 4, src, samples); break;
+        case 5: done = reduce_float32(acc, 5, src, samples); break;
+        case 6: done = reduce_float32(acc, 6, src, samples); break;
+        case 7: done = reduce_float32(acc, 7, src, samples); break;
+        default: done = reduce_float32(acc, k, src, samples); break;
+    }
+
+    for (i = 0; i < k; i++)
+        _mm256_storeu_ps(lanes + i * 8, acc[i]);
+
+    for (i = 0; i < k * 8; i++)
+        if (lanes[i] > max[i % channels])
+            max[i % channels] = lanes[i];
+
+    /* The rest starts on a frame boundary */
+    for (i = done; i < samples; i++) {
+        float v = fabsf(src[i]);
+
+        if (v > max[(i - done) % channels])
+            max[(i - done) % channels] = v;
+    }
+}
+
+static inline __attribute__((always_inline)) unsigned reduce_s16(__m256i *acc, unsigned k, const int16_t *src, unsigned samples) {
+    const __m256i limit = _mm256_set1_epi16(0x7fff);
+    unsigned v, done;
+
+    /* The absolute value of -0x8000 stays 0x8000 and is clamped as unsigned */
+    for (done = 0; samples - done >= k * 16; done += k * 16, src += k * 16)
+        for (v = 0; v < k; v++) {
+            __m256i x = _mm256_abs_epi16(_mm256_loadu_si256((const __m256i *) (src + v * 16)));
+
+            acc[v] = _mm256_max_epi16(_mm256_min_epu16(x, limit), acc[v]);
+        }
+
+    return done;
+}
+
+static void peaks_s16ne_avx2(int16_t *max, const int16_t *src, unsigned channels, unsigned n) {
+    __m256i acc[MAX_VECTORS];
+    int16_t lanes[MAX_VECTORS * 16];
+    unsigned i, k, done, samples = n * channels;
+
+    k = block_vectors(channels, 16);
+
+    for (i = 0; i < k * 16; i++)
+        lanes[i] = max[i % channels];
+    for (i = 0; i < k; i++)
+        acc[i] = _mm256_loadu_si256((const __m256i *) (lanes + i * 16));
+
+    switch (k) {
+        case 4: done = reduce_s16(acc, 4, src, samples); break;
+        case 5: done = reduce_s16(acc, 5, src, samples); break;
+        case 6: done = reduce_s16(acc, 6, src, samples); break;
+        case 7: done = reduce_s16(acc, 7, src, samples); break;
+        default: done = reduce_s16(acc, k, src, samples); break;
+    }
+
+    for (i = 0; i < k; i++)
+        _mm256_storeu_si256((__m256i *) (lanes + i * 16), acc[i]);
+
+    for (i = 0; i < k * 16; i++)
+        if (lanes[i] > max[i % channels])
+            max[i % channels] = lanes[i];
+
+    for (i = done; i < samples; i++) {
+        int16_t v = PA_MIN(abs(src[i]), 0x7FFF);
+
+        if (v > max[(i - done) % channels])
+            max[(i - done) % channels] = v;
+    }
+}
+
+void pa_peaks_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized peak detection.");
+
+        pa_set_peaks_func(PA_SAMPLE_FLOAT32NE, (pa_peaks_func_t) peaks_float32ne_avx2);
+        pa_set_peaks_func(PA_SAMPLE_S16NE, (pa_peaks_func_t) peaks_s16ne_avx2);
+    }
+}
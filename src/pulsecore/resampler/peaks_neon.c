@@ -0,0 +1,148 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#include <arm_neon.h>
+
+/* See peaks_avx2.c: blocks of vectors holding whole frames, folded into the
+ * channels at the end */
+#define MAX_VECTORS 32
+
+static unsigned block_vectors(unsigned channels, unsigned lanes) {
+    unsigned samples = channels;
+
+    while (samples % lanes)
+        samples += channels;
+
+    while (samples < 4 * lanes)
+        samples *= 2;
+
+    return samples / lanes;
+}
+
+static inline __attribute__((always_inline)) unsigned reduce_float32(float32x4_t *acc, unsigned k, const float *src, unsigned samples) {
+    unsigned v, done;
+
+    /* vmaxq_f32 would return NaN, the generic version ignores it */
+    for (done = 0; samples - done >= k * 4; done += k * 4, src += k * 4)
+        for (v = 0; v < k; v++) {
+            float32x4_t x = vabsq_f32(vld1q_f32(src + v * 4));
+
+            acc[v] = vbslq_f32(vcgtq_f32(x, acc[v]), x, acc[v]);
+        }
+
+    return done;
+}
+
+static void peaks_float32ne_neon(float *max, const float *src, unsigned channels, unsigned n) {
+    float32x4_t acc[MAX_VECTORS];
+    float lanes[MAX_VECTORS * 4];
+    unsigned i, k, done, samples = n * channels;
+
+    k = block_vectors(channels, 4);
+
+    for (i = 0; i < k * 4; i++)
+        lanes[i] = max[i % channels];
+    for (i = 0; i < k; i++)
+        acc[i] = vld1q_f32(lanes + i * 4);
+
+    switch (k) {
+        case 4: done = reduce_float32(acc, 4, src, samples); break;
+        case 5: done = reduce_float32(acc, 5, src, samples); break;
+        case 6: done = reduce_float32(acc, 6, src, samples); break;
+        case 7: done = reduce_float32(acc, 7, src, samples); break;
+        default: done = reduce_float32(acc, k, src, samples); break;
+    }
+
+    for (i = 0; i < k; i++)
+        vst1q_f32(lanes + i * 4, acc[i]);
+
+    for (i = 0; i < k * 4; i++)
+        if (lanes[i] > max[i % channels])
+            max[i % channels] = lanes[i];
+
+    for (i = done; i < samples; i++) {
+        float v = fabsf(src[i]);
+
+        if (v > max[(i - done) % channels])
+            max[(i - done) % channels] = v;
+    }
+}
+
+static inline __attribute__((always_inline)) unsigned reduce_s16(int16x8_t *acc, unsigned k, const int16_t *src, unsigned samples) {
+    unsigned v, done;
+
+    /* The saturating absolute value clamps -0x8000 like the generic version */
+    for (done = 0; samples - done >= k * 8; done += k * 8, src += k * 8)
+        for (v = 0; v < k; v++)
+            acc[v] = vmaxq_s16(vqabsq_s16(vld1q_s16(src + v * 8)), acc[v]);
+
+    return done;
+}
+
+static void peaks_s16ne_neon(int16_t *max, const int16_t *src, unsigned channels, unsigned n) {
+    int16x8_t acc[MAX_VECTORS];
+    int16_t lanes[MAX_VECTORS * 8];
+    unsigned i, k, done, samples = n * channels;
+
+    k = block_vectors(channels, 8);
+
+    for (i = 0; i < k * 8; i++)
+        lanes[i] = max[i % channels];
+    for (i = 0; i < k; i++)
+        acc[i] = vld1q_s16(lanes + i * 8);
+
+    switch (k) {
+        case 4: done = reduce_s16(acc, 4, src, samples); break;
+        case 5: done = reduce_s16(acc, 5, src, samples); break;
+        case 6: done = reduce_s16(acc, 6, src, samples); break;
+        case 7: done = reduce_s16(acc, 7, src, samples); break;
+        default: done = reduce_s16(acc, k, src, samples); break;
+    }
+
+    for (i = 0; i < k; i++)
+        vst1q_s16(lanes + i * 8, acc[i]);
+
+    for (i = 0; i < k * 8; i++)
+        if (lanes[i] > max[i % channels])
+            max[i % channels] = lanes[i];
+
+    for (i = done; i < samples; i++) {
+        int16_t v = PA_MIN(abs(src[i]), 0x7FFF);
+
+        if (v > max[(i - done) % channels])
+            max[(i - done) % channels] = v;
+    }
+}
+
+void pa_peaks_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized peak detection.");
+
+    pa_set_peaks_func(PA_SAMPLE_FLOAT32NE, (pa_peaks_func_t) peaks_float32ne_neon);
+    pa_set_peaks_func(PA_SAMPLE_S16NE, (pa_peaks_func_t) peaks_s16ne_neon);
+}
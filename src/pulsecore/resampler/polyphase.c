@@ -0,0 +1,408 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+/* A windowed sinc resampler. For ratios that reduce to at most
+ * MAX_EXACT_PHASES output samples per input period (44.1 -> 48 kHz is
+ * 160/147, 32 -> 48 kHz is 3/2) the filter for every output phase is
+ * precomputed, so each output sample is a single inner product. Other
+ * ratios, including the ones a variable rate stream drifts through, use a
+ * bank of INTERP_PHASES phases and interpolate linearly between the two
+ * closest ones. */
+
+#define BASE_TAPS 48
+#define MAX_TAPS 256
+#define CUTOFF 0.9
+#define KAISER_BETA 7.5
+#define MAX_EXACT_PHASES 320
+#define INTERP_PHASES_SHIFT 8
+#define INTERP_PHASES (1U << INTERP_PHASES_SHIFT)
+
+/* How many input frames we deinterleave into the history at a time */
+#define BLOCK_FRAMES 1024
+
+struct polyphase_data {
+    unsigned channels;
+
+    /* Current filter bank, (phases + 1) rows of taps coefficients, and
+     * room for one interpolated row */
+    float *bank, *interp;
+    unsigned taps, phases;
+    bool exact;
+    double cutoff;
+
+    /* Exact mode: advance by step_int frames and step_frac phases per
+     * output sample, phase counts in 1/phases. Interpolating mode: phase
+     * counts in 2^-32 input frames. */
+    unsigned step_int;
+    uint32_t step_frac;
+
+    /* Per channel history, the next output is centered between
+     * frame pos + taps/2 - 1 and the one after it, at phase */
+    float *hist;
+    unsigned hist_size, hist_len;
+    unsigned pos;
+    uint32_t phase;
+};
+
+static void dot_c(float *out, const float *x, unsigned stride, unsigned channels, const float *h, unsigned n) {
+    unsigned c, k;
+
+    for (c = 0; c < channels; c++, x += stride) {
+        float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+        for (k = 0; k < n; k += 4) {
+            s0 += x[k] * h[k];
+            s1 += x[k + 1] * h[k + 1];
+            s2 += x[k + 2] * h[k + 2];
+            s3 += x[k + 3] * h[k + 3];
+        }
+
+        out[c] = (s0 + s1) + (s2 + s3);
+    }
+}
+
+static pa_polyphase_dot_func_t dot_func = dot_c;
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+/* Zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    unsigned k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+static double kaiser_sinc(double d, double cutoff, unsigned taps) {
+    double w = d / (taps / 2);
+    double h;
+
+    if (w <= -1 || w >= 1)
+        return 0;
+
+    h = fabs(d) < 1e-9 ? cutoff : sin(M_PI * cutoff * d) / (M_PI * d);
+
+    return h * bessel_i0(KAISER_BETA * sqrt(1 - w * w)) / bessel_i0(KAISER_BETA);
+}
+
+static void build_bank(struct polyphase_data *p) {
+    unsigned q, k;
+
+    p->bank = pa_xrealloc(p->bank, (p->phases + 2) * p->taps * sizeof(float));
+    p->interp = p->bank + (p->phases + 1) * p->taps;
+
+    for (q = 0; q <= p->phases; q++) {
+        float *row = p->bank + q * p->taps;
+        double x = (double) q / p->phases, sum = 0;
+
+        for (k = 0; k < p->taps; k++) {
+            row[k] = (float) kaiser_sinc(x + p->taps / 2 - 1 - (double) k, p->cutoff, p->taps);
+            sum += row[k];
+        }
+
+        /* Unity gain at DC for every phase */
+        for (k = 0; k < p->taps; k++)
+            row[k] = (float) (row[k] / sum);
+    }
+}
+
+/* Changes the filter length, keeping the history centered on the same
+ * input frame */
+static void set_taps(struct polyphase_data *p, unsigned taps) {
+    unsigned center, c, size;
+    float *hist;
+
+    size = taps + BLOCK_FRAMES;
+    hist = pa_xnew0(float, p->channels * size);
+
+    if (!p->hist) {
+        p->hist = hist;
+        p->hist_size = size;
+        p->taps = taps;
+        return;
+    }
+
+    center = p->pos + p->taps / 2 - 1;
+
+    if (center < taps / 2 - 1) {
+        unsigned pad = taps / 2 - 1 - center;
+
+        for (c = 0; c < p->channels; c++)
+            memcpy(hist + c * size + pad, p->hist + c * p->hist_size, p->hist_len * sizeof(float));
+
+        p->hist_len += pad;
+        p->pos = 0;
+    } else {
+        unsigned skip = PA_MIN(center - (taps / 2 - 1), p->hist_len);
+
+        for (c = 0; c < p->channels; c++)
+            memcpy(hist + c * size, p->hist + c * p->hist_size + skip, (p->hist_len - skip) * sizeof(float));
+
+        p->hist_len -= skip;
+        p->pos = center - (taps / 2 - 1) - skip;
+    }
+
+    pa_xfree(p->hist);
+    p->hist = hist;
+    p->hist_size = size;
+    p->taps = taps;
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    struct polyphase_data *p;
+    unsigned g, l, m, taps, phases;
+    double ratio, cutoff;
+    uint64_t frac;
+    bool exact;
+
+    pa_assert(r);
+
+    p = r->impl.data;
+
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    l = r->o_ss.rate / g;
+    m = r->i_ss.rate / g;
+
+    ratio = (double) r->o_ss.rate / r->i_ss.rate;
+
+    /* When downsampling the filter has to cut below the output Nyquist
+     * frequency, and gets proportionally longer to keep its steepness */
+    if (ratio < 1) {
+        cutoff = CUTOFF * ratio;
+        taps = PA_MIN(PA_ROUND_UP((unsigned) ceil(BASE_TAPS / ratio), 8U), (unsigned) MAX_TAPS);
+    } else {
+        cutoff = CUTOFF;
+        taps = BASE_TAPS;
+    }
+
+    exact = l <= MAX_EXACT_PHASES;
+    phases = exact ? l : INTERP_PHASES;
+
+    /* Carry the current position over in units of 2^-32 frames */
+    if (!p->bank)
+        frac = 0;
+    else if (p->exact)
+        frac = ((uint64_t) p->phase << 32) / p->phases;
+    else
+        frac = p->phase;
+
+    if (exact) {
+        p->step_int = m / l;
+        p->step_frac = m % l;
+        frac = (frac * l + (1ULL << 31)) >> 32;
+
+        if (frac >= l) {
+            frac = 0;
+            p->pos++;
+        }
+    } else {
+        uint64_t step = ((uint64_t) r->i_ss.rate << 32) / r->o_ss.rate;
+
+        p->step_int = (unsigned) (step >> 32);
+        p->step_frac = (uint32_t) step;
+    }
+
+    p->phase = (uint32_t) frac;
+
+    if (taps != p->taps)
+        set_taps(p, taps);
+
+    if (!p->bank || exact != p->exact || phases != p->phases || cutoff != p->cutoff) {
+        p->exact = exact;
+        p->phases = phases;
+        p->cutoff = cutoff;
+        build_bank(p);
+    }
+
+    pa_log_debug("Polyphase resampler: %u taps, %u %s phases.", p->taps, p->phases, p->exact ? "exact" : "interpolated");
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    struct polyphase_data *p;
+
+    pa_assert(r);
+
+    p = r->impl.data;
+
+    /* Start with silence up to the first frame's position */
+    memset(p->hist, 0, p->channels * p->hist_size * sizeof(float));
+    p->hist_len = p->taps / 2 - 1;
+    p->pos = 0;
+    p->phase = 0;
+}
+
+/* Produces output until the history runs out or out_max is reached,
+ * returns the number of frames written */
+static unsigned polyphase_run(struct polyphase_data *p, float *out, unsigned out_max) {
+    pa_polyphase_dot_func_t dot = dot_func;
+    unsigned o;
+
+    for (o = 0; o < out_max && p->pos + p->taps <= p->hist_len; o++, out += p->channels) {
+
+        if (p->exact) {
+            dot(out, p->hist + p->pos, p->hist_size, p->channels, p->bank + p->phase * p->taps, p->taps);
+
+            p->pos += p->step_int;
+            if ((p->phase += p->step_frac) >= p->phases) {
+                p->phase -= p->phases;
+                p->pos++;
+            }
+        } else {
+            unsigned q = p->phase >> (32 - INTERP_PHASES_SHIFT), k;
+            float w = (float) (p->phase & ((1U << (32 - INTERP_PHASES_SHIFT)) - 1)) / (1U << (32 - INTERP_PHASES_SHIFT));
+            const float *h0 = p->bank + q * p->taps, *h1 = h0 + p->taps;
+
+            /* Interpolate the filter once, rather than the output of
+             * every channel */
+            for (k = 0; k < p->taps; k++)
+                p->interp[k] = h0[k] + w * (h1[k] - h0[k]);
+
+            dot(out, p->hist + p->pos, p->hist_size, p->channels, p->interp, p->taps);
+
+            p->pos += p->step_int;
+            if ((p->phase += p->step_frac) < p->step_frac)
+                p->pos++;
+        }
+    }
+
+    return o;
+}
+
+/* Drops the history that no output needs anymore */
+static void polyphase_compact(struct polyphase_data *p) {
+    unsigned n, c;
+
+    if (!(n = PA_MIN(p->pos, p->hist_len)))
+        return;
+
+    for (c = 0; c < p->channels; c++) {
+        float *h = p->hist + c * p->hist_size;
+        memmove(h, h + n, (p->hist_len - n) * sizeof(float));
+    }
+
+    p->hist_len -= n;
+    p->pos -= n;
+}
+
+static unsigned polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    struct polyphase_data *p;
+    const float *in;
+    float *out;
+    unsigned o = 0;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    p = r->impl.data;
+
+    in = pa_memblock_acquire_chunk(input);
+    out = pa_memblock_acquire_chunk(output);
+
+    while (in_n_frames > 0) {
+        unsigned n = PA_MIN(in_n_frames, p->hist_size - p->hist_len), i, c;
+
+        for (c = 0; c < p->channels; c++) {
+            float *h = p->hist + c * p->hist_size + p->hist_len;
+
+            for (i = 0; i < n; i++)
+                h[i] = in[i * p->channels + c];
+        }
+
+        p->hist_len += n;
+        in += n * p->channels;
+        in_n_frames -= n;
+
+        o += polyphase_run(p, out + o * p->channels, *out_n_frames - o);
+        polyphase_compact(p);
+
+        /* Keep the rest as leftover when the output buffer is full */
+        if (o >= *out_n_frames)
+            break;
+    }
+
+    pa_memblock_release(input->memblock);
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o;
+
+    return in_n_frames;
+}
+
+static void polyphase_free(pa_resampler *r) {
+    struct polyphase_data *p;
+
+    pa_assert(r);
+
+    if (!(p = r->impl.data))
+        return;
+
+    pa_xfree(p->bank);
+    pa_xfree(p->hist);
+    pa_xfree(p);
+}
+
+int pa_resampler_polyphase_init(pa_resampler *r) {
+    struct polyphase_data *p;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    p = pa_xnew0(struct polyphase_data, 1);
+    p->channels = r->work_channels;
+
+    r->impl.data = p;
+    r->impl.free = polyphase_free;
+    r->impl.update_rates = polyphase_update_rates;
+    r->impl.reset = polyphase_reset;
+    r->impl.resample = polyphase_resample;
+
+    polyphase_update_rates(r);
+    polyphase_reset(r);
+
+    return 0;
+}
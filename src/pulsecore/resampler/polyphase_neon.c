@@ -0,0 +1,53 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#include <arm_neon.h>
+
+static void dot_neon(float *out, const float *x, unsigned stride, unsigned channels, const float *h, unsigned n) {
+    unsigned c, k;
+
+    for (c = 0; c < channels; c++, x += stride) {
+        float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+        float32x2_t s;
+
+        for (k = 0; k < n; k += 8) {
+            s0 = vmlaq_f32(s0, vld1q_f32(x + k), vld1q_f32(h + k));
+            s1 = vmlaq_f32(s1, vld1q_f32(x + k + 4), vld1q_f32(h + k + 4));
+        }
+
+        s0 = vaddq_f32(s0, s1);
+        s = vadd_f32(vget_low_f32(s0), vget_high_f32(s0));
+        s = vpadd_f32(s, s);
+
+        out[c] = vget_lane_f32(s, 0);
+    }
+}
+
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized polyphase resampler.");
+
+    pa_set_polyphase_dot_func(dot_neon);
+}
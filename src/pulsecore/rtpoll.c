@@ -38,6 +38,8 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/trace.h>
 #include <pulse/rtclock.h>
 
 #include "rtpoll.h"
@@ -57,6 +59,9 @@ struct pa_rtpoll {
     bool quit:1;
     bool timer_elapsed:1;
 
+    /* How late we woke up for the timer, in usec */
+    pa_histogram wakeup_lateness;
+
 #ifdef DEBUG_TIMING
     pa_usec_t timestamp;
     pa_usec_t slept, awake;
@@ -305,6 +310,8 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     }
 #endif
 
+    PA_TRACE2(rtpoll_sleep, p, (p->quit || p->timer_enabled) ? pa_timeval_load(&timeout) : (pa_usec_t) -1);
+
     /* OK, now let's sleep */
 #ifdef HAVE_PPOLL
     {
@@ -319,6 +326,16 @@ int pa_rtpoll_run(pa_rtpoll *p) {
 
     p->timer_elapsed = r == 0;
 
+    PA_TRACE2(rtpoll_wake, p, r);
+
+    if (p->timer_elapsed && !p->quit && p->timer_enabled) {
+        pa_usec_t now = pa_rtclock_now(), elapse = pa_timeval_load(&p->next_elapse);
+        pa_usec_t lateness = now > elapse ? now - elapse : 0;
+
+        pa_histogram_add(&p->wakeup_lateness, lateness);
+        PA_TRACE2(rtpoll_timer_elapsed, p, lateness);
+    }
+
 #ifdef DEBUG_TIMING
     {
         pa_usec_t now = pa_rtclock_now();
@@ -627,6 +644,12 @@ pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_write(pa_rtpoll *p, pa_rtpoll_prior
     return i;
 }
 
+const pa_histogram *pa_rtpoll_get_wakeup_lateness(pa_rtpoll *p) {
+    pa_assert(p);
+
+    return &p->wakeup_lateness;
+}
+
 bool pa_rtpoll_timer_elapsed(pa_rtpoll *p) {
     pa_assert(p);
 
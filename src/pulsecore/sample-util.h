@@ -83,6 +83,13 @@ typedef void (*pa_do_volume_func_t) (void *samples, const void *volumes, unsigne
 pa_do_volume_func_t pa_get_volume_func(pa_sample_format_t f);
 void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func);
 
+/* Applies a linear gain ramp, the gain of channel c in frame k is start[c] +
+ * k * step[c]. Only available for some formats, NULL otherwise. */
+typedef void (*pa_do_volume_ramp_func_t) (void *samples, const float *start, const float *step, unsigned channels, unsigned length);
+
+pa_do_volume_ramp_func_t pa_get_volume_ramp_func(pa_sample_format_t f);
+void pa_set_volume_ramp_func(pa_sample_format_t f, pa_do_volume_ramp_func_t func);
+
 size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_spec *to);
 
 #define PA_CHANNEL_POSITION_MASK_LEFT                                   \
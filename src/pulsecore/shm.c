@@ -107,7 +107,49 @@ static char *segment_name(char *fn, size_t l, unsigned id) {
 }
 #endif
 
-static int privatemem_create(pa_shm *m, size_t size) {
+#ifdef __linux__
+/* Returns the size of the default huge pages of the system */
+static size_t hugepage_size(void) {
+    static size_t size = 0;
+    char line[128];
+    unsigned long kb;
+    FILE *f;
+
+    if (size > 0)
+        return size;
+
+    size = 2*1024*1024;
+
+    if (!(f = pa_fopen_cloexec("/proc/meminfo", "r")))
+        return size;
+
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+            if (kb > 0)
+                size = (size_t) kb * 1024;
+            break;
+        }
+
+    fclose(f);
+    return size;
+}
+#endif
+
+/* Asks the kernel to back the segment with transparent huge pages,
+ * for when no huge pages could be reserved for it */
+static void advise_hugepages(pa_shm *m) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(m->ptr, PA_PAGE_ALIGN(m->size), MADV_HUGEPAGE) < 0) {
+        pa_log_debug("madvise(MADV_HUGEPAGE) failed: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    pa_log_debug("Requested transparent huge pages for %s memory.", pa_mem_type_to_string(m->type));
+    m->hugepages = true;
+#endif
+}
+
+static int privatemem_create(pa_shm *m, size_t size, bool hugepages) {
     pa_assert(m);
     pa_assert(size > 0);
 
@@ -115,13 +157,32 @@ static int privatemem_create(pa_shm *m, size_t size) {
     m->id = 0;
     m->size = size;
     m->do_unlink = false;
+    m->hugepages = false;
     m->fd = -1;
 
 #ifdef MAP_ANONYMOUS
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    if (hugepages) {
+        size_t huge_size = PA_ROUND_UP(size, hugepage_size());
+
+        if ((m->ptr = mmap(NULL, huge_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB, -1, (off_t) 0)) != MAP_FAILED) {
+            pa_log_debug("Using huge pages for private memory.");
+            m->size = huge_size;
+            m->hugepages = true;
+            return 0;
+        }
+
+        pa_log_info("Failed to map huge pages, falling back to regular pages: %s", pa_cstrerror(errno));
+    }
+#endif
+
     if ((m->ptr = mmap(NULL, m->size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, (off_t) 0)) == MAP_FAILED) {
         pa_log("mmap() failed: %s", pa_cstrerror(errno));
         return -1;
     }
+
+    if (hugepages)
+        advise_hugepages(m);
 #elif defined(HAVE_POSIX_MEMALIGN)
     {
         int r;
@@ -138,7 +199,44 @@ static int privatemem_create(pa_shm *m, size_t size) {
     return 0;
 }
 
-static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
+#if defined(HAVE_MEMFD) && defined(__linux__)
+/* Creates a memfd on the hugetlbfs. The pages are reserved at mmap()
+ * time, so that running out of them fails here and not with a SIGBUS
+ * on first access. */
+static int hugetlb_memfd_create(pa_shm *m, size_t size) {
+    size_t huge_size = PA_ROUND_UP(size, hugepage_size());
+    int fd;
+
+    if ((fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING|MFD_HUGETLB)) < 0)
+        goto fail;
+
+    if (ftruncate(fd, (off_t) huge_size) < 0)
+        goto fail;
+
+    if ((m->ptr = mmap(NULL, huge_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED)
+        goto fail;
+
+    pa_log_debug("Using huge pages for memfd memory.");
+
+    m->type = PA_MEM_TYPE_SHARED_MEMFD;
+    m->size = huge_size;
+    m->do_unlink = false;
+    m->hugepages = true;
+    m->fd = fd;
+
+    return 0;
+
+fail:
+    pa_log_info("Failed to map huge pages, falling back to regular pages: %s", pa_cstrerror(errno));
+
+    if (fd >= 0)
+        pa_close(fd);
+
+    return -1;
+}
+#endif
+
+static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, bool hugepages) {
 #if defined(HAVE_SHM_OPEN) || defined(HAVE_MEMFD)
     char fn[32];
     int fd = -1;
@@ -161,6 +259,11 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
 #endif
 #ifdef HAVE_MEMFD
     case PA_MEM_TYPE_SHARED_MEMFD:
+#ifdef __linux__
+        if (hugepages && hugetlb_memfd_create(m, size) == 0)
+            return 0;
+#endif
+
         fd = memfd_create("pulseaudio", MFD_ALLOW_SEALING);
         break;
 #endif
@@ -176,6 +279,7 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
     m->type = type;
     m->size = size + shm_marker_size(m);
     m->do_unlink = do_unlink;
+    m->hugepages = false;
 
     if (ftruncate(fd, (off_t) m->size) < 0) {
         pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
@@ -191,6 +295,9 @@ static int sharedmem_create(pa_shm *m, pa_mem_type_t type, size_t size, mode_t m
         goto fail;
     }
 
+    if (hugepages)
+        advise_hugepages(m);
+
     if (type == PA_MEM_TYPE_SHARED_POSIX) {
         /* We store our PID at the end of the shm block, so that we
          * can check for dead shm segments later */
@@ -223,7 +330,7 @@ fail:
     return -1;
 }
 
-int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
+int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, bool hugepages) {
     pa_assert(m);
     pa_assert(size > 0);
     pa_assert(size <= MAX_SHM_SIZE);
@@ -234,9 +341,9 @@ int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode) {
     size = PA_PAGE_ALIGN(size);
 
     if (type == PA_MEM_TYPE_PRIVATE)
-        return privatemem_create(m, size);
+        return privatemem_create(m, size, hugepages);
 
-    return sharedmem_create(m, type, size, mode);
+    return sharedmem_create(m, type, size, mode, hugepages);
 }
 
 static void privatemem_free(pa_shm *m) {
@@ -311,6 +418,10 @@ void pa_shm_punch(pa_shm *m, size_t offset, size_t size) {
     /* You're welcome to implement this as NOOP on systems that don't
      * support it */
 
+    /* Punching holes into huge pages would only split them up */
+    if (m->hugepages)
+        return;
+
     /* Align the pointer up to multiples of the page size */
     ptr = (uint8_t*) m->ptr + offset;
     o = (size_t) ((uint8_t*) ptr - (uint8_t*) PA_PAGE_ALIGN_PTR(ptr));
@@ -402,6 +513,7 @@ static int shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd,
     m->id = id;
     m->size = (size_t) st.st_size;
     m->do_unlink = false;
+    m->hugepages = false;
     m->fd = -1;
 
     return 0;
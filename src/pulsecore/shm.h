@@ -34,6 +34,11 @@ typedef struct pa_shm {
     /* Only for type = PA_MEM_TYPE_SHARED_POSIX */
     bool do_unlink:1;
 
+    /* The segment is backed by huge pages, or the kernel has been
+     * asked to back it with transparent huge pages. Such segments
+     * are never punched, as that would split the huge pages up. */
+    bool hugepages:1;
+
     /* Only for type = PA_MEM_TYPE_SHARED_MEMFD
      *
      * To avoid fd leaks, we keep this fd open only until we pass it
@@ -49,7 +54,10 @@ typedef struct pa_shm {
     int fd;
 } pa_shm;
 
-int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode);
+/* If hugepages is true, the segment is backed by huge pages where
+ * possible, falling back to transparent huge pages and then to
+ * regular pages. The size is rounded up accordingly. */
+int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode, bool hugepages);
 int pa_shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd, bool writable);
 
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
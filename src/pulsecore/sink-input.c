@@ -29,6 +29,8 @@
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
+#include <pulse/timeval.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/core-format.h>
 #include <pulsecore/mix.h>
@@ -38,6 +40,7 @@
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/trace.h>
 
 #include "sink-input.h"
 
@@ -45,6 +48,7 @@
 
 #define MEMBLOCKQ_MAXLENGTH (32*1024*1024)
 #define CONVERT_BUFFER_LENGTH (PA_PAGE_SIZE)
+#define SOFT_VOLUME_RAMP_USEC (10*PA_USEC_PER_MSEC)
 
 PA_DEFINE_PUBLIC_CLASS(pa_sink_input, pa_msgobject);
 
@@ -834,6 +838,78 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
     return r[0];
 }
 
+/* Called from thread context. Returns the volume the soft volume ramp has
+ * reached after pos frames, interpolated in the linear domain. */
+static void ramp_volume_at(pa_sink_input *i, size_t pos, pa_cvolume *v) {
+    unsigned c;
+
+    pa_assert(i->thread_info.ramp_frames > 0);
+    pa_assert(pos <= i->thread_info.ramp_frames);
+
+    v->channels = i->thread_info.soft_volume.channels;
+
+    for (c = 0; c < v->channels; c++) {
+        double a = pa_sw_volume_to_linear(i->thread_info.ramp_from.values[c]);
+        double b = i->thread_info.muted ? 0.0 : pa_sw_volume_to_linear(i->thread_info.soft_volume.values[c]);
+
+        v->values[c] = pa_sw_volume_from_linear(a + (b - a) * pos / i->thread_info.ramp_frames);
+    }
+}
+
+/* Called from thread context, before soft_volume or muted change. Fades
+ * from what is currently played to the new setting. */
+static void start_volume_ramp(pa_sink_input *i) {
+    pa_cvolume from;
+
+    /* Start from wherever a running ramp got to */
+    if (i->thread_info.ramp_frames_left > 0)
+        ramp_volume_at(i, i->thread_info.ramp_frames - i->thread_info.ramp_frames_left, &from);
+    else if (i->thread_info.muted)
+        pa_cvolume_mute(&from, i->thread_info.soft_volume.channels);
+    else
+        from = i->thread_info.soft_volume;
+
+    i->thread_info.ramp_from = from;
+    i->thread_info.ramp_frames = i->thread_info.ramp_frames_left =
+        pa_usec_to_bytes(SOFT_VOLUME_RAMP_USEC, &i->sink->sample_spec) / pa_frame_size(&i->sink->sample_spec);
+}
+
+/* Called from thread context. Applies the part of a running volume ramp
+ * that falls on wchunk, which is about to be written to the render
+ * queue. Returns false if the ramp is over by then. */
+static bool ramp_render_chunk(pa_sink_input *i, pa_memchunk *wchunk) {
+    size_t fs = pa_frame_size(&i->thread_info.sample_spec);
+    size_t pos, n_sink, n;
+    pa_cvolume from, to;
+
+    if (i->thread_info.ramp_frames_left <= 0)
+        return false;
+
+    /* The ramp position belongs to the read index of the render queue,
+     * the chunk is written behind what is already queued */
+    pos = i->thread_info.ramp_frames - i->thread_info.ramp_frames_left +
+        pa_memblockq_get_length(i->thread_info.render_memblockq) / pa_frame_size(&i->sink->sample_spec);
+
+    if (pos >= i->thread_info.ramp_frames)
+        return false;
+
+    /* Only ramp the part of the chunk the ramp covers, in the sink input's
+     * sample rate. The rest is written with the final volume. */
+    n_sink = i->thread_info.ramp_frames - pos;
+    n = PA_CLAMP((size_t) (((uint64_t) n_sink * i->thread_info.sample_spec.rate + i->sink->sample_spec.rate - 1) /
+                           i->sink->sample_spec.rate), 1U, wchunk->length / fs);
+    n_sink = PA_MIN(n_sink, (size_t) ((uint64_t) n * i->sink->sample_spec.rate / i->thread_info.sample_spec.rate));
+
+    ramp_volume_at(i, pos, &from);
+    ramp_volume_at(i, pos + n_sink, &to);
+
+    wchunk->length = n * fs;
+    pa_memchunk_make_writable(wchunk, 0);
+    pa_volume_memchunk_ramp(wchunk, &i->thread_info.sample_spec, &from, &to);
+
+    return true;
+}
+
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
     bool do_volume_adj_here, need_volume_factor_sink;
@@ -853,6 +929,8 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     pa_log_debug("peek");
 #endif
 
+    PA_TRACE2(sink_input_peek, i->index, slength);
+
     block_size_max_sink_input = i->thread_info.resampler ?
         pa_resampler_max_block_size(i->thread_info.resampler) :
         pa_frame_align(pa_mempool_block_size_max(i->core->mempool), &i->sample_spec);
@@ -901,6 +979,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
             /* OK, we're corked or the implementor didn't give us any
              * data, so let's just hand out silence */
             pa_atomic_store(&i->thread_info.drained, 1);
+            PA_TRACE2(sink_input_underrun, i->index, slength);
 
             pa_memblockq_seek(i->thread_info.render_memblockq, (int64_t) slength, PA_SEEK_RELATIVE, true);
             i->thread_info.playing_for = 0;
@@ -931,7 +1010,9 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                 wchunk.length = block_size_max_sink_input;
 
             /* It might be necessary to adjust the volume here */
-            if (do_volume_adj_here && !volume_is_norm) {
+            if (do_volume_adj_here && ramp_render_chunk(i, &wchunk))
+                ;
+            else if (do_volume_adj_here && !volume_is_norm) {
                 pa_memchunk_make_writable(&wchunk, 0);
 
                 if (i->thread_info.muted) {
@@ -962,7 +1043,10 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
+                pa_usec_t start = pa_rtclock_now();
+
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                pa_histogram_add(&i->sink->thread_info.resample_usec, pa_rtclock_now() - start);
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -1001,6 +1085,28 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     if (chunk->length > block_size_max_sink)
         chunk->length = block_size_max_sink;
 
+    /* A soft volume or mute change is still being faded in. We apply that
+     * here on a copy and hand out only the ramped part, the sink takes
+     * over again once the ramp is done. With different channel maps the
+     * ramp was already applied before resampling. */
+    if (!do_volume_adj_here && i->thread_info.ramp_frames_left > 0 &&
+        !pa_memblock_is_silence(chunk->memblock)) {
+        size_t fs = pa_frame_size(&i->sink->sample_spec);
+        size_t n = PA_MIN(chunk->length / fs, i->thread_info.ramp_frames_left);
+        size_t pos = i->thread_info.ramp_frames - i->thread_info.ramp_frames_left;
+        pa_cvolume from, to;
+
+        ramp_volume_at(i, pos, &from);
+        ramp_volume_at(i, pos + n, &to);
+
+        chunk->length = n * fs;
+        pa_memchunk_make_writable(chunk, 0);
+        pa_volume_memchunk_ramp(chunk, &i->sink->sample_spec, &from, &to);
+
+        pa_cvolume_reset(volume, i->sink->sample_spec.channels);
+        return;
+    }
+
     /* Let's see if we had to apply the volume adjustment ourselves,
      * or if this can be done by the sink for us */
 
@@ -1027,7 +1133,31 @@ void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in sink sample spec *
     pa_log_debug("dropping %lu", (unsigned long) nbytes);
 #endif
 
+    PA_TRACE2(sink_input_drop, i->index, nbytes);
+
     pa_memblockq_drop(i->thread_info.render_memblockq, nbytes);
+
+    if (i->thread_info.ramp_frames_left > 0)
+        i->thread_info.ramp_frames_left -= PA_MIN(i->thread_info.ramp_frames_left, nbytes / pa_frame_size(&i->sink->sample_spec));
+}
+
+/* Called from thread context */
+void pa_sink_input_set_soft_volume_within_thread(pa_sink_input *i, const pa_cvolume *volume) {
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+    pa_assert(volume);
+
+    if (pa_cvolume_equal(&i->thread_info.soft_volume, volume))
+        return;
+
+    /* Fade to the new volume, so that the change doesn't click */
+    start_volume_ramp(i);
+
+    if (i->thread_info.ramp_from.channels != volume->channels)
+        i->thread_info.ramp_frames_left = 0;
+
+    i->thread_info.soft_volume = *volume;
+    pa_sink_input_request_rewind(i, 0, true, false, false);
 }
 
 /* Called from thread context */
@@ -1065,6 +1195,11 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
     if (nbytes > 0 && !i->thread_info.dont_rewind_render) {
         pa_log_debug("Have to rewind %lu bytes on render memblockq.", (unsigned long) nbytes);
         pa_memblockq_rewind(i->thread_info.render_memblockq, nbytes);
+
+        /* Whatever part of the volume ramp has been rewound is played again */
+        if (i->thread_info.ramp_frames_left > 0)
+            i->thread_info.ramp_frames_left = PA_MIN(i->thread_info.ramp_frames,
+                                                     i->thread_info.ramp_frames_left + nbytes / pa_frame_size(&i->sink->sample_spec));
     }
 
     if (i->thread_info.rewrite_nbytes == (size_t) -1) {
@@ -2011,14 +2146,14 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
     switch (code) {
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME:
-            if (!pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume)) {
-                i->thread_info.soft_volume = i->soft_volume;
-                pa_sink_input_request_rewind(i, 0, true, false, false);
-            }
+            pa_sink_input_set_soft_volume_within_thread(i, &i->soft_volume);
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE:
             if (i->thread_info.muted != i->muted) {
+                /* Fade out and in instead of switching, so that muting
+                 * doesn't click either */
+                start_volume_ramp(i);
                 i->thread_info.muted = i->muted;
                 pa_sink_input_request_rewind(i, 0, true, false, false);
             }
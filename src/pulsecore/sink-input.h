@@ -228,6 +228,12 @@ struct pa_sink_input {
         pa_cvolume soft_volume;
         bool muted:1;
 
+        /* When soft_volume or muted change we fade from ramp_from to the
+         * new value over ramp_frames frames, ramp_frames_left of them are
+         * still to be played */
+        pa_cvolume ramp_from;
+        size_t ramp_frames, ramp_frames_left;
+
         bool attached:1; /* True only between ->attach() and ->detach() calls */
 
         /* rewrite_nbytes: 0: rewrite nothing, (size_t) -1: rewrite everything, otherwise how many bytes to rewrite */
@@ -403,6 +409,7 @@ void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the
 void pa_sink_input_update_max_request(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */);
 
 void pa_sink_input_set_state_within_thread(pa_sink_input *i, pa_sink_input_state_t state);
+void pa_sink_input_set_soft_volume_within_thread(pa_sink_input *i, const pa_cvolume *volume);
 
 int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
 
@@ -41,6 +41,7 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
+#include <pulsecore/trace.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -134,6 +135,13 @@ void pa_sink_new_data_set_port(pa_sink_new_data *data, const char *port) {
     data->active_port = pa_xstrdup(port);
 }
 
+void pa_sink_new_data_set_cpu_affinity(pa_sink_new_data *data, const char *cpus) {
+    pa_assert(data);
+
+    pa_xfree(data->cpu_affinity);
+    data->cpu_affinity = pa_xstrdup(cpus);
+}
+
 void pa_sink_new_data_done(pa_sink_new_data *data) {
     pa_assert(data);
 
@@ -144,6 +152,7 @@ void pa_sink_new_data_done(pa_sink_new_data *data) {
 
     pa_xfree(data->name);
     pa_xfree(data->active_port);
+    pa_xfree(data->cpu_affinity);
 }
 
 /* Called from main context */
@@ -162,6 +171,7 @@ static void reset_callbacks(pa_sink *s) {
     s->get_formats = NULL;
     s->set_formats = NULL;
     s->update_rate = NULL;
+    s->process_filter = NULL;
 }
 
 /* Called from main context */
@@ -257,6 +267,7 @@ pa_sink* pa_sink_new(
     s->name = pa_xstrdup(name);
     s->proplist = pa_proplist_copy(data->proplist);
     s->driver = pa_xstrdup(pa_path_get_filename(data->driver));
+    s->cpu_affinity = pa_xstrdup(data->cpu_affinity);
     s->module = data->module;
     s->card = data->card;
 
@@ -576,6 +587,8 @@ void pa_sink_enable_decibel_volume(pa_sink *s, bool enable) {
 
 /* Called from main context */
 void pa_sink_put(pa_sink* s) {
+    char *cpus;
+
     pa_sink_assert_ref(s);
     pa_assert_ctl_context();
 
@@ -653,6 +666,13 @@ void pa_sink_put(pa_sink* s) {
     pa_assert(s->monitor_source->thread_info.min_latency == s->thread_info.min_latency);
     pa_assert(s->monitor_source->thread_info.max_latency == s->thread_info.max_latency);
 
+    /* Filter sinks run in the IO thread of their master. A thread that is
+     * shared with a source is only placed once, so that spreading doesn't
+     * move it to the next CPU. */
+    if (!s->input_to_master && !pa_core_io_thread_is_placed(s->core, s->asyncmsgq) &&
+        (cpus = s->cpu_affinity ? pa_xstrdup(s->cpu_affinity) : pa_core_get_io_thread_cpus(s->core)))
+        pa_asyncmsgq_post(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_CPU_AFFINITY, cpus, 0, NULL, pa_xfree);
+
     if (s->suspend_cause)
         pa_assert_se(sink_set_state(s, PA_SINK_SUSPENDED) == 0);
     else
@@ -743,6 +763,7 @@ static void sink_free(pa_object *o) {
 
     pa_xfree(s->name);
     pa_xfree(s->driver);
+    pa_xfree(s->cpu_affinity);
 
     if (s->proplist)
         pa_proplist_free(s->proplist);
@@ -1009,8 +1030,11 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = false;
 
+    PA_TRACE2(sink_process_rewind, s->index, nbytes);
+
     if (nbytes > 0) {
         pa_log_debug("Processing rewind...");
+        pa_histogram_add(&s->thread_info.rewind_bytes, nbytes);
         if (s->flags & PA_SINK_DEFERRED_VOLUME)
             pa_sink_volume_change_rewind(s, nbytes);
     }
@@ -1169,6 +1193,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
+    pa_usec_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1187,6 +1212,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     }
 
     pa_sink_ref(s);
+    start = pa_rtclock_now();
+    PA_TRACE2(sink_render_begin, s->index, length);
 
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
@@ -1246,6 +1273,9 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     inputs_drop(s, info, n, result);
 
+    pa_histogram_add(&s->thread_info.render_usec, pa_rtclock_now() - start);
+    PA_TRACE2(sink_render_end, s->index, result->length);
+
     pa_sink_unref(s);
 }
 
@@ -1254,6 +1284,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
+    pa_usec_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1272,6 +1303,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     }
 
     pa_sink_ref(s);
+    start = pa_rtclock_now();
+    PA_TRACE2(sink_render_begin, s->index, target->length);
 
     length = target->length;
     block_size_max = pa_mempool_block_size_max(s->core->mempool);
@@ -1331,6 +1364,9 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     inputs_drop(s, info, n, target);
 
+    pa_histogram_add(&s->thread_info.render_usec, pa_rtclock_now() - start);
+    PA_TRACE2(sink_render_end, s->index, target->length);
+
     pa_sink_unref(s);
 }
 
@@ -1406,6 +1442,94 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
     pa_sink_unref(s);
 }
 
+/* Called from IO thread context */
+static pa_sink_input *get_filter_chain_input(pa_sink *s) {
+    pa_sink_input *i;
+    void *state = NULL;
+
+    if (pa_hashmap_size(s->thread_info.inputs) != 1)
+        return NULL;
+
+    pa_assert_se(i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL));
+
+    if (!i->origin_sink || !i->origin_sink->process_filter)
+        return NULL;
+
+    if (i->thread_info.state != PA_SINK_INPUT_RUNNING ||
+        i->origin_sink->thread_info.state != PA_SINK_RUNNING)
+        return NULL;
+
+    /* After a rewind the render queue plays back what it still has first,
+     * which the normal path takes care of */
+    if (pa_memblockq_is_readable(i->thread_info.render_memblockq))
+        return NULL;
+
+    /* The link may only be bypassed if rendering it would have passed
+     * the filter's output on untouched */
+    if (i->thread_info.resampler ||
+        i->thread_info.muted ||
+        i->thread_info.ramp_frames_left > 0 ||
+        !pa_cvolume_is_norm(&i->thread_info.soft_volume) ||
+        s->thread_info.soft_muted ||
+        !pa_cvolume_is_norm(&s->thread_info.soft_volume))
+        return NULL;
+
+    return i;
+}
+
+/* Called from IO thread context. Renders like pa_sink_render(), but if
+ * the only thing connected to the sink is a filter sink that supports
+ * process_filter, renders that one in turn and runs its filter directly
+ * on the result. Chains of such filters are thus processed back to
+ * back, without going through the render queues of the sink inputs in
+ * between. */
+void pa_sink_render_filter_chain(pa_sink *s, size_t length, pa_memchunk *result) {
+    pa_sink_input *i;
+    pa_sink *filter;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+    pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
+    pa_assert(pa_frame_aligned(length, &s->sample_spec));
+    pa_assert(result);
+
+    if (!(i = get_filter_chain_input(s))) {
+        pa_sink_render(s, length, result);
+        return;
+    }
+
+    filter = i->origin_sink;
+
+    if (length <= 0)
+        length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
+
+    /* This is what the filter's pop() callback would have done first */
+    pa_sink_process_rewind(filter, 0);
+
+    pa_sink_render_filter_chain(filter, length / pa_frame_size(&s->sample_spec) * pa_frame_size(&filter->sample_spec), result);
+    filter->process_filter(filter, result);
+
+    pa_assert(result->length > 0);
+    pa_assert(pa_frame_aligned(result->length, &s->sample_spec));
+
+    /* Do what pa_sink_render() would have done with the result: pass it
+     * through the render queue of the sink input, so that it is there
+     * if the sink is rewound, and hand it to the monitor source and to
+     * anything recording the sink input directly */
+    pa_memblockq_push_align(i->thread_info.render_memblockq, result);
+    pa_sink_input_drop(i, result->length);
+
+    if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state)) {
+        pa_source_output *o;
+        void *state = NULL;
+
+        PA_HASHMAP_FOREACH(o, i->thread_info.direct_outputs, state)
+            pa_source_post_direct(s->monitor_source, o, result);
+
+        pa_source_post(s->monitor_source, result);
+    }
+}
+
 /* Called from main thread */
 int pa_sink_update_rate(pa_sink *s, uint32_t rate, bool passthrough) {
     int ret = -1;
@@ -1516,6 +1640,29 @@ pa_usec_t pa_sink_get_latency(pa_sink *s) {
     return usec;
 }
 
+/* Called from main thread */
+void pa_sink_get_cpu_placement(pa_sink *s, pa_cpu_placement *p) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_IS_LINKED(s->state));
+    pa_assert(p);
+
+    if (pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_CPU_PLACEMENT, p, 0, NULL) < 0) {
+        p->cpu = p->node = -1;
+        p->cpus = NULL;
+    }
+}
+
+/* Called from main thread */
+int pa_sink_get_timing(pa_sink *s, pa_io_timing *t) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_IS_LINKED(s->state));
+    pa_assert(t);
+
+    return pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_TIMING, t, 0, NULL);
+}
+
 /* Called from IO thread */
 pa_usec_t pa_sink_get_latency_within_thread(pa_sink *s) {
     pa_usec_t usec = 0;
@@ -2433,11 +2580,7 @@ static void sync_input_volumes_within_thread(pa_sink *s) {
     pa_sink_assert_io_context(s);
 
     PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
-        if (pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume))
-            continue;
-
-        i->thread_info.soft_volume = i->soft_volume;
-        pa_sink_input_request_rewind(i, 0, true, false, false);
+        pa_sink_input_set_soft_volume_within_thread(i, &i->soft_volume);
     }
 }
 
@@ -2893,6 +3036,29 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             s->thread_info.latency_offset = offset;
             return 0;
 
+        case PA_SINK_MESSAGE_SET_CPU_AFFINITY:
+            pa_set_cpu_affinity(userdata);
+            return 0;
+
+        case PA_SINK_MESSAGE_GET_CPU_PLACEMENT:
+            pa_get_cpu_placement(userdata);
+            return 0;
+
+        case PA_SINK_MESSAGE_GET_TIMING: {
+            pa_io_timing *t = userdata;
+
+            t->process_usec = s->thread_info.render_usec;
+            t->resample_usec = s->thread_info.resample_usec;
+            t->rewind_bytes = s->thread_info.rewind_bytes;
+
+            if (s->thread_info.rtpoll)
+                t->wakeup_lateness_usec = *pa_rtpoll_get_wakeup_lateness(s->thread_info.rtpoll);
+            else
+                pa_histogram_reset(&t->wakeup_lateness_usec);
+
+            return 0;
+        }
+
         case PA_SINK_MESSAGE_GET_LATENCY:
         case PA_SINK_MESSAGE_MAX:
             ;
@@ -2973,6 +3139,8 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
     s->thread_info.rewind_nbytes = nbytes;
     s->thread_info.rewind_requested = true;
 
+    PA_TRACE2(sink_request_rewind, s->index, nbytes);
+
     if (s->request_rewind)
         s->request_rewind(s);
 }
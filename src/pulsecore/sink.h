@@ -31,6 +31,8 @@
 #include <pulse/volume.h>
 
 #include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/source.h>
@@ -74,6 +76,7 @@ struct pa_sink {
 
     char *name;
     char *driver;                           /* may be NULL */
+    char *cpu_affinity;                     /* may be NULL */
     pa_proplist *proplist;
 
     pa_module *module;                      /* may be NULL */
@@ -248,6 +251,16 @@ struct pa_sink {
      * main thread. */
     int (*update_rate)(pa_sink *s, uint32_t rate);
 
+    /* Only for filter sinks whose processing keeps no audio buffered
+     * and maps every frame they get to one frame they put out. When
+     * the filter sink is part of a chain of such filters,
+     * pa_sink_render_filter_chain() calls this with the audio it
+     * rendered from the filter sink, instead of calling the pop()
+     * callback of input_to_master. The callback replaces the chunk
+     * with the processed audio, in the sample spec of
+     * input_to_master. Called from IO thread context. */
+    void (*process_filter)(pa_sink *s, pa_memchunk *chunk); /* may be NULL */
+
     /* Contains copies of the above data so that the real-time worker
      * thread can work without access locking */
     struct {
@@ -304,6 +317,12 @@ struct pa_sink {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Time spent in each mixing pass, in resampling the inputs, and
+         * the size of each rewind */
+        pa_histogram render_usec;
+        pa_histogram resample_usec;
+        pa_histogram rewind_bytes;
     } thread_info;
 
     void *userdata;
@@ -338,6 +357,9 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_SET_PORT,
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SINK_MESSAGE_SET_CPU_AFFINITY,
+    PA_SINK_MESSAGE_GET_CPU_PLACEMENT,
+    PA_SINK_MESSAGE_GET_TIMING,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
@@ -354,6 +376,9 @@ typedef struct pa_sink_new_data {
     pa_hashmap *ports;
     char *active_port;
 
+    /* The CPUs to run the IO thread on, overriding the daemon default */
+    char *cpu_affinity;
+
     pa_sample_spec sample_spec;
     pa_channel_map channel_map;
     uint32_t alternate_sample_rate;
@@ -381,6 +406,7 @@ void pa_sink_new_data_set_alternate_sample_rate(pa_sink_new_data *data, const ui
 void pa_sink_new_data_set_volume(pa_sink_new_data *data, const pa_cvolume *volume);
 void pa_sink_new_data_set_muted(pa_sink_new_data *data, bool mute);
 void pa_sink_new_data_set_port(pa_sink_new_data *data, const char *port);
+void pa_sink_new_data_set_cpu_affinity(pa_sink_new_data *data, const char *cpus);
 void pa_sink_new_data_done(pa_sink_new_data *data);
 
 /*** To be called exclusively by the sink driver, from main context */
@@ -427,6 +453,10 @@ void pa_sink_set_latency_offset(pa_sink *s, int64_t offset);
 
 /* The returned value is supposed to be in the time domain of the sound card! */
 pa_usec_t pa_sink_get_latency(pa_sink *s);
+void pa_sink_get_cpu_placement(pa_sink *s, pa_cpu_placement *p);
+/* Copies the timing statistics of the IO thread. Returns a negative
+ * value if they could not be retrieved. */
+int pa_sink_get_timing(pa_sink *s, pa_io_timing *t);
 pa_usec_t pa_sink_get_requested_latency(pa_sink *s);
 void pa_sink_get_latency_range(pa_sink *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
@@ -492,6 +522,10 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result);
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target);
 void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target);
 
+/*** To be called exclusively by filter sinks, from IO context */
+
+void pa_sink_render_filter_chain(pa_sink *s, size_t length, pa_memchunk *result);
+
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes);
 
 int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
@@ -29,6 +29,7 @@
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/core-format.h>
 #include <pulsecore/mix.h>
@@ -801,6 +802,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             o->push(o, &qchunk);
         else {
             pa_memchunk rchunk;
+            pa_usec_t start;
 
             if (mbs == 0)
                 mbs = pa_resampler_max_block_size(o->thread_info.resampler);
@@ -808,7 +810,21 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             if (qchunk.length > mbs)
                 qchunk.length = mbs;
 
-            pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
+            start = pa_rtclock_now();
+
+            /* Unless the volume made the chunk our own, the other peak
+             * detecting outputs of the source see the same chunks */
+            if (volume_is_norm && !need_volume_factor_source &&
+                pa_resampler_get_method(o->thread_info.resampler) == PA_RESAMPLER_PEAKS) {
+
+                if (!o->source->thread_info.peaks_cache)
+                    o->source->thread_info.peaks_cache = pa_peaks_cache_new();
+
+                pa_resampler_run_peaks_cached(o->thread_info.resampler, o->source->thread_info.peaks_cache, &qchunk, &rchunk);
+            } else
+                pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
+
+            pa_histogram_add(&o->source->thread_info.resample_usec, pa_rtclock_now() - start);
 
             if (rchunk.length > 0)
                 o->push(o, &rchunk);
@@ -125,6 +125,13 @@ void pa_source_new_data_set_port(pa_source_new_data *data, const char *port) {
     data->active_port = pa_xstrdup(port);
 }
 
+void pa_source_new_data_set_cpu_affinity(pa_source_new_data *data, const char *cpus) {
+    pa_assert(data);
+
+    pa_xfree(data->cpu_affinity);
+    data->cpu_affinity = pa_xstrdup(cpus);
+}
+
 void pa_source_new_data_done(pa_source_new_data *data) {
     pa_assert(data);
 
@@ -135,6 +142,7 @@ void pa_source_new_data_done(pa_source_new_data *data) {
 
     pa_xfree(data->name);
     pa_xfree(data->active_port);
+    pa_xfree(data->cpu_affinity);
 }
 
 /* Called from main context */
@@ -244,6 +252,7 @@ pa_source* pa_source_new(
     s->name = pa_xstrdup(name);
     s->proplist = pa_proplist_copy(data->proplist);
     s->driver = pa_xstrdup(pa_path_get_filename(data->driver));
+    s->cpu_affinity = pa_xstrdup(data->cpu_affinity);
     s->module = data->module;
     s->card = data->card;
 
@@ -527,6 +536,8 @@ void pa_source_enable_decibel_volume(pa_source *s, bool enable) {
 
 /* Called from main context */
 void pa_source_put(pa_source *s) {
+    char *cpus;
+
     pa_source_assert_ref(s);
     pa_assert_ctl_context();
 
@@ -598,6 +609,12 @@ void pa_source_put(pa_source *s) {
     pa_assert(!(s->flags & PA_SOURCE_DECIBEL_VOLUME) || s->n_volume_steps == PA_VOLUME_NORM+1);
     pa_assert(!(s->flags & PA_SOURCE_DYNAMIC_LATENCY) == !(s->thread_info.fixed_latency == 0));
 
+    /* Monitor and filter sources run in the IO thread of another device. A
+     * thread that is shared with a sink is only placed once. */
+    if (!s->monitor_of && !s->output_from_master && !pa_core_io_thread_is_placed(s->core, s->asyncmsgq) &&
+        (cpus = s->cpu_affinity ? pa_xstrdup(s->cpu_affinity) : pa_core_get_io_thread_cpus(s->core)))
+        pa_asyncmsgq_post(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_CPU_AFFINITY, cpus, 0, NULL, pa_xfree);
+
     if (s->suspend_cause)
         pa_assert_se(source_set_state(s, PA_SOURCE_SUSPENDED) == 0);
     else
@@ -672,11 +689,15 @@ static void source_free(pa_object *o) {
     pa_idxset_free(s->outputs, NULL);
     pa_hashmap_free(s->thread_info.outputs);
 
+    if (s->thread_info.peaks_cache)
+        pa_peaks_cache_free(s->thread_info.peaks_cache);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
     pa_xfree(s->name);
     pa_xfree(s->driver);
+    pa_xfree(s->cpu_affinity);
 
     if (s->proplist)
         pa_proplist_free(s->proplist);
@@ -896,6 +917,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
         return;
 
     pa_log_debug("Processing rewind...");
+    pa_histogram_add(&s->thread_info.rewind_bytes, nbytes);
 
     PA_HASHMAP_FOREACH(o, s->thread_info.outputs, state) {
         pa_source_output_assert_ref(o);
@@ -907,6 +929,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
 void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     pa_source_output *o;
     void *state = NULL;
+    pa_usec_t start;
 
     pa_source_assert_ref(s);
     pa_source_assert_io_context(s);
@@ -916,6 +939,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    start = pa_rtclock_now();
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -944,6 +969,12 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
                 pa_source_output_push(o, chunk);
         }
     }
+
+    /* Don't keep the chunks alive any longer than needed */
+    if (s->thread_info.peaks_cache)
+        pa_peaks_cache_flush(s->thread_info.peaks_cache);
+
+    pa_histogram_add(&s->thread_info.post_usec, pa_rtclock_now() - start);
 }
 
 /* Called from IO thread context */
@@ -1111,6 +1142,29 @@ pa_usec_t pa_source_get_latency(pa_source *s) {
     return usec;
 }
 
+/* Called from main thread */
+void pa_source_get_cpu_placement(pa_source *s, pa_cpu_placement *p) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_IS_LINKED(s->state));
+    pa_assert(p);
+
+    if (pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_CPU_PLACEMENT, p, 0, NULL) < 0) {
+        p->cpu = p->node = -1;
+        p->cpus = NULL;
+    }
+}
+
+/* Called from main thread */
+int pa_source_get_timing(pa_source *s, pa_io_timing *t) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_IS_LINKED(s->state));
+    pa_assert(t);
+
+    return pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_TIMING, t, 0, NULL);
+}
+
 /* Called from IO thread */
 pa_usec_t pa_source_get_latency_within_thread(pa_source *s) {
     pa_usec_t usec = 0;
@@ -2248,6 +2302,29 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
             s->thread_info.latency_offset = offset;
             return 0;
 
+        case PA_SOURCE_MESSAGE_SET_CPU_AFFINITY:
+            pa_set_cpu_affinity(userdata);
+            return 0;
+
+        case PA_SOURCE_MESSAGE_GET_CPU_PLACEMENT:
+            pa_get_cpu_placement(userdata);
+            return 0;
+
+        case PA_SOURCE_MESSAGE_GET_TIMING: {
+            pa_io_timing *t = userdata;
+
+            t->process_usec = s->thread_info.post_usec;
+            t->resample_usec = s->thread_info.resample_usec;
+            t->rewind_bytes = s->thread_info.rewind_bytes;
+
+            if (s->thread_info.rtpoll)
+                t->wakeup_lateness_usec = *pa_rtpoll_get_wakeup_lateness(s->thread_info.rtpoll);
+            else
+                pa_histogram_reset(&t->wakeup_lateness_usec);
+
+            return 0;
+        }
+
         case PA_SOURCE_MESSAGE_MAX:
             ;
     }
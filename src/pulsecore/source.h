@@ -32,6 +32,8 @@
 #include <pulse/volume.h>
 
 #include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/sink.h>
@@ -75,6 +77,7 @@ struct pa_source {
 
     char *name;
     char *driver;                             /* may be NULL */
+    char *cpu_affinity;                       /* may be NULL */
     pa_proplist *proplist;
 
     pa_module *module;                        /* may be NULL */
@@ -246,6 +249,16 @@ struct pa_source {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Lets the peak detecting outputs share their work while a chunk
+         * is posted. Created when first needed. */
+        pa_peaks_cache *peaks_cache;
+
+        /* Time spent in posting each chunk, in resampling for the
+         * outputs, and the size of each rewind */
+        pa_histogram post_usec;
+        pa_histogram resample_usec;
+        pa_histogram rewind_bytes;
     } thread_info;
 
     void *userdata;
@@ -276,6 +289,9 @@ typedef enum pa_source_message {
     PA_SOURCE_MESSAGE_SET_PORT,
     PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SOURCE_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SOURCE_MESSAGE_SET_CPU_AFFINITY,
+    PA_SOURCE_MESSAGE_GET_CPU_PLACEMENT,
+    PA_SOURCE_MESSAGE_GET_TIMING,
     PA_SOURCE_MESSAGE_MAX
 } pa_source_message_t;
 
@@ -292,6 +308,9 @@ typedef struct pa_source_new_data {
     pa_hashmap *ports;
     char *active_port;
 
+    /* The CPUs to run the IO thread on, overriding the daemon default */
+    char *cpu_affinity;
+
     pa_sample_spec sample_spec;
     pa_channel_map channel_map;
     uint32_t alternate_sample_rate;
@@ -319,6 +338,7 @@ void pa_source_new_data_set_alternate_sample_rate(pa_source_new_data *data, cons
 void pa_source_new_data_set_volume(pa_source_new_data *data, const pa_cvolume *volume);
 void pa_source_new_data_set_muted(pa_source_new_data *data, bool mute);
 void pa_source_new_data_set_port(pa_source_new_data *data, const char *port);
+void pa_source_new_data_set_cpu_affinity(pa_source_new_data *data, const char *cpus);
 void pa_source_new_data_done(pa_source_new_data *data);
 
 /*** To be called exclusively by the source driver, from main context */
@@ -360,6 +380,10 @@ void pa_source_set_latency_offset(pa_source *s, int64_t offset);
 
 /* The returned value is supposed to be in the time domain of the sound card! */
 pa_usec_t pa_source_get_latency(pa_source *s);
+void pa_source_get_cpu_placement(pa_source *s, pa_cpu_placement *p);
+/* Copies the timing statistics of the IO thread. Returns a negative
+ * value if they could not be retrieved. */
+int pa_source_get_timing(pa_source *s, pa_io_timing *t);
 pa_usec_t pa_source_get_requested_latency(pa_source *s);
 void pa_source_get_latency_range(pa_source *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_source_get_fixed_latency(pa_source *s);
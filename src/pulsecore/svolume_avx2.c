@@ -0,0 +1,269 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#include <immintrin.h>
+
+/* Channels must be at least 8 and always a multiple of the original number.
+ * This is also the max amount we overread the volume array, which should
+ * have enough padding. */
+static const unsigned channel_overread_table[8] = {8,8,8,12,8,10,12,14};
+
+static void pa_volume_float32ne_avx2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    if (channels < 8)
+        channels = channel_overread_table[channels];
+
+    length /= sizeof(float);
+
+    for (; length >= 8; length -= 8) {
+        __m256 s = _mm256_loadu_ps(samples);
+
+        s = _mm256_mul_ps(s, _mm256_loadu_ps(volumes + channel));
+        _mm256_storeu_ps(samples, s);
+        samples += 8;
+
+        if ((channel += 8) >= channels)
+            channel -= channels;
+    }
+
+    for (; length; length--, channel++)
+        *samples++ *= volumes[channel];
+}
+
+/* Scales 4 samples by 4 16.16 fixed point volumes. The products are exact
+ * in double precision as long as they do not need clamping, so this
+ * matches the 64 bit integer code of the C version. */
+static inline __m128i volume_s32x4(__m128i s, __m128i v) {
+    const __m256d scale = _mm256_set1_pd(1.0 / 0x10000);
+    const __m256d min = _mm256_set1_pd(-2147483648.0);
+    const __m256d max = _mm256_set1_pd(2147483647.0);
+    __m256d t;
+
+    t = _mm256_mul_pd(_mm256_cvtepi32_pd(s), _mm256_cvtepi32_pd(v));
+    t = _mm256_floor_pd(_mm256_mul_pd(t, scale));
+    t = _mm256_min_pd(_mm256_max_pd(t, min), max);
+
+    return _mm256_cvttpd_epi32(t);
+}
+
+static void pa_volume_s32ne_avx2(int32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    if (channels < 8)
+        channels = channel_overread_table[channels];
+
+    length /= sizeof(int32_t);
+
+    for (; length >= 8; length -= 8) {
+        __m128i s0 = _mm_loadu_si128((const __m128i *) samples);
+        __m128i s1 = _mm_loadu_si128((const __m128i *) (samples + 4));
+
+        s0 = volume_s32x4(s0, _mm_loadu_si128((const __m128i *) (volumes + channel)));
+        s1 = volume_s32x4(s1, _mm_loadu_si128((const __m128i *) (volumes + channel + 4)));
+        _mm_storeu_si128((__m128i *) samples, s0);
+        _mm_storeu_si128((__m128i *) (samples + 4), s1);
+        samples += 8;
+
+        if ((channel += 8) >= channels)
+            channel -= channels;
+    }
+
+    for (; length; length--, channel++) {
+        int64_t t;
+
+        t = (int64_t)(*samples);
+        t = (t * volumes[channel]) >> 16;
+        t = PA_CLAMP_UNLIKELY(t, -0x80000000LL, 0x7FFFFFFFLL);
+        *samples++ = (int32_t) t;
+    }
+}
+
+/* The ramps work on blocks of whole frames that are also a whole number of
+ * vectors. For every sample in such a block we keep its channel's start
+ * gain and step, and its frame index in the block. */
+#define RAMP_BLOCK_MAX (PA_CHANNELS_MAX * 8)
+
+typedef struct ramp_block {
+    unsigned samples, frames;
+    float start[RAMP_BLOCK_MAX];
+    float step[RAMP_BLOCK_MAX];
+    float frame[RAMP_BLOCK_MAX];
+} ramp_block;
+
+static void ramp_block_init(ramp_block *b, const float *start, const float *step, unsigned channels) {
+    unsigned i, c = channels;
+
+    /* Smallest multiple of 8 that is a multiple of channels */
+    while (c % 8)
+        c += channels;
+
+    b->samples = c;
+    b->frames = c / channels;
+
+    for (i = 0; i < b->samples; i++) {
+        b->start[i] = start[i % channels];
+        b->step[i] = step[i % channels];
+        b->frame[i] = (float) (i / channels);
+    }
+}
+
+static inline __m256 ramp_gain(const ramp_block *b, unsigned i, __m256 base) {
+    __m256 f = _mm256_add_ps(_mm256_loadu_ps(b->frame + i), base);
+
+    return _mm256_add_ps(_mm256_loadu_ps(b->start + i), _mm256_mul_ps(f, _mm256_loadu_ps(b->step + i)));
+}
+
+static void pa_volume_ramp_float32ne_avx2(float *samples, const float *start, const float *step, unsigned channels, unsigned length) {
+    ramp_block b;
+    unsigned i, channel, frame;
+
+    ramp_block_init(&b, start, step, channels);
+
+    length /= sizeof(float);
+
+    for (frame = 0; length >= b.samples; length -= b.samples, frame += b.frames) {
+        const __m256 base = _mm256_set1_ps((float) frame);
+
+        for (i = 0; i < b.samples; i += 8) {
+            __m256 s = _mm256_loadu_ps(samples + i);
+
+            _mm256_storeu_ps(samples + i, _mm256_mul_ps(s, ramp_gain(&b, i, base)));
+        }
+
+        samples += b.samples;
+    }
+
+    for (channel = 0; length; length--) {
+        *samples++ *= start[channel] + (float) frame * step[channel];
+
+        if (++channel >= channels) {
+            channel = 0;
+            frame++;
+        }
+    }
+}
+
+static void pa_volume_ramp_s16ne_avx2(int16_t *samples, const float *start, const float *step, unsigned channels, unsigned length) {
+    ramp_block b;
+    unsigned i, channel, frame;
+
+    ramp_block_init(&b, start, step, channels);
+
+    length /= sizeof(int16_t);
+
+    for (frame = 0; length >= b.samples; length -= b.samples, frame += b.frames) {
+        const __m256 base = _mm256_set1_ps((float) frame);
+
+        for (i = 0; i < b.samples; i += 8) {
+            __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (samples + i)));
+            __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(s), ramp_gain(&b, i, base));
+
+            s = _mm256_cvtps_epi32(t);
+            _mm_storeu_si128((__m128i *) (samples + i),
+                             _mm_packs_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+        }
+
+        samples += b.samples;
+    }
+
+    for (channel = 0; length; length--) {
+        float t;
+
+        t = *samples * (start[channel] + (float) frame * step[channel]);
+        t = PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+        *samples++ = (int16_t) lrintf(t);
+
+        if (++channel >= channels) {
+            channel = 0;
+            frame++;
+        }
+    }
+}
+
+static inline __m128i ramp_s32x4(__m128i s, __m128 g) {
+    const __m256d min = _mm256_set1_pd(-2147483648.0);
+    const __m256d max = _mm256_set1_pd(2147483647.0);
+    __m256d t;
+
+    t = _mm256_mul_pd(_mm256_cvtepi32_pd(s), _mm256_cvtps_pd(g));
+    t = _mm256_min_pd(_mm256_max_pd(t, min), max);
+
+    return _mm256_cvtpd_epi32(t);
+}
+
+static void pa_volume_ramp_s32ne_avx2(int32_t *samples, const float *start, const float *step, unsigned channels, unsigned length) {
+    ramp_block b;
+    unsigned i, channel, frame;
+
+    ramp_block_init(&b, start, step, channels);
+
+    length /= sizeof(int32_t);
+
+    for (frame = 0; length >= b.samples; length -= b.samples, frame += b.frames) {
+        const __m256 base = _mm256_set1_ps((float) frame);
+
+        for (i = 0; i < b.samples; i += 8) {
+            __m256 g = ramp_gain(&b, i, base);
+            __m128i s0 = _mm_loadu_si128((const __m128i *) (samples + i));
+            __m128i s1 = _mm_loadu_si128((const __m128i *) (samples + i + 4));
+
+            _mm_storeu_si128((__m128i *) (samples + i), ramp_s32x4(s0, _mm256_castps256_ps128(g)));
+            _mm_storeu_si128((__m128i *) (samples + i + 4), ramp_s32x4(s1, _mm256_extractf128_ps(g, 1)));
+        }
+
+        samples += b.samples;
+    }
+
+    for (channel = 0; length; length--) {
+        double t;
+
+        t = *samples * (double) (start[channel] + (float) frame * step[channel]);
+        t = PA_CLAMP_UNLIKELY(t, -2147483648.0, 2147483647.0);
+        *samples++ = (int32_t) lrint(t);
+
+        if (++channel >= channels) {
+            channel = 0;
+            frame++;
+        }
+    }
+}
+
+void pa_volume_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized volume functions.");
+
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_avx2);
+        pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_avx2);
+
+        pa_set_volume_ramp_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_ramp_func_t) pa_volume_ramp_float32ne_avx2);
+        pa_set_volume_ramp_func(PA_SAMPLE_S16NE, (pa_do_volume_ramp_func_t) pa_volume_ramp_s16ne_avx2);
+        pa_set_volume_ramp_func(PA_SAMPLE_S32NE, (pa_do_volume_ramp_func_t) pa_volume_ramp_s32ne_avx2);
+    }
+}
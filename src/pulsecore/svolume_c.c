@@ -22,6 +22,8 @@
 #include <config.h>
 #endif
 
+#include <math.h>
+
 #include <pulsecore/macro.h>
 #include <pulsecore/g711.h>
 #include <pulsecore/endianmacros.h>
@@ -269,3 +271,75 @@ void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func) {
 
     do_volume_table[f] = func;
 }
+
+/* The gain of channel c in frame k is start[c] + k * step[c] */
+static void pa_volume_ramp_s16ne_c(int16_t *samples, const float *start, const float *step, unsigned channels, unsigned length) {
+    unsigned channel, frame;
+
+    length /= sizeof(int16_t);
+
+    for (channel = 0, frame = 0; length; length--) {
+        float t;
+
+        t = *samples * (start[channel] + (float) frame * step[channel]);
+        t = PA_CLAMP_UNLIKELY(t, -0x8000, 0x7FFF);
+        *samples++ = (int16_t) lrintf(t);
+
+        if (PA_UNLIKELY(++channel >= channels)) {
+            channel = 0;
+            frame++;
+        }
+    }
+}
+
+static void pa_volume_ramp_float32ne_c(float *samples, const float *start, const float *step, unsigned channels, unsigned length) {
+    unsigned channel, frame;
+
+    length /= sizeof(float);
+
+    for (channel = 0, frame = 0; length; length--) {
+        *samples++ *= start[channel] + (float) frame * step[channel];
+
+        if (PA_UNLIKELY(++channel >= channels)) {
+            channel = 0;
+            frame++;
+        }
+    }
+}
+
+static void pa_volume_ramp_s32ne_c(int32_t *samples, const float *start, const float *step, unsigned channels, unsigned length) {
+    unsigned channel, frame;
+
+    length /= sizeof(int32_t);
+
+    for (channel = 0, frame = 0; length; length--) {
+        double t;
+
+        t = *samples * (double) (start[channel] + (float) frame * step[channel]);
+        t = PA_CLAMP_UNLIKELY(t, -2147483648.0, 2147483647.0);
+        *samples++ = (int32_t) lrint(t);
+
+        if (PA_UNLIKELY(++channel >= channels)) {
+            channel = 0;
+            frame++;
+        }
+    }
+}
+
+static pa_do_volume_ramp_func_t do_volume_ramp_table[PA_SAMPLE_MAX] = {
+    [PA_SAMPLE_S16NE]     = (pa_do_volume_ramp_func_t) pa_volume_ramp_s16ne_c,
+    [PA_SAMPLE_FLOAT32NE] = (pa_do_volume_ramp_func_t) pa_volume_ramp_float32ne_c,
+    [PA_SAMPLE_S32NE]     = (pa_do_volume_ramp_func_t) pa_volume_ramp_s32ne_c
+};
+
+pa_do_volume_ramp_func_t pa_get_volume_ramp_func(pa_sample_format_t f) {
+    pa_assert(pa_sample_format_valid(f));
+
+    return do_volume_ramp_table[f];
+}
+
+void pa_set_volume_ramp_func(pa_sample_format_t f, pa_do_volume_ramp_func_t func) {
+    pa_assert(pa_sample_format_valid(f));
+
+    do_volume_ramp_table[f] = func;
+}
@@ -249,6 +249,85 @@ static void pa_volume_s16re_sse2(int16_t *samples, const int32_t *volumes, unsig
     );
 }
 
+static void pa_volume_float32ne_sse(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    pa_reg_x86 channel, temp;
+
+    /* Channels must be at least 8 and always a multiple of the original number.
+     * This is also the max amount we overread the volume array, which should
+     * have enough padding. */
+    if (channels < 8)
+        channels = channel_overread_table[channels];
+
+    __asm__ __volatile__ (
+        " xor %3, %3                    \n\t"
+        " sar $2, %2                    \n\t" /* length /= sizeof (float) */
+
+        " test $1, %2                   \n\t" /* check for odd samples */
+        " je 2f                         \n\t"
+
+        " movss (%q1, %3, 4), %%xmm0    \n\t" /*                      |  v0  | */
+        " movss (%0), %%xmm1            \n\t" /*                      |  p0  | */
+        " mulss %%xmm0, %%xmm1          \n\t"
+        " movss %%xmm1, (%0)            \n\t" /*                      | p0*v0 | */
+        " add $4, %0                    \n\t"
+        MOD_ADD ($1, %5)
+
+        "2:                             \n\t"
+        " sar $1, %2                    \n\t" /* prepare for processing 2 samples at a time */
+        " test $1, %2                   \n\t"
+        " je 4f                         \n\t"
+
+        "3:                             \n\t" /* do samples in groups of 2 */
+        " movlps (%q1, %3, 4), %%xmm0   \n\t" /*              .. |  v1  |  v0  | */
+        " movlps (%0), %%xmm1           \n\t" /*              .. |  p1  |  p0  | */
+        " mulps %%xmm0, %%xmm1          \n\t"
+        " movlps %%xmm1, (%0)           \n\t" /*              .. | p1*v1 | p0*v0 | */
+        " add $8, %0                    \n\t"
+        MOD_ADD ($2, %5)
+
+        "4:                             \n\t"
+        " sar $1, %2                    \n\t" /* prepare for processing 4 samples at a time */
+        " test $1, %2                   \n\t"
+        " je 6f                         \n\t"
+
+        "5:                             \n\t" /* do samples in groups of 4 */
+        " movups (%q1, %3, 4), %%xmm0   \n\t" /* |  v3  ..  v0  | */
+        " movups (%0), %%xmm1           \n\t" /* |  p3  ..  p0  | */
+        " mulps %%xmm0, %%xmm1          \n\t"
+        " movups %%xmm1, (%0)           \n\t" /* | p3*v3 .. p0*v0 | */
+        " add $16, %0                   \n\t"
+        MOD_ADD ($4, %5)
+
+        "6:                             \n\t"
+        " sar $1, %2                    \n\t" /* prepare for processing 8 samples at a time */
+        " cmp $0, %2                    \n\t"
+        " je 8f                         \n\t"
+
+        "7:                             \n\t" /* do samples in groups of 8 */
+        " movups (%q1, %3, 4), %%xmm0   \n\t" /* |  v3  ..  v0  | */
+        " movups 16(%q1, %3, 4), %%xmm2 \n\t" /* |  v7  ..  v4  | */
+        " movups (%0), %%xmm1           \n\t" /* |  p3  ..  p0  | */
+        " movups 16(%0), %%xmm3         \n\t" /* |  p7  ..  p4  | */
+        " mulps %%xmm0, %%xmm1          \n\t"
+        " mulps %%xmm2, %%xmm3          \n\t"
+        " movups %%xmm1, (%0)           \n\t" /* | p3*v3 .. p0*v0 | */
+        " movups %%xmm3, 16(%0)         \n\t" /* | p7*v7 .. p4*v4 | */
+        " add $32, %0                   \n\t"
+        MOD_ADD ($8, %5)
+        " dec %2                        \n\t"
+        " jne 7b                        \n\t"
+        "8:                             \n\t"
+
+        : "+r" (samples), "+r" (volumes), "+r" (length), "=D" (channel), "=&r" (temp)
+#if defined (__i386__)
+        : "m" (channels)
+#else
+        : "r" ((pa_reg_x86)channels)
+#endif
+        : "cc", "memory"
+    );
+}
+
 #endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
 
 void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
@@ -259,5 +338,11 @@ void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
         pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_sse2);
         pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_sse2);
     }
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized float volume functions.");
+
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_sse);
+    }
 #endif /* (!defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__) */
 }
@@ -41,7 +41,6 @@
 
 #define MAX_TAG_SIZE (64*1024)
 #define MAX_APPENDED_SIZE 128
-#define GROW_TAG_SIZE 100
 
 struct pa_tagstruct {
     uint8_t *data;
@@ -51,10 +50,12 @@ struct pa_tagstruct {
     enum {
         PA_TAGSTRUCT_FIXED, /* The tagstruct does not own the data, buffer was provided by caller. */
         PA_TAGSTRUCT_DYNAMIC, /* Buffer owned by tagstruct, data must be freed. */
-        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to dynamic if needed. */
+        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to packet or dynamic if needed. */
+        PA_TAGSTRUCT_PACKET, /* Data points into a pooled packet, which is handed on when sending. Will change to dynamic if needed. */
     } type;
     union {
         uint8_t appended[MAX_APPENDED_SIZE];
+        pa_packet *packet;
     } per_type;
 };
 
@@ -93,10 +94,40 @@ void pa_tagstruct_free(pa_tagstruct*t) {
 
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
         pa_xfree(t->data);
+    else if (t->type == PA_TAGSTRUCT_PACKET)
+        pa_packet_unref(t->per_type.packet);
     if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
         pa_xfree(t);
 }
 
+pa_packet *pa_tagstruct_to_packet_free(pa_tagstruct *t) {
+    pa_packet *p;
+
+    pa_assert(t);
+    pa_assert(t->length > 0);
+
+    switch (t->type) {
+        case PA_TAGSTRUCT_PACKET:
+            p = t->per_type.packet;
+            pa_packet_set_length(p, t->length);
+            break;
+
+        case PA_TAGSTRUCT_DYNAMIC:
+            p = pa_packet_new_dynamic(t->data, t->length);
+            break;
+
+        default:
+            p = pa_packet_new_data(t->data, t->length);
+            break;
+    }
+
+    /* The data is owned by the packet now */
+    t->type = PA_TAGSTRUCT_FIXED;
+    pa_tagstruct_free(t);
+
+    return p;
+}
+
 static inline void extend(pa_tagstruct*t, size_t l) {
     pa_assert(t);
     pa_assert(t->type != PA_TAGSTRUCT_FIXED);
@@ -104,12 +135,30 @@ static inline void extend(pa_tagstruct*t, size_t l) {
     if (t->length+l <= t->allocated)
         return;
 
+    if (t->type == PA_TAGSTRUCT_APPENDED && t->length + l <= PA_PACKET_POOL_SIZE) {
+        pa_packet *p = pa_packet_new(PA_PACKET_POOL_SIZE);
+
+        t->data = (uint8_t*) pa_packet_data(p, &t->allocated);
+        memcpy(t->data, t->per_type.appended, t->length);
+        t->type = PA_TAGSTRUCT_PACKET;
+        t->per_type.packet = p;
+        return;
+    }
+
+    /* Grow exponentially, large replies are put together from many
+     * small values */
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
-        t->data = pa_xrealloc(t->data, t->allocated = t->length + l + GROW_TAG_SIZE);
-    else if (t->type == PA_TAGSTRUCT_APPENDED) {
+        t->data = pa_xrealloc(t->data, t->allocated = PA_MAX(t->length + l, t->allocated * 2));
+    else {
+        uint8_t *data = pa_xmalloc(t->allocated = PA_MAX(t->length + l, t->allocated * 2));
+
+        memcpy(data, t->data, t->length);
+
+        if (t->type == PA_TAGSTRUCT_PACKET)
+            pa_packet_unref(t->per_type.packet);
+
         t->type = PA_TAGSTRUCT_DYNAMIC;
-        t->data = pa_xmalloc(t->allocated = t->length + l + GROW_TAG_SIZE);
-        memcpy(t->data, t->per_type.appended, t->length);
+        t->data = data;
     }
 }
 
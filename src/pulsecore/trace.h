@@ -0,0 +1,50 @@
+#ifndef foopulsecoretracehfoo
+#define foopulsecoretracehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Static tracepoints (USDT probes) in the "pulseaudio" provider, for
+ * attaching perf, SystemTap or bpftrace to a running daemon. An inactive
+ * probe costs a single nop, its arguments are only computed into
+ * registers. With --disable-tracepoints, or without <sys/sdt.h>, the
+ * macros expand to nothing and the arguments are not evaluated.
+ *
+ * Probes are listed with e.g. "perf list sdt_pulseaudio:*" after
+ * "perf buildid-cache --add" on the libraries, or with
+ * "bpftrace -l 'usdt:/path/to/libpulsecore-X.so:*'". See
+ * scripts/pa-latency.bt for an example. */
+
+#ifdef HAVE_TRACEPOINTS
+
+#include <sys/sdt.h>
+
+#define PA_TRACE0(name) DTRACE_PROBE(pulseaudio, name)
+#define PA_TRACE1(name, a) DTRACE_PROBE1(pulseaudio, name, a)
+#define PA_TRACE2(name, a, b) DTRACE_PROBE2(pulseaudio, name, a, b)
+#define PA_TRACE3(name, a, b, c) DTRACE_PROBE3(pulseaudio, name, a, b, c)
+
+#else
+
+#define PA_TRACE0(name) do { } while (0)
+#define PA_TRACE1(name, a) do { } while (0)
+#define PA_TRACE2(name, a, b) do { } while (0)
+#define PA_TRACE3(name, a, b, c) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,436 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+
+#include <pulsecore/arpa-inet.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/poll.h>
+#include <pulsecore/thread.h>
+
+#include "rtp.h"
+#include "a2dp-sbc.h"
+
+/* Runs the A2DP sink write path of module-bluez5-device without a Bluetooth
+ * adapter: the stream socket is one end of a local socketpair, and a thread
+ * on the other end drains the packets at a configurable fraction of the
+ * audio rate, like a link that is fast enough, or not. Packets are encoded,
+ * written and skipped by the same pa_a2dp_sbc_writer as in the module, and
+ * the loop around it follows the timing of the module's IO thread when
+ * there is no source to synchronize to. */
+
+#define MTU 895
+#define DURATION_USEC (1 * PA_USEC_PER_SEC)
+#define MAX_PLAYBACK_CATCH_UP_USEC (100 * PA_USEC_PER_MSEC)
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = 44100,
+    .channels = 2
+};
+
+struct transport {
+    int fds[2];
+    double drain_rate;
+    size_t block_frames;
+
+    pa_thread *thread;
+    pa_atomic_t sender_done;
+
+    /* Filled in by the drain thread */
+    unsigned packets;
+    uint64_t skipped_frames;
+    bool in_order;
+};
+
+struct stats {
+    unsigned packets;
+    unsigned skips;
+    uint64_t skipped_frames;
+    pa_usec_t writer_usec;
+    pa_usec_t write_delay_usec, max_write_delay_usec;
+};
+
+static void drain_thread_func(void *userdata) {
+    struct transport *t = userdata;
+    uint8_t packet[MTU];
+    pa_usec_t start = 0;
+    uint64_t frames = 0;
+    uint16_t expected_seq = 0;
+    uint32_t expected_ts = 0;
+    ssize_t l;
+
+    t->in_order = true;
+
+    while ((l = recv(t->fds[1], packet, sizeof(packet), 0)) > 0) {
+        struct rtp_header *header = (struct rtp_header *) packet;
+        uint32_t ts = ntohl(header->timestamp);
+
+        if (t->packets == 0)
+            start = pa_rtclock_now();
+        else {
+            if (ntohs(header->sequence_number) != expected_seq || ts < expected_ts)
+                t->in_order = false;
+            else
+                t->skipped_frames += ts - expected_ts;
+        }
+
+        expected_seq = ntohs(header->sequence_number) + 1;
+        expected_ts = ts + t->block_frames;
+
+        t->packets++;
+        frames += t->block_frames;
+
+        /* Hand the audio to the "radio" no faster than the drain rate */
+        if (!pa_atomic_load(&t->sender_done)) {
+            pa_usec_t due = start + (pa_usec_t) (frames * PA_USEC_PER_SEC / (ss.rate * t->drain_rate));
+            pa_usec_t now = pa_rtclock_now();
+
+            if (due > now)
+                pa_msleep((unsigned long) ((due - now + PA_USEC_PER_MSEC - 1) / PA_USEC_PER_MSEC));
+        }
+    }
+}
+
+static void transport_open(struct transport *t, double drain_rate, size_t block_size) {
+    int size = 4 * MTU;
+
+    pa_zero(*t);
+    t->drain_rate = drain_rate;
+    t->block_frames = block_size / pa_frame_size(&ss);
+
+    pa_assert_se(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, t->fds) == 0);
+    pa_make_fd_nonblock(t->fds[0]);
+
+    /* Roughly what the controller buffers for us */
+    setsockopt(t->fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(t->fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    pa_assert_se(t->thread = pa_thread_new("a2dp-drain", drain_thread_func, t));
+}
+
+static void transport_close(struct transport *t) {
+    pa_atomic_store(&t->sender_done, 1);
+    shutdown(t->fds[0], SHUT_WR);
+
+    pa_thread_free(t->thread);
+
+    pa_close(t->fds[0]);
+    pa_close(t->fds[1]);
+}
+
+struct sender {
+    sbc_t sbc;
+    pa_mempool *pool;
+    pa_a2dp_sbc_writer writer;
+    size_t block_size;
+    int write_type;
+
+    uint64_t write_index, frame;
+    pa_usec_t rendered_at;
+};
+
+/* Stands in for pa_sink_render_full() */
+static void render(size_t length, pa_memchunk *chunk, void *userdata) {
+    struct sender *s = userdata;
+    int16_t *d;
+    size_t i;
+
+    s->rendered_at = pa_rtclock_now();
+
+    chunk->memblock = pa_memblock_new(s->pool, length);
+    chunk->index = 0;
+    chunk->length = length;
+
+    d = pa_memblock_acquire(chunk->memblock);
+
+    for (i = 0; i < length / pa_frame_size(&ss); i++, s->frame++) {
+        int16_t v = (int16_t) (10000 * sin(2 * M_PI * 440 * (double) s->frame / ss.rate));
+
+        d[2 * i] = d[2 * i + 1] = v;
+    }
+
+    pa_memblock_release(chunk->memblock);
+}
+
+static void sender_init(struct sender *s, bool encode_ahead) {
+    pa_zero(*s);
+    pa_assert_se(sbc_init(&s->sbc, 0) == 0);
+
+    s->sbc.frequency = SBC_FREQ_44100;
+    s->sbc.mode = SBC_MODE_JOINT_STEREO;
+    s->sbc.allocation = SBC_AM_LOUDNESS;
+    s->sbc.subbands = SBC_SB_8;
+    s->sbc.blocks = SBC_BLK_16;
+    s->sbc.bitpool = 53;
+
+    s->block_size = pa_a2dp_sbc_block_size(&s->sbc, MTU);
+    pa_assert_se(s->pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false));
+    pa_a2dp_sbc_writer_init(&s->writer, &s->sbc, &ss, encode_ahead, render, s);
+}
+
+static void sender_done(struct sender *s) {
+    pa_a2dp_sbc_writer_done(&s->writer);
+    pa_mempool_unref(s->pool);
+    sbc_finish(&s->sbc);
+}
+
+/* Returns what pa_a2dp_sbc_writer_write() returned, and when the packet
+ * went out in *written_at */
+static int write_packet(struct sender *s, int fd, struct stats *st, pa_usec_t *written_at) {
+    pa_usec_t start = pa_rtclock_now();
+    int r;
+
+    s->rendered_at = 0;
+    r = pa_a2dp_sbc_writer_write(&s->writer, fd, &s->write_type, &s->write_index, s->block_size, MTU);
+    st->writer_usec += pa_rtclock_now() - start;
+
+    /* When encoding ahead, the next packet was rendered right after the
+     * write, otherwise the packet went out just before returning */
+    *written_at = s->writer.encode_ahead && s->rendered_at > 0 ? s->rendered_at : pa_rtclock_now();
+
+    return r;
+}
+
+static int poll_usec(int fd, short events, pa_usec_t timeout) {
+    struct pollfd pfd = { .fd = fd, .events = events };
+    struct timespec ts = {
+        .tv_sec = timeout / PA_USEC_PER_SEC,
+        .tv_nsec = (timeout % PA_USEC_PER_SEC) * PA_NSEC_PER_USEC,
+    };
+
+    pa_assert_se(ppoll(&pfd, 1, timeout == PA_USEC_INVALID ? NULL : &ts, NULL) >= 0);
+
+    return pfd.revents;
+}
+
+static void run(double drain_rate, bool encode_ahead, struct stats *st, struct transport *t) {
+    struct sender s;
+    pa_usec_t started_at = 0, written_at;
+    bool writable = false;
+    int r;
+
+    sender_init(&s, encode_ahead);
+    transport_open(t, drain_rate, s.block_size);
+    pa_zero(*st);
+
+    while (pa_bytes_to_usec(s.write_index, &ss) < DURATION_USEC) {
+        pa_usec_t time_passed, audio_sent, timeout = PA_USEC_INVALID;
+
+        /* Wait for POLLOUT, or until the next packet is due */
+        if (writable) {
+            time_passed = pa_rtclock_now() - started_at;
+            audio_sent = pa_bytes_to_usec(s.write_index, &ss);
+            timeout = time_passed < audio_sent ? audio_sent - time_passed : 0;
+        }
+
+        if (poll_usec(t->fds[0], writable ? 0 : POLLOUT, timeout) & POLLOUT)
+            writable = true;
+
+        if (!writable)
+            continue;
+
+        if (s.write_index == 0)
+            started_at = pa_rtclock_now();
+
+        time_passed = pa_rtclock_now() - started_at;
+        audio_sent = pa_bytes_to_usec(s.write_index, &ss);
+
+        if (audio_sent > time_passed)
+            continue;
+
+        /* Never try to catch up for more than 100ms */
+        if (s.write_index > 0 && time_passed - audio_sent > MAX_PLAYBACK_CATCH_UP_USEC) {
+            uint64_t skip_bytes = pa_usec_to_bytes(time_passed - audio_sent - MAX_PLAYBACK_CATCH_UP_USEC, &ss);
+
+            pa_a2dp_sbc_writer_skip(&s.writer, &s.write_index, skip_bytes);
+            st->skipped_frames += skip_bytes / pa_frame_size(&ss);
+            st->skips++;
+        }
+
+        r = write_packet(&s, t->fds[0], st, &written_at);
+        fail_unless(r >= 0);
+        writable = false;
+
+        if (r == 0)
+            continue;
+
+        /* How late the packet went out compared to when it was due */
+        time_passed = written_at - started_at;
+        time_passed = time_passed > audio_sent ? time_passed - audio_sent : 0;
+        st->write_delay_usec += time_passed;
+        st->max_write_delay_usec = PA_MAX(st->max_write_delay_usec, time_passed);
+
+        st->packets++;
+    }
+
+    pa_log_info("Drain rate %0.2f, encode %s: %u packets, writer %0.1f us/packet (%0.2f%% CPU), "
+                "write delay avg %0.1f us max %llu us, %u skips",
+                drain_rate, encode_ahead ? "ahead" : "inline", st->packets,
+                (double) st->writer_usec / st->packets,
+                100.0 * st->writer_usec / pa_bytes_to_usec(s.write_index, &ss),
+                (double) st->write_delay_usec / st->packets,
+                (unsigned long long) st->max_write_delay_usec, st->skips);
+
+    /* Send one more packet so that the receiver sees the last skip, too */
+    do {
+        poll_usec(t->fds[0], POLLOUT, PA_USEC_INVALID);
+        r = write_packet(&s, t->fds[0], st, &written_at);
+        fail_unless(r >= 0);
+    } while (r == 0);
+    st->packets++;
+
+    transport_close(t);
+    sender_done(&s);
+}
+
+/* Checks the packets themselves, and that a skip moves a packet that was
+ * encoded ahead behind the gap */
+START_TEST (a2dp_packet_test) {
+    struct sender s;
+    struct rtp_header *header;
+    struct rtp_payload *payload;
+    uint64_t write_index = 0;
+    size_t skip_bytes = 1000 * pa_frame_size(&ss);
+
+    sender_init(&s, true);
+
+    fail_unless(pa_a2dp_sbc_writer_encode(&s.writer, write_index, s.block_size, MTU) == 0);
+    fail_unless(s.writer.packet_size > 0 && s.writer.packet_size <= MTU);
+    fail_unless(s.writer.packet_pcm_size == s.block_size);
+
+    header = (struct rtp_header *) s.writer.packet;
+    payload = (struct rtp_payload *) (s.writer.packet + sizeof(*header));
+
+    fail_unless(header->v == 2);
+    fail_unless(header->pt == 1);
+    fail_unless(ntohs(header->sequence_number) == 0);
+    fail_unless(ntohl(header->timestamp) == 0);
+    fail_unless(payload->frame_count == s.block_size / sbc_get_codesize(&s.sbc));
+    fail_unless(s.writer.packet_size ==
+                sizeof(*header) + sizeof(*payload) + payload->frame_count * sbc_get_frame_length(&s.sbc));
+
+    pa_a2dp_sbc_writer_skip(&s.writer, &write_index, skip_bytes);
+    fail_unless(write_index == skip_bytes);
+    fail_unless(s.frame == (s.block_size + skip_bytes) / pa_frame_size(&ss));
+    fail_unless(ntohl(header->timestamp) == skip_bytes / pa_frame_size(&ss));
+    fail_unless(s.writer.packet_size > 0);
+
+    /* The next packet follows the skipped audio and the pending one */
+    pa_a2dp_sbc_writer_reset(&s.writer);
+    fail_unless(pa_a2dp_sbc_writer_encode(&s.writer, write_index, s.block_size, MTU) == 0);
+    fail_unless(ntohs(header->sequence_number) == 1);
+    fail_unless(ntohl(header->timestamp) == write_index / pa_frame_size(&ss));
+
+    /* A block that doesn't fit into the MTU is refused */
+    pa_a2dp_sbc_writer_reset(&s.writer);
+    fail_unless(pa_a2dp_sbc_writer_encode(&s.writer, write_index, 2 * s.block_size, MTU) < 0);
+    fail_unless(s.writer.packet_size == 0);
+
+    /* ... without using up a sequence number */
+    fail_unless(pa_a2dp_sbc_writer_encode(&s.writer, write_index, s.block_size, MTU) == 0);
+    fail_unless(ntohs(header->sequence_number) == 2);
+
+    sender_done(&s);
+}
+END_TEST
+
+/* Whether a link that keeps up still needs skips depends on the scheduling
+ * of the machine running the tests, so only the packets are checked here.
+ * The timing is logged, run the test without MAKE_CHECK to see it. */
+START_TEST (a2dp_encode_inline_test) {
+    struct transport t;
+    struct stats st;
+
+    run(1.0, false, &st, &t);
+
+    fail_unless(t.in_order);
+    fail_unless(t.packets == st.packets);
+    fail_unless(t.skipped_frames == st.skipped_frames);
+}
+END_TEST
+
+START_TEST (a2dp_encode_ahead_test) {
+    struct transport t;
+    struct stats st;
+
+    run(1.0, true, &st, &t);
+
+    fail_unless(t.in_order);
+    fail_unless(t.packets == st.packets);
+    fail_unless(t.skipped_frames == st.skipped_frames);
+}
+END_TEST
+
+START_TEST (a2dp_slow_link_test) {
+    struct transport t;
+    struct stats st;
+
+    /* The link only takes half of the audio, so we have to skip, and the
+     * skipped audio must show up as gaps in the RTP timestamps */
+    run(0.5, true, &st, &t);
+
+    fail_unless(t.in_order);
+    fail_unless(t.packets == st.packets);
+    fail_unless(st.skips > 0);
+    fail_unless(t.skipped_frames == st.skipped_frames);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("A2DP encode");
+    tc = tcase_create("a2dp-encode");
+    tcase_add_test(tc, a2dp_packet_test);
+    tcase_add_test(tc, a2dp_encode_inline_test);
+    tcase_add_test(tc, a2dp_encode_ahead_test);
+    tcase_add_test(tc, a2dp_slow_link_test);
+    tcase_set_timeout(tc, 30);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
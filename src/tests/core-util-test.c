@@ -0,0 +1,114 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+/* Parses s and checks that the result is the n CPUs in expected */
+static void check_cpu_list(const char *s, const unsigned *expected, int n) {
+    unsigned cpus[16];
+    int i;
+
+    pa_assert(n <= (int) PA_ELEMENTSOF(cpus));
+
+    fail_unless(pa_parse_cpu_list(s, NULL, 0) == n);
+    fail_unless(pa_parse_cpu_list(s, cpus, PA_ELEMENTSOF(cpus)) == n);
+
+    for (i = 0; i < n; i++)
+        fail_unless(cpus[i] == expected[i]);
+}
+
+START_TEST (parse_cpu_list_test) {
+    static const unsigned single[] = { 3 };
+    static const unsigned list[] = { 0, 2, 5 };
+    static const unsigned range[] = { 4, 5, 6, 7 };
+    static const unsigned mixed[] = { 7, 0, 1, 2, 4 };
+    static const unsigned one_cpu_range[] = { 2 };
+    unsigned cpus[2] = { 0, 0 };
+
+    check_cpu_list("3", single, 1);
+    check_cpu_list("0,2,5", list, 3);
+    check_cpu_list("4-7", range, 4);
+    check_cpu_list("2-2", one_cpu_range, 1);
+
+    /* The order of the list is kept */
+    check_cpu_list("7,0-2,4", mixed, 5);
+
+    /* Whitespace around the numbers is fine */
+    check_cpu_list(" 7 , 0 - 2,4 ", mixed, 5);
+    check_cpu_list("\t3\n", single, 1);
+
+    /* Like elsewhere where pa_split() is used, a trailing comma is fine */
+    check_cpu_list("3,", single, 1);
+
+    /* Only as many CPUs as there is room for are stored, but all of them
+     * are counted */
+    fail_unless(pa_parse_cpu_list("4-7", cpus, 2) == 4);
+    fail_unless(cpus[0] == 4 && cpus[1] == 5);
+
+    /* Empty lists and empty entries */
+    fail_unless(pa_parse_cpu_list("", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list(" ", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("1,,2", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list(",1", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("-", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("1-", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("-1", NULL, 0) < 0);
+
+    /* Reversed ranges */
+    fail_unless(pa_parse_cpu_list("7-4", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("0,3-2", NULL, 0) < 0);
+
+    /* Garbage */
+    fail_unless(pa_parse_cpu_list("a", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("1 2", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("1-2-3", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("+1", NULL, 0) < 0);
+
+    /* Out of range CPUs */
+    fail_unless(pa_parse_cpu_list("4095", NULL, 0) == 1);
+    fail_unless(pa_parse_cpu_list("4096", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("0-4096", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("4294967295", NULL, 0) < 0);
+    fail_unless(pa_parse_cpu_list("99999999999", NULL, 0) < 0);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Core-Util");
+    tc = tcase_create("core-util");
+    tcase_add_test(tc, parse_cpu_list_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,340 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#include "runtime-test-util.h"
+
+#define FRAMES 2000
+#define TIMES 1000
+#define TIMES2 50
+
+static void run_peaks_test(
+        pa_sample_format_t format,
+        pa_peaks_func_t func,
+        pa_peaks_func_t orig_func,
+        int align,
+        int channels,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, int16_t, s16[FRAMES * 8 + 16]);
+    PA_DECLARE_ALIGNED(8, float, f[FRAMES * 8 + 16]);
+    int16_t max_s16[PA_CHANNELS_MAX], orig_max_s16[PA_CHANNELS_MAX];
+    float max_f[PA_CHANNELS_MAX], orig_max_f[PA_CHANNELS_MAX];
+    int16_t *samples_s16;
+    float *samples_f;
+    int i, nframes;
+
+    pa_assert(channels <= 8);
+
+    samples_s16 = s16 + align;
+    samples_f = f + align;
+    nframes = (FRAMES * 8 / channels) - align;
+
+    pa_random(samples_s16, nframes * channels * sizeof(int16_t));
+    /* Keep the peaks away from the end of the range, then put the
+     * negative extreme in somewhere */
+    for (i = 0; i < nframes * channels; i++) {
+        samples_s16[i] /= 2;
+        samples_f[i] = samples_s16[i] / (float) 0x8000;
+    }
+    samples_s16[nframes * channels / 2] = -0x8000;
+    samples_f[nframes * channels / 2] = -1.0f;
+
+    if (format == PA_SAMPLE_S16NE) {
+        memset(max_s16, 0, sizeof(max_s16));
+        memset(orig_max_s16, 0, sizeof(orig_max_s16));
+
+        /* In pieces, to also check that the maxima carry over */
+        func(max_s16, samples_s16, channels, nframes / 3);
+        func(max_s16, samples_s16 + nframes / 3 * channels, channels, nframes - nframes / 3);
+        orig_func(orig_max_s16, samples_s16, channels, nframes);
+
+        for (i = 0; i < channels; i++) {
+            if (max_s16[i] != orig_max_s16[i]) {
+                pa_log_debug("Correctness test failed: align=%d, channels=%d", align, channels);
+                pa_log_debug("%d: %hd != %hd", i, max_s16[i], orig_max_s16[i]);
+                fail();
+            }
+        }
+
+        if (perf) {
+            pa_log_debug("Testing s16 peaks performance with %d channels", channels);
+
+            PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+                func(max_s16, samples_s16, channels, nframes);
+            } PA_RUNTIME_TEST_RUN_STOP
+
+            PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+                orig_func(orig_max_s16, samples_s16, channels, nframes);
+            } PA_RUNTIME_TEST_RUN_STOP
+        }
+    } else {
+        memset(max_f, 0, sizeof(max_f));
+        memset(orig_max_f, 0, sizeof(orig_max_f));
+
+        func(max_f, samples_f, channels, nframes / 3);
+        func(max_f, samples_f + nframes / 3 * channels, channels, nframes - nframes / 3);
+        orig_func(orig_max_f, samples_f, channels, nframes);
+
+        for (i = 0; i < channels; i++) {
+            if (max_f[i] != orig_max_f[i]) {
+                pa_log_debug("Correctness test failed: align=%d, channels=%d", align, channels);
+                pa_log_debug("%d: %f != %f", i, max_f[i], orig_max_f[i]);
+                fail();
+            }
+        }
+
+        if (perf) {
+            pa_log_debug("Testing float32 peaks performance with %d channels", channels);
+
+            PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+                func(max_f, samples_f, channels, nframes);
+            } PA_RUNTIME_TEST_RUN_STOP
+
+            PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+                orig_func(orig_max_f, samples_f, channels, nframes);
+            } PA_RUNTIME_TEST_RUN_STOP
+        }
+    }
+}
+
+static void run_peaks_tests(pa_sample_format_t format, pa_peaks_func_t func, pa_peaks_func_t orig_func) {
+    int i, j;
+
+    for (i = 1; i <= 8; i++)
+        for (j = 0; j < 7; j++)
+            run_peaks_test(format, func, orig_func, j, i, false);
+
+    run_peaks_test(format, func, orig_func, 7, 1, true);
+    run_peaks_test(format, func, orig_func, 7, 2, true);
+    run_peaks_test(format, func, orig_func, 7, 6, true);
+}
+
+#ifdef HAVE_AVX2
+START_TEST (peaks_avx2_test) {
+    pa_peaks_func_t orig_s16, orig_float;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_s16 = pa_get_peaks_func(PA_SAMPLE_S16NE);
+    orig_float = pa_get_peaks_func(PA_SAMPLE_FLOAT32NE);
+    pa_peaks_func_init_avx2(flags);
+
+    pa_log_debug("Checking AVX2 peaks (s16)");
+    run_peaks_tests(PA_SAMPLE_S16NE, pa_get_peaks_func(PA_SAMPLE_S16NE), orig_s16);
+    pa_log_debug("Checking AVX2 peaks (float32)");
+    run_peaks_tests(PA_SAMPLE_FLOAT32NE, pa_get_peaks_func(PA_SAMPLE_FLOAT32NE), orig_float);
+}
+END_TEST
+#endif /* HAVE_AVX2 */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (peaks_neon_test) {
+    pa_peaks_func_t orig_s16, orig_float;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_s16 = pa_get_peaks_func(PA_SAMPLE_S16NE);
+    orig_float = pa_get_peaks_func(PA_SAMPLE_FLOAT32NE);
+    pa_peaks_func_init_neon(flags);
+
+    pa_log_debug("Checking NEON peaks (s16)");
+    run_peaks_tests(PA_SAMPLE_S16NE, pa_get_peaks_func(PA_SAMPLE_S16NE), orig_s16);
+    pa_log_debug("Checking NEON peaks (float32)");
+    run_peaks_tests(PA_SAMPLE_FLOAT32NE, pa_get_peaks_func(PA_SAMPLE_FLOAT32NE), orig_float);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
+/* 100 VU meters on one stereo source, like pavucontrol's: mono float32 at
+ * 25 Hz. Those that are created together must give the same output whether
+ * they share the work or not, one that is created later must fall in step. */
+#define STREAMS 100
+#define CHUNKS 200
+#define CHUNK_FRAMES 1024
+
+static void run_streams(pa_resampler **r, pa_peaks_cache *cache, pa_memchunk *chunks, float *out, unsigned *n_out) {
+    unsigned i, j;
+
+    for (i = 0; i < STREAMS; i++)
+        n_out[i] = 0;
+
+    for (j = 0; j < CHUNKS; j++) {
+        for (i = 0; i < STREAMS; i++) {
+            pa_memchunk rchunk;
+
+            if (!r[i])
+                continue;
+
+            if (cache)
+                pa_resampler_run_peaks_cached(r[i], cache, &chunks[j], &rchunk);
+            else
+                pa_resampler_run(r[i], &chunks[j], &rchunk);
+
+            if (rchunk.length > 0) {
+                float *d = pa_memblock_acquire_chunk(&rchunk);
+                unsigned k;
+
+                for (k = 0; k < rchunk.length / sizeof(float); k++, n_out[i]++)
+                    if (out && n_out[i] < CHUNKS)
+                        out[i * CHUNKS + n_out[i]] = d[k];
+
+                pa_memblock_release(rchunk.memblock);
+            }
+
+            if (rchunk.memblock)
+                pa_memblock_unref(rchunk.memblock);
+        }
+
+        if (cache)
+            pa_peaks_cache_flush(cache);
+    }
+}
+
+START_TEST (peaks_shared_test) {
+    pa_sample_spec iss = { PA_SAMPLE_S16NE, 44100, 2 }, oss = { PA_SAMPLE_FLOAT32NE, 25, 1 };
+    pa_channel_map icm, ocm;
+    pa_resampler *r[STREAMS];
+    pa_memchunk chunks[CHUNKS];
+    pa_peaks_cache *cache;
+    pa_mempool *pool;
+    float *out, *orig_out;
+    unsigned n_out[STREAMS], orig_n_out[STREAMS];
+    unsigned i, j;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false));
+    pa_channel_map_init_stereo(&icm);
+    pa_channel_map_init_mono(&ocm);
+
+    for (j = 0; j < CHUNKS; j++) {
+        void *d;
+
+        chunks[j].memblock = pa_memblock_new(pool, CHUNK_FRAMES * pa_frame_size(&iss));
+        chunks[j].index = 0;
+        chunks[j].length = CHUNK_FRAMES * pa_frame_size(&iss);
+
+        d = pa_memblock_acquire(chunks[j].memblock);
+        pa_random(d, chunks[j].length);
+        pa_memblock_release(chunks[j].memblock);
+    }
+
+    out = pa_xnew(float, STREAMS * CHUNKS);
+    orig_out = pa_xnew(float, STREAMS * CHUNKS);
+    cache = pa_peaks_cache_new();
+
+    for (i = 0; i < STREAMS; i++)
+        pa_assert_se(r[i] = pa_resampler_new(pool, &iss, &icm, &oss, &ocm, 0, PA_RESAMPLER_PEAKS, 0));
+
+    PA_RUNTIME_TEST_RUN_START("100 peak streams, separate", 1, 5) {
+        for (i = 0; i < STREAMS; i++)
+            pa_resampler_reset(r[i]);
+        run_streams(r, NULL, chunks, orig_out, orig_n_out);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("100 peak streams, shared", 1, 5) {
+        for (i = 0; i < STREAMS; i++)
+            pa_resampler_reset(r[i]);
+        run_streams(r, cache, chunks, out, n_out);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    for (i = 0; i < STREAMS; i++) {
+        fail_unless(n_out[i] == orig_n_out[i]);
+        fail_unless(memcmp(out + i * CHUNKS, orig_out + i * CHUNKS, PA_MIN(n_out[i], CHUNKS) * sizeof(float)) == 0);
+    }
+
+    /* The last stream starts out of step, half way through a 25 Hz period */
+    for (i = 0; i < STREAMS; i++)
+        pa_resampler_reset(r[i]);
+    for (j = 0; j < 44100 / 25 / 2 / CHUNK_FRAMES + 1; j++) {
+        pa_memchunk rchunk;
+
+        pa_resampler_run(r[STREAMS - 1], &chunks[CHUNKS - 1 - j], &rchunk);
+        if (rchunk.memblock)
+            pa_memblock_unref(rchunk.memblock);
+    }
+    run_streams(r, cache, chunks, out, n_out);
+
+    fail_unless(n_out[STREAMS - 1] == n_out[0]);
+    fail_unless(memcmp(out + (STREAMS - 1) * CHUNKS, out, PA_MIN(n_out[0], CHUNKS) * sizeof(float)) == 0);
+
+    for (i = 0; i < STREAMS; i++)
+        pa_resampler_free(r[i]);
+    for (j = 0; j < CHUNKS; j++)
+        pa_memblock_unref(chunks[j].memblock);
+
+    pa_peaks_cache_free(cache);
+    pa_xfree(out);
+    pa_xfree(orig_out);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("CPU");
+
+    tc = tcase_create("peaks");
+#ifdef HAVE_AVX2
+    tcase_add_test(tc, peaks_avx2_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, peaks_neon_test);
+#endif
+    tcase_add_test(tc, peaks_shared_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
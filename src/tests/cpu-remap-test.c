@@ -21,6 +21,8 @@
 
 #include <check.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu.h>
 #include <pulsecore/random.h>
@@ -171,6 +173,28 @@ static void setup_remap_channels(
     }
 }
 
+/* Distinct gains for every pair of channels, so that mixing up channels or
+ * frames shows up */
+static void setup_remap_matrix(
+    pa_remap_t *m,
+    pa_sample_format_t f,
+    unsigned in_channels,
+    unsigned out_channels) {
+
+    unsigned i, o;
+
+    m->format = f;
+    m->i_ss.channels = in_channels;
+    m->o_ss.channels = out_channels;
+
+    for (o = 0; o < out_channels; o++) {
+        for (i = 0; i < in_channels; i++) {
+            m->map_table_f[o][i] = (float) (1 + (o * 3 + i) % 4) / (4 * in_channels);
+            m->map_table_i[o][i] = (int32_t) (m->map_table_f[o][i] * 0x10000);
+        }
+    }
+}
+
 static void remap_test_channels(
     pa_remap_t *remap_func, pa_remap_t *remap_orig) {
 
@@ -223,6 +247,27 @@ static void remap_init_test_channels(
     remap_test_channels(&remap_func, &remap_orig);
 }
 
+static void remap_init_test_matrix(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels) {
+
+    pa_remap_t remap_orig, remap_func;
+
+    setup_remap_matrix(&remap_orig, f, in_channels, out_channels);
+    orig_init_func(&remap_orig);
+
+    setup_remap_matrix(&remap_func, f, in_channels, out_channels);
+    init_func(&remap_func);
+
+    remap_test_channels(&remap_func, &remap_orig);
+
+    pa_xfree(remap_orig.state);
+    pa_xfree(remap_func.state);
+}
+
 static void remap_init2_test_channels(
         pa_sample_format_t f,
         unsigned in_channels,
@@ -323,6 +368,76 @@ START_TEST (remap_sse2_test) {
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
 }
 END_TEST
+
+#ifdef HAVE_AVX2
+static void remap_avx2_test_layouts(const unsigned layouts[][2], unsigned n) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+    unsigned i;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_avx2(flags);
+    init_func = pa_get_init_remap_func();
+
+    for (i = 0; i < n; i++) {
+        pa_log_debug("Checking AVX2 remap (float, %u-channel->%u-channel)", layouts[i][0], layouts[i][1]);
+        remap_init_test_matrix(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, layouts[i][0], layouts[i][1]);
+        pa_log_debug("Checking AVX2 remap (s16, %u-channel->%u-channel)", layouts[i][0], layouts[i][1]);
+        remap_init_test_matrix(init_func, orig_init_func, PA_SAMPLE_S16NE, layouts[i][0], layouts[i][1]);
+    }
+}
+
+/* 5.1 and 7.1 down- and upmixes, which have their own instances */
+START_TEST (remap_avx2_test) {
+    static const unsigned layouts[][2] = {
+        { 6, 2 }, { 8, 2 }, { 2, 6 }, { 2, 8 },
+    };
+
+    remap_avx2_test_layouts(layouts, PA_ELEMENTSOF(layouts));
+}
+END_TEST
+
+START_TEST (remap_avx2_matrix_test) {
+    static const unsigned layouts[][2] = {
+        { 3, 2 }, { 5, 4 }, { 4, 3 }, { 3, 6 }, { 6, 6 },
+    };
+
+    remap_avx2_test_layouts(layouts, PA_ELEMENTSOF(layouts));
+}
+END_TEST
+
+START_TEST (rearrange_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_avx2(flags);
+    init_func = pa_get_init_remap_func();
+
+    pa_log_debug("Checking AVX2 remap (float, stereo->6-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 6, true);
+    pa_log_debug("Checking AVX2 remap (s16, stereo->6-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 6, true);
+
+    pa_log_debug("Checking AVX2 remap (float, 8-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 8, true);
+    pa_log_debug("Checking AVX2 remap (s16, 8-channel rearrange)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 8, true);
+}
+END_TEST
+#endif /* HAVE_AVX2 */
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -410,6 +525,10 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, remap_mmx_test);
     tcase_add_test(tc, remap_sse2_test);
+#ifdef HAVE_AVX2
+    tcase_add_test(tc, remap_avx2_test);
+    tcase_add_test(tc, remap_avx2_matrix_test);
+#endif
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
@@ -419,6 +538,9 @@ int main(int argc, char *argv[]) {
 
     tc = tcase_create("rearrange");
     tcase_add_test(tc, rearrange_special_test);
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, rearrange_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, rearrange_neon_test);
 #endif
@@ -100,6 +100,156 @@ static void run_volume_test(
     }
 }
 
+/* Like run_volume_test(), for the 32 bit formats */
+static void run_volume_test_32(
+        pa_sample_format_t format,
+        pa_do_volume_func_t func,
+        pa_do_volume_func_t orig_func,
+        int align,
+        int channels,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(32, int32_t, s[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(32, int32_t, s_ref[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(32, int32_t, s_orig[SAMPLES]) = { 0 };
+    int32_t volumes[channels + PADDING];
+    float *fvolumes = (float *) volumes;
+    int32_t *samples, *samples_ref, *samples_orig;
+    int i, padding, nsamples, size;
+
+    samples = s + (8 - align);
+    samples_ref = s_ref + (8 - align);
+    samples_orig = s_orig + (8 - align);
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    size = nsamples * sizeof(int32_t);
+
+    pa_random(samples, size);
+
+    for (i = 0; i < channels; i++) {
+        /* Up to 4x gain, so that s32 also needs clamping */
+        int32_t v = rand() & 0x3ffff;
+
+        if (format == PA_SAMPLE_FLOAT32NE)
+            fvolumes[i] = (float) v / 0x10000;
+        else
+            volumes[i] = v;
+    }
+    for (padding = 0; padding < PADDING; padding++, i++)
+        volumes[i] = volumes[padding];
+
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        for (i = 0; i < nsamples; i++)
+            ((float *) samples)[i] = (float) samples[i] / 0x80000000U;
+    }
+
+    memcpy(samples_ref, samples, size);
+    memcpy(samples_orig, samples, size);
+
+    orig_func(samples_ref, volumes, channels, size);
+    func(samples, volumes, channels, size);
+
+    for (i = 0; i < nsamples; i++) {
+        if (samples[i] != samples_ref[i]) {
+            pa_log_debug("Correctness test failed: format=%s, align=%d, channels=%d",
+                    pa_sample_format_to_string(format), align, channels);
+            pa_log_debug("%d: %08x != %08x (%08x * %08x)\n", i, samples[i], samples_ref[i],
+                    samples_orig[i], volumes[i % channels]);
+            ck_abort();
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s svolume %dch performance with %d sample alignment",
+                pa_sample_format_to_string(format), channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            func(samples, volumes, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            orig_func(samples_ref, volumes, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(memcmp(samples_ref, samples, size) == 0);
+    }
+}
+
+static void run_volume_ramp_test(
+        pa_sample_format_t format,
+        pa_do_volume_ramp_func_t func,
+        pa_do_volume_ramp_func_t orig_func,
+        int align,
+        int channels,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(32, int32_t, s[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(32, int32_t, s_ref[SAMPLES]) = { 0 };
+    PA_DECLARE_ALIGNED(32, int32_t, s_orig[SAMPLES]) = { 0 };
+    float start[channels], step[channels];
+    uint8_t *samples, *samples_ref, *samples_orig;
+    size_t ss = pa_sample_size_of_format(format);
+    int i, nsamples, size;
+
+    samples = (uint8_t *) s + (8 - align) * ss;
+    samples_ref = (uint8_t *) s_ref + (8 - align) * ss;
+    samples_orig = (uint8_t *) s_orig + (8 - align) * ss;
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    size = nsamples * ss;
+
+    pa_random(samples, size);
+
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        for (i = 0; i < nsamples; i++)
+            ((float *) samples)[i] = (float) ((int32_t *) samples)[i] / 0x80000000U;
+    }
+
+    /* Fade between 0 and 2x gain over the buffer, in both directions */
+    for (i = 0; i < channels; i++) {
+        float end = (float) (rand() & 0xffff) / 0x8000;
+
+        start[i] = (float) (rand() & 0xffff) / 0x8000;
+        step[i] = (end - start[i]) / (nsamples / channels);
+    }
+
+    memcpy(samples_ref, samples, size);
+    memcpy(samples_orig, samples, size);
+
+    orig_func(samples_ref, start, step, channels, size);
+    func(samples, start, step, channels, size);
+
+    for (i = 0; i < size; i += ss) {
+        if (memcmp(samples + i, samples_ref + i, ss)) {
+            pa_log_debug("Correctness test failed: format=%s, align=%d, channels=%d",
+                    pa_sample_format_to_string(format), align, channels);
+            pa_log_debug("sample %d differs\n", (int) (i / ss));
+            ck_abort();
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s volume ramp %dch performance with %d sample alignment",
+                pa_sample_format_to_string(format), channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            func(samples, start, step, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            orig_func(samples_ref, start, step, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(memcmp(samples_ref, samples, size) == 0);
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (svolume_mmx_test) {
     pa_do_volume_func_t orig_func, mmx_func;
@@ -154,6 +304,94 @@ START_TEST (svolume_sse_test) {
     run_volume_test(sse_func, orig_func, 7, 3, true, true);
 }
 END_TEST
+
+START_TEST (svolume_sse_float_test) {
+    pa_do_volume_func_t orig_func, sse_func;
+    pa_cpu_x86_flag_t flags = 0;
+    int i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE)) {
+        pa_log_info("SSE not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_volume_func(PA_SAMPLE_FLOAT32NE);
+    pa_volume_func_init_sse(flags);
+    sse_func = pa_get_volume_func(PA_SAMPLE_FLOAT32NE);
+
+    pa_log_debug("Checking SSE float32ne svolume");
+    for (i = 1; i <= 3; i++) {
+        for (j = 0; j < 7; j++)
+            run_volume_test_32(PA_SAMPLE_FLOAT32NE, sse_func, orig_func, j, i, false);
+    }
+    run_volume_test_32(PA_SAMPLE_FLOAT32NE, sse_func, orig_func, 7, 2, true);
+}
+END_TEST
+
+#ifdef HAVE_AVX2
+START_TEST (svolume_avx2_test) {
+    pa_do_volume_func_t orig_float, orig_s32, avx2_float, avx2_s32;
+    pa_cpu_x86_flag_t flags = 0;
+    int i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_float = pa_get_volume_func(PA_SAMPLE_FLOAT32NE);
+    orig_s32 = pa_get_volume_func(PA_SAMPLE_S32NE);
+    pa_volume_func_init_avx2(flags);
+    avx2_float = pa_get_volume_func(PA_SAMPLE_FLOAT32NE);
+    avx2_s32 = pa_get_volume_func(PA_SAMPLE_S32NE);
+
+    pa_log_debug("Checking AVX2 svolume");
+    for (i = 1; i <= 8; i++) {
+        for (j = 0; j < 7; j++) {
+            run_volume_test_32(PA_SAMPLE_FLOAT32NE, avx2_float, orig_float, j, i, false);
+            run_volume_test_32(PA_SAMPLE_S32NE, avx2_s32, orig_s32, j, i, false);
+        }
+    }
+    run_volume_test_32(PA_SAMPLE_FLOAT32NE, avx2_float, orig_float, 7, 2, true);
+    run_volume_test_32(PA_SAMPLE_S32NE, avx2_s32, orig_s32, 7, 2, true);
+}
+END_TEST
+
+START_TEST (svolume_ramp_avx2_test) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_FLOAT32NE, PA_SAMPLE_S32NE };
+    pa_do_volume_ramp_func_t orig_func[PA_ELEMENTSOF(formats)];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned f;
+    int i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        orig_func[f] = pa_get_volume_ramp_func(formats[f]);
+    pa_volume_func_init_avx2(flags);
+
+    pa_log_debug("Checking AVX2 volume ramps");
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        pa_do_volume_ramp_func_t avx2_func = pa_get_volume_ramp_func(formats[f]);
+
+        for (i = 1; i <= 8; i++) {
+            for (j = 0; j < 7; j++)
+                run_volume_ramp_test(formats[f], avx2_func, orig_func[f], j, i, false);
+        }
+        run_volume_ramp_test(formats[f], avx2_func, orig_func[f], 7, 2, true);
+    }
+}
+END_TEST
+#endif /* HAVE_AVX2 */
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__)
@@ -230,6 +468,11 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, svolume_mmx_test);
     tcase_add_test(tc, svolume_sse_test);
+    tcase_add_test(tc, svolume_sse_float_test);
+#ifdef HAVE_AVX2
+    tcase_add_test(tc, svolume_avx2_test);
+    tcase_add_test(tc, svolume_ramp_avx2_test);
+#endif
 #endif
 #if defined (__arm__) && defined (__linux__)
     tcase_add_test(tc, svolume_arm_test);
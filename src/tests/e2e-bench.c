@@ -0,0 +1,683 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* End-to-end benchmark: connects a number of playback and record streams
+ * of mixed sample formats and rates to a daemon and measures what the
+ * whole system costs for them. It is meant to be run against a daemon of
+ * its own with just a null sink loaded, see e2e-bench.sh, which does that
+ * for every memory transport.
+ *
+ * The results are printed to stdout one per line, as
+ * "<label> <metric> <value>", so that they can be collected and compared
+ * across commits. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/macro.h>
+
+/* How often the latency of every stream is sampled */
+#define LATENCY_INTERVAL_USEC (50 * PA_USEC_PER_MSEC)
+
+struct bench_stream {
+    pa_stream *stream;
+    bool playback;
+    uint64_t bytes;
+    unsigned xruns;
+};
+
+/* The IO thread statistics of all sinks or sources together */
+struct timing {
+    pa_histogram process_usec;
+    pa_histogram resample_usec;
+    pa_histogram wakeup_lateness_usec;
+};
+
+enum phase {
+    PHASE_CONNECTING,
+    PHASE_WARMUP,
+    PHASE_MEASURE,
+    PHASE_COLLECT
+};
+
+/* The formats the streams cycle through, so that the daemon has to
+ * convert and resample most of them */
+static const pa_sample_spec sample_specs[] = {
+    { PA_SAMPLE_S16LE, 44100, 2 },
+    { PA_SAMPLE_FLOAT32LE, 48000, 2 },
+    { PA_SAMPLE_S24LE, 96000, 2 },
+    { PA_SAMPLE_S16LE, 22050, 1 },
+    { PA_SAMPLE_S32LE, 32000, 2 },
+    { PA_SAMPLE_FLOAT32LE, 44100, 1 },
+};
+
+static pa_mainloop *mainloop = NULL;
+static pa_context *context = NULL;
+static pa_time_event *latency_event = NULL;
+
+static struct bench_stream *streams = NULL;
+static unsigned n_playback = 8, n_record = 2, n_ready = 0;
+static unsigned warmup_sec = 2, duration_sec = 10, latency_msec = 40;
+static const char *label = "default";
+static pid_t daemon_pid = 0, remote_daemon_pid = 0;
+
+static enum phase phase = PHASE_CONNECTING;
+static unsigned pending_operations = 0;
+
+static pa_usec_t start_time, end_time;
+static uint64_t start_daemon_ticks, end_daemon_ticks;
+static uint64_t start_remote_daemon_ticks, end_remote_daemon_ticks;
+static pa_usec_t start_client_cpu, end_client_cpu;
+
+static pa_histogram playback_latency, record_latency;
+static struct timing sink_timing[2], source_timing[2];
+
+static void quit(int ret) {
+    pa_mainloop_quit(mainloop, ret);
+}
+
+/* The user and system time of a daemon in clock ticks, from
+ * /proc/<pid>/stat */
+static int read_daemon_ticks(pid_t pid, uint64_t *ticks) {
+    char fn[64], buf[1024], *p;
+    unsigned long long utime, stime;
+    FILE *f;
+    bool ok;
+
+    if (pid <= 0)
+        return -1;
+
+    pa_snprintf(fn, sizeof(fn), "/proc/%lu/stat", (unsigned long) pid);
+
+    if (!(f = fopen(fn, "r")))
+        return -1;
+
+    ok = !!fgets(buf, sizeof(buf), f);
+    fclose(f);
+
+    /* The process name may contain spaces, the fields after it don't */
+    if (!ok || !(p = strrchr(buf, ')')))
+        return -1;
+
+    if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2)
+        return -1;
+
+    *ticks = utime + stime;
+    return 0;
+}
+
+static pa_usec_t client_cpu_usec(void) {
+    struct rusage ru;
+
+    pa_assert_se(getrusage(RUSAGE_SELF, &ru) == 0);
+
+    return pa_timeval_load(&ru.ru_utime) + pa_timeval_load(&ru.ru_stime);
+}
+
+/* Reads a "<key>: <n> kB" line of /proc/<pid>/status, pid 0 is this
+ * process */
+static int read_status_kb(pid_t pid, const char *key, unsigned long *kb) {
+    char fn[64], line[256];
+    size_t l = strlen(key);
+    FILE *f;
+    int r = -1;
+
+    if (pid > 0)
+        pa_snprintf(fn, sizeof(fn), "/proc/%lu/status", (unsigned long) pid);
+    else
+        pa_snprintf(fn, sizeof(fn), "/proc/self/status");
+
+    if (!(f = fopen(fn, "r")))
+        return -1;
+
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, key, l) == 0 && line[l] == ':') {
+            r = sscanf(line + l + 1, "%lu", kb) == 1 ? 0 : -1;
+            break;
+        }
+
+    fclose(f);
+    return r;
+}
+
+static void add_histogram_info(pa_histogram *h, const pa_histogram_info *i) {
+    uint32_t j;
+
+    for (j = 0; j < i->n_buckets; j++)
+        h->buckets[pa_histogram_bucket_index(i->buckets[j].upper_bound)] += i->buckets[j].count;
+
+    h->count += i->count;
+    h->sum += i->sum;
+    h->max = PA_MAX(h->max, i->max);
+}
+
+/* Leaves the values that were added between the two snapshots in b */
+static void histogram_subtract(pa_histogram *b, const pa_histogram *a) {
+    unsigned j;
+
+    b->count -= a->count;
+    b->sum -= a->sum;
+
+    for (j = 0; j < PA_HISTOGRAM_N_BUCKETS; j++)
+        b->buckets[j] -= a->buckets[j];
+
+    /* Only the bucket of the largest value is known now */
+    for (j = PA_HISTOGRAM_N_BUCKETS; j > 0; j--)
+        if (b->buckets[j - 1] > 0) {
+            b->max = PA_MIN(b->max, pa_histogram_bucket_upper_bound(j - 1));
+            break;
+        }
+}
+
+static void print_value(const char *metric, const char *format, ...) PA_GCC_PRINTF_ATTR(2,3);
+
+static void print_value(const char *metric, const char *format, ...) {
+    va_list ap;
+
+    printf("%s %s ", label, metric);
+
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+
+    printf("\n");
+}
+
+static void print_histogram(const char *metric, const pa_histogram *h) {
+    char name[128];
+
+    if (h->count == 0)
+        return;
+
+    pa_snprintf(name, sizeof(name), "%s_count", metric);
+    print_value(name, "%" PRIu64, h->count);
+    pa_snprintf(name, sizeof(name), "%s_mean", metric);
+    print_value(name, "%" PRIu64, h->sum / h->count);
+    pa_snprintf(name, sizeof(name), "%s_p50", metric);
+    print_value(name, "%" PRIu64, pa_histogram_quantile(h, 0.5));
+    pa_snprintf(name, sizeof(name), "%s_p99", metric);
+    print_value(name, "%" PRIu64, pa_histogram_quantile(h, 0.99));
+    pa_snprintf(name, sizeof(name), "%s_p999", metric);
+    print_value(name, "%" PRIu64, pa_histogram_quantile(h, 0.999));
+    pa_snprintf(name, sizeof(name), "%s_max", metric);
+    print_value(name, "%" PRIu64, h->max);
+}
+
+static void print_daemon_usage(const char *prefix, pid_t pid, uint64_t start_ticks, uint64_t end_ticks, pa_usec_t elapsed) {
+    unsigned n = n_playback + n_record;
+    char name[128];
+    unsigned long kb;
+
+    if (pid <= 0)
+        return;
+
+    if (end_ticks >= start_ticks) {
+        double cpu = (double) (end_ticks - start_ticks) / (double) sysconf(_SC_CLK_TCK) *
+            PA_USEC_PER_SEC / (double) elapsed * 100.0;
+
+        pa_snprintf(name, sizeof(name), "%s_cpu_percent", prefix);
+        print_value(name, "%0.3f", cpu);
+        pa_snprintf(name, sizeof(name), "%s_cpu_percent_per_stream", prefix);
+        print_value(name, "%0.4f", cpu / n);
+    }
+
+    pa_snprintf(name, sizeof(name), "%s_rss_kb", prefix);
+    if (read_status_kb(pid, "VmRSS", &kb) >= 0)
+        print_value(name, "%lu", kb);
+    pa_snprintf(name, sizeof(name), "%s_peak_rss_kb", prefix);
+    if (read_status_kb(pid, "VmHWM", &kb) >= 0)
+        print_value(name, "%lu", kb);
+}
+
+static void print_results(void) {
+    pa_usec_t elapsed = end_time - start_time;
+    unsigned n = n_playback + n_record;
+    uint64_t playback_bytes = 0, record_bytes = 0;
+    unsigned underruns = 0, overruns = 0, i;
+    unsigned long kb;
+
+    for (i = 0; i < n; i++) {
+        if (streams[i].playback) {
+            playback_bytes += streams[i].bytes;
+            underruns += streams[i].xruns;
+        } else {
+            record_bytes += streams[i].bytes;
+            overruns += streams[i].xruns;
+        }
+    }
+
+    print_value("playback_streams", "%u", n_playback);
+    print_value("record_streams", "%u", n_record);
+    print_value("duration_usec", "%llu", (unsigned long long) elapsed);
+    print_value("playback_bytes", "%" PRIu64, playback_bytes);
+    print_value("record_bytes", "%" PRIu64, record_bytes);
+    print_value("underruns", "%u", underruns);
+    print_value("overruns", "%u", overruns);
+
+    print_daemon_usage("daemon", daemon_pid, start_daemon_ticks, end_daemon_ticks, elapsed);
+    print_daemon_usage("remote_daemon", remote_daemon_pid, start_remote_daemon_ticks, end_remote_daemon_ticks, elapsed);
+
+    print_value("client_cpu_percent", "%0.3f", (double) (end_client_cpu - start_client_cpu) / (double) elapsed * 100.0);
+
+    if (read_status_kb(0, "VmHWM", &kb) >= 0)
+        print_value("client_peak_rss_kb", "%lu", kb);
+
+    histogram_subtract(&sink_timing[1].process_usec, &sink_timing[0].process_usec);
+    histogram_subtract(&sink_timing[1].resample_usec, &sink_timing[0].resample_usec);
+    histogram_subtract(&sink_timing[1].wakeup_lateness_usec, &sink_timing[0].wakeup_lateness_usec);
+    histogram_subtract(&source_timing[1].process_usec, &source_timing[0].process_usec);
+    histogram_subtract(&source_timing[1].resample_usec, &source_timing[0].resample_usec);
+
+    print_histogram("sink_render_usec", &sink_timing[1].process_usec);
+    print_histogram("sink_resample_usec", &sink_timing[1].resample_usec);
+    print_histogram("sink_wakeup_lateness_usec", &sink_timing[1].wakeup_lateness_usec);
+    print_histogram("source_post_usec", &source_timing[1].process_usec);
+    print_histogram("source_resample_usec", &source_timing[1].resample_usec);
+    print_histogram("playback_latency_usec", &playback_latency);
+    print_histogram("record_latency_usec", &record_latency);
+
+    fflush(stdout);
+}
+
+static void timing_info_cb(pa_context *c, const pa_io_timing_info *i, int eol, void *userdata) {
+    struct timing *t = userdata;
+
+    if (eol < 0) {
+        fprintf(stderr, "Failed to get timing information: %s\n", pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    if (!eol) {
+        add_histogram_info(&t->process_usec, &i->process_usec);
+        add_histogram_info(&t->resample_usec, &i->resample_usec);
+        add_histogram_info(&t->wakeup_lateness_usec, &i->wakeup_lateness_usec);
+        return;
+    }
+
+    pa_assert(pending_operations > 0);
+
+    if (--pending_operations > 0 || phase != PHASE_COLLECT)
+        return;
+
+    print_results();
+    quit(0);
+}
+
+static void get_timing(unsigned which) {
+    pa_operation *o;
+
+    pa_assert_se(o = pa_context_get_sink_timing_info_list(context, timing_info_cb, &sink_timing[which]));
+    pa_operation_unref(o);
+    pa_assert_se(o = pa_context_get_source_timing_info_list(context, timing_info_cb, &source_timing[which]));
+    pa_operation_unref(o);
+
+    pending_operations += 2;
+}
+
+static void latency_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    unsigned i;
+
+    for (i = 0; i < n_playback + n_record; i++) {
+        pa_usec_t usec;
+        int negative;
+
+        if (pa_stream_get_latency(streams[i].stream, &usec, &negative) < 0 || negative)
+            continue;
+
+        pa_histogram_add(streams[i].playback ? &playback_latency : &record_latency, usec);
+    }
+
+    pa_context_rttime_restart(context, e, pa_rtclock_now() + LATENCY_INTERVAL_USEC);
+}
+
+static void end_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    a->time_free(e);
+
+    end_time = pa_rtclock_now();
+    end_client_cpu = client_cpu_usec();
+    if (read_daemon_ticks(daemon_pid, &end_daemon_ticks) < 0)
+        daemon_pid = 0;
+    if (read_daemon_ticks(remote_daemon_pid, &end_remote_daemon_ticks) < 0)
+        remote_daemon_pid = 0;
+
+    a->time_free(latency_event);
+    latency_event = NULL;
+
+    phase = PHASE_COLLECT;
+    get_timing(1);
+}
+
+static void warmup_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    unsigned i;
+
+    a->time_free(e);
+
+    for (i = 0; i < n_playback + n_record; i++) {
+        streams[i].bytes = 0;
+        streams[i].xruns = 0;
+    }
+
+    start_time = pa_rtclock_now();
+    start_client_cpu = client_cpu_usec();
+    if (read_daemon_ticks(daemon_pid, &start_daemon_ticks) < 0)
+        daemon_pid = 0;
+    if (read_daemon_ticks(remote_daemon_pid, &start_remote_daemon_ticks) < 0)
+        remote_daemon_pid = 0;
+
+    phase = PHASE_MEASURE;
+    get_timing(0);
+
+    latency_event = pa_context_rttime_new(context, start_time + LATENCY_INTERVAL_USEC, latency_cb, NULL);
+    pa_context_rttime_new(context, start_time + duration_sec * PA_USEC_PER_SEC, end_cb, NULL);
+}
+
+static void write_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    struct bench_stream *b = userdata;
+
+    while (nbytes > 0) {
+        void *data;
+        size_t l = nbytes;
+
+        /* Let the library hand out shared memory where it can, so that
+         * the transport is exercised like it is by real clients */
+        if (pa_stream_begin_write(s, &data, &l) < 0) {
+            fprintf(stderr, "pa_stream_begin_write() failed: %s\n", pa_strerror(pa_context_errno(context)));
+            quit(1);
+            return;
+        }
+
+        memset(data, 0, l);
+
+        if (pa_stream_write(s, data, l, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+            fprintf(stderr, "pa_stream_write() failed: %s\n", pa_strerror(pa_context_errno(context)));
+            quit(1);
+            return;
+        }
+
+        b->bytes += l;
+        nbytes -= l;
+    }
+}
+
+static void read_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    struct bench_stream *b = userdata;
+
+    while (pa_stream_readable_size(s) > 0) {
+        const void *data;
+        size_t l;
+
+        if (pa_stream_peek(s, &data, &l) < 0) {
+            fprintf(stderr, "pa_stream_peek() failed: %s\n", pa_strerror(pa_context_errno(context)));
+            quit(1);
+            return;
+        }
+
+        if (l == 0)
+            break;
+
+        b->bytes += l;
+        pa_stream_drop(s);
+    }
+}
+
+static void xrun_cb(pa_stream *s, void *userdata) {
+    struct bench_stream *b = userdata;
+
+    if (phase == PHASE_MEASURE)
+        b->xruns++;
+}
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+    switch (pa_stream_get_state(s)) {
+        case PA_STREAM_CREATING:
+        case PA_STREAM_TERMINATED:
+            break;
+
+        case PA_STREAM_READY:
+            if (++n_ready == n_playback + n_record) {
+                fprintf(stderr, "All %u streams are running, warming up.\n", n_ready);
+                phase = PHASE_WARMUP;
+                pa_context_rttime_new(context, pa_rtclock_now() + warmup_sec * PA_USEC_PER_SEC, warmup_cb, NULL);
+            }
+            break;
+
+        case PA_STREAM_FAILED:
+        default:
+            fprintf(stderr, "Stream error: %s\n", pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+            quit(1);
+    }
+}
+
+static void create_streams(pa_context *c) {
+    unsigned i;
+
+    streams = pa_xnew0(struct bench_stream, n_playback + n_record);
+
+    for (i = 0; i < n_playback + n_record; i++) {
+        struct bench_stream *b = &streams[i];
+        const pa_sample_spec *ss = &sample_specs[i % PA_ELEMENTSOF(sample_specs)];
+        pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+        pa_buffer_attr attr;
+        char name[64];
+
+        b->playback = i < n_playback;
+
+        pa_snprintf(name, sizeof(name), "%s #%u", b->playback ? "playback" : "record", i);
+        pa_assert_se(b->stream = pa_stream_new(c, name, ss, NULL));
+        pa_stream_set_state_callback(b->stream, stream_state_cb, b);
+
+        attr.maxlength = (uint32_t) -1;
+        attr.tlength = (uint32_t) pa_usec_to_bytes(latency_msec * PA_USEC_PER_MSEC, ss);
+        attr.prebuf = (uint32_t) -1;
+        attr.minreq = (uint32_t) -1;
+        attr.fragsize = attr.tlength;
+
+        if (b->playback) {
+            pa_stream_set_write_callback(b->stream, write_cb, b);
+            pa_stream_set_underflow_callback(b->stream, xrun_cb, b);
+            pa_assert_se(pa_stream_connect_playback(b->stream, NULL, &attr, flags, NULL, NULL) >= 0);
+        } else {
+            pa_stream_set_read_callback(b->stream, read_cb, b);
+            pa_stream_set_overflow_callback(b->stream, xrun_cb, b);
+            pa_assert_se(pa_stream_connect_record(b->stream, NULL, &attr, flags) >= 0);
+        }
+    }
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+        case PA_CONTEXT_TERMINATED:
+            break;
+
+        case PA_CONTEXT_READY:
+            if (n_playback + n_record == 0) {
+                fprintf(stderr, "No streams requested.\n");
+                quit(1);
+                break;
+            }
+
+            create_streams(c);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Connection failure: %s\n", pa_strerror(pa_context_errno(c)));
+            quit(1);
+    }
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "  -h, --help                 Show this help\n"
+           "  -s, --server=SERVER        The name of the server to connect to\n"
+           "  -p, --playback=N           Number of playback streams (default 8)\n"
+           "  -r, --record=N             Number of record streams (default 2)\n"
+           "  -d, --duration=SECS        Length of the measurement (default 10)\n"
+           "  -w, --warmup=SECS          Time to let the streams settle first (default 2)\n"
+           "  -l, --latency-msec=MSEC    Requested latency of the streams (default 40)\n"
+           "      --label=LABEL          First column of the output, e.g. the transport\n"
+           "      --daemon-pid=PID       Process of the daemon, for CPU and memory usage\n"
+           "      --remote-daemon-pid=PID  Process of the daemon behind a tunnel, likewise\n",
+           argv0);
+}
+
+enum {
+    ARG_LABEL = 256,
+    ARG_DAEMON_PID,
+    ARG_REMOTE_DAEMON_PID
+};
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",         0, NULL, 'h'},
+        {"server",       1, NULL, 's'},
+        {"playback",     1, NULL, 'p'},
+        {"record",       1, NULL, 'r'},
+        {"duration",     1, NULL, 'd'},
+        {"warmup",       1, NULL, 'w'},
+        {"latency-msec", 1, NULL, 'l'},
+        {"label",        1, NULL, ARG_LABEL},
+        {"daemon-pid",   1, NULL, ARG_DAEMON_PID},
+        {"remote-daemon-pid", 1, NULL, ARG_REMOTE_DAEMON_PID},
+        {NULL,           0, NULL, 0}
+    };
+
+    const char *server = NULL;
+    uint32_t pid;
+    int c, ret = 1;
+
+    while ((c = getopt_long(argc, argv, "hs:p:r:d:w:l:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                return 0;
+
+            case 's':
+                server = optarg;
+                break;
+
+            case 'p':
+                if (pa_atou(optarg, &n_playback) < 0) {
+                    fprintf(stderr, "Invalid number of playback streams: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'r':
+                if (pa_atou(optarg, &n_record) < 0) {
+                    fprintf(stderr, "Invalid number of record streams: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'd':
+                if (pa_atou(optarg, &duration_sec) < 0 || duration_sec == 0) {
+                    fprintf(stderr, "Invalid duration: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'w':
+                if (pa_atou(optarg, &warmup_sec) < 0) {
+                    fprintf(stderr, "Invalid warmup time: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'l':
+                if (pa_atou(optarg, &latency_msec) < 0 || latency_msec == 0) {
+                    fprintf(stderr, "Invalid latency: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case ARG_LABEL:
+                label = optarg;
+                break;
+
+            case ARG_DAEMON_PID:
+                if (pa_atou(optarg, &pid) < 0 || pid == 0) {
+                    fprintf(stderr, "Invalid daemon pid: %s\n", optarg);
+                    return 1;
+                }
+                daemon_pid = (pid_t) pid;
+                break;
+
+            case ARG_REMOTE_DAEMON_PID:
+                if (pa_atou(optarg, &pid) < 0 || pid == 0) {
+                    fprintf(stderr, "Invalid daemon pid: %s\n", optarg);
+                    return 1;
+                }
+                remote_daemon_pid = (pid_t) pid;
+                break;
+
+            default:
+                help(argv[0]);
+                return 1;
+        }
+    }
+
+    mainloop = pa_mainloop_new();
+    pa_assert_se(context = pa_context_new(pa_mainloop_get_api(mainloop), "e2e-bench"));
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+
+    if (pa_context_connect(context, server, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
+        fprintf(stderr, "pa_context_connect() failed: %s\n", pa_strerror(pa_context_errno(context)));
+        goto finish;
+    }
+
+    pa_mainloop_run(mainloop, &ret);
+
+finish:
+    if (streams) {
+        unsigned i;
+
+        for (i = 0; i < n_playback + n_record; i++)
+            if (streams[i].stream) {
+                pa_stream_disconnect(streams[i].stream);
+                pa_stream_unref(streams[i].stream);
+            }
+
+        pa_xfree(streams);
+    }
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(mainloop);
+
+    return ret;
+}
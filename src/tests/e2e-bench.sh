@@ -0,0 +1,180 @@
+#!/bin/sh
+#
+# Runs e2e-bench against a daemon of its own with a null sink, once for
+# every memory transport. Arguments are passed on to e2e-bench, e.g.
+#
+#   tests/e2e-bench.sh --playback=32 --record=4 --duration=30 > results.txt
+#
+# The transports that are benchmarked can be picked with E2E_BENCH_MODES,
+# by default these are:
+#
+#   pipe        no shared memory, all audio is copied through the socket
+#   shm         POSIX shared memory
+#   memfd       memfd shared memory
+#   srbchannel  memfd shared memory and the shared ringbuffer channel
+#   tunnel      memfd, with the null sink on a second daemon behind
+#               module-tunnel-sink-new, whose CPU and memory usage are
+#               reported as remote_daemon_*
+#   tunnel-pipe like tunnel, but without shared memory, so that all audio
+#               crosses the sockets like over a network
+#   tunnel-rice like tunnel-pipe, with the tunnel sending its audio
+#               PA_ENCODING_PCM_RICE compressed
+#   filter-chain
+#               memfd, with the streams playing to a chain of four
+#               module-virtual-sink filters on top of the null sink
+#   snapshot    runs snapshot-bench instead, which compares introspection
+#               with one request per kind of object against a single
+#               snapshot request, with arguments from
+#               E2E_BENCH_SNAPSHOT_ARGS, e.g. "--samples=2000"
+#
+# This script is called from within the src/ directory of the build tree,
+# where pulseaudio, e2e-bench and snapshot-bench are found in $PATH.
+#
+
+SCRIPTNAME="$0"
+MODES=${E2E_BENCH_MODES:-"pipe shm memfd srbchannel tunnel tunnel-pipe tunnel-rice filter-chain snapshot"}
+DLPATH=${E2E_BENCH_DL_SEARCH_PATH:-"${PWD}/.libs/"}
+
+die()
+{
+    for PID in $DAEMON_PID $REMOTE_DAEMON_PID; do
+        kill -9 $PID
+    done
+    if ! test -z "$TEMP_PULSE_DIR" ; then
+        rm -rf "$TEMP_PULSE_DIR"
+    fi
+    echo $SCRIPTNAME: $* >&2
+    exit 1
+}
+
+# start_daemon DIR ARGS... starts a daemon with its runtime files in DIR,
+# and sets DAEMON to its pid once it accepts connections
+start_daemon()
+{
+    DIR=$1
+    shift
+
+    mkdir -p "$DIR"
+
+    PULSE_RUNTIME_PATH=$DIR PULSE_STATE_PATH=$DIR/state \
+    pulseaudio -n \
+            --daemonize=no \
+            --exit-idle-time=-1 \
+            --log-target=file:$DIR/pulse-daemon.log \
+            --dl-search-path="$DLPATH" \
+            "$@" \
+            &
+    DAEMON=$!
+
+    # wait for the daemon to start accepting connections
+    for i in `seq 50`; do
+        test -S "$DIR/native" && break
+        sleep 0.1
+    done
+
+    test -S "$DIR/native" || die "The daemon did not start, see $DIR/pulse-daemon.log"
+}
+
+trap 'die "Received SIGINT"' INT
+
+unset DISPLAY
+unset PULSE_SERVER
+
+EXIT_CODE=0
+
+for MODE in $MODES; do
+    case $MODE in
+        pipe|tunnel-pipe|tunnel-rice)
+            DAEMON_ARGS="--disable-shm=yes"
+            CLIENT_CONF="enable-shm = no"
+            SRBCHANNEL=no
+            ;;
+        shm)
+            DAEMON_ARGS="--disable-shm=no --enable-memfd=no"
+            CLIENT_CONF="enable-shm = yes
+enable-memfd = no"
+            SRBCHANNEL=no
+            ;;
+        memfd|tunnel|snapshot)
+            DAEMON_ARGS="--disable-shm=no --enable-memfd=yes"
+            CLIENT_CONF="enable-shm = yes
+enable-memfd = yes"
+            SRBCHANNEL=no
+            ;;
+        filter-chain)
+            DAEMON_ARGS="--disable-shm=no --enable-memfd=yes"
+            CLIENT_CONF="enable-shm = yes
+enable-memfd = yes
+default-sink = filter4"
+            SRBCHANNEL=no
+            ;;
+        srbchannel)
+            DAEMON_ARGS="--disable-shm=no --enable-memfd=yes"
+            CLIENT_CONF="enable-shm = yes
+enable-memfd = yes"
+            SRBCHANNEL=yes
+            ;;
+        *)
+            die "Unknown mode $MODE"
+            ;;
+    esac
+
+    TEMP_PULSE_DIR=`mktemp -d`
+    export PULSE_CLIENTCONFIG=${TEMP_PULSE_DIR}/client.conf
+
+    echo "$CLIENT_CONF" > "$PULSE_CLIENTCONFIG"
+
+    echo "Benchmarking $MODE" >&2
+
+    if test "$MODE" = tunnel || test "$MODE" = tunnel-pipe || test "$MODE" = tunnel-rice ; then
+        start_daemon "${TEMP_PULSE_DIR}/remote" \
+                --load="module-null-sink" \
+                --load="module-native-protocol-unix" \
+                $DAEMON_ARGS
+        REMOTE_DAEMON_PID=$DAEMON
+
+        SINK_ARGS="--load=module-tunnel-sink-new server=unix:${TEMP_PULSE_DIR}/remote/native"
+        if test "$MODE" = tunnel-rice ; then
+            SINK_ARGS="$SINK_ARGS compression=rice"
+        fi
+        REMOTE_ARGS="--remote-daemon-pid=$REMOTE_DAEMON_PID"
+    elif test "$MODE" = filter-chain ; then
+        cat > "${TEMP_PULSE_DIR}/filter-chain.pa" <<EOF
+load-module module-null-sink
+load-module module-virtual-sink sink_name=filter1 master=null
+load-module module-virtual-sink sink_name=filter2 master=filter1
+load-module module-virtual-sink sink_name=filter3 master=filter2
+load-module module-virtual-sink sink_name=filter4 master=filter3
+EOF
+
+        SINK_ARGS="--file=${TEMP_PULSE_DIR}/filter-chain.pa"
+        REMOTE_ARGS=
+    else
+        SINK_ARGS="--load=module-null-sink"
+        REMOTE_ARGS=
+    fi
+
+    start_daemon "${TEMP_PULSE_DIR}/local" \
+            "$SINK_ARGS" \
+            --load="module-native-protocol-unix srbchannel=$SRBCHANNEL" \
+            $DAEMON_ARGS
+    DAEMON_PID=$DAEMON
+
+    if test "$MODE" = snapshot ; then
+        snapshot-bench --server="unix:${TEMP_PULSE_DIR}/local/native" --label=$MODE $E2E_BENCH_SNAPSHOT_ARGS || EXIT_CODE=1
+    else
+        e2e-bench --server="unix:${TEMP_PULSE_DIR}/local/native" --label=$MODE --daemon-pid=$DAEMON_PID $REMOTE_ARGS "$@" || EXIT_CODE=1
+    fi
+
+    for PID in $DAEMON_PID $REMOTE_DAEMON_PID; do
+        kill -TERM $PID
+        wait $PID
+    done
+    DAEMON_PID=
+    REMOTE_DAEMON_PID=
+
+    rm -rf "$TEMP_PULSE_DIR"
+    TEMP_PULSE_DIR=
+done
+
+exit $EXIT_CODE
@@ -0,0 +1,520 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/source-output.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+/* A device sink with two filter sinks stacked on it and a stream playing
+ * to the upper one:
+ *
+ *   stream -> filter "upper" -> filter "lower" -> device
+ *
+ * When the device renders, the lower filter renders its sink with
+ * pa_sink_render_filter_chain(), which bypasses the render queue of the
+ * upper filter's sink input. */
+
+#define BLOCK_BYTES 1024
+#define REWIND_BYTES (8 * BLOCK_BYTES)
+#define OUTPUT_SAMPLES (64 * 1024)
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = 44100,
+    .channels = 1
+};
+
+struct device {
+    pa_sink *sink;
+    pa_rtpoll *rtpoll;
+    pa_thread_mq thread_mq;
+    pa_thread *thread;
+
+    /* Everything the device has played, a rewind moves back pos */
+    int16_t output[OUTPUT_SAMPLES];
+    size_t pos;
+};
+
+struct filter {
+    pa_sink *sink;
+    pa_sink_input *sink_input;
+
+    unsigned n_pop, n_process_filter;
+};
+
+struct stream {
+    pa_sink_input *sink_input;
+    size_t counter;
+};
+
+struct monitor {
+    pa_source_output *source_output;
+    size_t length;
+};
+
+enum {
+    DEVICE_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    DEVICE_MESSAGE_REWIND
+};
+
+static pa_mainloop *mainloop;
+static pa_core *core;
+
+/* The stream never repeats a sample and never plays silence */
+static int16_t sample_at(size_t n) {
+    return (int16_t) (n % 30000 + 1);
+}
+
+/* Called from I/O thread context */
+static void device_render(struct device *d, size_t length) {
+    pa_memchunk chunk;
+
+    pa_assert(d->pos * sizeof(int16_t) + length <= sizeof(d->output));
+
+    pa_sink_render_full(d->sink, length, &chunk);
+    memcpy(d->output + d->pos, pa_memblock_acquire_chunk(&chunk), chunk.length);
+    pa_memblock_release(chunk.memblock);
+    pa_memblock_unref(chunk.memblock);
+
+    d->pos += chunk.length / sizeof(int16_t);
+}
+
+/* Called from I/O thread context */
+static int device_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    struct device *d = PA_SINK(o)->userdata;
+
+    switch (code) {
+
+        case DEVICE_MESSAGE_RENDER:
+            device_render(d, (size_t) offset);
+            return 0;
+
+        case DEVICE_MESSAGE_REWIND: {
+            size_t nbytes;
+
+            /* Something new showed up on the lower filter sink, like a
+             * stream that was moved there. The rewind starts below the
+             * upper filter, which is asked for nothing new. */
+            pa_sink_request_rewind(data, (size_t) offset);
+
+            nbytes = PA_MIN(d->sink->thread_info.rewind_nbytes, d->pos * sizeof(int16_t));
+            fail_unless(nbytes == (size_t) offset);
+
+            pa_sink_process_rewind(d->sink, nbytes);
+            d->pos -= nbytes / sizeof(int16_t);
+            return 0;
+        }
+
+        case PA_SINK_MESSAGE_GET_LATENCY:
+            *((pa_usec_t*) data) = 0;
+            return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void device_thread_func(void *userdata) {
+    struct device *d = userdata;
+
+    pa_thread_mq_install(&d->thread_mq);
+
+    while (pa_rtpoll_run(d->rtpoll) > 0)
+        ;
+}
+
+static struct device *device_new(void) {
+    struct device *d;
+    pa_sink_new_data data;
+
+    d = pa_xnew0(struct device, 1);
+    d->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&d->thread_mq, pa_mainloop_get_api(mainloop), d->rtpoll);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, "device");
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+    pa_assert_se(d->sink = pa_sink_new(core, &data, 0));
+    pa_sink_new_data_done(&data);
+
+    d->sink->parent.process_msg = device_process_msg;
+    d->sink->userdata = d;
+
+    pa_sink_set_asyncmsgq(d->sink, d->thread_mq.inq);
+    pa_sink_set_rtpoll(d->sink, d->rtpoll);
+    pa_sink_set_max_rewind(d->sink, REWIND_BYTES);
+
+    pa_assert_se(d->thread = pa_thread_new("filter-chain-test", device_thread_func, d));
+
+    pa_sink_put(d->sink);
+
+    return d;
+}
+
+static void device_free(struct device *d) {
+    pa_sink_unlink(d->sink);
+
+    pa_asyncmsgq_send(d->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(d->thread);
+
+    pa_sink_unref(d->sink);
+    pa_thread_mq_done(&d->thread_mq);
+    pa_rtpoll_free(d->rtpoll);
+    pa_xfree(d);
+}
+
+/* Called from main context */
+static void sink_input_kill(pa_sink_input *i) {
+    /* Nothing in here is ever removed from under the test */
+    pa_assert_not_reached();
+}
+
+/* Called from I/O thread context */
+static void filter_request_rewind(pa_sink *s) {
+    struct filter *f = s->userdata;
+
+    if (!PA_SINK_IS_LINKED(f->sink->thread_info.state) ||
+        !PA_SINK_INPUT_IS_LINKED(f->sink_input->thread_info.state))
+        return;
+
+    pa_sink_input_request_rewind(f->sink_input, s->thread_info.rewind_nbytes, true, false, false);
+}
+
+/* Called from I/O thread context */
+static void filter_process_filter(pa_sink *s, pa_memchunk *chunk) {
+    struct filter *f = s->userdata;
+
+    /* Passes everything on as it is */
+    f->n_process_filter++;
+}
+
+/* Called from I/O thread context */
+static int filter_pop(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct filter *f = i->userdata;
+
+    f->n_pop++;
+
+    pa_sink_process_rewind(f->sink, 0);
+    pa_sink_render_filter_chain(f->sink, nbytes, chunk);
+    return 0;
+}
+
+/* Called from I/O thread context */
+static void filter_process_rewind(pa_sink_input *i, size_t nbytes) {
+    struct filter *f = i->userdata;
+    size_t amount = 0;
+
+    if (f->sink->thread_info.rewind_nbytes > 0) {
+        amount = PA_MIN(f->sink->thread_info.rewind_nbytes, nbytes);
+        f->sink->thread_info.rewind_nbytes = 0;
+    }
+
+    pa_sink_process_rewind(f->sink, amount);
+}
+
+/* Called from I/O thread context */
+static void filter_update_max_rewind(pa_sink_input *i, size_t nbytes) {
+    struct filter *f = i->userdata;
+
+    pa_sink_set_max_rewind_within_thread(f->sink, nbytes);
+}
+
+/* Called from I/O thread context */
+static void filter_attach(pa_sink_input *i) {
+    struct filter *f = i->userdata;
+
+    pa_sink_set_rtpoll(f->sink, i->sink->thread_info.rtpoll);
+    pa_sink_set_max_request_within_thread(f->sink, pa_sink_input_get_max_request(i));
+    pa_sink_set_max_rewind_within_thread(f->sink, pa_sink_input_get_max_rewind(i));
+    pa_sink_attach_within_thread(f->sink);
+}
+
+/* Called from I/O thread context */
+static void filter_detach(pa_sink_input *i) {
+    struct filter *f = i->userdata;
+
+    pa_sink_detach_within_thread(f->sink);
+    pa_sink_set_rtpoll(f->sink, NULL);
+}
+
+static struct filter *filter_new(pa_sink *master, const char *name) {
+    struct filter *f;
+    pa_sink_new_data sink_data;
+    pa_sink_input_new_data sink_input_data;
+
+    f = pa_xnew0(struct filter, 1);
+
+    pa_sink_new_data_init(&sink_data);
+    sink_data.driver = __FILE__;
+    pa_sink_new_data_set_name(&sink_data, name);
+    pa_sink_new_data_set_sample_spec(&sink_data, &ss);
+    pa_assert_se(f->sink = pa_sink_new(core, &sink_data, 0));
+    pa_sink_new_data_done(&sink_data);
+
+    f->sink->request_rewind = filter_request_rewind;
+    f->sink->process_filter = filter_process_filter;
+    f->sink->userdata = f;
+
+    pa_sink_set_asyncmsgq(f->sink, master->asyncmsgq);
+
+    pa_sink_input_new_data_init(&sink_input_data);
+    sink_input_data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&sink_input_data, master, false);
+    sink_input_data.origin_sink = f->sink;
+    pa_sink_input_new_data_set_sample_spec(&sink_input_data, &ss);
+    pa_assert_se(pa_sink_input_new(&f->sink_input, core, &sink_input_data) == 0);
+    pa_sink_input_new_data_done(&sink_input_data);
+
+    f->sink_input->pop = filter_pop;
+    f->sink_input->process_rewind = filter_process_rewind;
+    f->sink_input->update_max_rewind = filter_update_max_rewind;
+    f->sink_input->attach = filter_attach;
+    f->sink_input->detach = filter_detach;
+    f->sink_input->kill = sink_input_kill;
+    f->sink_input->userdata = f;
+
+    f->sink->input_to_master = f->sink_input;
+
+    pa_sink_put(f->sink);
+    pa_sink_input_put(f->sink_input);
+
+    return f;
+}
+
+static void filter_free(struct filter *f) {
+    pa_sink_input_unlink(f->sink_input);
+    pa_sink_unlink(f->sink);
+
+    pa_sink_input_unref(f->sink_input);
+    pa_sink_unref(f->sink);
+    pa_xfree(f);
+}
+
+/* Called from I/O thread context */
+static int stream_pop(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct stream *st = i->userdata;
+    int16_t *d;
+    size_t n;
+
+    chunk->index = 0;
+    chunk->length = PA_MIN(nbytes, (size_t) BLOCK_BYTES);
+    chunk->memblock = pa_memblock_new(core->mempool, chunk->length);
+
+    d = pa_memblock_acquire(chunk->memblock);
+    for (n = 0; n < chunk->length / sizeof(int16_t); n++)
+        d[n] = sample_at(st->counter++);
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+/* Called from I/O thread context */
+static void stream_process_rewind(pa_sink_input *i, size_t nbytes) {
+    /* The rewind never reaches up to the stream */
+    fail_unless(i->thread_info.rewrite_nbytes == 0);
+}
+
+static struct stream *stream_new(pa_sink *sink) {
+    struct stream *st;
+    pa_sink_input_new_data data;
+
+    st = pa_xnew0(struct stream, 1);
+
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&data, sink, false);
+    pa_sink_input_new_data_set_sample_spec(&data, &ss);
+    pa_assert_se(pa_sink_input_new(&st->sink_input, core, &data) == 0);
+    pa_sink_input_new_data_done(&data);
+
+    st->sink_input->pop = stream_pop;
+    st->sink_input->process_rewind = stream_process_rewind;
+    st->sink_input->kill = sink_input_kill;
+    st->sink_input->userdata = st;
+
+    pa_sink_input_put(st->sink_input);
+
+    return st;
+}
+
+static void stream_free(struct stream *st) {
+    pa_sink_input_unlink(st->sink_input);
+    pa_sink_input_unref(st->sink_input);
+    pa_xfree(st);
+}
+
+/* Called from main context */
+static void monitor_kill(pa_source_output *o) {
+    pa_assert_not_reached();
+}
+
+/* Called from I/O thread context */
+static void monitor_push(pa_source_output *o, const pa_memchunk *chunk) {
+    struct monitor *m = o->userdata;
+    const int16_t *d;
+    size_t n;
+
+    d = pa_memblock_acquire_chunk(chunk);
+    for (n = 0; n < chunk->length / sizeof(int16_t); n++)
+        fail_unless(d[n] == sample_at(m->length / sizeof(int16_t) + n));
+    pa_memblock_release(chunk->memblock);
+
+    m->length += chunk->length;
+}
+
+/* Called from I/O thread context */
+static void monitor_process_rewind(pa_source_output *o, size_t nbytes) {
+    struct monitor *m = o->userdata;
+
+    fail_unless(nbytes <= m->length);
+    m->length -= nbytes;
+}
+
+static struct monitor *monitor_new(pa_source *source) {
+    struct monitor *m;
+    pa_source_output_new_data data;
+
+    m = pa_xnew0(struct monitor, 1);
+
+    pa_source_output_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_source_output_new_data_set_source(&data, source, false);
+    pa_source_output_new_data_set_sample_spec(&data, &ss);
+    pa_assert_se(pa_source_output_new(&m->source_output, core, &data) == 0);
+    pa_source_output_new_data_done(&data);
+
+    m->source_output->push = monitor_push;
+    m->source_output->process_rewind = monitor_process_rewind;
+    m->source_output->kill = monitor_kill;
+    m->source_output->userdata = m;
+
+    pa_source_output_put(m->source_output);
+
+    return m;
+}
+
+static void monitor_free(struct monitor *m) {
+    pa_source_output_unlink(m->source_output);
+    pa_source_output_unref(m->source_output);
+    pa_xfree(m);
+}
+
+static void render(struct device *d, size_t length) {
+    pa_assert_se(pa_asyncmsgq_send(d->thread_mq.inq, PA_MSGOBJECT(d->sink), DEVICE_MESSAGE_RENDER, NULL, (int64_t) length, NULL) == 0);
+
+    while (pa_mainloop_iterate(mainloop, false, NULL) > 0)
+        ;
+}
+
+static void check_output(struct device *d, size_t length) {
+    size_t n;
+
+    fail_unless(d->pos == length / sizeof(int16_t));
+
+    for (n = 0; n < d->pos; n++)
+        fail_unless(d->output[n] == sample_at(n));
+}
+
+/* Rewinding the lower filter sink must play back what the upper filter
+ * produced while the two were rendered back to back, and the monitor of
+ * the lower filter sink must get all of that as well */
+START_TEST (filter_chain_rewind_test) {
+    struct device *d;
+    struct filter *lower, *upper;
+    struct stream *st;
+    struct monitor *m;
+
+    mainloop = pa_mainloop_new();
+    pa_assert_se(core = pa_core_new(pa_mainloop_get_api(mainloop), false, false, 0, false));
+
+    d = device_new();
+    lower = filter_new(d->sink, "lower");
+    upper = filter_new(lower->sink, "upper");
+    st = stream_new(upper->sink);
+    m = monitor_new(lower->sink->monitor_source);
+
+    render(d, 4 * REWIND_BYTES);
+    check_output(d, 4 * REWIND_BYTES);
+
+    /* The link from the upper to the lower filter was bypassed */
+    fail_unless(upper->n_pop == 0);
+    fail_unless(upper->n_process_filter > 0);
+    fail_unless(lower->n_pop > 0);
+    fail_unless(m->length == 4 * REWIND_BYTES);
+
+    pa_assert_se(pa_asyncmsgq_send(d->thread_mq.inq, PA_MSGOBJECT(d->sink), DEVICE_MESSAGE_REWIND, lower->sink, REWIND_BYTES / 2, NULL) == 0);
+    fail_unless(d->pos == (4 * REWIND_BYTES - REWIND_BYTES / 2) / sizeof(int16_t));
+
+    /* What was rewound is played again, and the stream goes on right
+     * after it */
+    render(d, REWIND_BYTES);
+    check_output(d, 4 * REWIND_BYTES + REWIND_BYTES / 2);
+
+    render(d, REWIND_BYTES);
+    check_output(d, 5 * REWIND_BYTES + REWIND_BYTES / 2);
+    fail_unless(upper->n_pop == 0);
+    fail_unless(m->length == 5 * REWIND_BYTES + REWIND_BYTES / 2);
+
+    monitor_free(m);
+    stream_free(st);
+    filter_free(upper);
+    filter_free(lower);
+    device_free(d);
+
+    pa_core_unref(core);
+    pa_mainloop_free(mainloop);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Filter Chain");
+    tc = tcase_create("filter-chain");
+    tcase_add_test(tc, filter_chain_rewind_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/histogram.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+START_TEST (histogram_bucket_test) {
+    unsigned i;
+    uint64_t lower = 0;
+
+    /* The buckets cover all values without gaps or overlaps */
+    for (i = 0; i < PA_HISTOGRAM_N_BUCKETS; i++) {
+        uint64_t upper = pa_histogram_bucket_upper_bound(i);
+
+        fail_unless(upper >= lower);
+        fail_unless(pa_histogram_bucket_index(lower) == i);
+        fail_unless(pa_histogram_bucket_index(upper) == i);
+
+        /* The relative error stays within the promised bounds */
+        if (lower >= PA_HISTOGRAM_SUB_BUCKETS)
+            fail_unless(upper - lower < lower / (PA_HISTOGRAM_SUB_BUCKETS / 2));
+
+        lower = upper + 1;
+    }
+
+    fail_unless(lower == 0);
+    fail_unless(pa_histogram_bucket_index(UINT64_MAX) == PA_HISTOGRAM_N_BUCKETS - 1);
+}
+END_TEST
+
+START_TEST (histogram_quantile_test) {
+    pa_histogram h;
+    uint64_t v, q;
+
+    pa_histogram_reset(&h);
+    fail_unless(pa_histogram_quantile(&h, 0.5) == 0);
+
+    for (v = 1; v <= 10000; v++)
+        pa_histogram_add(&h, v);
+
+    fail_unless(h.count == 10000);
+    fail_unless(h.min == 1);
+    fail_unless(h.max == 10000);
+    fail_unless(h.sum == 10000 * 10001 / 2);
+
+    q = pa_histogram_quantile(&h, 0.5);
+    fail_unless(q >= 5000 && q < 5000 + 5000 * 2 / PA_HISTOGRAM_SUB_BUCKETS);
+
+    q = pa_histogram_quantile(&h, 0.99);
+    fail_unless(q >= 9900 && q <= 10000);
+
+    fail_unless(pa_histogram_quantile(&h, 0.0) == 1);
+    fail_unless(pa_histogram_quantile(&h, 1.0) == 10000);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Histogram");
+    tc = tcase_create("histogram");
+    tcase_add_test(tc, histogram_bucket_test);
+    tcase_add_test(tc, histogram_quantile_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,452 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <check.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/arpa-inet.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/poll.h>
+#include <pulsecore/rate-controller.h>
+#include <pulsecore/sample-util.h>
+
+#include "rtp.h"
+#include "jitter-buffer.h"
+
+/* Streams a simulated minute of audio over a UDP socket on the loopback
+ * device. The network impairments are applied on the sending side, which
+ * sends the packets in the order they would arrive and tells the receiving
+ * side when that would have been. The receiving side is driven like
+ * module-rtp-recv drives the jitter buffer, with a sink that asks for 10 ms
+ * every 10 ms, and a rate controller that varies how much audio is taken
+ * out in that time, as a resampler would. */
+
+#define PAYLOAD 127
+#define MTU 1280
+#define DURATION (60*PA_USEC_PER_SEC)
+#define WARMUP (5*PA_USEC_PER_SEC)
+#define REQUEST_USEC (10*PA_USEC_PER_MSEC)
+#define MIN_LATENCY (20*PA_USEC_PER_MSEC)
+#define MAX_LATENCY (500*PA_USEC_PER_MSEC)
+#define RATE_UPDATE_INTERVAL (1*PA_USEC_PER_SEC)
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16BE,
+    .rate = 48000,
+    .channels = 2
+};
+
+struct impairment {
+    const char *name;
+    pa_usec_t delay;
+    pa_usec_t jitter;           /* Uniformly distributed extra delay */
+    double loss;
+    double reorder;             /* Packets that are overtaken by the next two */
+
+    /* Expectations, the latency is the one added on top of the delay */
+    pa_usec_t max_latency;
+    unsigned max_glitches;
+};
+
+struct packet {
+    unsigned n;
+    pa_usec_t arrival;
+};
+
+struct result {
+    pa_jitter_buffer_stats stats;
+    unsigned glitches;
+    double mean_latency;
+    pa_usec_t max_latency;
+};
+
+static int packet_compare(const void *a, const void *b) {
+    const struct packet *x = a, *y = b;
+
+    if (x->arrival != y->arrival)
+        return x->arrival < y->arrival ? -1 : 1;
+
+    return x->n < y->n ? -1 : (x->n > y->n ? 1 : 0);
+}
+
+static double random_double(void) {
+    return (double) rand() / ((double) RAND_MAX + 1);
+}
+
+static void open_sockets(int *send_fd, int *recv_fd) {
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+    int one = 1, size = 4 * 1024 * 1024;
+
+    pa_assert_se((*recv_fd = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    pa_assert_se((*send_fd = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+
+    pa_zero(sa);
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    pa_assert_se(bind(*recv_fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+    pa_assert_se(getsockname(*recv_fd, (struct sockaddr*) &sa, &len) == 0);
+    pa_assert_se(setsockopt(*recv_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) == 0);
+    setsockopt(*recv_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    pa_assert_se(connect(*send_fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+}
+
+/* Every frame carries its own index, so the receiver can tell where it is */
+static void send_packet(int fd, unsigned n, unsigned frames) {
+    uint8_t buf[MTU];
+    uint32_t header[3];
+    uint16_t *d = (uint16_t*) (buf + sizeof(header));
+    unsigned i;
+
+    header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) PAYLOAD << 16) | ((uint32_t) (n + 0xfff0) & 0xffff));
+    header[1] = htonl(0xfffff000U + n * frames);
+    header[2] = htonl(0x12345678);
+    memcpy(buf, header, sizeof(header));
+
+    for (i = 0; i < frames; i++) {
+        uint32_t f = n * frames + i;
+
+        d[2 * i] = (uint16_t) f;
+        d[2 * i + 1] = (uint16_t) (f >> 16);
+    }
+
+    pa_assert_se(send(fd, buf, sizeof(header) + frames * pa_frame_size(&ss), 0) > 0);
+}
+
+static void run(const struct impairment *imp, struct result *r) {
+    pa_mempool *pool;
+    pa_memchunk silence;
+    pa_jitter_buffer *jb;
+    pa_rate_controller *rc;
+    pa_rtp_context ctx;
+    struct packet *packets;
+    pa_usec_t packet_usec, now, last_rate_update = 0;
+    unsigned frames, n_packets, n_sent = 0, i, n_latency = 0;
+    int send_fd, recv_fd;
+    pa_jitter_buffer_stats last_stats;
+    int64_t last_frame = -1;
+    bool glitched = false;
+    double latency_sum = 0, owed = 0;
+
+    srand(0);
+    open_sockets(&send_fd, &recv_fd);
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    silence.memblock = pa_silence_memblock(pa_memblock_new(pool, pa_usec_to_bytes(REQUEST_USEC, &ss)), &ss);
+    silence.index = 0;
+    silence.length = pa_memblock_get_length(silence.memblock);
+
+    jb = pa_jitter_buffer_new(&ss, pool, MIN_LATENCY, MAX_LATENCY, &silence);
+    rc = pa_rate_controller_new(ss.rate, MIN_LATENCY, RATE_UPDATE_INTERVAL);
+    pa_rtp_context_init_recv(&ctx, recv_fd, pa_frame_size(&ss));
+
+    frames = (unsigned) (pa_frame_align(MTU - 12, &ss) / pa_frame_size(&ss));
+    packet_usec = (pa_usec_t) frames * PA_USEC_PER_SEC / ss.rate;
+    n_packets = (unsigned) (DURATION / packet_usec);
+
+    /* Work out when each packet arrives, if at all */
+    packets = pa_xnew(struct packet, n_packets);
+    for (i = 0; i < n_packets; i++) {
+        packets[i].n = i;
+        packets[i].arrival = (i + 1) * packet_usec + imp->delay;
+
+        if (imp->jitter > 0)
+            packets[i].arrival += (pa_usec_t) (random_double() * imp->jitter);
+
+        if (random_double() < imp->reorder)
+            packets[i].arrival += 2 * packet_usec + 1;
+
+        if (random_double() < imp->loss)
+            packets[i].arrival = PA_USEC_INVALID;
+    }
+
+    qsort(packets, n_packets, sizeof(struct packet), packet_compare);
+
+    pa_jitter_buffer_get_stats(jb, &last_stats);
+
+    for (now = REQUEST_USEC; now < DURATION; now += REQUEST_USEC) {
+        pa_jitter_buffer_stats stats;
+        unsigned n_received = 0, n_to_receive = 0;
+        size_t left;
+        double ratio;
+
+        /* Deliver everything that arrived since the last request */
+        for (; n_sent < n_packets && packets[n_sent].arrival <= now; n_sent++, n_to_receive++)
+            send_packet(send_fd, packets[n_sent].n, frames);
+
+        while (n_received < n_to_receive) {
+            struct pollfd pfd = { .fd = recv_fd, .events = POLLIN };
+            pa_memchunk chunk;
+            struct timeval tv;
+            unsigned n;
+
+            if (!pa_rtp_recv_pending(&ctx))
+                fail_unless(pa_poll(&pfd, 1, 1000) == 1);
+
+            if (pa_rtp_recv(&ctx, &chunk, pool, &tv) < 0)
+                continue;
+
+            n = (ctx.timestamp - 0xfffff000U) / frames;
+            fail_unless(n < n_packets);
+
+            /* The packets were sent in arrival order */
+            fail_unless(packets[n_sent - n_to_receive + n_received].n == n);
+
+            pa_jitter_buffer_push(jb, ctx.sequence, ctx.timestamp, packets[n_sent - n_to_receive + n_received].arrival, &chunk);
+            pa_memblock_unref(chunk.memblock);
+
+            n_received++;
+        }
+
+        if (pa_jitter_buffer_is_readable(jb) && last_rate_update + RATE_UPDATE_INTERVAL <= now) {
+            pa_rate_controller_set_target(rc, pa_jitter_buffer_get_target(jb));
+            pa_rate_controller_update(rc, now, pa_jitter_buffer_get_latency(jb));
+            last_rate_update = now;
+        }
+
+        /* And play one request worth of audio, at the rate the controller
+         * asks for */
+        ratio = pa_rate_controller_get_ratio(rc);
+        owed += (double) (REQUEST_USEC * ss.rate / PA_USEC_PER_SEC) * ratio;
+        left = (size_t) owed * pa_frame_size(&ss);
+        owed -= (double) (size_t) owed;
+
+        while (left > 0) {
+            pa_memchunk chunk;
+
+            if (pa_jitter_buffer_pop(jb, left, &chunk) < 0) {
+                glitched = true;
+                break;
+            }
+
+            fail_unless(chunk.length > 0 && chunk.length <= left);
+            left -= chunk.length;
+
+            /* Skips happen when packets are pushed, so compare against the
+             * state after the previous pop */
+            pa_jitter_buffer_get_stats(jb, &stats);
+
+            if (stats.skipped_frames != last_stats.skipped_frames)
+                glitched = true;
+
+            if (stats.concealed_frames != last_stats.concealed_frames)
+                glitched = true;
+            else {
+                const uint16_t *d = pa_memblock_acquire_chunk(&chunk);
+                unsigned k;
+
+                for (k = 0; k < chunk.length / pa_frame_size(&ss); k++) {
+                    int64_t f = (int64_t) d[2 * k] | ((int64_t) d[2 * k + 1] << 16);
+
+                    /* Audio never goes back, and only jumps where something
+                     * was concealed or skipped */
+                    if (last_frame >= 0) {
+                        fail_unless(f > last_frame);
+
+                        if (!glitched)
+                            fail_unless(f == last_frame + 1);
+                    }
+
+                    last_frame = f;
+                    glitched = false;
+                }
+
+                if (now >= WARMUP) {
+                    /* From the end of the packet to the playout of this frame */
+                    pa_usec_t l = now - (pa_usec_t) (d[0] | ((uint32_t) d[1] << 16)) * PA_USEC_PER_SEC / ss.rate - imp->delay;
+
+                    latency_sum += (double) l;
+                    r->max_latency = PA_MAX(r->max_latency, l);
+                    n_latency++;
+                }
+
+                pa_memblock_release(chunk.memblock);
+            }
+
+            pa_memblock_unref(chunk.memblock);
+            last_stats = stats;
+        }
+    }
+
+    pa_jitter_buffer_get_stats(jb, &r->stats);
+    r->glitches = (unsigned) (r->stats.concealments + r->stats.skips);
+    r->mean_latency = n_latency > 0 ? latency_sum / n_latency : 0;
+
+    pa_log_info("%s: latency %0.2f ms mean, %0.2f ms max, target %0.2f ms, jitter %0.2f ms, %u glitches "
+                "(%llu lost, %llu late, %llu concealments, %llu concealed ms, %llu underruns, %llu skips)",
+                imp->name, r->mean_latency / PA_USEC_PER_MSEC, (double) r->max_latency / PA_USEC_PER_MSEC,
+                (double) r->stats.target / PA_USEC_PER_MSEC, (double) r->stats.jitter / PA_USEC_PER_MSEC,
+                r->glitches, (unsigned long long) r->stats.lost, (unsigned long long) r->stats.late,
+                (unsigned long long) r->stats.concealments,
+                (unsigned long long) (r->stats.concealed_frames * 1000 / ss.rate),
+                (unsigned long long) r->stats.underruns, (unsigned long long) r->stats.skips);
+
+    pa_xfree(packets);
+    pa_rtp_context_destroy(&ctx);
+    pa_rate_controller_free(rc);
+    pa_jitter_buffer_free(jb);
+    pa_memblock_unref(silence.memblock);
+    pa_mempool_unref(pool);
+    pa_close(send_fd);
+    pa_close(recv_fd);
+}
+
+static void check_impairment(const struct impairment *imp) {
+    struct result r;
+
+    pa_zero(r);
+    run(imp, &r);
+
+    fail_unless(r.mean_latency <= imp->max_latency);
+    fail_unless(r.glitches <= imp->max_glitches);
+}
+
+START_TEST (clean_test) {
+    /* A quiet LAN must not cost more than a few tens of milliseconds */
+    static const struct impairment imp = {
+        .name = "clean",
+        .delay = 1 * PA_USEC_PER_MSEC,
+        .jitter = 500,
+        .max_latency = 40 * PA_USEC_PER_MSEC,
+        .max_glitches = 0,
+    };
+
+    check_impairment(&imp);
+}
+END_TEST
+
+START_TEST (delay_test) {
+    /* A constant delay does not need any buffering */
+    static const struct impairment imp = {
+        .name = "delay",
+        .delay = 80 * PA_USEC_PER_MSEC,
+        .jitter = PA_USEC_PER_MSEC,
+        .max_latency = 40 * PA_USEC_PER_MSEC,
+        .max_glitches = 0,
+    };
+
+    check_impairment(&imp);
+}
+END_TEST
+
+START_TEST (jitter_test) {
+    static const struct impairment imp = {
+        .name = "jitter",
+        .delay = 5 * PA_USEC_PER_MSEC,
+        .jitter = 30 * PA_USEC_PER_MSEC,
+        .max_latency = 100 * PA_USEC_PER_MSEC,
+        .max_glitches = 5,
+    };
+
+    check_impairment(&imp);
+}
+END_TEST
+
+START_TEST (loss_test) {
+    static const struct impairment imp = {
+        .name = "loss",
+        .delay = 1 * PA_USEC_PER_MSEC,
+        .jitter = PA_USEC_PER_MSEC,
+        .loss = 0.02,
+        .max_latency = 40 * PA_USEC_PER_MSEC,
+        .max_glitches = 200,
+    };
+    struct result r;
+
+    pa_zero(r);
+    run(&imp, &r);
+
+    /* Every lost packet is concealed, but nothing else is */
+    fail_unless(r.mean_latency <= imp.max_latency);
+    fail_unless(r.stats.lost > 0);
+    fail_unless(r.glitches <= r.stats.lost);
+    fail_unless(r.stats.underruns == 0);
+}
+END_TEST
+
+START_TEST (reorder_test) {
+    static const struct impairment imp = {
+        .name = "reorder",
+        .delay = 1 * PA_USEC_PER_MSEC,
+        .jitter = PA_USEC_PER_MSEC,
+        .reorder = 0.05,
+        .max_latency = 50 * PA_USEC_PER_MSEC,
+        .max_glitches = 3,
+    };
+
+    check_impairment(&imp);
+}
+END_TEST
+
+START_TEST (combined_test) {
+    static const struct impairment imp = {
+        .name = "combined",
+        .delay = 20 * PA_USEC_PER_MSEC,
+        .jitter = 10 * PA_USEC_PER_MSEC,
+        .loss = 0.01,
+        .reorder = 0.02,
+        .max_latency = 70 * PA_USEC_PER_MSEC,
+        .max_glitches = 150,
+    };
+
+    check_impairment(&imp);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Jitter Buffer");
+    tc = tcase_create("jitter-buffer");
+    tcase_add_test(tc, clean_test);
+    tcase_add_test(tc, delay_test);
+    tcase_add_test(tc, jitter_test);
+    tcase_add_test(tc, loss_test);
+    tcase_add_test(tc, reorder_test);
+    tcase_add_test(tc, combined_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -23,10 +23,16 @@
 
 #include <pulse/pulseaudio.h>
 #include <pulse/sample.h>
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
 
+#include <pulsecore/filter/crossover.h>
 #include <pulsecore/filter/lfe-filter.h>
 
+#include "runtime-test-util.h"
+
 struct lfe_filter_test {
     pa_lfe_filter_t *lf;
     pa_mempool *pool;
@@ -79,8 +85,10 @@ static int compare_data_block(struct lfe_filter_test *lft, void *a, void *b) {
 }
 
 /* in this test case, we pass two blocks of sample data to lfe-filter, each
-   block contains 4096 samples, and don't let rewind_samples exceed TOTAL_SAMPLES */
-static int lfe_filter_rewind_test(struct lfe_filter_test *lft, int rewind_samples)
+   block contains 4096 samples, and don't let rewind_samples exceed TOTAL_SAMPLES.
+   If update_rate is set, the rate is set again before rewinding, which must not
+   lose the saved states. */
+static int lfe_filter_rewind_test(struct lfe_filter_test *lft, int rewind_samples, bool update_rate)
 {
     int ret = -1, pos, i;
     pa_memchunk mc;
@@ -106,6 +114,9 @@ static int lfe_filter_rewind_test(struct lfe_filter_test *lft, int rewind_sample
         pa_memblock_unref(mc.memblock);
     }
 
+    if (update_rate)
+        pa_lfe_filter_update_rate(lft->lf, lft->ss->rate);
+
     pa_lfe_filter_rewind(lft->lf, rewind_samples * fz);
     pos = (TOTAL_SAMPLES - rewind_samples) * fz;
     mc.memblock = generate_data_block(lft, pos);
@@ -136,7 +147,7 @@ START_TEST (lfe_filter_test) {
     a.format = PA_SAMPLE_S16NE;
 
     lft.ss = &a;
-    pa_assert_se(lft.pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    pa_assert_se(lft.pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false));
 
     /* We prepare pseudo-random input audio samples for lfe-filter rewind testing*/
     ori_sample_ptr = pa_xmalloc(pa_frame_size(lft.ss) * TOTAL_SAMPLES);
@@ -147,15 +158,25 @@ START_TEST (lfe_filter_test) {
     /* we create a lfe-filter with cutoff frequency 120Hz and max rewind time 10 seconds */
     pa_assert_se(lft.lf = pa_lfe_filter_new(&a, &chmapmono, crossover_freq, a.rate * 10));
     /* rewind to a block boundary */
-    ret = lfe_filter_rewind_test(&lft, ONE_BLOCK_SAMPLES);
+    ret = lfe_filter_rewind_test(&lft, ONE_BLOCK_SAMPLES, false);
     if (ret)
         pa_log_error("lfe-filer-test: rewind to block boundary test failed!!!");
     pa_lfe_filter_free(lft.lf);
 
+    /* we create a lfe-filter with cutoff frequency 120Hz and max rewind time 10 seconds */
+    pa_assert_se(lft.lf = pa_lfe_filter_new(&a, &chmapmono, crossover_freq, a.rate * 10));
+    /* rewind after a rate update */
+    if (!ret)
+        ret = lfe_filter_rewind_test(&lft, ONE_BLOCK_SAMPLES + ONE_BLOCK_SAMPLES / 4, true);
+    if (ret)
+        pa_log_error("lfe-filer-test: rewind after rate update test failed!!!");
+    pa_lfe_filter_free(lft.lf);
+
     /* we create a lfe-filter with cutoff frequency 120Hz and max rewind time 10 seconds */
     pa_assert_se(lft.lf = pa_lfe_filter_new(&a, &chmapmono, crossover_freq, a.rate * 10));
     /* rewind to the middle position of a block */
-    ret = lfe_filter_rewind_test(&lft, ONE_BLOCK_SAMPLES + ONE_BLOCK_SAMPLES / 2);
+    if (!ret)
+        ret = lfe_filter_rewind_test(&lft, ONE_BLOCK_SAMPLES + ONE_BLOCK_SAMPLES / 2, false);
     if (ret)
         pa_log_error("lfe-filer-test: rewind to middle of block test failed!!!");
 
@@ -172,6 +193,160 @@ START_TEST (lfe_filter_test) {
 }
 END_TEST
 
+#define LR4_FRAMES 1024
+#define LR4_TIMES 100
+#define LR4_TIMES2 20
+
+/* Runs the optimized filters against the generic ones on interleaved blocks
+   of different lengths, with the LFE channel in the middle, and optionally
+   benchmarks them. */
+static void run_lr4_test(
+        lr4_multi_float32_func_t func_float, lr4_multi_float32_func_t orig_func_float,
+        lr4_multi_s16_func_t func_s16, lr4_multi_s16_func_t orig_func_s16,
+        int channels, bool perf) {
+
+    struct lr4_multi lr4, orig_lr4;
+    float *in_f, *out_f, *out_orig_f;
+    short *in_s, *out_s, *out_orig_s;
+    int c, i, n, pos;
+
+    in_f = pa_xnew(float, LR4_FRAMES * channels);
+    out_f = pa_xnew(float, LR4_FRAMES * channels);
+    out_orig_f = pa_xnew(float, LR4_FRAMES * channels);
+    in_s = pa_xnew(short, LR4_FRAMES * channels);
+    out_s = pa_xnew(short, LR4_FRAMES * channels);
+    out_orig_s = pa_xnew(short, LR4_FRAMES * channels);
+
+    pa_random(in_s, LR4_FRAMES * channels * sizeof(short));
+    for (i = 0; i < LR4_FRAMES * channels; i++)
+        in_f[i] = in_s[i] / (float) 0x8000;
+
+    lr4_multi_init(&lr4, channels);
+    for (c = 0; c < channels; c++)
+        lr4_multi_set(&lr4, c, c == channels / 2 ? BQ_LOWPASS : BQ_HIGHPASS, 120.0f / 22050);
+    orig_lr4 = lr4;
+
+    for (pos = 0, n = 1; pos < LR4_FRAMES; pos += n, n = PA_MIN(2 * n + 1, LR4_FRAMES - pos)) {
+        func_float(&lr4, n, in_f + pos * channels, out_f + pos * channels);
+        orig_func_float(&orig_lr4, n, in_f + pos * channels, out_orig_f + pos * channels);
+    }
+
+    for (i = 0; i < LR4_FRAMES * channels; i++) {
+        if (fabsf(out_f[i] - out_orig_f[i]) > 1e-6f) {
+            pa_log_debug("Correctness test failed: float32, %d channels, sample %d: %f != %f", channels, i, out_f[i], out_orig_f[i]);
+            fail();
+        }
+    }
+
+    lr4_multi_reset(&lr4);
+    lr4_multi_reset(&orig_lr4);
+
+    for (pos = 0, n = 1; pos < LR4_FRAMES; pos += n, n = PA_MIN(2 * n + 1, LR4_FRAMES - pos)) {
+        func_s16(&lr4, n, in_s + pos * channels, out_s + pos * channels);
+        orig_func_s16(&orig_lr4, n, in_s + pos * channels, out_orig_s + pos * channels);
+    }
+
+    for (i = 0; i < LR4_FRAMES * channels; i++) {
+        if (abs(out_s[i] - out_orig_s[i]) > 1) {
+            pa_log_debug("Correctness test failed: s16, %d channels, sample %d: %d != %d", channels, i, out_s[i], out_orig_s[i]);
+            fail();
+        }
+    }
+
+    /* The LFE filter works in place, so measure that */
+    if (perf) {
+        pa_log_debug("Testing LR4 filter performance with %d channels", channels);
+
+        PA_RUNTIME_TEST_RUN_START("func float32", LR4_TIMES, LR4_TIMES2) {
+            memcpy(out_f, in_f, LR4_FRAMES * channels * sizeof(float));
+            func_float(&lr4, LR4_FRAMES, out_f, out_f);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig float32", LR4_TIMES, LR4_TIMES2) {
+            memcpy(out_orig_f, in_f, LR4_FRAMES * channels * sizeof(float));
+            orig_func_float(&orig_lr4, LR4_FRAMES, out_orig_f, out_orig_f);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("func s16", LR4_TIMES, LR4_TIMES2) {
+            memcpy(out_s, in_s, LR4_FRAMES * channels * sizeof(short));
+            func_s16(&lr4, LR4_FRAMES, out_s, out_s);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig s16", LR4_TIMES, LR4_TIMES2) {
+            memcpy(out_orig_s, in_s, LR4_FRAMES * channels * sizeof(short));
+            orig_func_s16(&orig_lr4, LR4_FRAMES, out_orig_s, out_orig_s);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_xfree(in_f);
+    pa_xfree(out_f);
+    pa_xfree(out_orig_f);
+    pa_xfree(in_s);
+    pa_xfree(out_s);
+    pa_xfree(out_orig_s);
+}
+
+static void run_lr4_tests(
+        lr4_multi_float32_func_t func_float, lr4_multi_float32_func_t orig_func_float,
+        lr4_multi_s16_func_t func_s16, lr4_multi_s16_func_t orig_func_s16) {
+
+    int channels;
+
+    for (channels = 1; channels <= 12; channels++)
+        run_lr4_test(func_float, orig_func_float, func_s16, orig_func_s16, channels, false);
+    run_lr4_test(func_float, orig_func_float, func_s16, orig_func_s16, PA_CHANNELS_MAX, false);
+
+    run_lr4_test(func_float, orig_func_float, func_s16, orig_func_s16, 3, true);
+    run_lr4_test(func_float, orig_func_float, func_s16, orig_func_s16, 6, true);
+    run_lr4_test(func_float, orig_func_float, func_s16, orig_func_s16, 8, true);
+}
+
+#ifdef HAVE_AVX2
+START_TEST (lr4_avx2_test) {
+    lr4_multi_float32_func_t orig_func_float;
+    lr4_multi_s16_func_t orig_func_s16;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_func_float = lr4_multi_get_float32_func();
+    orig_func_s16 = lr4_multi_get_s16_func();
+    pa_lr4_func_init_avx2(flags);
+
+    pa_log_debug("Checking AVX2 LR4 filters");
+    run_lr4_tests(lr4_multi_get_float32_func(), orig_func_float, lr4_multi_get_s16_func(), orig_func_s16);
+}
+END_TEST
+#endif /* HAVE_AVX2 */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (lr4_neon_test) {
+    lr4_multi_float32_func_t orig_func_float;
+    lr4_multi_s16_func_t orig_func_s16;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_func_float = lr4_multi_get_float32_func();
+    orig_func_s16 = lr4_multi_get_s16_func();
+    pa_lr4_func_init_neon(flags);
+
+    pa_log_debug("Checking NEON LR4 filters");
+    run_lr4_tests(lr4_multi_get_float32_func(), orig_func_float, lr4_multi_get_s16_func(), orig_func_s16);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -184,7 +359,13 @@ int main(int argc, char *argv[]) {
     s = suite_create("lfe-filter");
     tc = tcase_create("lfe-filter");
     tcase_add_test(tc, lfe_filter_test);
-    tcase_set_timeout(tc, 10);
+#ifdef HAVE_AVX2
+    tcase_add_test(tc, lr4_avx2_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, lr4_neon_test);
+#endif
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
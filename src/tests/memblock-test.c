@@ -81,11 +81,11 @@ START_TEST (memblock_test) {
 
     const char txt[] = "This is a test!";
 
-    pool_a = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pool_a = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true, false);
     fail_unless(pool_a != NULL);
-    pool_b = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pool_b = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true, false);
     fail_unless(pool_b != NULL);
-    pool_c = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pool_c = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true, false);
     fail_unless(pool_c != NULL);
 
     pa_mempool_get_shm_id(pool_a, &id_a);
@@ -176,6 +176,91 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+#define N_IN_FLIGHT 1000
+
+static void release_to_export_cb(pa_memimport *i, uint32_t block_id, void *userdata) {
+    fail_unless(pa_memexport_process_release(userdata, block_id) == 0);
+}
+
+START_TEST (memblock_in_flight_test) {
+    pa_mempool *pool_a, *pool_b;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    pa_memblock *blocks_a[N_IN_FLIGHT], *blocks_b[N_IN_FLIGHT];
+    uint32_t ids[N_IN_FLIGHT];
+    pa_mem_type_t mem_type;
+    uint32_t shm_id;
+    size_t offset, size;
+    unsigned i, j;
+
+    pool_a = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true, false);
+    fail_unless(pool_a != NULL);
+    pool_b = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true, false);
+    fail_unless(pool_b != NULL);
+
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    import_b = pa_memimport_new(pool_b, release_to_export_cb, export_a);
+    fail_unless(import_b != NULL);
+
+    /* Way more blocks than the export and import tables used to hold */
+    for (i = 0; i < N_IN_FLIGHT; i++) {
+        blocks_a[i] = pa_memblock_new_pool(pool_a, sizeof(i));
+        fail_unless(blocks_a[i] != NULL);
+        *(unsigned*) pa_memblock_acquire(blocks_a[i]) = i;
+        pa_memblock_release(blocks_a[i]);
+
+        /* Unless told that the peer can take more, the export stays
+         * within what older peers can import */
+        if (i == PA_MEMEXPORT_SLOTS_DEFAULT) {
+            fail_unless(pa_memexport_put(export_a, blocks_a[i], &mem_type, &ids[i], &shm_id, &offset, &size) < 0);
+            pa_memexport_set_max_slots(export_a, PA_MEMEXPORT_SLOTS_MAX);
+        }
+
+        fail_unless(pa_memexport_put(export_a, blocks_a[i], &mem_type, &ids[i], &shm_id, &offset, &size) == 0);
+
+        blocks_b[i] = pa_memimport_get(import_b, mem_type, ids[i], shm_id, offset, size, false);
+        fail_unless(blocks_b[i] != NULL);
+    }
+
+    for (i = 0; i < N_IN_FLIGHT; i++) {
+        fail_unless(*(unsigned*) pa_memblock_acquire(blocks_b[i]) == i);
+        pa_memblock_release(blocks_b[i]);
+
+        for (j = 0; j < i; j++)
+            fail_unless(ids[j] != ids[i]);
+    }
+
+    print_stats(pool_a, "A");
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_exported) == N_IN_FLIGHT);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool_b)->n_imported) == N_IN_FLIGHT);
+
+    /* Releasing the imports releases the exports */
+    for (i = 0; i < N_IN_FLIGHT; i++) {
+        pa_memblock_unref(blocks_b[i]);
+        pa_memblock_unref(blocks_a[i]);
+    }
+
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool_a)->n_exported) == 0);
+    fail_unless(pa_atomic_load(&pa_mempool_get_stat(pool_b)->n_imported) == 0);
+    fail_unless(pa_memexport_process_release(export_a, ids[0]) < 0);
+
+    /* Freed slots are reused */
+    fail_unless(pa_memexport_put(export_a, blocks_a[0] = pa_memblock_new_pool(pool_a, 1), &mem_type, &ids[0], &shm_id, &offset, &size) == 0);
+    for (i = 1, j = 0; i < N_IN_FLIGHT; i++)
+        if (ids[i] == ids[0])
+            j++;
+    fail_unless(j == 1);
+    pa_memblock_unref(blocks_a[0]);
+
+    pa_memimport_free(import_b);
+    pa_memexport_free(export_a);
+
+    pa_mempool_unref(pool_a);
+    pa_mempool_unref(pool_b);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -188,6 +273,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_in_flight_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,271 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <check.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/mix.h>
+
+#define MAX_BLOCKS 1024
+#define N_STREAMS 8
+#define N_PERIODS 200000
+#define PERIOD_SIZE 256
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = 48000,
+    .channels = 2
+};
+
+/* The dTLB load misses of this process, as counted by the kernel, or -1
+ * if the counter is not available here, e.g. in a VM or because of
+ * perf_event_paranoid. */
+static int tlb_counter_open(void) {
+#if defined(__linux__) && defined(__NR_perf_event_open)
+    struct perf_event_attr attr;
+
+    pa_zero(attr);
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static void tlb_counter_start(int fd) {
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static int64_t tlb_counter_stop(int fd) {
+    uint64_t count;
+
+    if (fd < 0)
+        return -1;
+
+#ifdef __linux__
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+
+    return (int64_t) count;
+}
+
+/* Fills the whole pool with blocks, so that the streams are scattered
+ * over all of it like on a busy daemon. Returns the number of blocks. */
+static unsigned fill_pool(pa_mempool *pool, pa_memblock **blocks) {
+    size_t size = pa_mempool_block_size_max(pool);
+    unsigned n, i;
+
+    for (n = 0; n < MAX_BLOCKS; n++) {
+        int16_t *d;
+
+        if (!(blocks[n] = pa_memblock_new_pool(pool, size)))
+            break;
+
+        d = pa_memblock_acquire(blocks[n]);
+        for (i = 0; i < size / sizeof(int16_t); i++)
+            d[i] = (int16_t) ((n * 7919 + i * 31) & 0x3fff);
+        pa_memblock_release(blocks[n]);
+    }
+
+    return n;
+}
+
+static void free_blocks(pa_memblock **blocks, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        if (blocks[i])
+            pa_memblock_unref(blocks[i]);
+}
+
+/* Returns a checksum of the mixed data, which must not depend on the
+ * pages backing the pool */
+static uint32_t bench(pa_mem_type_t type, bool hugepages) {
+    pa_memblock *blocks[MAX_BLOCKS];
+    pa_mix_info streams[N_STREAMS];
+    int16_t out[PERIOD_SIZE / sizeof(int16_t)];
+    pa_mempool *pool;
+    pa_cvolume volume;
+    pa_usec_t start, elapsed;
+    int64_t misses;
+    uint32_t checksum = 0, seed = 1;
+    unsigned n, i, j, k;
+    size_t size;
+    int fd;
+
+    pa_assert_se(pool = pa_mempool_new(type, 0, true, hugepages));
+    n = fill_pool(pool, blocks);
+    fail_unless(n >= N_STREAMS);
+
+    size = pa_mempool_block_size_max(pool);
+    pa_cvolume_set(&volume, ss.channels, PA_VOLUME_NORM / 2);
+
+    fd = tlb_counter_open();
+    tlb_counter_start(fd);
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_PERIODS; i++) {
+        for (j = 0; j < N_STREAMS; j++) {
+            seed = seed * 1103515245 + 12345;
+            k = (seed >> 8) % n;
+
+            streams[j].chunk.memblock = blocks[k];
+            streams[j].chunk.index = ((seed >> 4) % (size / PERIOD_SIZE)) * PERIOD_SIZE;
+            streams[j].chunk.length = PERIOD_SIZE;
+            streams[j].volume = volume;
+            pa_memblock_acquire(blocks[k]);
+        }
+
+        pa_mix(streams, N_STREAMS, out, sizeof(out), &ss, NULL, false);
+
+        for (j = 0; j < N_STREAMS; j++)
+            pa_memblock_release(streams[j].chunk.memblock);
+
+        for (j = 0; j < PA_ELEMENTSOF(out); j++)
+            checksum = checksum * 31 + (uint16_t) out[j];
+    }
+
+    elapsed = pa_rtclock_now() - start;
+    misses = tlb_counter_stop(fd);
+
+    if (misses >= 0)
+        pa_log_info("%s memory, %s: %u blocks, %llu ms, %0.1f MiB/s mixed, %lld dTLB load misses",
+                    pa_mem_type_to_string(type), hugepages ? "huge pages" : "regular pages", n,
+                    (unsigned long long) elapsed / PA_USEC_PER_MSEC,
+                    (double) N_PERIODS * N_STREAMS * PERIOD_SIZE * PA_USEC_PER_SEC / elapsed / (1024 * 1024),
+                    (long long) misses);
+    else
+        pa_log_info("%s memory, %s: %u blocks, %llu ms, %0.1f MiB/s mixed, dTLB load misses not available",
+                    pa_mem_type_to_string(type), hugepages ? "huge pages" : "regular pages", n,
+                    (unsigned long long) elapsed / PA_USEC_PER_MSEC,
+                    (double) N_PERIODS * N_STREAMS * PERIOD_SIZE * PA_USEC_PER_SEC / elapsed / (1024 * 1024));
+
+    if (fd >= 0)
+        pa_close(fd);
+
+    free_blocks(blocks, n);
+    pa_mempool_unref(pool);
+
+    return checksum;
+}
+
+static void test_type(pa_mem_type_t type) {
+    pa_memblock *blocks[MAX_BLOCKS];
+    pa_mempool *pool;
+    size_t size;
+    unsigned n, i, j;
+
+    /* Whatever backs the pool in the end, it has to be usable */
+    pa_assert_se(pool = pa_mempool_new(type, 0, true, true));
+    n = fill_pool(pool, blocks);
+    fail_unless(n > 0);
+
+    size = pa_mempool_block_size_max(pool);
+
+    /* Vacuuming must not touch the blocks that are still in use */
+    for (i = 0; i < n; i += 2) {
+        pa_memblock_unref(blocks[i]);
+        blocks[i] = NULL;
+    }
+
+    pa_mempool_vacuum(pool);
+
+    for (i = 1; i < n; i += 2) {
+        const int16_t *d = pa_memblock_acquire(blocks[i]);
+
+        for (j = 0; j < size / sizeof(int16_t); j++)
+            if (d[j] != (int16_t) ((i * 7919 + j * 31) & 0x3fff))
+                break;
+
+        fail_unless(j == size / sizeof(int16_t));
+        pa_memblock_release(blocks[i]);
+    }
+
+    free_blocks(blocks, n);
+    pa_mempool_unref(pool);
+}
+
+START_TEST (mempool_hugepage_test) {
+    test_type(PA_MEM_TYPE_PRIVATE);
+    test_type(PA_MEM_TYPE_SHARED_POSIX);
+
+    if (pa_memfd_is_locally_supported())
+        test_type(PA_MEM_TYPE_SHARED_MEMFD);
+}
+END_TEST
+
+START_TEST (mempool_hugepage_mix_bench) {
+    fail_unless(bench(PA_MEM_TYPE_PRIVATE, false) == bench(PA_MEM_TYPE_PRIVATE, true));
+
+    if (pa_memfd_is_locally_supported())
+        fail_unless(bench(PA_MEM_TYPE_SHARED_MEMFD, false) == bench(PA_MEM_TYPE_SHARED_MEMFD, true));
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Mempool huge pages");
+    tc = tcase_create("mempool-hugepage");
+    tcase_add_test(tc, mempool_hugepage_test);
+    tcase_add_test(tc, mempool_hugepage_mix_bench);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,395 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/pcm-rice.h>
+
+/* Not a multiple of the packet size, so the last packet is short */
+#define N_FRAMES 10000
+
+#define BENCH_SECONDS 10
+
+enum signal {
+    SIGNAL_SILENCE,
+    SIGNAL_SINE,
+    SIGNAL_NOISE,
+    SIGNAL_EXTREME,
+    SIGNAL_RANDOM_BYTES,
+    SIGNAL_MAX
+};
+
+static const pa_sample_format_t formats[] = {
+    PA_SAMPLE_S16LE,
+    PA_SAMPLE_S16BE,
+    PA_SAMPLE_S24LE,
+    PA_SAMPLE_S24BE,
+    PA_SAMPLE_S24_32LE,
+    PA_SAMPLE_S24_32BE,
+    PA_SAMPLE_S32LE,
+    PA_SAMPLE_S32BE,
+    PA_SAMPLE_FLOAT32LE,
+    PA_SAMPLE_FLOAT32BE,
+};
+
+/* Writes v, which is in [-1, 1], as a sample of the given format */
+static void write_sample(pa_sample_format_t format, uint8_t *p, double v) {
+    int16_t s16;
+    uint32_t u32;
+    float f;
+
+    switch (format) {
+        case PA_SAMPLE_S16LE:
+        case PA_SAMPLE_S16BE:
+            s16 = (int16_t) lrint(v * 0x7fff);
+            s16 = format == PA_SAMPLE_S16LE ? PA_INT16_TO_LE(s16) : PA_INT16_TO_BE(s16);
+            memcpy(p, &s16, sizeof(s16));
+            break;
+
+        case PA_SAMPLE_S24LE:
+            PA_WRITE24LE(p, (uint32_t) lrint(v * 0x7fffff));
+            break;
+
+        case PA_SAMPLE_S24BE:
+            PA_WRITE24BE(p, (uint32_t) lrint(v * 0x7fffff));
+            break;
+
+        case PA_SAMPLE_S24_32LE:
+        case PA_SAMPLE_S24_32BE:
+        case PA_SAMPLE_S32LE:
+        case PA_SAMPLE_S32BE:
+            if (format == PA_SAMPLE_S24_32LE || format == PA_SAMPLE_S24_32BE)
+                u32 = (uint32_t) lrint(v * 0x7fffff) & 0xffffffU;
+            else
+                u32 = (uint32_t) llrint(v * 0x7fffffff);
+
+            u32 = format == PA_SAMPLE_S24_32LE || format == PA_SAMPLE_S32LE ? PA_UINT32_TO_LE(u32) : PA_UINT32_TO_BE(u32);
+            memcpy(p, &u32, sizeof(u32));
+            break;
+
+        case PA_SAMPLE_FLOAT32LE:
+        case PA_SAMPLE_FLOAT32BE:
+            f = (float) v;
+            memcpy(&u32, &f, sizeof(u32));
+            u32 = format == PA_SAMPLE_FLOAT32LE ? PA_UINT32_TO_LE(u32) : PA_UINT32_TO_BE(u32);
+            memcpy(p, &u32, sizeof(u32));
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void *make_signal(const pa_sample_spec *ss, unsigned n_frames, enum signal signal) {
+    size_t fs = pa_frame_size(ss), sample_size = pa_sample_size(ss);
+    uint8_t *data = pa_xmalloc(n_frames * fs);
+    unsigned i, c;
+
+    if (signal == SIGNAL_RANDOM_BYTES) {
+        for (i = 0; i < n_frames * fs; i++)
+            data[i] = (uint8_t) rand();
+
+        return data;
+    }
+
+    for (i = 0; i < n_frames; i++)
+        for (c = 0; c < ss->channels; c++) {
+            double v;
+
+            switch (signal) {
+                case SIGNAL_SILENCE:
+                    v = 0;
+                    break;
+                case SIGNAL_SINE:
+                    v = 0.5 * sin(2 * M_PI * 440 * (c + 1) * i / ss->rate) + 0.001 * (rand() / (double) RAND_MAX - 0.5);
+                    break;
+                case SIGNAL_NOISE:
+                    v = 2 * rand() / (double) RAND_MAX - 1;
+                    break;
+                case SIGNAL_EXTREME:
+                    v = (i + c) % 2 ? 1 : -1;
+                    break;
+                default:
+                    pa_assert_not_reached();
+            }
+
+            write_sample(ss->format, data + i * fs + c * sample_size, v);
+        }
+
+    return data;
+}
+
+/* Decodes everything pushed so far and appends it to out */
+static int pop_all(pa_pcm_rice_decoder *d, uint8_t *out, size_t *out_length) {
+    pa_memchunk chunk;
+    int r;
+
+    while ((r = pa_pcm_rice_decoder_pop(d, &chunk)) > 0) {
+        memcpy(out + *out_length, (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index, chunk.length);
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+
+        *out_length += chunk.length;
+    }
+
+    return r;
+}
+
+START_TEST (pcm_rice_test) {
+    pa_mempool *pool;
+    unsigned i, channels;
+    enum signal signal;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    fail_unless(pool != NULL);
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++)
+        for (channels = 1; channels <= 3; channels++)
+            for (signal = 0; signal < SIGNAL_MAX; signal++) {
+                pa_sample_spec ss = { formats[i], 48000, channels };
+                size_t length = N_FRAMES * pa_frame_size(&ss), encoded_length, out_length = 0, pos;
+                pa_pcm_rice_decoder *d;
+                pa_memchunk chunk;
+                uint8_t *pcm, *encoded, *out;
+
+                fail_unless(pa_pcm_rice_supported(&ss));
+
+                pcm = make_signal(&ss, N_FRAMES, signal);
+                encoded = pa_xmalloc(pa_pcm_rice_encode_bound(&ss, length));
+                out = pa_xmalloc(length);
+
+                encoded_length = pa_pcm_rice_encode(&ss, pcm, length, encoded);
+                fail_unless(encoded_length <= pa_pcm_rice_encode_bound(&ss, length));
+                fail_unless(encoded_length % pa_frame_size(&ss) == 0);
+
+                /* Pieces of odd sizes, like a pstream may hand them out */
+                d = pa_pcm_rice_decoder_new(pool, &ss);
+                for (pos = 0; pos < encoded_length; pos += 1 + (pos % 997)) {
+                    size_t n = PA_MIN(1 + (pos % 997), encoded_length - pos);
+
+                    pa_pcm_rice_decoder_push(d, encoded + pos, n);
+                    fail_unless(pop_all(d, out, &out_length) == 0);
+                }
+
+                fail_unless(out_length == length);
+                fail_unless(memcmp(pcm, out, length) == 0);
+
+                if (signal == SIGNAL_SILENCE)
+                    fail_unless(encoded_length < length / 10);
+                else if (signal == SIGNAL_SINE && pa_sample_size(&ss) <= 3)
+                    fail_unless(encoded_length < length * 3 / 4);
+
+                /* A flipped size field is caught, and the decoder can start
+                 * over after a reset */
+                pa_pcm_rice_decoder_reset(d);
+                encoded[0] ^= 0x80;
+                pa_pcm_rice_decoder_push(d, encoded, encoded_length);
+                fail_unless(pa_pcm_rice_decoder_pop(d, &chunk) < 0);
+                encoded[0] ^= 0x80;
+
+                pa_pcm_rice_decoder_reset(d);
+                out_length = 0;
+                pa_pcm_rice_decoder_push(d, encoded, encoded_length);
+                fail_unless(pop_all(d, out, &out_length) == 0);
+                fail_unless(out_length == length);
+
+                pa_pcm_rice_decoder_free(d);
+                pa_xfree(out);
+                pa_xfree(encoded);
+                pa_xfree(pcm);
+            }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* Plays white noise, as random bytes, through a model of a compressed tunnel stream. The
+ * server requests PCM bytes as it plays them. The client counts what it
+ * writes against the requests like pa_stream_write() does, with the offset
+ * module-tunnel-sink-new passes. White noise gets bigger once encoded, and
+ * the client must keep up with the requests regardless. */
+static void flow(pa_mempool *pool, const pa_sample_spec *ss) {
+    size_t tlength = pa_usec_to_bytes(100 * PA_USEC_PER_MSEC, ss);
+    size_t minreq = pa_frame_align(tlength / 4, ss), period = pa_frame_align(tlength / 10, ss);
+    int64_t requested = (int64_t) tlength, missing = 0, queue = 0;
+    size_t written_pcm = 0, written_encoded = 0;
+    pa_pcm_rice_decoder *d;
+    unsigned tick, underruns = 0;
+
+    d = pa_pcm_rice_decoder_new(pool, ss);
+
+    for (tick = 0; tick < 1000; tick++) {
+        size_t writable = requested > 0 ? (size_t) requested : 0;
+        pa_memchunk chunk;
+
+        /* The client, like the thread of the tunnel sink */
+        if (writable > 0) {
+            size_t l = pa_frame_align(writable, ss), n;
+            uint8_t *pcm, *encoded;
+
+            pcm = make_signal(ss, (unsigned) (l / pa_frame_size(ss)), SIGNAL_RANDOM_BYTES);
+            encoded = pa_xmalloc(pa_pcm_rice_encode_bound(ss, l));
+            n = pa_pcm_rice_encode(ss, pcm, l, encoded);
+
+            requested -= ((int64_t) l - (int64_t) n) + (int64_t) n;
+            written_pcm += l;
+            written_encoded += n;
+
+            /* The server */
+            pa_pcm_rice_decoder_push(d, encoded, n);
+            while (pa_pcm_rice_decoder_pop(d, &chunk) > 0) {
+                queue += (int64_t) chunk.length;
+                pa_memblock_unref(chunk.memblock);
+            }
+
+            pa_xfree(encoded);
+            pa_xfree(pcm);
+        }
+
+        fail_unless(requested >= 0);
+        fail_unless(queue <= (int64_t) tlength);
+
+        /* The server plays a period and asks for what is missing */
+        if (queue < (int64_t) period)
+            underruns++;
+
+        queue -= PA_MIN(queue, (int64_t) period);
+        missing += (int64_t) period;
+
+        if (missing >= (int64_t) minreq) {
+            requested += missing;
+            missing = 0;
+        }
+    }
+
+    pa_log_debug("Wrote %llu bytes of PCM as %llu bytes",
+                 (unsigned long long) written_pcm, (unsigned long long) written_encoded);
+
+    fail_unless(written_encoded > written_pcm);
+    fail_unless(underruns == 0);
+
+    pa_pcm_rice_decoder_free(d);
+}
+
+START_TEST (pcm_rice_flow_test) {
+    pa_sample_spec s16 = { PA_SAMPLE_S16LE, 44100, 2 };
+    pa_sample_spec f32 = { PA_SAMPLE_FLOAT32LE, 48000, 2 };
+    pa_mempool *pool;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    fail_unless(pool != NULL);
+
+    flow(pool, &s16);
+    flow(pool, &f32);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+static void bench(pa_mempool *pool, const pa_sample_spec *ss, enum signal signal, const char *name) {
+    size_t length = ss->rate * BENCH_SECONDS * pa_frame_size(ss), encoded_length, out_length = 0;
+    pa_usec_t start, encode_usec, decode_usec;
+    char t[PA_SAMPLE_SPEC_SNPRINT_MAX];
+    pa_pcm_rice_decoder *d;
+    uint8_t *pcm, *encoded, *out;
+
+    pcm = make_signal(ss, ss->rate * BENCH_SECONDS, signal);
+    encoded = pa_xmalloc(pa_pcm_rice_encode_bound(ss, length));
+    out = pa_xmalloc(length);
+
+    start = pa_rtclock_now();
+    encoded_length = pa_pcm_rice_encode(ss, pcm, length, encoded);
+    encode_usec = PA_MAX(pa_rtclock_now() - start, 1U);
+
+    d = pa_pcm_rice_decoder_new(pool, ss);
+    start = pa_rtclock_now();
+    pa_pcm_rice_decoder_push(d, encoded, encoded_length);
+    fail_unless(pop_all(d, out, &out_length) == 0);
+    decode_usec = PA_MAX(pa_rtclock_now() - start, 1U);
+
+    fail_unless(out_length == length);
+    fail_unless(memcmp(pcm, out, length) == 0);
+
+    pa_log_info("%s, %s: %0.1f%% of the PCM size, encoding %0.0f MB/s (%0.2f%% of a core), decoding %0.0f MB/s (%0.2f%% of a core)",
+                pa_sample_spec_snprint(t, sizeof(t), ss), name,
+                100.0 * encoded_length / length,
+                (double) length / encode_usec, 100.0 * encode_usec / (BENCH_SECONDS * PA_USEC_PER_SEC),
+                (double) length / decode_usec, 100.0 * decode_usec / (BENCH_SECONDS * PA_USEC_PER_SEC));
+
+    pa_pcm_rice_decoder_free(d);
+    pa_xfree(out);
+    pa_xfree(encoded);
+    pa_xfree(pcm);
+}
+
+START_TEST (pcm_rice_bench) {
+    pa_sample_spec s16 = { PA_SAMPLE_S16LE, 44100, 2 };
+    pa_sample_spec s24 = { PA_SAMPLE_S24LE, 48000, 2 };
+    pa_sample_spec f32 = { PA_SAMPLE_FLOAT32LE, 48000, 8 };
+    pa_mempool *pool;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    fail_unless(pool != NULL);
+
+    bench(pool, &s16, SIGNAL_SINE, "sine");
+    bench(pool, &s16, SIGNAL_NOISE, "noise");
+    bench(pool, &s24, SIGNAL_SINE, "sine");
+    bench(pool, &f32, SIGNAL_SINE, "sine");
+    bench(pool, &f32, SIGNAL_SILENCE, "silence");
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("PCM Rice");
+    tc = tcase_create("pcm-rice");
+    tcase_add_test(tc, pcm_rice_test);
+    tcase_add_test(tc, pcm_rice_flow_test);
+    tcase_add_test(tc, pcm_rice_bench);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,10 +24,16 @@
 #include <check.h>
 
 #include <pulse/proplist.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
+#include <pulsecore/tagstruct.h>
+
+#define N_BENCH_STREAMS 1000
+#define N_BENCH_ROUNDS 20
 
 START_TEST (proplist_test) {
     pa_modargs *ma;
@@ -96,6 +102,137 @@ START_TEST (proplist_test) {
 }
 END_TEST
 
+START_TEST (proplist_iterate_test) {
+    pa_proplist *a, *b;
+    const char *key;
+    void *state = NULL;
+    char k[32];
+    unsigned i, n = 0;
+
+    a = pa_proplist_new();
+
+    /* Mix well-known and other keys, and make the array grow a few times */
+    for (i = 0; i < 100; i++) {
+        pa_snprintf(k, sizeof(k), "test.key%u", i);
+        fail_unless(pa_proplist_setf(a, k, "%u", i) == 0);
+        if (i == 50)
+            fail_unless(pa_proplist_sets(a, PA_PROP_APPLICATION_NAME, "test") == 0);
+    }
+
+    fail_unless(pa_proplist_size(a) == 101);
+
+    /* Properties may be unset while iterating, the others must still be
+     * visited in the order they were added */
+    i = 0;
+    while ((key = pa_proplist_iterate(a, &state))) {
+        if (pa_streq(key, PA_PROP_APPLICATION_NAME)) {
+            fail_unless(i == 51);
+            i++;
+            continue;
+        }
+
+        pa_snprintf(k, sizeof(k), "test.key%u", n);
+        fail_unless(pa_streq(key, k));
+
+        if (n % 2 == 0)
+            fail_unless(pa_proplist_unset(a, k) == 0);
+
+        n++;
+        i++;
+    }
+
+    fail_unless(n == 100);
+    fail_unless(pa_proplist_size(a) == 51);
+    fail_unless(pa_proplist_contains(a, "test.key1") == 1);
+    fail_unless(pa_proplist_contains(a, "test.key2") == 0);
+    fail_unless(pa_streq(pa_proplist_gets(a, PA_PROP_APPLICATION_NAME), "test"));
+
+    /* Refill the holes */
+    for (i = 0; i < 100; i += 2) {
+        pa_snprintf(k, sizeof(k), "test.key%u", i);
+        fail_unless(pa_proplist_setf(a, k, "%u", i) == 0);
+    }
+
+    fail_unless(pa_proplist_size(a) == 101);
+
+    b = pa_proplist_copy(a);
+    fail_unless(pa_proplist_equal(a, b));
+
+    fail_unless(pa_proplist_sets(b, "test.key3", "changed") == 0);
+    fail_unless(!pa_proplist_equal(a, b));
+    fail_unless(pa_streq(pa_proplist_gets(a, "test.key3"), "3"));
+
+    pa_proplist_update(b, PA_UPDATE_MERGE, a);
+    fail_unless(pa_streq(pa_proplist_gets(b, "test.key3"), "changed"));
+    pa_proplist_update(b, PA_UPDATE_REPLACE, a);
+    fail_unless(pa_proplist_equal(a, b));
+
+    pa_proplist_clear(b);
+    fail_unless(pa_proplist_isempty(b));
+    fail_unless(!pa_proplist_iterate(b, &state));
+
+    pa_proplist_free(a);
+    pa_proplist_free(b);
+}
+END_TEST
+
+/* What introspection replies do with the proplists of many streams: copy
+ * them, serialize them and parse them on the other side */
+START_TEST (proplist_bench) {
+    pa_proplist *streams[N_BENCH_STREAMS];
+    pa_usec_t start, elapsed;
+    unsigned i, j;
+
+    for (i = 0; i < N_BENCH_STREAMS; i++) {
+        pa_proplist *p = streams[i] = pa_proplist_new();
+
+        pa_proplist_sets(p, PA_PROP_APPLICATION_NAME, "Music Player");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_ID, "org.example.MusicPlayer");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_VERSION, "1.0");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_ICON_NAME, "audio-player");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_LANGUAGE, "en_US.UTF-8");
+        pa_proplist_setf(p, PA_PROP_APPLICATION_PROCESS_ID, "%u", 1000 + i);
+        pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_USER, "user");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_HOST, "localhost");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_BINARY, "music-player");
+        pa_proplist_sets(p, PA_PROP_APPLICATION_PROCESS_MACHINE_ID, "0123456789abcdef0123456789abcdef");
+        pa_proplist_setf(p, PA_PROP_MEDIA_NAME, "Track %u", i);
+        pa_proplist_setf(p, PA_PROP_MEDIA_TITLE, "Track %u", i);
+        pa_proplist_sets(p, PA_PROP_MEDIA_ARTIST, "Johann Sebastian Bach");
+        pa_proplist_sets(p, PA_PROP_MEDIA_ROLE, "music");
+        pa_proplist_sets(p, "module-stream-restore.id", "sink-input-by-application-name:Music Player");
+        pa_proplist_sets(p, "native-protocol.peer", "UNIX socket client");
+        pa_proplist_sets(p, "native-protocol.version", "32");
+        pa_proplist_sets(p, "window.x11.display", ":0");
+    }
+
+    start = pa_rtclock_now();
+
+    for (j = 0; j < N_BENCH_ROUNDS; j++)
+        for (i = 0; i < N_BENCH_STREAMS; i++) {
+            pa_tagstruct *t = pa_tagstruct_new();
+            pa_proplist *copy, *parsed = pa_proplist_new();
+
+            copy = pa_proplist_copy(streams[i]);
+            pa_tagstruct_put_proplist(t, copy);
+            fail_unless(pa_tagstruct_get_proplist(t, parsed) == 0);
+            fail_unless(pa_streq(pa_proplist_gets(parsed, PA_PROP_MEDIA_ROLE), "music"));
+
+            pa_proplist_free(copy);
+            pa_proplist_free(parsed);
+            pa_tagstruct_free(t);
+        }
+
+    elapsed = pa_rtclock_now() - start;
+    pa_log_info("Copied, serialized and parsed %u proplists in %llu ms, %0.2f usec each",
+                N_BENCH_STREAMS * N_BENCH_ROUNDS, (unsigned long long) elapsed / PA_USEC_PER_MSEC,
+                (double) elapsed / (N_BENCH_STREAMS * N_BENCH_ROUNDS));
+
+    for (i = 0; i < N_BENCH_STREAMS; i++)
+        pa_proplist_free(streams[i]);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -108,6 +245,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Property List");
     tc = tcase_create("propertylist");
     tcase_add_test(tc, proplist_test);
+    tcase_add_test(tc, proplist_iterate_test);
+    tcase_add_test(tc, proplist_bench);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
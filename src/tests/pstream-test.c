@@ -0,0 +1,285 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/socket.h>
+
+#define N_ITEMS 5000
+#define N_BENCH_PACKETS 200000
+#define BENCH_PACKET_SIZE 40
+#define BENCH_BURST 32
+#define BENCH_MEMBLOCK_SIZE 4096
+
+struct receiver {
+    unsigned received, fds_received;
+    size_t bytes;
+    bool check;
+};
+
+static pa_mainloop *ml;
+static pa_mempool *pool;
+static pa_pstream *p1, *p2;
+
+/* Every item carries its sequence number. Items are packets of varying
+ * size, every 7th is a memblock instead and every 11th packet comes with
+ * an fd. */
+static bool item_is_memblock(unsigned i) {
+    return i % 7 == 3;
+}
+
+static bool item_has_fd(unsigned i) {
+    return i % 11 == 5 && !item_is_memblock(i);
+}
+
+static size_t item_size(unsigned i) {
+    return 4 + (i * 37) % 600;
+}
+
+static void fill(uint8_t *d, size_t l, unsigned i) {
+    size_t j;
+
+    memcpy(d, &i, sizeof(i));
+    for (j = sizeof(i); j < l; j++)
+        d[j] = (uint8_t) (i + j);
+}
+
+static void check_data(const uint8_t *d, size_t l, unsigned i) {
+    uint8_t *expected = pa_xmalloc(l);
+
+    fill(expected, l, i);
+    fail_unless(memcmp(d, expected, l) == 0);
+    pa_xfree(expected);
+}
+
+static void packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    struct receiver *r = userdata;
+    const uint8_t *d;
+    size_t l;
+
+    d = pa_packet_data(packet, &l);
+    r->bytes += l;
+
+    if (r->check) {
+        fail_unless(!item_is_memblock(r->received));
+        fail_unless(l == item_size(r->received));
+        check_data(d, l, r->received);
+
+#ifdef HAVE_CREDS
+        /* The fd must arrive with its own packet, and only with that */
+        fail_unless(ancil_data->nfd == (item_has_fd(r->received) ? 1 : 0));
+
+        if (ancil_data->nfd > 0) {
+            r->fds_received++;
+            pa_cmsg_ancil_data_close_fds(ancil_data);
+        }
+#endif
+    }
+
+    r->received++;
+}
+
+static void memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    struct receiver *r = userdata;
+
+    r->bytes += chunk->length;
+
+    if (r->check) {
+        fail_unless(item_is_memblock(r->received));
+        fail_unless(channel == r->received);
+        fail_unless(offset == (int64_t) r->received);
+        fail_unless(chunk->length == item_size(r->received));
+        check_data((const uint8_t *) pa_memblock_acquire_chunk(chunk), chunk->length, r->received);
+        pa_memblock_release(chunk->memblock);
+    }
+
+    r->received++;
+}
+
+static void send_item(unsigned i) {
+    size_t l = item_size(i);
+
+    if (item_is_memblock(i)) {
+        pa_memchunk chunk;
+
+        chunk.memblock = pa_memblock_new(pool, l);
+        chunk.index = 0;
+        chunk.length = l;
+        fill(pa_memblock_acquire(chunk.memblock), l, i);
+        pa_memblock_release(chunk.memblock);
+
+        pa_pstream_send_memblock(p1, i, i, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+    } else {
+        pa_packet *packet = pa_packet_new(l);
+        pa_cmsg_ancil_data *ancil_data = NULL;
+#ifdef HAVE_CREDS
+        pa_cmsg_ancil_data a;
+
+        if (item_has_fd(i)) {
+            pa_zero(a);
+            a.nfd = 1;
+            a.fds[0] = dup(STDERR_FILENO);
+            a.close_fds_on_cleanup = true;
+            ancil_data = &a;
+        }
+#endif
+
+        fill((uint8_t *) pa_packet_data(packet, &l), l, i);
+        pa_pstream_send_packet(p1, packet, ancil_data);
+        pa_packet_unref(packet);
+    }
+}
+
+static void pstream_setup(void) {
+    pa_iochannel *io1, *io2;
+    int fds[2];
+
+    ml = pa_mainloop_new();
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, pool);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, pool);
+}
+
+static void pstream_teardown(void) {
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(pool);
+    pa_mainloop_free(ml);
+}
+
+START_TEST (pstream_order_test) {
+    struct receiver r;
+    unsigned i, fds_sent = 0;
+
+    pa_zero(r);
+    r.check = true;
+    pa_pstream_set_receive_packet_callback(p2, packet_received, &r);
+    pa_pstream_set_receive_memblock_callback(p2, memblock_received, &r);
+
+    /* Queue up items in bursts of varying length, so that they are
+     * gathered into writes in many different ways */
+    for (i = 0; i < N_ITEMS; i++) {
+        send_item(i);
+        fds_sent += item_has_fd(i);
+
+        if (i % 13 == 0)
+            pa_mainloop_iterate(ml, 0, NULL);
+    }
+
+    while (r.received < N_ITEMS)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    fail_unless(!pa_pstream_is_pending(p1));
+#ifdef HAVE_CREDS
+    fail_unless(r.fds_received == fds_sent);
+#endif
+}
+END_TEST
+
+static void bench(const char *what, unsigned n, size_t size, bool memblocks) {
+    struct receiver r;
+    pa_packet *packet;
+    pa_memchunk chunk;
+    pa_usec_t start, elapsed;
+    unsigned i;
+
+    pa_zero(r);
+    pa_pstream_set_receive_packet_callback(p2, packet_received, &r);
+    pa_pstream_set_receive_memblock_callback(p2, memblock_received, &r);
+
+    packet = pa_packet_new(size);
+    chunk.memblock = pa_memblock_new(pool, size);
+    chunk.index = 0;
+    chunk.length = size;
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < n; i++) {
+        if (memblocks)
+            pa_pstream_send_memblock(p1, 0, 0, PA_SEEK_RELATIVE, &chunk);
+        else
+            pa_pstream_send_packet(p1, packet, NULL);
+
+        if (i % BENCH_BURST == BENCH_BURST - 1)
+            while (pa_mainloop_iterate(ml, 0, NULL) > 0)
+                ;
+    }
+
+    while (r.received < n)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    elapsed = pa_rtclock_now() - start;
+
+    pa_log_info("%s: %u items of %zu bytes in %llu ms, %0.0f items/s, %0.1f MiB/s", what, n, size,
+                (unsigned long long) elapsed / PA_USEC_PER_MSEC,
+                (double) n * PA_USEC_PER_SEC / elapsed,
+                (double) r.bytes * PA_USEC_PER_SEC / elapsed / (1024 * 1024));
+
+    fail_unless(r.bytes == (size_t) n * size);
+
+    pa_memblock_unref(chunk.memblock);
+    pa_packet_unref(packet);
+}
+
+START_TEST (pstream_throughput_test) {
+    bench("Small packets", N_BENCH_PACKETS, BENCH_PACKET_SIZE, false);
+    bench("Memblocks", N_BENCH_PACKETS / 4, BENCH_MEMBLOCK_SIZE, true);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("pstream");
+    tc = tcase_create("pstream");
+    tcase_add_checked_fixture(tc, pstream_setup, pstream_teardown);
+    tcase_add_test(tc, pstream_order_test);
+    tcase_add_test(tc, pstream_throughput_test);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,434 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <check.h>
+
+#include <openssl/evp.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/arpa-inet.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/thread.h>
+
+#include "runtime-test-util.h"
+
+#include "raop_encoder.h"
+
+/* What module-raop-sink renders per packet: 50 ms of 44.1 kHz stereo */
+#define FRAMES 2205
+#define PACKETS 2000
+#define HEADER_SIZE 16
+
+#define TIMES 300
+#define TIMES2 20
+
+static const uint8_t key[PA_RAOP_AES_BLOCK_SIZE] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+
+static const uint8_t iv[PA_RAOP_AES_BLOCK_SIZE] = {
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78, 0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+static void fill_samples(int16_t *d, unsigned n_samples, unsigned seed) {
+    uint32_t x = seed * 2654435761U + 1;
+    unsigned i;
+
+    for (i = 0; i < n_samples; i++) {
+        x = x * 1103515245U + 12345U;
+        d[i] = (int16_t) (x >> 16);
+    }
+}
+
+static pa_memchunk* make_chunk(pa_mempool *pool, pa_memchunk *c, unsigned seed) {
+    int16_t *d;
+
+    /* Use an offset, the encoder has to honour the chunk index */
+    c->memblock = pa_memblock_new(pool, 4 + FRAMES * 4);
+    c->index = 4;
+    c->length = FRAMES * 4;
+
+    d = pa_memblock_acquire(c->memblock);
+    fill_samples(d + 2, FRAMES * 2, seed);
+    pa_memblock_release(c->memblock);
+
+    return c;
+}
+
+/* The encoder as it used to be, one bit_writer() call per byte and one
+ * cipher call per AES block */
+static void bit_writer(uint8_t **buffer, uint8_t *bit_pos, int *size, uint8_t data, uint8_t data_bit_len) {
+    int bits_left, bit_overflow;
+    uint8_t bit_data;
+
+    if (!data_bit_len)
+        return;
+
+    if (!*bit_pos)
+        *size += 1;
+
+    bits_left = 7 - *bit_pos  + 1;
+    bit_overflow = bits_left - data_bit_len;
+    if (bit_overflow >= 0) {
+        bit_data = data << bit_overflow;
+        if (*bit_pos)
+            **buffer |= bit_data;
+        else
+            **buffer = bit_data;
+        if (0 == bit_overflow) {
+            *buffer += 1;
+            *bit_pos = 0;
+        } else {
+            *bit_pos += data_bit_len;
+        }
+    } else {
+        bit_data = data >> -bit_overflow;
+        **buffer |= bit_data;
+        *buffer += 1;
+        *size += 1;
+        **buffer = data << (8 + bit_overflow);
+        *bit_pos = -bit_overflow;
+    }
+}
+
+static size_t reference_encode(EVP_CIPHER_CTX *ecb, const int16_t *samples, uint8_t *b) {
+    static const uint8_t header[] = {
+        0x24, 0x00, 0x00, 0x00,
+        0xF0, 0xFF, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    uint8_t *bp, bpos, nv[PA_RAOP_AES_BLOCK_SIZE];
+    const uint8_t *ibp, *maxibp;
+    uint32_t bsize = FRAMES;
+    uint16_t len;
+    int size, i, j, l;
+
+    memcpy(b, header, HEADER_SIZE);
+
+    bp = b + HEADER_SIZE;
+    size = bpos = 0;
+    bit_writer(&bp,&bpos,&size,1,3);
+    bit_writer(&bp,&bpos,&size,0,4);
+    bit_writer(&bp,&bpos,&size,0,8);
+    bit_writer(&bp,&bpos,&size,0,4);
+    bit_writer(&bp,&bpos,&size,1,1);
+    bit_writer(&bp,&bpos,&size,0,2);
+    bit_writer(&bp,&bpos,&size,1,1);
+    bit_writer(&bp,&bpos,&size,(bsize>>24)&0xff,8);
+    bit_writer(&bp,&bpos,&size,(bsize>>16)&0xff,8);
+    bit_writer(&bp,&bpos,&size,(bsize>>8)&0xff,8);
+    bit_writer(&bp,&bpos,&size,(bsize)&0xff,8);
+
+    ibp = (const uint8_t*) samples;
+    maxibp = ibp + FRAMES * 4 - 4;
+    while (ibp <= maxibp) {
+#ifdef WORDS_BIGENDIAN
+        bit_writer(&bp,&bpos,&size,*(ibp+0),8);
+        bit_writer(&bp,&bpos,&size,*(ibp+1),8);
+        bit_writer(&bp,&bpos,&size,*(ibp+2),8);
+        bit_writer(&bp,&bpos,&size,*(ibp+3),8);
+#else
+        bit_writer(&bp,&bpos,&size,*(ibp+1),8);
+        bit_writer(&bp,&bpos,&size,*(ibp+0),8);
+        bit_writer(&bp,&bpos,&size,*(ibp+3),8);
+        bit_writer(&bp,&bpos,&size,*(ibp+2),8);
+#endif
+        ibp += 4;
+    }
+
+    len = size + HEADER_SIZE - 4;
+    b[2] = len >> 8;
+    b[3] = len & 0xff;
+
+    memcpy(nv, iv, sizeof(nv));
+    for (i = 0; i + PA_RAOP_AES_BLOCK_SIZE <= size; i += PA_RAOP_AES_BLOCK_SIZE) {
+        uint8_t *buf = b + HEADER_SIZE + i;
+
+        for (j = 0; j < PA_RAOP_AES_BLOCK_SIZE; j++)
+            buf[j] ^= nv[j];
+
+        pa_assert_se(EVP_EncryptUpdate(ecb, buf, &l, buf, PA_RAOP_AES_BLOCK_SIZE));
+        memcpy(nv, buf, sizeof(nv));
+    }
+
+    return HEADER_SIZE + size;
+}
+
+static EVP_CIPHER_CTX* reference_cipher_new(void) {
+    EVP_CIPHER_CTX *ecb;
+
+    pa_assert_se(ecb = EVP_CIPHER_CTX_new());
+    pa_assert_se(EVP_EncryptInit_ex(ecb, EVP_aes_128_ecb(), NULL, key, NULL));
+    EVP_CIPHER_CTX_set_padding(ecb, 0);
+
+    return ecb;
+}
+
+START_TEST (encode_test) {
+    pa_mempool *pool;
+    pa_raop_encoder *e;
+    EVP_CIPHER_CTX *ecb;
+    int16_t samples[FRAMES * 2];
+    uint8_t expected[HEADER_SIZE + FRAMES * 4 + 16];
+    unsigned seed;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    e = pa_raop_encoder_new(pool, key, iv);
+    ecb = reference_cipher_new();
+
+    for (seed = 0; seed < 16; seed++) {
+        pa_memchunk raw, encoded;
+        size_t length;
+        uint8_t *d;
+
+        make_chunk(pool, &raw, seed);
+        fill_samples(samples, FRAMES * 2, seed);
+
+        fail_unless(pa_raop_encoder_encode(e, &raw, &encoded) == 0);
+        fail_unless(raw.length == 0);
+
+        /* Byte exact, including the clear text tail */
+        length = reference_encode(ecb, samples, expected);
+        fail_unless(encoded.length == length);
+
+        d = pa_memblock_acquire_chunk(&encoded);
+        fail_unless(memcmp(d, expected, length) == 0);
+        pa_memblock_release(encoded.memblock);
+
+        pa_memblock_unref(raw.memblock);
+        pa_memblock_unref(encoded.memblock);
+    }
+
+    /* Compare the cost of one packet */
+    {
+        pa_memchunk raw, encoded;
+
+        make_chunk(pool, &raw, 0);
+
+        PA_RUNTIME_TEST_RUN_START("new encoder", TIMES, TIMES2) {
+            pa_memchunk r = raw;
+
+            pa_raop_encoder_encode(e, &r, &encoded);
+            pa_memblock_unref(encoded.memblock);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig encoder", TIMES, TIMES2) {
+            reference_encode(ecb, samples, expected);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_memblock_unref(raw.memblock);
+    }
+
+    EVP_CIPHER_CTX_free(ecb);
+    pa_raop_encoder_free(e);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* Stands in for an AirPlay speaker: reads packets off the stream socket,
+ * decrypts them and unpacks the ALAC frame. */
+struct receiver {
+    int fd;
+    unsigned n_packets;
+    unsigned n_bad;
+};
+
+static uint32_t read_bits(const uint8_t *d, size_t *pos, unsigned n) {
+    uint32_t v = 0;
+
+    while (n-- > 0) {
+        v = (v << 1) | ((d[*pos / 8] >> (7 - *pos % 8)) & 1);
+        (*pos)++;
+    }
+
+    return v;
+}
+
+static bool read_all(int fd, uint8_t *d, size_t length) {
+    while (length > 0) {
+        ssize_t r;
+
+        if ((r = read(fd, d, length)) <= 0)
+            return false;
+
+        d += r;
+        length -= (size_t) r;
+    }
+
+    return true;
+}
+
+static void receiver_thread(void *userdata) {
+    struct receiver *r = userdata;
+    EVP_CIPHER_CTX *cbc;
+    uint8_t d[HEADER_SIZE + FRAMES * 4 + 16];
+    int16_t samples[FRAMES * 2];
+
+    pa_assert_se(cbc = EVP_CIPHER_CTX_new());
+
+    for (;;) {
+        size_t length, size, pos = 0;
+        int l;
+        unsigned i;
+
+        if (!read_all(r->fd, d, 4))
+            break;
+
+        length = (((size_t) d[2] << 8) | d[3]) + 4;
+        pa_assert_se(length <= sizeof(d));
+
+        if (!read_all(r->fd, d + 4, length - 4))
+            break;
+
+        size = length - HEADER_SIZE;
+        size -= size % PA_RAOP_AES_BLOCK_SIZE;
+
+        pa_assert_se(EVP_DecryptInit_ex(cbc, EVP_aes_128_cbc(), NULL, key, iv));
+        EVP_CIPHER_CTX_set_padding(cbc, 0);
+        pa_assert_se(EVP_DecryptUpdate(cbc, d + HEADER_SIZE, &l, d + HEADER_SIZE, (int) size));
+
+        fill_samples(samples, FRAMES * 2, r->n_packets);
+
+        if (read_bits(d + HEADER_SIZE, &pos, 3) != 1 ||
+            read_bits(d + HEADER_SIZE, &pos, 16) != 0 ||
+            read_bits(d + HEADER_SIZE, &pos, 4) != 0x9 ||
+            read_bits(d + HEADER_SIZE, &pos, 32) != FRAMES) {
+            r->n_bad++;
+        } else {
+            for (i = 0; i < FRAMES * 2; i++)
+                if ((int16_t) read_bits(d + HEADER_SIZE, &pos, 16) != samples[i]) {
+                    r->n_bad++;
+                    break;
+                }
+        }
+
+        r->n_packets++;
+    }
+
+    EVP_CIPHER_CTX_free(cbc);
+}
+
+START_TEST (stream_test) {
+    pa_mempool *pool;
+    pa_raop_encoder *e;
+    pa_thread *thread;
+    struct receiver r;
+    struct sockaddr_in sa;
+    socklen_t salen = sizeof(sa);
+    int listen_fd, fd;
+    unsigned i;
+    pa_usec_t start, encode_time = 0, total;
+
+    pa_assert_se((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+    pa_zero(sa);
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    pa_assert_se(bind(listen_fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+    pa_assert_se(getsockname(listen_fd, (struct sockaddr*) &sa, &salen) == 0);
+    pa_assert_se(listen(listen_fd, 1) == 0);
+
+    pa_assert_se((fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+    pa_assert_se(connect(fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+
+    pa_zero(r);
+    pa_assert_se((r.fd = accept(listen_fd, NULL, NULL)) >= 0);
+    pa_assert_se(thread = pa_thread_new("raop-receiver", receiver_thread, &r));
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    e = pa_raop_encoder_new(pool, key, iv);
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < PACKETS; i++) {
+        pa_memchunk raw, encoded;
+        pa_usec_t t;
+        uint8_t *d;
+
+        make_chunk(pool, &raw, i);
+
+        t = pa_rtclock_now();
+        fail_unless(pa_raop_encoder_encode(e, &raw, &encoded) == 0);
+        encode_time += pa_rtclock_now() - t;
+
+        d = pa_memblock_acquire_chunk(&encoded);
+        pa_assert_se(pa_loop_write(fd, d, encoded.length, NULL) == (ssize_t) encoded.length);
+        pa_memblock_release(encoded.memblock);
+
+        pa_memblock_unref(raw.memblock);
+        pa_memblock_unref(encoded.memblock);
+    }
+
+    shutdown(fd, SHUT_WR);
+    pa_thread_free(thread);
+
+    total = pa_rtclock_now() - start;
+
+    pa_log_info("%u packets in %0.2f ms, %0.0f packets/s, %0.2f us encoding per packet",
+                r.n_packets, (double) total / PA_USEC_PER_MSEC,
+                (double) r.n_packets * PA_USEC_PER_SEC / total, (double) encode_time / PACKETS);
+
+    fail_unless(r.n_packets == PACKETS);
+    fail_unless(r.n_bad == 0);
+
+    pa_raop_encoder_free(e);
+    pa_mempool_unref(pool);
+    pa_close(r.fd);
+    pa_close(fd);
+    pa_close(listen_fd);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("RAOP");
+    tc = tcase_create("raop");
+    tcase_add_test(tc, encode_test);
+    tcase_add_test(tc, stream_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,227 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <check.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rate-controller.h>
+
+#define BASE_RATE 48000
+#define TARGET_LATENCY (20*PA_USEC_PER_MSEC)
+#define SIMULATION_STEP (5*PA_USEC_PER_MSEC)
+
+struct simulation {
+    /* Relative drift of the writing clock against the reading clock */
+    double drift;
+    /* Peak to peak measurement noise, e.g. caused by block sized buffers */
+    pa_usec_t jitter;
+    pa_usec_t initial_latency;
+    pa_usec_t update_interval;
+    pa_usec_t duration;
+
+    /* Results, evaluated over the last quarter of the run */
+    double max_error;
+    double mean_ratio;
+    double max_step;
+    double max_deviation;
+};
+
+/* Simulates a buffer that is filled by one clock and drained by another one
+ * that runs at the rate chosen by the controller. */
+static void simulate(struct simulation *sim) {
+    pa_rate_controller *c;
+    pa_usec_t now, next_update = 0;
+    double latency = (double) sim->initial_latency;
+    uint32_t rate = BASE_RATE, old_rate = BASE_RATE;
+    double ratio_sum = 0;
+    unsigned n_ratio = 0;
+
+    srand(0);
+
+    sim->max_error = sim->mean_ratio = sim->max_step = sim->max_deviation = 0;
+
+    c = pa_rate_controller_new(BASE_RATE, TARGET_LATENCY, sim->update_interval);
+
+    for (now = 0; now < sim->duration; now += SIMULATION_STEP) {
+        latency += (double) SIMULATION_STEP * ((1.0 + sim->drift) - (double) rate / BASE_RATE);
+
+        if (now >= next_update) {
+            double noise = 0;
+
+            if (sim->jitter > 0)
+                noise = (double) (rand() % (sim->jitter + 1));
+
+            rate = pa_rate_controller_update(c, now, (pa_usec_t) PA_MAX(latency + noise, 0.0));
+
+            sim->max_step = PA_MAX(sim->max_step, fabs((double) rate - (double) old_rate) / old_rate);
+            sim->max_deviation = PA_MAX(sim->max_deviation, fabs((double) rate - BASE_RATE) / BASE_RATE);
+            old_rate = rate;
+
+            pa_log_debug("%0.1f s: latency %0.3f ms, rate %u Hz",
+                         (double) now / PA_USEC_PER_SEC, latency / PA_USEC_PER_MSEC, rate);
+
+            next_update += sim->update_interval;
+        }
+
+        if (now >= sim->duration / 4 * 3) {
+            /* The controller aims at the mean of the noisy measurement */
+            double error = fabs(latency + (double) sim->jitter / 2 - TARGET_LATENCY);
+
+            sim->max_error = PA_MAX(sim->max_error, error);
+            ratio_sum += (double) rate / BASE_RATE;
+            n_ratio++;
+        }
+    }
+
+    sim->mean_ratio = ratio_sum / n_ratio;
+
+    pa_log_debug("drift %0.0f ppm: max error %0.3f ms, mean rate ratio deviation %0.1f ppm, max step %0.1f ppm, max deviation %0.1f ppm",
+                 sim->drift * 1000000, sim->max_error / PA_USEC_PER_MSEC, (sim->mean_ratio - 1.0) * 1000000,
+                 sim->max_step * 1000000, sim->max_deviation * 1000000);
+
+    pa_rate_controller_free(c);
+}
+
+START_TEST (drift_test) {
+    static const double drifts[] = { 0, 50e-6, -50e-6, 300e-6, -300e-6, 2e-3 };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(drifts); i++) {
+        struct simulation sim = {
+            .drift = drifts[i],
+            .jitter = 2 * PA_USEC_PER_MSEC,
+            .initial_latency = TARGET_LATENCY,
+            .update_interval = PA_USEC_PER_SEC,
+            .duration = 600 * PA_USEC_PER_SEC,
+        };
+
+        simulate(&sim);
+
+        /* Latency stays within a couple of milliseconds of the target, which
+         * is well below what a fixed 10 s proportional step achieves. */
+        fail_unless(sim.max_error < 2 * PA_USEC_PER_MSEC);
+
+        /* The integral term has found the clock drift. One Hz at 48 kHz is
+         * about 21 ppm, so allow for the rate quantization. */
+        fail_unless(fabs(sim.mean_ratio - 1.0 - sim.drift) < 25e-6);
+    }
+}
+END_TEST
+
+START_TEST (step_test) {
+    struct simulation sim = {
+        .drift = 100e-6,
+        .jitter = 0,
+        .initial_latency = 500 * PA_USEC_PER_MSEC,
+        .update_interval = PA_USEC_PER_SEC,
+        .duration = 600 * PA_USEC_PER_SEC,
+    };
+
+    simulate(&sim);
+
+    /* A large initial error must neither cause audible steps nor leave the
+     * allowed deviation, and the loop must still settle. */
+    fail_unless(sim.max_step <= 0.002 + 1.0 / BASE_RATE);
+    fail_unless(sim.max_deviation <= 0.01 + 1.0 / BASE_RATE);
+    fail_unless(sim.max_error < 2 * PA_USEC_PER_MSEC);
+}
+END_TEST
+
+START_TEST (interval_test) {
+    static const pa_usec_t intervals[] = { 50 * PA_USEC_PER_MSEC, 200 * PA_USEC_PER_MSEC, 10 * PA_USEC_PER_SEC };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(intervals); i++) {
+        struct simulation sim = {
+            .drift = -150e-6,
+            .jitter = PA_USEC_PER_MSEC,
+            .initial_latency = 40 * PA_USEC_PER_MSEC,
+            .update_interval = intervals[i],
+            .duration = 2000 * PA_USEC_PER_SEC,
+        };
+
+        simulate(&sim);
+
+        fail_unless(sim.max_error < 2 * PA_USEC_PER_MSEC);
+        fail_unless(fabs(sim.mean_ratio - 1.0 - sim.drift) < 25e-6);
+    }
+}
+END_TEST
+
+/* What combine-sink and loopback do when the nominal rate changes or a
+ * stream is moved: the learned correction must not carry over */
+START_TEST (reset_test) {
+    pa_rate_controller *c;
+    pa_usec_t now;
+    uint32_t rate = BASE_RATE;
+
+    c = pa_rate_controller_new(BASE_RATE, TARGET_LATENCY, PA_USEC_PER_SEC);
+
+    /* Too much latency for a while, so the controller speeds up */
+    for (now = 0; now < 60 * PA_USEC_PER_SEC; now += PA_USEC_PER_SEC)
+        rate = pa_rate_controller_update(c, now, TARGET_LATENCY + 50 * PA_USEC_PER_MSEC);
+
+    fail_unless(rate > BASE_RATE);
+    fail_unless(pa_rate_controller_get_base_rate(c) == BASE_RATE);
+
+    pa_rate_controller_reset(c, 44100);
+    fail_unless(pa_rate_controller_get_base_rate(c) == 44100);
+    fail_unless(pa_rate_controller_get_ratio(c) == 1.0);
+
+    /* The first update after a reset only primes the controller */
+    fail_unless(pa_rate_controller_update(c, now, TARGET_LATENCY) == 44100);
+
+    pa_rate_controller_free(c);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Rate Controller");
+    tc = tcase_create("rate-controller");
+    tcase_add_test(tc, drift_test);
+    tcase_add_test(tc, step_test);
+    tcase_add_test(tc, interval_test);
+    tcase_add_test(tc, reset_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
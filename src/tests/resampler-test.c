@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <math.h>
 
 #include <pulse/pulseaudio.h>
 
@@ -37,6 +38,7 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/cpu.h>
 
 static void dump_block(const char *label, const pa_sample_spec *ss, const pa_memchunk *chunk) {
     void *d;
@@ -263,6 +265,7 @@ static void help(const char *argv0) {
            "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
            "      --resample-method=METHOD        Resample method (defaults to auto)\n"
            "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+           "      --quality                       Measure THD+N and speed of the resample methods\n"
            "\n"
            "If the formats are not specified, the test performs all formats combinations,\n"
            "back and forth.\n"
@@ -270,6 +273,9 @@ static void help(const char *argv0) {
            "Sample type must be one of s16le, s16be, u8, float32le, float32be, ulaw, alaw,\n"
            "s24le, s24be, s24-32le, s24-32be, s32le, s32be (defaults to s16ne)\n"
            "\n"
+           "With --quality, all resample methods are measured unless --resample-method is\n"
+           "given, converting a sine tone from float32 at the from rate to the to rate.\n"
+           "\n"
            "See --dump-resample-methods for possible values of resample methods.\n",
            argv0);
 }
@@ -284,7 +290,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_QUALITY
 };
 
 static void dump_resample_methods(void) {
@@ -296,11 +303,115 @@ static void dump_resample_methods(void) {
 
 }
 
+/* Fits a sine of the given frequency to the signal with least squares and
+ * returns the power of what is left relative to it, in dB. */
+static double thd_n(const float *y, unsigned n, double freq, unsigned rate) {
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, det, a, b, sig = 0, res = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        double s = sin(2 * M_PI * freq * i / rate), c = cos(2 * M_PI * freq * i / rate);
+
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += y[i] * s;
+        yc += y[i] * c;
+    }
+
+    det = ss * cc - sc * sc;
+    a = (ys * cc - yc * sc) / det;
+    b = (yc * ss - ys * sc) / det;
+
+    for (i = 0; i < n; i++) {
+        double f = a * sin(2 * M_PI * freq * i / rate) + b * cos(2 * M_PI * freq * i / rate);
+
+        sig += f * f;
+        res += (y[i] - f) * (y[i] - f);
+    }
+
+    return 10 * log10(res / sig);
+}
+
+/* Resamples a sine tone in 20 ms blocks, like a sink input would, and
+ * reports the distortion at the output and the time that took */
+static void quality_test(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b, pa_resample_method_t method, int seconds) {
+    static const double freqs[] = { 1000, 10000, 18000 };
+    pa_sample_spec fa = *a, fb = *b;
+    pa_resampler *resampler;
+    unsigned f, in_frames, block_frames, out_max, n_out, i, c;
+    float *out;
+    pa_usec_t t = 0;
+
+    fa.format = fb.format = PA_SAMPLE_FLOAT32NE;
+    fb.channels = fa.channels;
+
+    in_frames = seconds * fa.rate;
+    block_frames = fa.rate / 50;
+    out_max = (uint64_t) in_frames * fb.rate / fa.rate + fb.rate;
+    out = pa_xnew(float, out_max);
+
+    printf("%-24s", pa_resample_method_to_string(method));
+
+    for (f = 0; f < PA_ELEMENTSOF(freqs); f++) {
+        pa_memchunk in, res;
+        unsigned pos = 0;
+        pa_usec_t ts;
+
+        if (freqs[f] > 0.45 * PA_MIN(fa.rate, fb.rate)) {
+            printf("                ");
+            continue;
+        }
+
+        pa_assert_se(resampler = pa_resampler_new(pool, &fa, NULL, &fb, NULL, 0, method, 0));
+
+        in.memblock = pa_memblock_new(pool, block_frames * pa_frame_size(&fa));
+        in.index = 0;
+        in.length = block_frames * pa_frame_size(&fa);
+
+        n_out = 0;
+        while (pos < in_frames) {
+            float *d = pa_memblock_acquire(in.memblock);
+
+            for (i = 0; i < block_frames; i++, pos++)
+                for (c = 0; c < fa.channels; c++)
+                    *d++ = (float) (0.5 * sin(2 * M_PI * freqs[f] * pos / fa.rate));
+
+            pa_memblock_release(in.memblock);
+
+            ts = pa_rtclock_now();
+            pa_resampler_run(resampler, &in, &res);
+            t += pa_rtclock_now() - ts;
+
+            if (res.memblock) {
+                const float *r = (const float *) ((uint8_t *) pa_memblock_acquire(res.memblock) + res.index);
+
+                for (i = 0; i < res.length / pa_frame_size(&fb) && n_out < out_max; i++)
+                    out[n_out++] = r[i * fb.channels];
+
+                pa_memblock_release(res.memblock);
+                pa_memblock_unref(res.memblock);
+            }
+        }
+
+        pa_memblock_unref(in.memblock);
+        pa_resampler_free(resampler);
+
+        /* Skip the start, where the filters are still settling */
+        printf("  %6.1f dB @%2.0fk", n_out > fb.rate / 5 ? thd_n(out + fb.rate / 10, n_out - fb.rate / 10, freqs[f], fb.rate) : 0.0,
+               freqs[f] / 1000);
+    }
+
+    printf("  %8.1fx realtime\n", (double) seconds * PA_ELEMENTSOF(freqs) * PA_USEC_PER_SEC / PA_MAX(t, 1));
+
+    pa_xfree(out);
+}
+
 int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    bool all_formats = true;
+    bool all_formats = true, quality = false;
     pa_resample_method_t method;
     int seconds;
     unsigned crossover_freq = 120;
@@ -318,6 +429,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"quality",               0, NULL, ARG_QUALITY},
         {NULL,                    0, NULL, 0}
     };
 
@@ -389,6 +501,10 @@ int main(int argc, char *argv[]) {
                 seconds = atoi(optarg);
                 break;
 
+            case ARG_QUALITY:
+                quality = true;
+                break;
+
             case ARG_RESAMPLE_METHOD:
                 if (*optarg == '\0' || pa_streq(optarg, "help")) {
                     dump_resample_methods();
@@ -404,7 +520,31 @@ int main(int argc, char *argv[]) {
     }
 
     ret = 0;
-    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false));
+
+    if (quality) {
+        pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+        int m;
+
+        /* Use the optimized code paths, like the daemon does */
+        pa_cpu_init(&cpu_info);
+
+        printf("%u Hz -> %u Hz, THD+N for sine tones:\n", a.rate, b.rate);
+
+        for (m = 0; m < PA_RESAMPLER_MAX; m++) {
+            if (method != PA_RESAMPLER_AUTO && m != (int) method)
+                continue;
+
+            /* These can't convert between arbitrary rates */
+            if (m == PA_RESAMPLER_AUTO || m == PA_RESAMPLER_COPY || m == PA_RESAMPLER_PEAKS ||
+                !pa_resample_method_supported(m))
+                continue;
+
+            quality_test(pool, &a, &b, m, seconds);
+        }
+
+        goto quit;
+    }
 
     if (!all_formats) {
 
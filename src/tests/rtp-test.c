@@ -0,0 +1,369 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/arpa-inet.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/poll.h>
+
+#include "rtp.h"
+
+#define MULTICAST_ADDRESS "239.255.42.42"
+#define PAYLOAD 127
+#define MTU 1280
+#define PACKETS_PER_ROUND 64
+#define ROUNDS 500
+
+/* 8 channels of s16 is what we typically multicast */
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16BE,
+    .rate = 48000,
+    .channels = 8
+};
+
+struct setup {
+    int send_fd, recv_fd;
+    struct sockaddr_in sa;
+};
+
+static int open_sockets(struct setup *s, bool multicast) {
+    struct sockaddr_in bind_sa;
+    socklen_t len = sizeof(bind_sa);
+    int one = 1, size = 4 * 1024 * 1024;
+
+    pa_assert_se((s->recv_fd = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    pa_assert_se((s->send_fd = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+
+    pa_zero(bind_sa);
+    bind_sa.sin_family = AF_INET;
+    bind_sa.sin_addr.s_addr = htonl(multicast ? INADDR_ANY : INADDR_LOOPBACK);
+
+    pa_assert_se(bind(s->recv_fd, (struct sockaddr*) &bind_sa, sizeof(bind_sa)) == 0);
+    pa_assert_se(getsockname(s->recv_fd, (struct sockaddr*) &bind_sa, &len) == 0);
+    pa_assert_se(setsockopt(s->recv_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) == 0);
+    setsockopt(s->recv_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    pa_zero(s->sa);
+    s->sa.sin_family = AF_INET;
+    s->sa.sin_port = bind_sa.sin_port;
+    s->sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (multicast) {
+        struct ip_mreq mr;
+        struct in_addr iface;
+        unsigned char loop = 1;
+
+        pa_zero(mr);
+        inet_pton(AF_INET, MULTICAST_ADDRESS, &mr.imr_multiaddr);
+        mr.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (setsockopt(s->recv_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr, sizeof(mr)) < 0)
+            goto fail;
+
+        iface.s_addr = htonl(INADDR_LOOPBACK);
+        if (setsockopt(s->send_fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) < 0 ||
+            setsockopt(s->send_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0)
+            goto fail;
+
+        s->sa.sin_addr = mr.imr_multiaddr;
+    }
+
+    if (connect(s->send_fd, (struct sockaddr*) &s->sa, sizeof(s->sa)) < 0)
+        goto fail;
+
+    if (multicast) {
+        /* Multicast on the loopback device is not available everywhere, so
+         * check that a probe packet actually arrives */
+        struct pollfd pfd = { .fd = s->recv_fd, .events = POLLIN };
+        char probe = 0;
+
+        if (send(s->send_fd, &probe, 1, 0) != 1 || pa_poll(&pfd, 1, 200) != 1)
+            goto fail;
+
+        pa_assert_se(recv(s->recv_fd, &probe, 1, 0) == 1);
+    }
+
+    return 0;
+
+fail:
+    pa_close(s->send_fd);
+    pa_close(s->recv_fd);
+    return -1;
+}
+
+static void fill_queue(pa_memblockq *q, pa_mempool *pool, uint16_t *counter, size_t length) {
+    pa_memchunk chunk;
+    uint16_t *d;
+    size_t i;
+
+    chunk.memblock = pa_memblock_new(pool, length);
+    chunk.index = 0;
+    chunk.length = length;
+
+    d = pa_memblock_acquire(chunk.memblock);
+    for (i = 0; i < length / sizeof(uint16_t); i++)
+        d[i] = (*counter)++;
+    pa_memblock_release(chunk.memblock);
+
+    pa_assert_se(pa_memblockq_push(q, &chunk) == 0);
+    pa_memblock_unref(chunk.memblock);
+}
+
+static void run(bool multicast) {
+    struct setup s;
+    pa_rtp_context send_ctx, recv_ctx;
+    pa_mempool *pool;
+    pa_memblockq *q;
+    size_t payload_size = pa_frame_align(MTU - 12, &ss);
+    uint16_t send_counter = 0, recv_counter = 0, expected_seq = 0;
+    uint32_t expected_ts = 0;
+    unsigned round, received = 0;
+    pa_usec_t start, send_time = 0, recv_time = 0;
+    bool first = true;
+
+    if (open_sockets(&s, multicast) < 0) {
+        pa_log_info("Multicast over the loopback device is not available, skipping.");
+        return;
+    }
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    q = pa_memblockq_new("rtp-test memblockq", 0, 4 * 1024 * 1024, 0, &ss, 1, 1, 0, NULL);
+
+    pa_rtp_context_init_send(&send_ctx, s.send_fd, 0, PAYLOAD, pa_frame_size(&ss));
+    pa_rtp_context_init_recv(&recv_ctx, s.recv_fd, pa_frame_size(&ss));
+
+    for (round = 0; round < ROUNDS; round++) {
+        unsigned n;
+
+        for (n = 0; n < PACKETS_PER_ROUND; n += 8)
+            fill_queue(q, pool, &send_counter, payload_size * 8);
+
+        start = pa_rtclock_now();
+        fail_unless(pa_rtp_send(&send_ctx, payload_size, q) == 0);
+        send_time += pa_rtclock_now() - start;
+
+        start = pa_rtclock_now();
+
+        for (n = 0; n < PACKETS_PER_ROUND;) {
+            struct pollfd pfd = { .fd = s.recv_fd, .events = POLLIN };
+            pa_memchunk chunk;
+            struct timeval tv;
+
+            if (!pa_rtp_recv_pending(&recv_ctx) && pa_poll(&pfd, 1, 1000) != 1)
+                break;
+
+            if (pa_rtp_recv(&recv_ctx, &chunk, pool, &tv) < 0)
+                continue;
+
+            if (first) {
+                expected_seq = recv_ctx.sequence;
+                expected_ts = recv_ctx.timestamp;
+                first = false;
+            }
+
+            /* Nothing got lost or reordered on the way */
+            fail_unless(recv_ctx.payload == PAYLOAD);
+            fail_unless(recv_ctx.sequence == expected_seq);
+            fail_unless(recv_ctx.timestamp == expected_ts);
+            fail_unless(chunk.length == payload_size);
+
+            if (chunk.length == payload_size) {
+                uint16_t *d = pa_memblock_acquire_chunk(&chunk);
+                size_t i;
+
+                for (i = 0; i < chunk.length / sizeof(uint16_t); i++)
+                    fail_unless(d[i] == recv_counter++);
+
+                pa_memblock_release(chunk.memblock);
+            }
+
+            pa_memblock_unref(chunk.memblock);
+
+            expected_seq++;
+            expected_ts += (uint32_t) (payload_size / pa_frame_size(&ss));
+            n++;
+        }
+
+        recv_time += pa_rtclock_now() - start;
+        received += n;
+
+        fail_unless(n == PACKETS_PER_ROUND);
+    }
+
+    pa_log_info("%s: %u packets of %zu bytes, send %0.2f us/packet, receive %0.2f us/packet",
+                multicast ? "Multicast" : "Unicast", received, payload_size,
+                (double) send_time / received, (double) recv_time / received);
+
+    pa_rtp_context_destroy(&send_ctx);
+    pa_rtp_context_destroy(&recv_ctx);
+    pa_memblockq_free(q);
+    pa_mempool_unref(pool);
+}
+
+/* A packet that is larger than the first one of its batch does not fit
+ * its slot. It is dropped, but the next batch makes room for it. */
+START_TEST (rtp_truncation_test) {
+    struct setup s;
+    pa_rtp_context send_ctx, recv_ctx;
+    pa_mempool *pool;
+    pa_memblockq *q;
+    size_t small_size = pa_frame_align(96, &ss), payload_size = pa_frame_align(MTU - 12, &ss);
+    uint16_t counter = 0;
+    unsigned i;
+    int r[3];
+
+    pa_assert_se(open_sockets(&s, false) == 0);
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    q = pa_memblockq_new("rtp-test memblockq", 0, 4 * 1024 * 1024, 0, &ss, 1, 1, 0, NULL);
+
+    pa_rtp_context_init_send(&send_ctx, s.send_fd, 0, PAYLOAD, pa_frame_size(&ss));
+    pa_rtp_context_init_recv(&recv_ctx, s.recv_fd, pa_frame_size(&ss));
+
+    for (i = 0; i < 3; i++) {
+        struct pollfd pfd = { .fd = s.recv_fd, .events = POLLIN };
+        pa_memchunk chunk;
+        struct timeval tv;
+
+        if (i == 0) {
+            fill_queue(q, pool, &counter, small_size);
+            fail_unless(pa_rtp_send(&send_ctx, small_size, q) == 0);
+        }
+
+        if (i != 1) {
+            fill_queue(q, pool, &counter, payload_size);
+            fail_unless(pa_rtp_send(&send_ctx, payload_size, q) == 0);
+        }
+
+        fail_unless(pa_rtp_recv_pending(&recv_ctx) || pa_poll(&pfd, 1, 1000) == 1);
+
+        if ((r[i] = pa_rtp_recv(&recv_ctx, &chunk, pool, &tv)) < 0)
+            continue;
+
+        fail_unless(chunk.length == (i == 0 ? small_size : payload_size));
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    fail_unless(r[0] == 0);
+    fail_unless(r[1] < 0);
+    fail_unless(r[2] == 0);
+    fail_unless(recv_ctx.sequence == (uint16_t) (send_ctx.sequence - 1));
+
+    pa_rtp_context_destroy(&send_ctx);
+    pa_rtp_context_destroy(&recv_ctx);
+    pa_memblockq_free(q);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* Packets that do not fit into a full socket buffer are dropped right away
+ * and counted, the sequence numbers of the rest stay consecutive. */
+START_TEST (rtp_full_buffer_test) {
+    int fds[2];
+    pa_rtp_context send_ctx;
+    pa_mempool *pool;
+    pa_memblockq *q;
+    size_t payload_size = pa_frame_align(MTU - 12, &ss);
+    uint16_t counter = 0, start;
+    uint64_t received = 0;
+    uint32_t buf[MTU / 4];
+    unsigned i;
+    int r = 0;
+
+    pa_assert_se(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true, false);
+    q = pa_memblockq_new("rtp-test memblockq", 0, 4 * 1024 * 1024, 0, &ss, 1, 1, 0, NULL);
+
+    pa_rtp_context_init_send(&send_ctx, fds[0], 0, PAYLOAD, pa_frame_size(&ss));
+    start = send_ctx.sequence;
+
+    /* Nobody reads from fds[1], so sooner or later the buffer is full */
+    for (i = 0; i < 100000 && r == 0; i++) {
+        fill_queue(q, pool, &counter, 4 * payload_size);
+        r = pa_rtp_send(&send_ctx, payload_size, q);
+    }
+
+    fail_unless(r < 0);
+    fail_unless(send_ctx.dropped > 0);
+
+    while (recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+        fail_unless((uint16_t) (ntohl(buf[0]) & 0xFFFF) == (uint16_t) (start + received));
+        received++;
+    }
+
+    fail_unless((uint16_t) (received + send_ctx.dropped) == (uint16_t) (send_ctx.sequence - start));
+
+    pa_rtp_context_destroy(&send_ctx);
+    pa_memblockq_free(q);
+    pa_mempool_unref(pool);
+    pa_close(fds[1]);
+}
+END_TEST
+
+START_TEST (rtp_multicast_test) {
+    run(true);
+}
+END_TEST
+
+START_TEST (rtp_unicast_test) {
+    run(false);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("RTP");
+    tc = tcase_create("rtp");
+    tcase_add_test(tc, rtp_multicast_test);
+    tcase_add_test(tc, rtp_unicast_test);
+    tcase_add_test(tc, rtp_truncation_test);
+    tcase_add_test(tc, rtp_full_buffer_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
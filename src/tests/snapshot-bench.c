@@ -0,0 +1,407 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Introspection benchmark: fills the sample cache of a daemon with a
+ * number of samples, and then compares how long it takes to get the whole
+ * state of the daemon with one request per kind of object, as pactl list
+ * does, with how long it takes with a single snapshot request, and with a
+ * snapshot of what changed since the previous one.
+ *
+ * The results are printed to stdout one per line, as
+ * "<label> <metric> <value>", like e2e-bench does. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/macro.h>
+
+/* The kinds of requests that are compared */
+enum method {
+    METHOD_MULTI,
+    METHOD_SNAPSHOT,
+    METHOD_DELTA,
+    METHOD_MAX
+};
+
+static const char * const method_names[METHOD_MAX] = {
+    [METHOD_MULTI] = "multi_request",
+    [METHOD_SNAPSHOT] = "snapshot",
+    [METHOD_DELTA] = "snapshot_delta"
+};
+
+/* What a sample consists of, it only needs to exist */
+static const pa_sample_spec sample_spec = { PA_SAMPLE_S16LE, 44100, 2 };
+static const int16_t sample_data[2] = { 0, 0 };
+
+static pa_mainloop *mainloop = NULL;
+static pa_context *context = NULL;
+
+static unsigned n_samples = 2000, n_uploaded = 0, n_removed = 0;
+static unsigned n_rounds = 100, round_number = 0;
+static const char *label = "default";
+
+static enum method method = METHOD_MULTI;
+static unsigned pending_operations = 0;
+static pa_usec_t start_time;
+static uint64_t generation = 0;
+static unsigned n_objects[METHOD_MAX];
+
+static pa_histogram request_usec[METHOD_MAX];
+
+static void quit(int ret) {
+    pa_mainloop_quit(mainloop, ret);
+}
+
+static void print_value(const char *metric, const char *format, ...) PA_GCC_PRINTF_ATTR(2,3);
+
+static void print_value(const char *metric, const char *format, ...) {
+    va_list ap;
+
+    printf("%s %s ", label, metric);
+
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+
+    printf("\n");
+}
+
+static void print_histogram(const char *metric, const pa_histogram *h) {
+    char name[128];
+
+    if (h->count == 0)
+        return;
+
+    pa_snprintf(name, sizeof(name), "%s_mean", metric);
+    print_value(name, "%" PRIu64, h->sum / h->count);
+    pa_snprintf(name, sizeof(name), "%s_p50", metric);
+    print_value(name, "%" PRIu64, pa_histogram_quantile(h, 0.5));
+    pa_snprintf(name, sizeof(name), "%s_p99", metric);
+    print_value(name, "%" PRIu64, pa_histogram_quantile(h, 0.99));
+    pa_snprintf(name, sizeof(name), "%s_max", metric);
+    print_value(name, "%" PRIu64, h->max);
+}
+
+static void print_results(void) {
+    char name[128];
+    unsigned m;
+
+    print_value("samples", "%u", n_samples);
+    print_value("rounds", "%u", n_rounds);
+
+    for (m = 0; m < METHOD_MAX; m++) {
+        pa_snprintf(name, sizeof(name), "%s_objects", method_names[m]);
+        print_value(name, "%u", n_objects[m]);
+        pa_snprintf(name, sizeof(name), "%s_usec", method_names[m]);
+        print_histogram(name, &request_usec[m]);
+    }
+}
+
+static void remove_sample_cb(pa_context *c, int success, void *userdata) {
+    if (!success) {
+        fprintf(stderr, "Failed to remove a sample: %s\n", pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    if (++n_removed == n_samples)
+        quit(0);
+}
+
+/* Leaves the sample cache the way we found it */
+static void remove_samples(void) {
+    unsigned i;
+
+    for (i = 0; i < n_samples; i++) {
+        char name[64];
+
+        pa_snprintf(name, sizeof(name), "snapshot-bench-%u", i);
+        pa_operation_unref(pa_context_remove_sample(context, name, remove_sample_cb, NULL));
+    }
+}
+
+static void run_request(void);
+
+static void request_done(void) {
+    pa_assert(pending_operations > 0);
+
+    if (--pending_operations > 0)
+        return;
+
+    pa_histogram_add(&request_usec[method], pa_rtclock_now() - start_time);
+
+    if (++method == METHOD_MAX) {
+        method = METHOD_MULTI;
+
+        if (++round_number == n_rounds) {
+            print_results();
+
+            if (n_samples > 0)
+                remove_samples();
+            else
+                quit(0);
+
+            return;
+        }
+    }
+
+    run_request();
+}
+
+static void server_info_cb(pa_context *c, const pa_server_info *i, void *userdata) {
+    if (!i) {
+        fprintf(stderr, "Failed to get server info: %s\n", pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    n_objects[METHOD_MULTI]++;
+    request_done();
+}
+
+/* All list callbacks are the same, apart from the type of the object */
+#define LIST_CB(name, type)                                                           \
+    static void name(pa_context *c, const type *i, int eol, void *userdata) {        \
+        if (eol < 0) {                                                                \
+            fprintf(stderr, "Failed to get a list: %s\n", pa_strerror(pa_context_errno(c))); \
+            quit(1);                                                                  \
+            return;                                                                   \
+        }                                                                             \
+                                                                                      \
+        if (eol) {                                                                    \
+            request_done();                                                           \
+            return;                                                                   \
+        }                                                                             \
+                                                                                      \
+        n_objects[METHOD_MULTI]++;                                                    \
+    }
+
+LIST_CB(module_info_cb, pa_module_info)
+LIST_CB(client_info_cb, pa_client_info)
+LIST_CB(card_info_cb, pa_card_info)
+LIST_CB(sink_info_cb, pa_sink_info)
+LIST_CB(source_info_cb, pa_source_info)
+LIST_CB(sink_input_info_cb, pa_sink_input_info)
+LIST_CB(source_output_info_cb, pa_source_output_info)
+LIST_CB(sample_info_cb, pa_sample_info)
+
+static void snapshot_cb(pa_context *c, const pa_snapshot_info *i, void *userdata) {
+    if (!i) {
+        fprintf(stderr, "Failed to get a snapshot: %s\n", pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    n_objects[method] = (i->server_info ? 1 : 0) +
+        i->n_modules + i->n_clients + i->n_cards + i->n_sinks + i->n_sources +
+        i->n_sink_inputs + i->n_source_outputs + i->n_samples;
+
+    generation = i->generation;
+    request_done();
+}
+
+/* Like pactl list, all requests are sent at once, and the replies come
+ * in one after the other */
+static void run_request(void) {
+    start_time = pa_rtclock_now();
+
+    switch (method) {
+        case METHOD_MULTI:
+            n_objects[METHOD_MULTI] = 0;
+            pending_operations = 9;
+
+            pa_operation_unref(pa_context_get_server_info(context, server_info_cb, NULL));
+            pa_operation_unref(pa_context_get_module_info_list(context, module_info_cb, NULL));
+            pa_operation_unref(pa_context_get_client_info_list(context, client_info_cb, NULL));
+            pa_operation_unref(pa_context_get_card_info_list(context, card_info_cb, NULL));
+            pa_operation_unref(pa_context_get_sink_info_list(context, sink_info_cb, NULL));
+            pa_operation_unref(pa_context_get_source_info_list(context, source_info_cb, NULL));
+            pa_operation_unref(pa_context_get_sink_input_info_list(context, sink_input_info_cb, NULL));
+            pa_operation_unref(pa_context_get_source_output_info_list(context, source_output_info_cb, NULL));
+            pa_operation_unref(pa_context_get_sample_info_list(context, sample_info_cb, NULL));
+            break;
+
+        case METHOD_SNAPSHOT:
+            pending_operations = 1;
+            pa_operation_unref(pa_context_get_snapshot(context, 0, snapshot_cb, NULL));
+            break;
+
+        case METHOD_DELTA:
+            pending_operations = 1;
+            pa_operation_unref(pa_context_get_snapshot(context, generation, snapshot_cb, NULL));
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void upload_next_sample(void);
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+    switch (pa_stream_get_state(s)) {
+        case PA_STREAM_CREATING:
+            break;
+
+        case PA_STREAM_READY:
+            pa_stream_write(s, sample_data, sizeof(sample_data), NULL, 0, PA_SEEK_RELATIVE);
+            pa_stream_finish_upload(s);
+            break;
+
+        case PA_STREAM_TERMINATED:
+            pa_stream_unref(s);
+
+            if (++n_uploaded < n_samples) {
+                upload_next_sample();
+                break;
+            }
+
+            fprintf(stderr, "Uploaded %u samples, benchmarking.\n", n_uploaded);
+            run_request();
+            break;
+
+        case PA_STREAM_FAILED:
+        default:
+            fprintf(stderr, "Stream error: %s\n", pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+            quit(1);
+    }
+}
+
+static void upload_next_sample(void) {
+    pa_stream *s;
+    char name[64];
+
+    pa_snprintf(name, sizeof(name), "snapshot-bench-%u", n_uploaded);
+    pa_assert_se(s = pa_stream_new(context, name, &sample_spec, NULL));
+    pa_stream_set_state_callback(s, stream_state_cb, NULL);
+    pa_assert_se(pa_stream_connect_upload(s, sizeof(sample_data)) >= 0);
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+        case PA_CONTEXT_TERMINATED:
+            break;
+
+        case PA_CONTEXT_READY:
+            if (n_samples == 0)
+                run_request();
+            else
+                upload_next_sample();
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Connection failure: %s\n", pa_strerror(pa_context_errno(c)));
+            quit(1);
+    }
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "  -h, --help                 Show this help\n"
+           "  -s, --server=SERVER        The name of the server to connect to\n"
+           "  -n, --samples=N            Number of samples to fill the cache with (default 2000)\n"
+           "  -r, --rounds=N             How often every request is timed (default 100)\n"
+           "      --label=LABEL          First column of the output\n",
+           argv0);
+}
+
+enum {
+    ARG_LABEL = 256
+};
+
+int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"help",         0, NULL, 'h'},
+        {"server",       1, NULL, 's'},
+        {"samples",      1, NULL, 'n'},
+        {"rounds",       1, NULL, 'r'},
+        {"label",        1, NULL, ARG_LABEL},
+        {NULL,           0, NULL, 0}
+    };
+
+    const char *server = NULL;
+    int c, ret = 1;
+
+    while ((c = getopt_long(argc, argv, "hs:n:r:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                return 0;
+
+            case 's':
+                server = optarg;
+                break;
+
+            case 'n':
+                if (pa_atou(optarg, &n_samples) < 0) {
+                    fprintf(stderr, "Invalid number of samples: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'r':
+                if (pa_atou(optarg, &n_rounds) < 0 || n_rounds == 0) {
+                    fprintf(stderr, "Invalid number of rounds: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case ARG_LABEL:
+                label = optarg;
+                break;
+
+            default:
+                help(argv[0]);
+                return 1;
+        }
+    }
+
+    mainloop = pa_mainloop_new();
+    pa_assert_se(context = pa_context_new(pa_mainloop_get_api(mainloop), "snapshot-bench"));
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+
+    if (pa_context_connect(context, server, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
+        fprintf(stderr, "pa_context_connect() failed: %s\n", pa_strerror(pa_context_errno(context)));
+        goto finish;
+    }
+
+    pa_mainloop_run(mainloop, &ret);
+
+finish:
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(mainloop);
+
+    return ret;
+}
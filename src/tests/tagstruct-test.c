@@ -0,0 +1,285 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <check.h>
+
+#include <pulse/proplist.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/tagstruct.h>
+
+#define N_BENCH_COMMANDS 100000
+
+/* How many packets are in flight at once, like in the send queue of a
+ * pstream */
+#define N_BENCH_BATCH 16
+
+/* Objects in one reply to a list request, and how many of these are
+ * put together */
+#define N_BENCH_LIST_OBJECTS 2000
+#define N_BENCH_LISTS 20
+
+/* Writes n values, so that the tagstruct ends up in the appended buffer,
+ * in a pooled packet or in a buffer of its own depending on n */
+static void put_values(pa_tagstruct *t, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        char s[32];
+
+        pa_snprintf(s, sizeof(s), "value %u", i);
+        pa_tagstruct_putu32(t, i);
+        pa_tagstruct_puts(t, s);
+        pa_tagstruct_putu64(t, (uint64_t) i << 32);
+        pa_tagstruct_put_boolean(t, i % 2);
+    }
+}
+
+static void check_values(pa_tagstruct *t, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        char expected[32];
+        const char *s;
+        uint32_t u32;
+        uint64_t u64;
+        bool b;
+
+        pa_snprintf(expected, sizeof(expected), "value %u", i);
+        fail_unless(pa_tagstruct_getu32(t, &u32) == 0);
+        fail_unless(u32 == i);
+        fail_unless(pa_tagstruct_gets(t, &s) == 0);
+        fail_unless(pa_streq(s, expected));
+        fail_unless(pa_tagstruct_getu64(t, &u64) == 0);
+        fail_unless(u64 == (uint64_t) i << 32);
+        fail_unless(pa_tagstruct_get_boolean(t, &b) == 0);
+        fail_unless(b == (i % 2));
+    }
+
+    fail_unless(pa_tagstruct_eof(t));
+}
+
+START_TEST (tagstruct_test) {
+    static const unsigned sizes[] = { 1, 4, 100, 1000, 10000 };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++) {
+        pa_tagstruct *t, *copy;
+        pa_packet *p;
+        const uint8_t *data, *packet_data;
+        size_t length, packet_length;
+
+        t = pa_tagstruct_new();
+        put_values(t, sizes[i]);
+
+        data = pa_tagstruct_data(t, &length);
+        check_values(copy = pa_tagstruct_new_fixed(data, length), sizes[i]);
+        pa_tagstruct_free(copy);
+
+        /* The packet has to carry the same data, however it was stored */
+        p = pa_tagstruct_to_packet_free(t);
+        packet_data = pa_packet_data(p, &packet_length);
+        fail_unless(packet_length == length);
+
+        check_values(copy = pa_tagstruct_new_fixed(packet_data, packet_length), sizes[i]);
+        pa_tagstruct_free(copy);
+
+        pa_packet_unref(p);
+    }
+}
+END_TEST
+
+/* Roughly what the reply to GET_SINK_INPUT_INFO carries */
+static void put_command(pa_tagstruct *t, uint32_t tag, pa_proplist *proplist) {
+    pa_sample_spec ss = { PA_SAMPLE_S16LE, 44100, 2 };
+    pa_channel_map map;
+    pa_cvolume volume;
+
+    pa_channel_map_init_stereo(&map);
+    pa_cvolume_set(&volume, 2, PA_VOLUME_NORM);
+
+    pa_tagstruct_putu32(t, 2); /* PA_COMMAND_REPLY */
+    pa_tagstruct_putu32(t, tag);
+    pa_tagstruct_putu32(t, 42);
+    pa_tagstruct_puts(t, "Playback Stream");
+    pa_tagstruct_putu32(t, 3);
+    pa_tagstruct_putu32(t, 7);
+    pa_tagstruct_putu32(t, 0);
+    pa_tagstruct_put_sample_spec(t, &ss);
+    pa_tagstruct_put_channel_map(t, &map);
+    pa_tagstruct_put_cvolume(t, &volume);
+    pa_tagstruct_put_usec(t, 20000);
+    pa_tagstruct_put_usec(t, 40000);
+    pa_tagstruct_puts(t, "speex-float-1");
+    pa_tagstruct_puts(t, "protocol-native.c");
+    pa_tagstruct_put_boolean(t, false);
+    pa_tagstruct_put_proplist(t, proplist);
+    pa_tagstruct_put_boolean(t, false);
+    pa_tagstruct_put_boolean(t, true);
+    pa_tagstruct_put_boolean(t, true);
+}
+
+static void get_command(pa_tagstruct *t, pa_proplist *proplist) {
+    uint32_t command, tag, idx, module, client, sink;
+    const char *name, *resample_method, *driver;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_cvolume volume;
+    pa_usec_t buffer_usec, sink_usec;
+    bool mute, corked, has_volume, volume_writable;
+
+    fail_unless(pa_tagstruct_getu32(t, &command) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &tag) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &idx) == 0);
+    fail_unless(pa_tagstruct_gets(t, &name) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &module) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &client) == 0);
+    fail_unless(pa_tagstruct_getu32(t, &sink) == 0);
+    fail_unless(pa_tagstruct_get_sample_spec(t, &ss) == 0);
+    fail_unless(pa_tagstruct_get_channel_map(t, &map) == 0);
+    fail_unless(pa_tagstruct_get_cvolume(t, &volume) == 0);
+    fail_unless(pa_tagstruct_get_usec(t, &buffer_usec) == 0);
+    fail_unless(pa_tagstruct_get_usec(t, &sink_usec) == 0);
+    fail_unless(pa_tagstruct_gets(t, &resample_method) == 0);
+    fail_unless(pa_tagstruct_gets(t, &driver) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &mute) == 0);
+    fail_unless(pa_tagstruct_get_proplist(t, proplist) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &corked) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &has_volume) == 0);
+    fail_unless(pa_tagstruct_get_boolean(t, &volume_writable) == 0);
+    fail_unless(pa_tagstruct_eof(t));
+}
+
+START_TEST (tagstruct_bench) {
+    pa_proplist *proplist, *parsed;
+    pa_packet *packets[N_BENCH_BATCH];
+    pa_usec_t start, encode_usec = 0, decode_usec = 0, list_usec;
+    size_t length = 0;
+    unsigned i, j;
+
+    proplist = pa_proplist_new();
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_NAME, "Music Player");
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_ID, "org.example.MusicPlayer");
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_ICON_NAME, "audio-player");
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_PROCESS_ID, "1000");
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_PROCESS_BINARY, "music-player");
+    pa_proplist_sets(proplist, PA_PROP_MEDIA_NAME, "Track 1");
+    pa_proplist_sets(proplist, PA_PROP_MEDIA_ROLE, "music");
+    pa_proplist_sets(proplist, "native-protocol.peer", "UNIX socket client");
+
+    parsed = pa_proplist_new();
+
+    for (i = 0; i < N_BENCH_COMMANDS; i += N_BENCH_BATCH) {
+        /* Like pa_pstream_send_tagstruct(), which hands the packet over
+         * to the pstream */
+        start = pa_rtclock_now();
+
+        for (j = 0; j < N_BENCH_BATCH; j++) {
+            pa_tagstruct *t = pa_tagstruct_new();
+
+            put_command(t, i + j, proplist);
+            packets[j] = pa_tagstruct_to_packet_free(t);
+        }
+
+        encode_usec += pa_rtclock_now() - start;
+
+        /* Like pa_pdispatch_run(), which parses the packet in place */
+        start = pa_rtclock_now();
+
+        for (j = 0; j < N_BENCH_BATCH; j++) {
+            const uint8_t *data;
+            size_t l;
+            pa_tagstruct *t;
+
+            data = pa_packet_data(packets[j], &l);
+            t = pa_tagstruct_new_fixed(data, l);
+            get_command(t, parsed);
+            pa_tagstruct_free(t);
+            pa_packet_unref(packets[j]);
+
+            length += l;
+        }
+
+        decode_usec += pa_rtclock_now() - start;
+    }
+
+    fail_unless(pa_streq(pa_proplist_gets(parsed, PA_PROP_MEDIA_ROLE), "music"));
+
+    pa_log_info("Encoded %u commands of %llu bytes in %llu ms, %0.0f commands/s",
+                N_BENCH_COMMANDS, (unsigned long long) (length / N_BENCH_COMMANDS),
+                (unsigned long long) encode_usec / PA_USEC_PER_MSEC,
+                (double) N_BENCH_COMMANDS * PA_USEC_PER_SEC / PA_MAX(encode_usec, 1U));
+    pa_log_info("Decoded %u commands in %llu ms, %0.0f commands/s",
+                N_BENCH_COMMANDS, (unsigned long long) decode_usec / PA_USEC_PER_MSEC,
+                (double) N_BENCH_COMMANDS * PA_USEC_PER_SEC / PA_MAX(decode_usec, 1U));
+
+    /* Large replies like those to GET_SINK_INPUT_INFO_LIST are put
+     * together from many small values */
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_BENCH_LISTS; i++) {
+        pa_tagstruct *t = pa_tagstruct_new();
+
+        for (j = 0; j < N_BENCH_LIST_OBJECTS; j++)
+            put_command(t, j, proplist);
+
+        pa_packet_unref(pa_tagstruct_to_packet_free(t));
+    }
+
+    list_usec = pa_rtclock_now() - start;
+
+    pa_log_info("Encoded %u replies of %u objects in %llu ms, %0.2f ms each",
+                N_BENCH_LISTS, N_BENCH_LIST_OBJECTS, (unsigned long long) list_usec / PA_USEC_PER_MSEC,
+                (double) list_usec / N_BENCH_LISTS / PA_USEC_PER_MSEC);
+
+    pa_proplist_free(parsed);
+    pa_proplist_free(proplist);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Tagstruct");
+    tc = tcase_create("tagstruct");
+    tcase_add_test(tc, tagstruct_test);
+    tcase_add_test(tc, tagstruct_bench);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -532,6 +532,80 @@ static void get_client_info_callback(pa_context *c, const pa_client_info *i, int
     pa_xfree(pl);
 }
 
+/* Returns the upper bound of the bucket below which the fraction q of all
+ * values lie */
+static uint64_t histogram_quantile(const pa_histogram_info *h, double q) {
+    uint64_t n, seen = 0;
+    uint32_t j;
+
+    if (h->count == 0)
+        return 0;
+
+    n = PA_MAX((uint64_t) (q * (double) h->count + 0.5), (uint64_t) 1);
+
+    for (j = 0; j < h->n_buckets; j++) {
+        seen += h->buckets[j].count;
+
+        if (seen >= n)
+            return PA_MIN(h->buckets[j].upper_bound, h->max);
+    }
+
+    return h->max;
+}
+
+static void print_histogram(const char *name, const pa_histogram_info *h, const char *unit) {
+    if (h->count == 0) {
+        printf(_("\t%s: n/a\n"), name);
+        return;
+    }
+
+    printf(_("\t%s: %llu samples, min %llu %s, avg %llu %s, median %llu %s, 99%% %llu %s, 99.9%% %llu %s, max %llu %s\n"),
+           name, (unsigned long long) h->count,
+           (unsigned long long) h->min, unit,
+           (unsigned long long) (h->sum / h->count), unit,
+           (unsigned long long) histogram_quantile(h, 0.5), unit,
+           (unsigned long long) histogram_quantile(h, 0.99), unit,
+           (unsigned long long) histogram_quantile(h, 0.999), unit,
+           (unsigned long long) h->max, unit);
+}
+
+static void get_timing_info_callback(pa_context *c, const pa_io_timing_info *i, int is_last, void *userdata) {
+    bool sink = PA_PTR_TO_UINT(userdata);
+
+    if (is_last < 0) {
+        pa_log(_("Failed to get timing information: %s"), pa_strerror(pa_context_errno(c)));
+        complete_action();
+        return;
+    }
+
+    if (is_last) {
+        complete_action();
+        return;
+    }
+
+    pa_assert(i);
+
+    if (nl && !short_list_format)
+        printf("\n");
+    nl = true;
+
+    if (short_list_format) {
+        printf("%u\t%s\t%llu\t%llu\t%llu\t%llu\n", i->index, i->name,
+               (unsigned long long) histogram_quantile(&i->process_usec, 0.5),
+               (unsigned long long) histogram_quantile(&i->process_usec, 0.99),
+               (unsigned long long) i->process_usec.max,
+               (unsigned long long) i->wakeup_lateness_usec.max);
+        return;
+    }
+
+    printf(sink ? _("Sink Timing #%u\n") : _("Source Timing #%u\n"), i->index);
+    printf(_("\tName: %s\n"), i->name);
+    print_histogram(sink ? _("Render") : _("Post"), &i->process_usec, "usec");
+    print_histogram(_("Resample"), &i->resample_usec, "usec");
+    print_histogram(_("Wakeup Lateness"), &i->wakeup_lateness_usec, "usec");
+    print_histogram(_("Rewind"), &i->rewind_bytes, "bytes");
+}
+
 static void get_card_info_callback(pa_context *c, const pa_card_info *i, int is_last, void *userdata) {
     char t[32];
     char *pl;
@@ -1245,6 +1319,10 @@ static void context_state_callback(pa_context *c, void *userdata) {
                             o = pa_context_get_sample_info_list(c, get_sample_info_callback, NULL);
                         else if (pa_streq(list_type, "cards"))
                             o = pa_context_get_card_info_list(c, get_card_info_callback, NULL);
+                        else if (pa_streq(list_type, "sink-timing"))
+                            o = pa_context_get_sink_timing_info_list(c, get_timing_info_callback, PA_UINT_TO_PTR(true));
+                        else if (pa_streq(list_type, "source-timing"))
+                            o = pa_context_get_source_timing_info_list(c, get_timing_info_callback, PA_UINT_TO_PTR(false));
                         else
                             pa_assert_not_reached();
                     } else {
@@ -1676,12 +1754,13 @@ int main(int argc, char *argv[]) {
                 if (pa_streq(argv[i], "modules") || pa_streq(argv[i], "clients") ||
                     pa_streq(argv[i], "sinks")   || pa_streq(argv[i], "sink-inputs") ||
                     pa_streq(argv[i], "sources") || pa_streq(argv[i], "source-outputs") ||
-                    pa_streq(argv[i], "samples") || pa_streq(argv[i], "cards")) {
+                    pa_streq(argv[i], "samples") || pa_streq(argv[i], "cards") ||
+                    pa_streq(argv[i], "sink-timing") || pa_streq(argv[i], "source-timing")) {
                     list_type = pa_xstrdup(argv[i]);
                 } else if (pa_streq(argv[i], "short")) {
                     short_list_format = true;
                 } else {
-                    pa_log(_("Specify nothing, or one of: %s"), "modules, sinks, sources, sink-inputs, source-outputs, clients, samples, cards");
+                    pa_log(_("Specify nothing, or one of: %s"), "modules, sinks, sources, sink-inputs, source-outputs, clients, samples, cards, sink-timing, source-timing");
                     goto quit;
                 }
             }